@@ -12,16 +12,30 @@
 
 #include "buffer/buffer_pool_manager.h"
 
+#include <sys/mman.h>
+
+#include <algorithm>
 #include <list>
 #include <unordered_map>
+#include <vector>
+#include "common/exception.h"
 #include "include/common/logger.h"  // 日志调试
 
 namespace bustub {
 
-BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager)
+/** Size of a huge page on x86-64 Linux, the arena is rounded up to it when huge pages are requested. */
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager,
+                                     bool use_huge_pages)
     : pool_size_(pool_size), disk_manager_(disk_manager), log_manager_(log_manager) {
   // We allocate a consecutive memory space for the buffer pool.
+  // 先映射frame内存，映射失败时抛出异常，此时还没有分配pages_和replacer_，不会泄漏
+  AllocateFrameArena(use_huge_pages);
   pages_ = new Page[pool_size_];
+  for (size_t i = 0; i < pool_size_; ++i) {
+    pages_[i].data_ = frame_arena_ + i * PAGE_SIZE;
+  }
   replacer_ = new LRUReplacer(pool_size);
 
   // Initially, every page is in the free list.
@@ -32,9 +46,39 @@ BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager
 
 BufferPoolManager::~BufferPoolManager() {
   delete[] pages_;
+  munmap(frame_arena_, arena_size_);
   delete replacer_;
 }
 
+/*
+ * 所有frame的data_都来自同一块按PAGE_SIZE对齐的匿名映射内存，这样可以直接交给O_DIRECT读写
+ * 匿名映射的内存已经被内核清零，不需要再ResetMemory
+ */
+void BufferPoolManager::AllocateFrameArena(bool use_huge_pages) {
+  arena_size_ = std::max<size_t>(pool_size_, 1) * PAGE_SIZE;
+  void *arena = MAP_FAILED;
+  if (use_huge_pages) {
+    arena_size_ = (arena_size_ + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    // 1 优先使用预留的huge pages（需要系统配置vm.nr_hugepages）
+    arena = mmap(nullptr, arena_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    arena_huge_pages_ = arena != MAP_FAILED;
+  }
+  if (arena == MAP_FAILED) {
+    arena = mmap(nullptr, arena_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "can't map buffer pool frames");
+    }
+    // 2 没有预留的huge pages时，退而请求transparent huge pages
+    if (use_huge_pages) {
+      arena_huge_pages_ = madvise(arena, arena_size_, MADV_HUGEPAGE) == 0;
+      if (!arena_huge_pages_) {
+        LOG_WARN("huge pages unavailable, buffer pool uses regular pages");
+      }
+    }
+  }
+  frame_arena_ = static_cast<char *>(arena);
+}
+
 /*
 注意pin_count的变化：
 1. when new a page, set this page's pin_count = 1
@@ -187,7 +231,7 @@ bool BufferPoolManager::FlushPageImpl(page_id_t page_id) {
  * @param[out] page_id id of created page
  * @return nullptr if no new pages could be created, otherwise pointer to new page
  */
-Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
+Page *BufferPoolManager::NewPageImpl(page_id_t *page_id, segment_id_t segment_id) {
   // 0.   Make sure you call DiskManager::AllocatePage!
   // 1.   If all the pages in the buffer pool are pinned, return nullptr.
   // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
@@ -201,8 +245,17 @@ Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
     return nullptr;
   }
   // 2 得到victim frame_id（从free_list或replacer中得到）
-  *page_id = disk_manager_->AllocatePage();  // 分配一个新的page_id（修改了外部参数*page_id）
-  Page *page = &pages_[frame_id];            // 由frame_id得到page
+  *page_id = disk_manager_->AllocatePage(segment_id);  // 分配一个新的page_id（修改了外部参数*page_id）
+  if (*page_id == INVALID_PAGE_ID) {
+    // 段不存在或已满，把victim frame原样还回去：空frame回到free_list，仍存着page的frame回到replacer
+    if (pages_[frame_id].page_id_ == INVALID_PAGE_ID) {
+      free_list_.push_front(frame_id);
+    } else {
+      replacer_->Unpin(frame_id);
+    }
+    return nullptr;
+  }
+  Page *page = &pages_[frame_id];  // 由frame_id得到page
   // pages_[frame_id]就是首地址偏移frame_id，左边的*page表示是一个指针指向那个地址，所以右边加&
   UpdatePage(page, *page_id, frame_id);
   page->pin_count_ = 1;  // 这里特别注意！每个新建page的pin_count初始为1
@@ -237,19 +290,69 @@ bool BufferPoolManager::DeletePageImpl(page_id_t page_id) {
   disk_manager_->DeallocatePage(page_id);
   UpdatePage(page, INVALID_PAGE_ID, frame_id);
   page->pin_count_ = 0;            // 删除page后，pin_count置0
+  replacer_->Pin(frame_id);        // 从replacer中移除，否则frame从free_list重新分配后仍可能被驱逐
   free_list_.push_back(frame_id);  // 加到尾部
   return true;
 }
 
+/*
+先检查再驱逐，保证要么整个段都被驱逐，要么什么都不做
+*/
+bool BufferPoolManager::DiscardSegmentPages(segment_id_t segment_id) {
+  std::vector<frame_id_t> frames;
+  for (const auto &[page_id, frame_id] : page_table_) {
+    if (DiskManager::GetSegmentId(page_id) == segment_id) {
+      if (pages_[frame_id].GetPinCount() > 0) {
+        return false;
+      }
+      frames.push_back(frame_id);
+    }
+  }
+  for (frame_id_t frame_id : frames) {
+    Page *page = &pages_[frame_id];
+    page->is_dirty_ = false;  // 段里的数据马上就要被删除，不必写回
+    UpdatePage(page, INVALID_PAGE_ID, frame_id);
+    page_table_.erase(INVALID_PAGE_ID);
+    replacer_->Pin(frame_id);  // 从replacer中移除
+    free_list_.push_back(frame_id);
+  }
+  return true;
+}
+
+bool BufferPoolManager::DropSegment(segment_id_t segment_id) {
+  std::scoped_lock lock{latch_};
+  if (!DiscardSegmentPages(segment_id)) {
+    return false;
+  }
+  disk_manager_->DropSegment(segment_id);
+  return true;
+}
+
+bool BufferPoolManager::TruncateSegment(segment_id_t segment_id) {
+  std::scoped_lock lock{latch_};
+  if (!DiscardSegmentPages(segment_id)) {
+    return false;
+  }
+  disk_manager_->TruncateSegment(segment_id);
+  return true;
+}
+
 /**
  * Flushes all the pages in the buffer pool to disk.
  */
 void BufferPoolManager::FlushAllPagesImpl() {
   // You can do it!
+  // 不能调用FlushPageImpl：它会再次获取latch_；而且页表中的key才是page_id，frame下标不是
   std::scoped_lock lock{latch_};
-  for (size_t i = 0; i < pool_size_; i++) {
-    FlushPageImpl(i);
+  for (const auto &[page_id, frame_id] : page_table_) {
+    Page *page = &pages_[frame_id];
+    if (page_id != INVALID_PAGE_ID && page->IsDirty()) {
+      disk_manager_->WritePage(page_id, page->data_);
+      page->is_dirty_ = false;
+    }
   }
+  // 写回的page还在OS page cache里，fsync之后才算真正落盘
+  disk_manager_->Sync();
 }
 
 }  // namespace bustub
@@ -56,8 +56,10 @@ class BufferPoolManager {
    * @param pool_size the size of the buffer pool
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param use_huge_pages back the frame arena with huge pages if the system provides them
    */
-  BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr);
+  BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                    bool use_huge_pages = false);
 
   /**
    * Destroys an existing BufferPoolManager.
@@ -111,12 +113,49 @@ class BufferPoolManager {
     GradingCallback(callback, CallbackType::AFTER, INVALID_PAGE_ID);
   }
 
+  /**
+   * Creates a new page that is allocated from a segment of the disk manager instead of the main db file.
+   * @param[out] page_id id of created page
+   * @param segment_id segment to allocate the page from
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  Page *NewPage(page_id_t *page_id, segment_id_t segment_id) { return NewPageImpl(page_id, segment_id); }
+
+  /**
+   * @param page_id id of the page
+   * @return true if the page is in the buffer pool; it is not fetched and may be evicted right after
+   */
+  bool IsResident(page_id_t page_id) {
+    std::scoped_lock lock{latch_};
+    return page_table_.count(page_id) > 0;
+  }
+
+  /**
+   * Drops a segment: its cached pages are discarded without being written back, then its file is removed.
+   * @param segment_id id of the segment
+   * @return false if a page of the segment is still pinned, nothing is dropped then
+   */
+  bool DropSegment(segment_id_t segment_id);
+
+  /**
+   * Removes every page of a segment, like DropSegment but the segment stays usable.
+   * @param segment_id id of the segment
+   * @return false if a page of the segment is still pinned, nothing is truncated then
+   */
+  bool TruncateSegment(segment_id_t segment_id);
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
   /** @return size of the buffer pool */
   size_t GetPoolSize() { return pool_size_; }
 
+  /** @return the disk manager of the buffer pool, for writers that fill pages of a segment without caching them */
+  DiskManager *GetDiskManager() { return disk_manager_; }
+
+  /** @return true if the frame arena is backed by huge pages (explicit or transparent) */
+  bool UsesHugePages() const { return arena_huge_pages_; }
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -156,9 +195,10 @@ class BufferPoolManager {
   /**
    * Creates a new page in the buffer pool.
    * @param[out] page_id id of created page
+   * @param segment_id segment to allocate the page from
    * @return nullptr if no new pages could be created, otherwise pointer to new page
    */
-  Page *NewPageImpl(page_id_t *page_id);
+  Page *NewPageImpl(page_id_t *page_id, segment_id_t segment_id = DEFAULT_SEGMENT_ID);
 
   /**
    * Deletes a page from the buffer pool.
@@ -175,6 +215,18 @@ class BufferPoolManager {
   bool FindVictimPage(frame_id_t *frame_id);
   void UpdatePage(Page *page, page_id_t page_id, frame_id_t frame_id);
 
+  /**
+   * Evicts every page of a segment from the buffer pool without writing it back (caller holds latch_).
+   * @return false if a page of the segment is pinned, nothing is evicted then
+   */
+  bool DiscardSegmentPages(segment_id_t segment_id);
+
+  /**
+   * Maps the PAGE_SIZE-aligned arena that holds the data of every frame.
+   * @param use_huge_pages try MAP_HUGETLB first, then fall back to transparent huge pages
+   */
+  void AllocateFrameArena(bool use_huge_pages);
+
   // 这里需要理解：pages就是缓冲区当前存的pool_size个page，可以用frame_id作为下标取出缓冲区的单个page
   // page_id表示由diskmanager分配得到的page编号，目前是id自增策略，它的大小完全有可能超过pool_size
   // frame_id表示缓冲区中的每页占的位置，它的范围只能是[0,pool_size)
@@ -184,6 +236,12 @@ class BufferPoolManager {
   size_t pool_size_;
   /** Array of buffer pool pages. 大小为pool_size_，下标为[0,pool_size_) */
   Page *pages_;
+  /** Frame data of all pages, frame i lives at frame_arena_ + i * PAGE_SIZE. */
+  char *frame_arena_;
+  /** Mapped size of frame_arena_, rounded up to the huge page size when huge pages are requested. */
+  size_t arena_size_;
+  /** True if frame_arena_ is backed by huge pages. */
+  bool arena_huge_pages_{false};
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
@@ -8,6 +8,7 @@
 
 #include "buffer/buffer_pool_manager.h"
 #include "catalog/schema.h"
+#include "storage/index/art_index.h"
 #include "storage/index/b_plus_tree_index.h"
 #include "storage/index/index.h"
 #include "storage/table/table_heap.h"
@@ -21,6 +22,14 @@ using table_oid_t = uint32_t;
 using column_oid_t = uint32_t;
 using index_oid_t = uint32_t;
 
+/** Index implementations that CreateIndex can build. */
+enum class IndexType {
+  /** BPlusTreeIndex, pages in the buffer pool. */
+  BPLUS_TREE,
+  /** ARTIndex, in memory, for lookup tables that are cached anyway; point lookups only. */
+  ART,
+};
+
 /**
  * Metadata about a table.
  */
@@ -77,14 +86,18 @@ class Catalog {
    */
   TableMetadata *CreateTable(Transaction *txn, const std::string &table_name, const Schema &schema) {
     BUSTUB_ASSERT(names_.count(table_name) == 0, "Table names should be unique!");
-    return nullptr;
+    table_oid_t oid = next_table_oid_++;
+    auto table = std::make_unique<TableHeap>(bpm_, lock_manager_, log_manager_, txn);
+    tables_[oid] = std::make_unique<TableMetadata>(schema, table_name, std::move(table), oid);
+    names_[table_name] = oid;
+    return tables_[oid].get();
   }
 
-  /** @return table metadata by name */
-  TableMetadata *GetTable(const std::string &table_name) { return nullptr; }
+  /** @return table metadata by name, throws std::out_of_range if there is no such table */
+  TableMetadata *GetTable(const std::string &table_name) { return GetTable(names_.at(table_name)); }
 
-  /** @return table metadata by oid */
-  TableMetadata *GetTable(table_oid_t table_oid) { return nullptr; }
+  /** @return table metadata by oid, throws std::out_of_range if there is no such table */
+  TableMetadata *GetTable(table_oid_t table_oid) { return tables_.at(table_oid).get(); }
 
   /**
    * Create a new index, populate existing data of the table and return its metadata.
@@ -95,25 +108,64 @@ class Catalog {
    * @param key_schema the schema of the key
    * @param key_attrs key attributes
    * @param keysize size of the key
+   * @param index_type implementation of the index, the template arguments only matter for IndexType::BPLUS_TREE
+   * @param include_attrs columns stored in the entries besides the key (covering index), only supported by
+   * IndexType::BPLUS_TREE; the key and the included columns have to fit into KeyType together
    * @return a pointer to the metadata of the new table
    */
   template <class KeyType, class ValueType, class KeyComparator>
   IndexInfo *CreateIndex(Transaction *txn, const std::string &index_name, const std::string &table_name,
                          const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs,
-                         size_t keysize) {
-    return nullptr;
+                         size_t keysize, IndexType index_type = IndexType::BPLUS_TREE,
+                         const std::vector<uint32_t> &include_attrs = {}) {
+    TableMetadata *table = GetTable(table_name);
+    BUSTUB_ASSERT(index_names_[table_name].count(index_name) == 0, "Index names should be unique!");
+    auto metadata = new IndexMetadata(index_name, table_name, &schema, key_attrs, KeyFormat::RAW, true, include_attrs);
+    std::unique_ptr<Index> index;
+    if (index_type == IndexType::ART) {
+      if (!include_attrs.empty()) {
+        delete metadata;
+        throw Exception(ExceptionType::NOT_IMPLEMENTED, "ARTIndex cannot store included columns");
+      }
+      index = std::make_unique<ARTIndex>(metadata);
+    } else {
+      index = std::make_unique<BPlusTreeIndex<KeyType, ValueType, KeyComparator>>(metadata, bpm_);
+    }
+    // 把表中已有的tuple加入索引
+    for (auto iterator = table->table_->Begin(txn); iterator != table->table_->End(); ++iterator) {
+      index->InsertEntry(iterator->KeyFromTuple(schema, *metadata->GetEntrySchema(), metadata->GetEntryAttrs()),
+                         iterator->GetRid(), txn);
+    }
+    index_oid_t oid = next_index_oid_++;
+    indexes_[oid] = std::make_unique<IndexInfo>(key_schema, index_name, std::move(index), oid, table_name, keysize);
+    index_names_[table_name][index_name] = oid;
+    return indexes_[oid].get();
   }
 
-  IndexInfo *GetIndex(const std::string &index_name, const std::string &table_name) { return nullptr; }
-
-  IndexInfo *GetIndex(index_oid_t index_oid) { return nullptr; }
+  /** @return index metadata by name, throws std::out_of_range if there is no such index */
+  IndexInfo *GetIndex(const std::string &index_name, const std::string &table_name) {
+    return GetIndex(index_names_.at(table_name).at(index_name));
+  }
 
-  std::vector<IndexInfo *> GetTableIndexes(const std::string &table_name) { return std::vector<IndexInfo *>(); }
+  /** @return index metadata by oid, throws std::out_of_range if there is no such index */
+  IndexInfo *GetIndex(index_oid_t index_oid) { return indexes_.at(index_oid).get(); }
+
+  /** @return the indexes of a table */
+  std::vector<IndexInfo *> GetTableIndexes(const std::string &table_name) {
+    std::vector<IndexInfo *> indexes;
+    auto it = index_names_.find(table_name);
+    if (it != index_names_.end()) {
+      for (const auto &[index_name, oid] : it->second) {
+        indexes.push_back(indexes_.at(oid).get());
+      }
+    }
+    return indexes;
+  }
 
  private:
-  [[maybe_unused]] BufferPoolManager *bpm_;
-  [[maybe_unused]] LockManager *lock_manager_;
-  [[maybe_unused]] LogManager *log_manager_;
+  BufferPoolManager *bpm_;
+  LockManager *lock_manager_;
+  LogManager *log_manager_;
 
   /** tables_ : table identifiers -> table metadata. Note that tables_ owns all table metadata. */
   std::unordered_map<table_oid_t, std::unique_ptr<TableMetadata>> tables_;
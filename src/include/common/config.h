@@ -35,9 +35,13 @@ static constexpr int PAGE_SIZE = 4096;                                        //
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int DEFAULT_SEGMENT_ID = 0;                                  // segment of the main db file
+static constexpr int SEGMENT_PAGE_BITS = 24;                                  // bits of the page number in a page id
+static constexpr int MAX_SEGMENTS = 128;                                      // segment ids use the remaining 7 bits
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
+using segment_id_t = int32_t;  // segment (tablespace file) id type
 using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
 using slot_offset_t = size_t;  // slot offset type
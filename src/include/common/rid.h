@@ -34,7 +34,11 @@ class RID {
 
   explicit RID(int64_t rid) : page_id_(static_cast<page_id_t>(rid >> 32)), slot_num_(static_cast<uint32_t>(rid)) {}
 
-  inline int64_t Get() const { return (static_cast<int64_t>(page_id_)) << 32 | slot_num_; }
+  /** @return the rid as one integer, page id in the upper half; rids compare in the order of their page id and slot */
+  inline int64_t Get() const {
+    // shift the page id as an unsigned value, shifting a negative value left is undefined
+    return static_cast<int64_t>(static_cast<uint64_t>(static_cast<uint32_t>(page_id_)) << 32 | slot_num_);
+  }
 
   inline page_id_t GetPageId() const { return page_id_; }
 
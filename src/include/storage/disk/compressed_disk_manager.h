@@ -0,0 +1,177 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compressed_disk_manager.h
+//
+// Identification: src/include/storage/disk/compressed_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * PageCodec is a small LZ77 codec in the spirit of LZ4: a greedy matcher with a single-entry hash table, and a byte
+ * oriented format of (literals, match) sequences. It favors speed over ratio, which suits pages that are compressed
+ * on every write-back. Runs of zeroes, e.g. the free space of a page, collapse into a single overlapping match.
+ */
+class PageCodec {
+ public:
+  /**
+   * Compress a buffer.
+   * @param src data to compress
+   * @param size size of src
+   * @param[out] dst output buffer
+   * @param capacity size of dst
+   * @return size of the compressed data, 0 if it does not fit into capacity bytes
+   */
+  static size_t Compress(const char *src, size_t size, char *dst, size_t capacity);
+
+  /**
+   * Decompress a buffer produced by Compress.
+   * @param src compressed data
+   * @param size size of src
+   * @param[out] dst output buffer
+   * @param dst_size exact size of the uncompressed data
+   * @return false if src is corrupt
+   */
+  static bool Decompress(const char *src, size_t size, char *dst, size_t dst_size);
+};
+
+/** Counters of a CompressedDiskManager. */
+struct CompressionStats {
+  /** Number of pages written. */
+  uint64_t pages_written_{0};
+  /** Number of written pages that did not compress and were stored raw. */
+  uint64_t pages_stored_raw_{0};
+  /** Bytes handed to WritePage, PAGE_SIZE per page. */
+  uint64_t bytes_in_{0};
+  /** Bytes of the slots the written pages were stored in. */
+  uint64_t bytes_stored_{0};
+  /** Time spent compressing pages. */
+  uint64_t compress_ns_{0};
+  /** Time spent decompressing pages. */
+  uint64_t decompress_ns_{0};
+
+  /** @return bytes_in / bytes_stored, 1 if nothing was written yet */
+  double GetCompressionRatio() const {
+    return bytes_stored_ == 0 ? 1 : static_cast<double>(bytes_in_) / static_cast<double>(bytes_stored_);
+  }
+};
+
+/**
+ * CompressedDiskManager stores pages compressed with PageCodec. A compressed page goes into a slot of one of a few
+ * size classes (512 B to PAGE_SIZE), a page that does not compress below half a page is stored raw. A page map
+ * records the slot and the compressed size of every page. Every write of a page goes to a fresh slot, the slot it
+ * replaces is reused by the next page of its size class. The page map is saved next to the db file on Sync and
+ * ShutDown and loaded again when the database is opened.
+ *
+ * A freed slot is only reused after a page map that no longer refers to it has been saved, so the saved page map
+ * never points at a slot that holds another page: after a crash every page reads back as it was when the page map was
+ * last saved, or as a later write of it.
+ *
+ * Slots are not block aligned, so the compressed format always uses buffered I/O.
+ */
+class CompressedDiskManager : public DiskManager {
+ public:
+  /**
+   * Creates a new disk manager that writes compressed pages to the specified database file.
+   * @param db_file the file name of the database file to write to
+   */
+  explicit CompressedDiskManager(const std::string &db_file);
+
+  ~CompressedDiskManager() override;
+
+  /** Saves the page map, then closes all files. */
+  void ShutDown() override;
+
+  void DropSegment(segment_id_t segment_id) override;
+
+  void TruncateSegment(segment_id_t segment_id) override;
+
+  /** @return a snapshot of the compression counters */
+  CompressionStats GetCompressionStats() const;
+
+  /** @return the number of bytes occupied by slots in all files, used or free */
+  uint64_t GetStoredSize();
+
+ protected:
+  void WritePageImpl(page_id_t page_id, const char *page_data) override;
+
+  /** Pages that were never written read as zeroes. */
+  void ReadPageImpl(page_id_t page_id, char *page_data) override;
+
+  /** Saves the page map as well, a synced page is only durable together with its slot. */
+  void SyncImpl() override;
+
+ private:
+  /** Number of slot size classes, class i holds slots of MIN_SLOT_SIZE << i bytes. */
+  static constexpr int NUM_SIZE_CLASSES = 4;
+  static constexpr int MIN_SLOT_SIZE = PAGE_SIZE >> (NUM_SIZE_CLASSES - 1);
+
+  /** Where a page is stored. */
+  struct Slot {
+    uint64_t offset_;
+    /** Size class of the slot. */
+    uint16_t size_class_;
+    /** Bytes of compressed data in the slot, PAGE_SIZE for a page stored raw. */
+    uint16_t stored_size_;
+  };
+
+  /** Slot allocation state of one file. */
+  struct SlotAllocator {
+    /** End of the last slot, new slots are appended there. */
+    uint64_t end_{0};
+    /** Offsets of free slots per size class. */
+    std::array<std::vector<uint64_t>, NUM_SIZE_CLASSES> free_slots_;
+    /** Freed slots the saved page map may still refer to, they become free once the page map is saved. */
+    std::array<std::vector<uint64_t>, NUM_SIZE_CLASSES> pending_free_slots_;
+  };
+
+  /** @return the smallest size class that holds stored_size bytes */
+  static uint16_t GetSizeClass(size_t stored_size);
+
+  /** @return a free slot of the size class in the segment (caller holds map_latch_) */
+  uint64_t AllocateSlot(segment_id_t segment_id, uint16_t size_class);
+
+  /** Forgets every page of a segment (caller holds map_latch_). */
+  void ClearSegment(segment_id_t segment_id);
+
+  void LoadPageMap();
+
+  /** Saves the page map, then releases the slots that were pending when it was written. */
+  void SavePageMap();
+
+  std::string page_map_name_;
+  /** Protects page_map_ and allocators_. */
+  std::mutex map_latch_;
+  std::unordered_map<page_id_t, Slot> page_map_;
+  /** One allocator per segment. */
+  std::vector<SlotAllocator> allocators_;
+  /** Serializes SavePageMap with ClearSegment, so the slots a save releases go back to the allocator they came from. */
+  std::mutex save_latch_;
+  bool page_map_saved_{false};
+
+  std::atomic<uint64_t> pages_written_{0};
+  std::atomic<uint64_t> pages_stored_raw_{0};
+  std::atomic<uint64_t> bytes_stored_{0};
+  std::atomic<uint64_t> compress_ns_{0};
+  std::atomic<uint64_t> decompress_ns_{0};
+};
+
+}  // namespace bustub
@@ -12,33 +12,47 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <fstream>
 #include <future>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <vector>
 
 #include "common/config.h"
+#include "storage/disk/disk_stats.h"
 
 namespace bustub {
 
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * Besides the main db file (segment 0), a table or index can get a segment of its own: a separate tablespace file
+ * next to the db file. The upper bits of a page id hold the segment id and the lower SEGMENT_PAGE_BITS number the
+ * page inside the segment, so pages of segment 0 keep their plain ids.
+ *
+ * Every page and log request is counted and timed (see GetStats and GetLatencyHistogram). Subclasses that store
+ * pages elsewhere override the *Impl methods, the public methods around them do the book-keeping.
  */
 class DiskManager {
  public:
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param direct_io open the database file with O_DIRECT so that pages bypass the OS page cache
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, bool direct_io = false);
 
-  ~DiskManager() = default;
+  virtual ~DiskManager();
 
   /**
    * Shut down the disk manager and close all the file resources.
    */
-  void ShutDown();
+  virtual void ShutDown();
 
   /**
    * Write a page to the database file.
@@ -61,6 +75,11 @@ class DiskManager {
    */
   void WriteLog(char *log_data, int size);
 
+  /**
+   * Flush the pages written so far from the OS page cache to the device (fsync of every page file).
+   */
+  void Sync();
+
   /**
    * Read a log entry from the log file.
    * @param[out] log_data output buffer
@@ -68,7 +87,7 @@ class DiskManager {
    * @param offset offset of the log entry in the file
    * @return true if the read was successful, false otherwise
    */
-  bool ReadLog(char *log_data, int size, int offset);
+  virtual bool ReadLog(char *log_data, int size, int offset);
 
   /**
    * Allocate a page on disk.
@@ -76,6 +95,47 @@ class DiskManager {
    */
   page_id_t AllocatePage();
 
+  /**
+   * Allocate a page in the given segment. Segment files grow by whole extents, which are preallocated with
+   * fallocate so that the pages of one object stay contiguous on disk.
+   * @param segment_id id of the segment
+   * @return the id of the allocated page, INVALID_PAGE_ID if the segment does not exist or is full
+   */
+  virtual page_id_t AllocatePage(segment_id_t segment_id);
+
+  /**
+   * Open the segment of a table or index, creating its file if needed. Segment ids are recorded in a directory
+   * file, so reopening the database maps each name to the same id again.
+   * @param name name of the table or index, used in the file name of the segment
+   * @return the id of the segment
+   */
+  virtual segment_id_t CreateSegment(const std::string &name);
+
+  /**
+   * Drop a segment by unlinking its file. Its id may be reused by a later CreateSegment.
+   * @param segment_id id of the segment, the main db file cannot be dropped
+   */
+  virtual void DropSegment(segment_id_t segment_id);
+
+  /**
+   * Remove every page of a segment but keep the segment, page numbers start over at 0.
+   * @param segment_id id of the segment, the main db file cannot be truncated
+   */
+  virtual void TruncateSegment(segment_id_t segment_id);
+
+  /** @return the page id of the page_no-th page of a segment */
+  static constexpr page_id_t MakePageId(segment_id_t segment_id, page_id_t page_no) {
+    return (segment_id << SEGMENT_PAGE_BITS) | page_no;
+  }
+
+  /** @return the segment a page belongs to */
+  static constexpr segment_id_t GetSegmentId(page_id_t page_id) { return page_id >> SEGMENT_PAGE_BITS; }
+
+  /** @return the position of a page inside its segment */
+  static constexpr page_id_t GetPageNumber(page_id_t page_id) {
+    return page_id & ((1 << SEGMENT_PAGE_BITS) - 1);
+  }
+
   /**
    * Deallocate a page on disk.
    * @param page_id id of the page to deallocate
@@ -91,6 +151,36 @@ class DiskManager {
   /** @return the number of disk writes */
   int GetNumWrites() const;
 
+  /** @return true if page I/O bypasses the OS page cache */
+  bool IsDirectIO() const { return direct_io_; }
+
+  /** @return a snapshot of the I/O counters */
+  DiskStats GetStats() const;
+
+  /** @return the latency histogram of the given kind of request */
+  const LatencyHistogram &GetLatencyHistogram(IOKind kind) const { return latencies_[static_cast<int>(kind)]; }
+
+  /** Reset the I/O counters and latency histograms, GetNumWrites and GetNumFlushes are not affected. */
+  void ResetStats();
+
+  /**
+   * Start tracing page requests into a ring buffer, replacing the previous trace.
+   * @param capacity number of most recent requests to keep
+   */
+  void EnableTrace(size_t capacity);
+
+  /** Stop tracing, the records so far are dropped. */
+  void DisableTrace();
+
+  /** @return the traced requests, oldest first, empty if tracing is disabled */
+  std::vector<IOTraceRecord> GetTrace() const;
+
+  /**
+   * Dump the traced requests to a CSV file for offline analysis.
+   * @return false if tracing is disabled or the file could not be written
+   */
+  bool DumpTrace(const std::string &file_name) const;
+
   /**
    * Sets the future which is used to check for non-blocking flushes.
    * @param f the non-blocking flush check
@@ -100,19 +190,102 @@ class DiskManager {
   /** Checks if the non-blocking flush future was set. */
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
- private:
+ protected:
+  /** Creates a disk manager without any backing files, for subclasses that keep pages elsewhere. */
+  DiskManager();
+
+  /** Writes a page, see WritePage. */
+  virtual void WritePageImpl(page_id_t page_id, const char *page_data);
+
+  /** Reads a page, see ReadPage. */
+  virtual void ReadPageImpl(page_id_t page_id, char *page_data);
+
+  /** Writes the log buffer, see WriteLog. */
+  virtual void WriteLogImpl(char *log_data, int size);
+
+  /** Makes written pages durable, see Sync. */
+  virtual void SyncImpl();
+
+  /** Counts and times a request, traces it if tracing is enabled. Called after the request completed. */
+  void RecordRequest(IOKind kind, page_id_t page_id, uint64_t bytes, std::chrono::nanoseconds latency,
+                     uint64_t queue_depth);
+
+  /**
+   * Book-keeping shared by every WriteLog implementation: enforces the log buffer swap and waits for the flush.
+   * @return false if the log buffer is empty and there is nothing to write
+   */
+  bool BeginLogFlush(char *log_data, int size);
+
   int GetFileSize(const std::string &file_name);
+
+  /**
+   * A tablespace file other than the main db file. Readers and writers hold a reference while they use fd_, so the
+   * file is closed when the segment is dropped and its last I/O has finished.
+   */
+  struct Segment {
+    ~Segment();
+    std::string name_;
+    std::string file_name_;
+    int fd_{-1};
+    // number of pages handed out so far
+    page_id_t next_page_no_{0};
+    // number of pages covered by preallocated extents
+    page_id_t preallocated_pages_{0};
+  };
+
+  /**
+   * @return the file descriptor that holds the page, -1 if its segment does not exist. *segment keeps the file of a
+   * segment open until the caller releases it.
+   */
+  int GetPageFd(page_id_t page_id, std::shared_ptr<Segment> *segment);
+
+  /** @return the segment with the given id (caller holds segment_latch_), nullptr if it does not exist */
+  Segment *GetSegment(segment_id_t segment_id);
+
+  /** @return the name of the file that holds the segment with the given name */
+  std::string GetSegmentFileName(const std::string &name) const;
+
+  /** Opens the file of a segment, honoring direct_io_. */
+  int OpenSegmentFile(const std::string &file_name);
+
+  /** Loads the segment directory written by SaveSegmentDirectory. */
+  void LoadSegmentDirectory();
+
+  /** Rewrites the segment directory (caller holds segment_latch_). */
+  void SaveSegmentDirectory();
+
   // stream to write log file
   std::fstream log_io_;
   std::string log_name_;
-  // stream to write db file
-  std::fstream db_io_;
+  // file descriptor of the db file, pages are read and written with pread/pwrite
+  int db_fd_;
   std::string file_name_;
+  bool direct_io_;
   std::atomic<page_id_t> next_page_id_;
-  int num_flushes_;
-  int num_writes_;
+  std::atomic<int> num_flushes_;
+  std::atomic<int> num_writes_;
   bool flush_log_;
   std::future<void> *flush_log_f_;
+  // file mapping segment ids to names, stored next to the db file
+  std::string segment_dir_name_;
+  // protects segments_, slot 0 is always empty since segment 0 is the db file itself
+  std::mutex segment_latch_;
+  std::vector<std::shared_ptr<Segment>> segments_;
+  // false if pages are not stored at page_no * PAGE_SIZE, extents of raw pages would only waste space then
+  bool preallocate_extents_{true};
+
+  // I/O statistics, indexed by IOKind
+  std::array<std::atomic<uint64_t>, NUM_IO_KINDS> requests_{};
+  std::array<std::atomic<uint64_t>, NUM_IO_KINDS> bytes_{};
+  std::array<LatencyHistogram, NUM_IO_KINDS> latencies_;
+  // number of requests currently being served
+  std::atomic<uint64_t> in_flight_{0};
+  std::atomic<uint64_t> queue_depth_sum_{0};
+  std::atomic<uint64_t> max_queue_depth_{0};
+  // trace of page requests, only read through std::atomic_load since it is replaced while requests are in flight
+  std::shared_ptr<IOTrace> trace_;
+  // fast check on the I/O path, so that requests skip the atomic_load while tracing is disabled
+  std::atomic<bool> tracing_{false};
 };
 
 }  // namespace bustub
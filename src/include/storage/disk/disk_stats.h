@@ -0,0 +1,144 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_stats.h
+//
+// Identification: src/include/storage/disk/disk_stats.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/** Kinds of requests a DiskManager serves. */
+enum class IOKind : uint8_t { READ = 0, WRITE, LOG_WRITE, SYNC };
+
+static constexpr int NUM_IO_KINDS = 4;
+
+/** @return name of the request kind, as used in trace dumps */
+const char *IOKindToString(IOKind kind);
+
+/**
+ * LatencyHistogram counts latencies in power-of-two buckets: bucket i holds latencies in [2^i, 2^(i+1)) ns, bucket
+ * 0 also holds zero. Recording is a single relaxed atomic increment, so it can sit on the I/O path of every thread.
+ */
+class LatencyHistogram {
+ public:
+  /** The last bucket starts at 2^39 ns, about 9 minutes. */
+  static constexpr int NUM_BUCKETS = 40;
+
+  void Record(std::chrono::nanoseconds latency);
+
+  /** @return number of recorded latencies */
+  uint64_t GetCount() const;
+
+  /** @return number of recorded latencies in the bucket */
+  uint64_t GetBucketCount(int bucket) const { return buckets_[bucket].load(std::memory_order_relaxed); }
+
+  /** @return mean of the recorded latencies */
+  std::chrono::nanoseconds GetMean() const;
+
+  /**
+   * @param p quantile in [0, 1], e.g. 0.99
+   * @return upper bound of the bucket that holds the p-quantile, 0 if nothing was recorded
+   */
+  std::chrono::nanoseconds GetPercentile(double p) const;
+
+  void Reset();
+
+ private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+  std::atomic<uint64_t> sum_ns_{0};
+};
+
+/** Snapshot of the counters of a DiskManager. */
+struct DiskStats {
+  uint64_t reads_{0};
+  uint64_t writes_{0};
+  uint64_t bytes_read_{0};
+  uint64_t bytes_written_{0};
+  uint64_t log_writes_{0};
+  uint64_t log_bytes_written_{0};
+  uint64_t fsyncs_{0};
+  /** Sum of the queue depth seen by every request when it was issued, including the request itself. */
+  uint64_t queue_depth_sum_{0};
+  uint64_t max_queue_depth_{0};
+
+  /** @return mean number of requests in flight when a request was issued */
+  double GetMeanQueueDepth() const {
+    uint64_t requests = reads_ + writes_ + log_writes_ + fsyncs_;
+    return requests == 0 ? 0 : static_cast<double>(queue_depth_sum_) / static_cast<double>(requests);
+  }
+};
+
+/** One traced request. */
+struct IOTraceRecord {
+  /** Time the request completed, relative to the start of the trace. */
+  uint64_t timestamp_ns_;
+  page_id_t page_id_;
+  IOKind kind_;
+  uint64_t latency_ns_;
+  /** Tag of the issuing thread at the time of the request, see IOTraceTag. */
+  const char *tag_;
+};
+
+/**
+ * IOTraceTag labels the I/O a thread issues while the tag is in scope, e.g. IOTraceTag tag("seq_scan"). Tags nest,
+ * the innermost one wins. The tag is stored by pointer, so it has to outlive the trace (a string literal does).
+ */
+class IOTraceTag {
+ public:
+  explicit IOTraceTag(const char *tag);
+  ~IOTraceTag();
+  DISALLOW_COPY_AND_MOVE(IOTraceTag);
+
+  /** @return the innermost tag of the calling thread, nullptr if there is none */
+  static const char *Current();
+
+ private:
+  const char *previous_;
+};
+
+/**
+ * IOTrace keeps the most recent requests in a ring buffer of fixed capacity, older records are overwritten.
+ */
+class IOTrace {
+ public:
+  explicit IOTrace(size_t capacity);
+
+  void Record(page_id_t page_id, IOKind kind, std::chrono::nanoseconds latency);
+
+  /** @return the records in the ring buffer, oldest first */
+  std::vector<IOTraceRecord> GetRecords() const;
+
+  /**
+   * Write the records as CSV with the header "timestamp_ns,page_id,kind,latency_ns,tag".
+   * @return false if the file could not be written
+   */
+  bool Dump(const std::string &file_name) const;
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  /** Protects records_ and next_. */
+  mutable std::mutex latch_;
+  std::vector<IOTraceRecord> records_;
+  /** Total number of records so far, the next one goes to records_[next_ % capacity]. */
+  uint64_t next_{0};
+};
+
+}  // namespace bustub
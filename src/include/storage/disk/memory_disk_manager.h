@@ -0,0 +1,138 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// memory_disk_manager.h
+//
+// Identification: src/include/storage/disk/memory_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * DiskLatencyModel draws the service time of a single page request. Latencies follow a log-normal distribution
+ * around a per-operation median, which matches the long right tail of real devices. The random engine is seeded
+ * explicitly, so a single-threaded run always sees the same sequence of latencies.
+ */
+class DiskLatencyModel {
+ public:
+  /** Devices with a built-in latency profile. */
+  enum class Device { HDD, SATA_SSD, NVME };
+
+  /**
+   * Creates a new latency model.
+   * @param read_median median latency of a page read
+   * @param write_median median latency of a page write
+   * @param sigma shape of the log-normal distribution, 0 makes every request take exactly the median
+   * @param seed seed of the random engine
+   */
+  DiskLatencyModel(std::chrono::nanoseconds read_median, std::chrono::nanoseconds write_median, double sigma = 0,
+                   uint64_t seed = 0);
+
+  /** @return a latency model with the typical random 4 KiB access latencies of the given device */
+  static DiskLatencyModel ForDevice(Device device, uint64_t seed = 0);
+
+  /** @return the latency of the next page read */
+  std::chrono::nanoseconds NextRead() { return Next(read_median_); }
+
+  /** @return the latency of the next page write */
+  std::chrono::nanoseconds NextWrite() { return Next(write_median_); }
+
+ private:
+  std::chrono::nanoseconds Next(std::chrono::nanoseconds median);
+
+  std::chrono::nanoseconds read_median_;
+  std::chrono::nanoseconds write_median_;
+  double sigma_;
+  /** Protects the random engine, requests may come from several threads. */
+  std::mutex latch_;
+  std::mt19937_64 engine_;
+};
+
+/**
+ * MemoryDiskManager keeps every page and the log in a growable memory arena instead of a file. Optionally it
+ * injects the latency of a storage device into every request, so that I/O-bound behavior of the buffer pool,
+ * the indexes and the executors can be reproduced without measuring the host's file system. Every segment gets
+ * an arena of its own, segments only live as long as the disk manager.
+ */
+class MemoryDiskManager : public DiskManager {
+ public:
+  /**
+   * Creates a new in-memory disk manager.
+   * @param latency_model latency to inject into every page and log request, nullptr = no latency
+   */
+  explicit MemoryDiskManager(std::unique_ptr<DiskLatencyModel> latency_model = nullptr);
+
+  ~MemoryDiskManager() override = default;
+
+  /** Nothing to close, the pages stay readable until the disk manager is destroyed. */
+  void ShutDown() override {}
+
+  bool ReadLog(char *log_data, int size, int offset) override;
+
+  using DiskManager::AllocatePage;
+
+  page_id_t AllocatePage(segment_id_t segment_id) override;
+
+  segment_id_t CreateSegment(const std::string &name) override;
+
+  void DropSegment(segment_id_t segment_id) override;
+
+  void TruncateSegment(segment_id_t segment_id) override;
+
+  /** @return number of bytes currently held by the page arenas of all segments */
+  size_t GetArenaSize();
+
+ protected:
+  void WritePageImpl(page_id_t page_id, const char *page_data) override;
+
+  /** Pages that were never written read as zeroes, just like a hole in a sparse file. */
+  void ReadPageImpl(page_id_t page_id, char *page_data) override;
+
+  void WriteLogImpl(char *log_data, int size) override;
+
+  /** Nothing to flush, but the latency of a device flush is injected like a write. */
+  void SyncImpl() override;
+
+ private:
+  /** Number of pages in one arena chunk, the arena grows by one chunk at a time. */
+  static constexpr size_t PAGES_PER_CHUNK = 256;
+
+  /** @return the in-memory location of the page, growing the arena if needed (caller holds latch_) */
+  char *GetPageLocation(page_id_t page_id);
+
+  /** @return true if the segment exists (caller holds latch_) */
+  bool HasSegment(segment_id_t segment_id) const;
+
+  /** Waits for the given duration, spinning for latencies that are too short for the scheduler. */
+  static void InjectLatency(std::chrono::nanoseconds latency);
+
+  std::unique_ptr<DiskLatencyModel> latency_model_;
+  /** Protects arena_, the segment book-keeping and log_. */
+  std::mutex latch_;
+  /** Fixed-size chunks of pages per segment, so that growing an arena never moves a page. */
+  std::vector<std::vector<std::unique_ptr<char[]>>> arena_;
+  /** Name of every segment, empty for unused ids. Segment 0 has no name and always exists. */
+  std::vector<std::string> segment_names_;
+  /** Number of pages allocated per segment, segment 0 uses next_page_id_ instead. */
+  std::vector<page_id_t> segment_sizes_;
+  std::vector<char> log_;
+};
+
+}  // namespace bustub
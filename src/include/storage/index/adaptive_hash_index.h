@@ -0,0 +1,102 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// adaptive_hash_index.h
+//
+// Identification: src/include/storage/index/adaptive_hash_index.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <shared_mutex>  // NOLINT
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * AdaptiveHashIndex maps the hot keys of a B+ tree to the leaf and the slot that held them when they were last looked
+ * up, so that a lookup of a hot key costs one hash probe and one leaf fetch instead of a root-to-leaf descent (the
+ * adaptive hash index of InnoDB). It is built from the lookups themselves: a key that took a descent
+ * BUILD_THRESHOLD times is added, up to max_entries keys, after that a new hot key replaces an arbitrary one.
+ *
+ * An entry is only a hint. The tree checks under the read latch of the leaf that the entry still points to the leaf
+ * and that the key is still in it, otherwise it takes the descent. Leaves drop their entries when they split or merge;
+ * a leaf that is deleted must drop its entries while it is still write latched, before it is deleted, so that a
+ * lookup that latches the leaf afterwards finds its entry gone and never reads a deleted page.
+ *
+ * Keys are hashed and compared as bytes, the key format makes the bytes of equal keys equal.
+ */
+template <typename KeyType>
+class AdaptiveHashIndex {
+ public:
+  /** Number of descents that make a key hot. */
+  static constexpr int BUILD_THRESHOLD = 8;
+  /** Default max number of keys. */
+  static constexpr size_t DEFAULT_MAX_ENTRIES = 1 << 16;
+
+  explicit AdaptiveHashIndex(size_t max_entries = DEFAULT_MAX_ENTRIES) : max_entries_(max_entries) {}
+
+  /** @return true and the leaf and slot of key if key is hot */
+  bool Lookup(const KeyType &key, page_id_t *page_id, int *slot);
+
+  /** @return true if the entry of key still points to page_id */
+  bool Contains(const KeyType &key, page_id_t page_id) const;
+
+  /** Counts a descent that found key at slot of leaf page_id, adds or moves the entry of key once it is hot. */
+  void RecordDescent(const KeyType &key, page_id_t page_id, int slot);
+
+  /** Removes the entry of key, e.g. after the key was not found where its entry pointed to. */
+  void Erase(const KeyType &key);
+
+  /** Removes the entries of all keys that point to leaf page_id. */
+  void DropPage(page_id_t page_id);
+
+  /** @return number of hot keys */
+  size_t GetSize() const;
+
+  /** @return number of lookups that found an entry */
+  size_t GetHits() const;
+
+ private:
+  /** Remembers that the entry of key points to page_id. */
+  void AddPageKey(page_id_t page_id, const KeyType &key);
+
+  struct Entry {
+    page_id_t page_id_;
+    int slot_;
+  };
+
+  struct KeyHash {
+    size_t operator()(const KeyType &key) const {
+      return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char *>(&key), sizeof(KeyType)));
+    }
+  };
+
+  struct KeyEqual {
+    bool operator()(const KeyType &lhs, const KeyType &rhs) const { return memcmp(&lhs, &rhs, sizeof(KeyType)) == 0; }
+  };
+
+  size_t max_entries_;
+  mutable std::shared_mutex latch_;
+  std::unordered_map<KeyType, Entry, KeyHash, KeyEqual> entries_;
+  /** Descents of keys that are not hot yet, cleared when it holds max_entries keys. */
+  std::unordered_map<KeyType, int, KeyHash, KeyEqual> descents_;
+  /** Keys whose entries pointed to a leaf, some of them may point elsewhere by now. */
+  std::unordered_map<page_id_t, std::vector<KeyType>> page_keys_;
+  /** Number of keys in page_keys_, it is rebuilt from entries_ when it gets twice as large as max_entries. */
+  size_t page_key_count_{0};
+  std::atomic<size_t> hits_{0};
+};
+
+}  // namespace bustub
@@ -0,0 +1,111 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// art_index.h
+//
+// Identification: src/include/storage/index/art_index.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "storage/index/index.h"
+
+namespace bustub {
+
+struct ARTNode;
+
+/**
+ * ARTIndex is an in-memory adaptive radix tree (Leis et al., "The Adaptive Radix Tree", ICDE 2013) over the
+ * KeyEncoder encoding of the key tuples, for lookup tables that are cached anyway and do not need pages in the buffer
+ * pool. Inner nodes hold 4, 16, 48 or 256 children and grow or shrink between these sizes; a node stores up to
+ * MAX_PREFIX bytes of the path to it (path compression), longer common prefixes take a chain of nodes. Leaves hold
+ * the whole key, a leaf sits right below the first node where its key differs from all others.
+ *
+ * Encoded keys are never a prefix of each other, so no key ends at an inner node. A non-unique index appends the rid
+ * of the entry to its key like BPlusTreeIndex does; ScanKey then collects the subtree under the encoded key tuple.
+ *
+ * Concurrency is optimistic lock coupling (Leis et al., "The ART of Practical Synchronization", DaMoN 2016): every
+ * inner node has a version word with a lock bit and an obsolete bit. Readers do not write to the nodes, they read the
+ * version before and validate it after reading a node, and start over from the root if it changed. Writers lock the
+ * one or two nodes they change by a compare and swap on the versions they read on the way down. A node that is
+ * replaced (grown, shrunk, or removed) is marked obsolete and freed once no operation that started before can still
+ * hold a pointer to it (epoch based reclamation).
+ */
+class ARTIndex : public Index {
+ public:
+  /** Max number of prefix bytes stored in a node. */
+  static constexpr size_t MAX_PREFIX = 8;
+
+  explicit ARTIndex(IndexMetadata *metadata);
+
+  ~ARTIndex() override;
+
+  void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
+
+  void DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) override;
+
+  void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
+
+  // number of entries in the index
+  size_t GetSize() const { return size_.load(); }
+
+ private:
+  /**
+   * Operations in flight register the epoch they started in, one slot per thread. With more concurrent threads than
+   * slots, the extra threads wait, yielding, until an operation ends.
+   */
+  static constexpr size_t NUM_EPOCH_SLOTS = 64;
+  /** Retired nodes are reclaimed once this many are waiting. */
+  static constexpr size_t RECLAIM_BATCH = 64;
+
+  /** Registers the calling thread in an epoch slot for its lifetime, retired nodes outlive it. */
+  class EpochGuard {
+   public:
+    explicit EpochGuard(ARTIndex *index);
+    ~EpochGuard();
+
+   private:
+    ARTIndex *index_;
+    size_t slot_;
+  };
+
+  struct alignas(64) EpochSlot {
+    // epoch the operation in this slot started in, 0 if the slot is free
+    std::atomic<uint64_t> epoch_{0};
+  };
+
+  // encoded key of a key tuple, and of an entry (with the rid suffix if the index is not unique)
+  std::string EncodeKey(const Tuple &key) const;
+  std::string EncodeKey(const Tuple &key, const RID &rid) const;
+
+  // each Try* returns false if it has to start over, because a node it read changed
+  bool TryLookup(const std::string &key, RID *rid, bool *found);
+  bool TryInsert(const std::string &key, RID rid, bool *inserted);
+  bool TryRemove(const std::string &key, bool *removed);
+  bool TryScanPrefix(const std::string &prefix, std::vector<RID> *result);
+  bool CollectLeaves(ARTNode *node, uint64_t version, std::vector<RID> *result);
+
+  // frees node once no operation can reach it
+  void Retire(ARTNode *node);
+
+  // the root is a node of 256 children that is never replaced
+  ARTNode *root_;
+  std::atomic<size_t> size_{0};
+  std::atomic<uint64_t> global_epoch_{1};
+  EpochSlot epoch_slots_[NUM_EPOCH_SLOTS];
+  std::mutex retired_latch_;
+  // retired nodes and the epoch they were retired in
+  std::vector<std::pair<ARTNode *, uint64_t>> retired_;
+};
+
+}  // namespace bustub
@@ -10,6 +10,8 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <queue>
 #include <string>
 #include <utility>  // for std::pair
@@ -17,6 +19,8 @@
 
 #include "common/logger.h"
 #include "concurrency/transaction.h"
+#include "storage/index/adaptive_hash_index.h"
+#include "storage/index/bloom_filter.h"
 #include "storage/index/index_iterator.h"
 #include "storage/page/b_plus_tree_internal_page.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
@@ -32,10 +36,43 @@ enum class Operation { FIND = 0, INSERT, DELETE };  // 三种操作：查找、
  *
  * Implementation of simple b+ tree data structure where internal pages direct
  * the search and leaf pages contain actual data.
- * (1) We only support unique key
+ * (1) We only support unique key, a non-unique index makes its keys unique with a rid suffix (see BPlusTreeIndex)
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * In B-link mode (Lehman and Yao) every page has a right link and a high key. A descent holds one latch at a time
+ * and moves right whenever its key is not below the high key of a page, i.e. it reached the page while a concurrent
+ * split moved the key to a new right sibling that is not in the parent yet. A split latches the page and, after
+ * the split is done, its parent; it never holds latches of the levels above, so readers do not wait for structural
+ * changes of the tree. Removes never merge or redistribute pages in this mode: pages may become underfull or empty,
+ * and no page is ever deleted while the tree is in use, which is what makes the latch-free descent safe.
+ *
+ * Compressible keys, as told by KeyTraits, e.g. KeyFormat::NORMALIZED keys, are stored in slotted pages that are
+ * prefix compressed (see BPlusTreeLeafPage), so a wide KeyType such as GenericKey<256> for a VARCHAR column only costs
+ * the actual length of each key; a key still has to fit into KeyType. Leaf splits push up the shortest separator that
+ * tells the two halves apart (suffix truncation), which lengthens the common prefix of the pages below it. Compressed
+ * pages hold a variable number of pairs: they are merged only when the result fits into one page, otherwise an
+ * underfull page borrows one pair from a larger sibling, so a page may stay less than half full after a remove.
+ *
+ * A counted tree keeps in every internal page the number of pairs in the subtree of each child (see
+ * BPlusTreeInternalPage), which answers CountRange and SeekToRank with one or two root-to-leaf descents instead of a
+ * scan of the leaves. An insert or remove changes the counts of every page on its path, so a write keeps the whole
+ * path write latched, and does not take the optimistic descent; writes to a counted tree are serialized at the root.
+ * A tree cannot be counted in B-link mode, whose writes never latch the path.
+ *
+ * The keys of a non-unique index in KeyFormat::NORMALIZED are a key tuple followed by a rid (see KeyTraits). Their
+ * leaves store each key tuple once with the delta encoded rids of its entries (posting lists, see BPlusTreeLeafPage),
+ * so a key with many entries takes a few bytes per entry instead of a whole pair. The leaves are still pages of
+ * pairs to the tree, they decode the pairs they are asked for; iterators decode a whole posting list at a time.
+ *
+ * With an adaptive hash index (see AdaptiveHashIndex) GetValue of a hot key goes straight to the leaf and slot that
+ * held it the last time, and only descends when that leaf no longer has the key. Leaves drop their entries when
+ * they split or merge.
+ *
+ * With a Bloom filter (see BloomFilter) GetValue of an absent key, e.g. the uniqueness check before an insert, usually
+ * returns before the descent. Every insert path adds its keys to the filter before they reach a leaf; removes do not
+ * clear them.
  */
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -44,8 +81,15 @@ class BPlusTree {
   using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
 
  public:
+  // segment_id: segment (tablespace file) that the pages of this tree are allocated from
+  // b_link: run the tree in B-link mode
+  // counted: keep subtree counts in the internal pages, for CountRange and SeekToRank
+  // adaptive_hash: answer GetValue of hot keys from an adaptive hash index
+  // filter_keys: expected number of keys of a Bloom filter that answers GetValue of absent keys, 0 for no filter
   explicit BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE);
+                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE,
+                     segment_id_t segment_id = DEFAULT_SEGMENT_ID, bool b_link = false, bool counted = false,
+                     bool adaptive_hash = false, size_t filter_keys = 0);
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
@@ -53,16 +97,83 @@ class BPlusTree {
   // Insert a key-value pair into this B+ tree.
   bool Insert(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
+  /**
+   * Insert pairs sorted by key, pairs that land in the same leaf share one root-to-leaf descent and its latches.
+   * @param[out] descents_saved number of descents saved compared to inserting the pairs one by one, may be nullptr
+   * @return number of pairs inserted, pairs whose key is already in the tree are skipped
+   */
+  size_t InsertBatch(const std::vector<MappingType> &pairs, Transaction *transaction = nullptr,
+                     size_t *descents_saved = nullptr);
+
   // Remove a key and its value from this B+ tree.
   void Remove(const KeyType &key, Transaction *transaction = nullptr);
 
+  // Returns true if the leaf that key belongs to is in the buffer pool, only the internal pages are fetched. A hint
+  // for deferring changes of absent leaves (see ChangeBuffer), the leaf may be evicted or read in right after
+  bool IsLeafResident(const KeyType &key);
+
   // return the value associated with a given key
   bool GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr);
 
+  // the adaptive hash index of the tree, nullptr if it has none
+  AdaptiveHashIndex<KeyType> *GetAdaptiveHashIndex() { return adaptive_hash_index_.get(); }
+
+  // the Bloom filter of the tree, e.g. for its false positive rate, nullptr if it has none
+  BloomFilter<KeyType> *GetBloomFilter() { return bloom_filter_.get(); }
+
   // index iterator
   INDEXITERATOR_TYPE begin();
   INDEXITERATOR_TYPE Begin(const KeyType &key);
+  // iterator over the keys in [lo, hi), it is at the end as soon as it reaches hi
+  INDEXITERATOR_TYPE Begin(const KeyType &lo, const KeyType &hi);
   INDEXITERATOR_TYPE end();
+  // reverse iterator in descending key order from the largest key, operator++ moves it to the previous key; it is
+  // equal to end() after the smallest key
+  INDEXITERATOR_TYPE RBegin();
+  // reverse iterator from the largest key <= key
+  INDEXITERATOR_TYPE RBegin(const KeyType &key);
+
+  // append the values of all keys in [lo, hi) to result, in key order
+  void ScanRange(const KeyType &lo, const KeyType &hi, std::vector<ValueType> *result,
+                 Transaction *transaction = nullptr);
+
+  /**
+   * Split [lo, hi) into at most parts sub-ranges [lo, key(1)), [key(1), key(2)), ..., [key(n), hi) of about the same
+   * number of leaves, with keys taken from the internal levels of the tree. Iterators over different sub-ranges walk
+   * disjoint chains of leaves, so that parts workers can scan the range in parallel.
+   * @return the increasing keys key(1) .. key(n), fewer than parts - 1 if the tree has not enough keys in the range
+   */
+  std::vector<KeyType> PartitionRange(const KeyType &lo, const KeyType &hi, size_t parts);
+
+  // ScanRange with up to parts threads, one for each sub-range of PartitionRange; result is in key order as well
+  void ParallelScanRange(const KeyType &lo, const KeyType &hi, size_t parts, std::vector<ValueType> *result);
+
+  /**
+   * @return number of keys in [lo, hi); a counted tree sums the subtree counts on the paths to lo and hi, any other
+   * tree scans the range
+   */
+  size_t CountRange(const KeyType &lo, const KeyType &hi);
+
+  // number of keys in the tree, see CountRange
+  size_t GetCount();
+
+  /**
+   * @return iterator at the key of the given rank in key order, rank 0 is the smallest key; end() if the tree has no
+   * more than rank keys. A counted tree descends by the subtree counts, any other tree skips rank keys of a scan.
+   */
+  INDEXITERATOR_TYPE SeekToRank(size_t rank);
+
+  /**
+   * Build the tree bottom-up from pairs in strictly increasing key order, instead of inserting them one by one.
+   * next_pair is called until it returns false. Every leaf and internal page is packed to fill_factor of its
+   * capacity, and pages are allocated in key order so that they are written to disk sequentially. The tree must be
+   * empty; concurrent operations wait until the load is done.
+   * @return false if the tree is not empty or the pairs are not in strictly increasing order, the tree stays empty
+   */
+  bool BulkLoad(const std::function<bool(KeyType *, ValueType *)> &next_pair, double fill_factor = 1.0);
+
+  // bulk load from a vector of pairs sorted by key
+  bool BulkLoad(const std::vector<MappingType> &pairs, double fill_factor = 1.0);
 
   void Print(BufferPoolManager *bpm) {
     ToString(reinterpret_cast<BPlusTreePage *>(bpm->FetchPage(root_page_id_)->GetData()), bpm);
@@ -92,8 +203,39 @@ class BPlusTree {
                                                   bool rightMost = false);
 
  private:
+  // 反向迭代器找不到前一个leaf时，用它从root重新下降到key所在的leaf
+  std::function<Page *(const KeyType &)> FindLeafFunction();
+
+  // 乐观下降：内部节点只加读锁，只对leaf加写锁；树为空时返回nullptr
+  // high_key不为空时同时返回leaf的key上界，没有上界时has_high_key为false
+  Page *FindLeafPageOptimistic(const KeyType &key, KeyType *high_key = nullptr, bool *has_high_key = nullptr);
+
   void StartNewTree(const KeyType &key, const ValueType &value);
 
+  // GetValue从adaptive hash index找到leaf，entry不存在或者已经过期时返回false，调用者再从root下降
+  bool GetValueAdaptive(const KeyType &key, std::vector<ValueType> *result);
+
+  // B-link mode: 从root下降到leaf，每个节点都先向右移动到包含key的节点；内部节点只加读锁，并且拿孩子的锁之前
+  // 就释放父节点。exclusive时leaf加写锁，否则加读锁。stack不为空时记录经过的内部节点，最后一个是leaf的父节点
+  // 树为空时返回nullptr
+  Page *FindLeafPageBLink(const KeyType &key, bool exclusive, std::vector<page_id_t> *stack = nullptr,
+                          bool left_most = false, bool right_most = false);
+
+  // B-link mode: 沿右指针移动到key所在的节点(right_most时移动到这一层最右边的节点)，
+  // 移动时先锁右边的节点再释放当前节点；返回持有锁的节点
+  Page *MoveRightBLink(Page *page, const KeyType &key, bool exclusive, bool right_most = false);
+
+  // B-link mode: 从当前root下降到level层(leaf为第0层)，把经过的节点记录到stack
+  void FindAncestorsBLink(const KeyType &key, int level, std::vector<page_id_t> *stack);
+
+  bool InsertBLink(const KeyType &key, const ValueType &value);
+
+  void RemoveBLink(const KeyType &key);
+
+  // bulk loading之后为每个节点设置fence key，B-link mode还设置每一层的右指针；nullptr表示-inf/+inf
+  void SetFences(page_id_t page_id, const KeyType *low_key, const KeyType *high_key, size_t level,
+                 std::vector<page_id_t> *last_at_level);
+
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
   void InsertIntoParent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node,
@@ -102,6 +244,9 @@ class BPlusTree {
   template <typename N>
   N *Split(N *node);
 
+  // 把leaf page_id的前驱设为prev_page_id，分裂与合并时维护leaf的双向链表
+  void SetLeafPrevPageId(page_id_t page_id, page_id_t prev_page_id);
+
   template <typename N>
   bool CoalesceOrRedistribute(N *node, Transaction *transaction = nullptr, bool *root_is_latched = nullptr);
 
@@ -112,10 +257,68 @@ class BPlusTree {
   template <typename N>
   void Redistribute(N *neighbor_node, N *node, int index);
 
+  // right能否合并到它左边的兄弟left中
+  template <typename N>
+  bool CanCoalesce(N *left, N *right, const KeyType &middle_key);
+
   bool AdjustRoot(BPlusTreePage *node);
 
+  // PartitionRange: 收集page以及它下面depth层内部节点中落在(lo, hi)中的key，释放page的读锁和pin
+  void CollectSeparators(Page *page, const KeyType &lo, const KeyType &hi, int depth, std::vector<KeyType> *separators);
+
+  // counted的树中小于key的key的个数
+  size_t Rank(const KeyType &key);
+
+  // 子树中的pair数：leaf的size，或者internal节点的计数之和
+  size_t SubtreeCount(BPlusTreePage *node) const;
+
+  // counted的树在leaf插入(delta = 1)或删除(delta = -1)一个key之后，修改page set中每个祖先节点指向key的孩子的计数
+  void UpdatePathCounts(const KeyType &key, int delta, Transaction *transaction);
+
+  // counted的树在节点分裂、合并、重新分配之后，把parent中node的计数设为node子树的pair数
+  void UpdateChildCount(InternalPage *parent, BPlusTreePage *node);
+
   void UpdateRootPageId(int insert_record = 0);
 
+  // bulk loading 时每一层最右边的两个节点，它们保持pin，直到确定不会再被调整
+  struct BulkLoadLevel {
+    Page *prev_{nullptr};
+    Page *cur_{nullptr};
+  };
+
+  // bulk loading 的状态，levels_[0]是leaf层
+  struct BulkLoadContext {
+    std::vector<BulkLoadLevel> levels_;
+    // 已分配的page，构建失败时删除
+    std::vector<page_id_t> allocated_;
+    // leaf和internal节点装入的pair数
+    int leaf_capacity_;
+    int internal_capacity_;
+  };
+
+  // bulk loading时节点是否已经装满
+  template <typename N>
+  bool BulkIsFull(N *node, int capacity);
+
+  // 为bulk loading分配一个新的leaf或internal节点
+  Page *BulkNewNode(BulkLoadContext *context, bool is_leaf);
+
+  // page成为level层最右边的节点，原来的prev_节点不会再被调整，将其交给上一层
+  void BulkPushNode(BulkLoadContext *context, size_t level, Page *page);
+
+  // 将level层的节点page交给上一层，设置其parent page id并unpin
+  void BulkFinalize(BulkLoadContext *context, size_t level, Page *page);
+
+  // 在level层(internal)最右边的节点后追加孩子，count是孩子子树的pair数，返回孩子的parent page id
+  page_id_t BulkAppendChild(BulkLoadContext *context, size_t level, const KeyType &key, page_id_t child,
+                            uint32_t count);
+
+  // 调整level层最右边的两个节点，并逐层向上完成构建，返回root page id
+  page_id_t BulkFinish(BulkLoadContext *context, size_t level);
+
+  // 构建失败时unpin并删除所有已分配的page
+  void BulkAbort(BulkLoadContext *context);
+
   /* Debug Routines for FREE!! */
   void ToGraph(BPlusTreePage *page, BufferPoolManager *bpm, std::ofstream &out) const;
 
@@ -123,8 +326,11 @@ class BPlusTree {
 
   void UnlockPages(Transaction *transaction);
 
-  // unlock 和 unpin 事务中经过的所有parent page
-  void UnlockUnpinPages(Transaction *transaction);
+  // unlock 和 unpin 事务中经过的所有parent page，is_dirty时按脏页unpin
+  void UnlockUnpinPages(Transaction *transaction, bool is_dirty = false);
+
+  // 写操作结束时释放leaf page、page set中的祖先节点以及root_latch_
+  void ReleaseWriteLatches(Page *leaf_page, bool is_dirty, Transaction *transaction, bool root_is_latched);
 
   // 判断node是否安全
   template <typename N>
@@ -137,6 +343,22 @@ class BPlusTree {
   KeyComparator comparator_;
   int leaf_max_size_;
   int internal_max_size_;
+  segment_id_t segment_id_;
+  bool b_link_;
+  // key可以压缩时（KeyTraits），节点使用前缀压缩的slotted格式
+  bool compress_keys_;
+  // key以rid结尾时（KeyTraits），leaf按key tuple存放posting list
+  bool posting_lists_;
+  // page的fence key存放的key前缀的字节数（KeyTraits）
+  int fence_size_;
+  // internal节点记录每个孩子子树的pair数
+  bool counted_;
+  // 热点key到leaf的hash index，没有开启时为nullptr
+  std::unique_ptr<AdaptiveHashIndex<KeyType>> adaptive_hash_index_;
+  // 树中所有key的Bloom filter，没有开启时为nullptr
+  std::unique_ptr<BloomFilter<KeyType>> bloom_filter_;
+  // 树的层数，root为leaf时是1；和root_page_id_一起修改
+  int height_{0};
   std::mutex root_latch_;  // 保护root page id不被改变
   // bool root_is_latched_;   // static thread_local
   // std::mutex latch_;  // DEBUG
@@ -12,20 +12,44 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "storage/index/b_plus_tree.h"
+#include "storage/index/change_buffer.h"
 #include "storage/index/index.h"
 
 namespace bustub {
 
 #define BPLUSTREE_INDEX_TYPE BPlusTreeIndex<KeyType, ValueType, KeyComparator>
 
+/**
+ * A B+ tree over the keys of an index. A non-unique index (IndexMetadata::IsUnique) stores the rid of each entry as a
+ * suffix of its key (see GenericKey::SetFromKey), so that the tree still only holds distinct keys: the entries of a
+ * key tuple are adjacent and ordered by rid, ScanKey returns them all with one descent, and DeleteEntry removes exactly
+ * the entry of its rid.
+ *
+ * A covering index (IndexMetadata::GetIncludeAttrs) stores the included columns after the key columns in the leaf
+ * keys, which needs KeyFormat::RAW: the comparator only compares the key columns there, so lookups by key tuple find
+ * the entries, and ScanEntries returns the included values without a fetch from the table heap.
+ *
+ * A non-unique index may defer the changes of leaves that are not in the buffer pool to a ChangeBuffer. Every read
+ * merges the buffered changes of its key range first (iterators and counts all of them), so reads see all changes.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeIndex : public Index {
  public:
-  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager);
+  // counted: keep subtree counts in the tree, so that CountRange and SeekToRank do not scan, see BPlusTree
+  // adaptive_hash: answer point lookups of hot keys from an adaptive hash index, see BPlusTree
+  // filter_keys: expected number of keys of a Bloom filter that answers ScanKey of absent keys of a unique index, 0
+  // for no filter; a non-unique index does not keep one, see BPlusTree
+  // change_buffer_size: number of buffered changes that starts a background merge of a ChangeBuffer, 0 for none; a
+  // unique index applies its changes right away, an insert has to see whether the key is already there
+  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager,
+                 segment_id_t segment_id = DEFAULT_SEGMENT_ID, bool counted = false, bool adaptive_hash = false,
+                 size_t filter_keys = 0, size_t change_buffer_size = 0);
 
   void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
@@ -33,17 +57,75 @@ class BPlusTreeIndex : public Index {
 
   void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
 
+  void ScanRange(const Tuple &lo, const Tuple &hi, std::vector<RID> *result, Transaction *transaction) override;
+
+  void ScanEntries(const Tuple &key, std::vector<std::pair<Tuple, RID>> *result, Transaction *transaction) override;
+
+  // ScanRange over up to parts sub-ranges in parallel, e.g. for a scan of a large range predicate
+  void ParallelScanRange(const Tuple &lo, const Tuple &hi, size_t parts, std::vector<RID> *result);
+
+  /**
+   * Build the index bottom-up from (key tuple, rid) entries in any order, the index has to be empty. The entries are
+   * sorted by key first, see BPlusTree::BulkLoad.
+   * @return false if the index is not empty or two entries have the same key (the same key and rid if the index is
+   * not unique)
+   */
+  bool BulkLoad(const std::vector<std::pair<Tuple, RID>> &entries, double fill_factor = 1.0);
+
+  /**
+   * Build this empty index from the entries of source, converting the keys to the key format of this index. This is
+   * how an existing index is rebuilt, e.g. into KeyFormat::NORMALIZED. Both indexes must have the same key schema.
+   * @return false if this index is not empty or two keys of source are equal in the new format
+   */
+  bool RebuildFrom(BPlusTreeIndex *source, double fill_factor = 1.0);
+
   INDEXITERATOR_TYPE GetBeginIterator();
 
   INDEXITERATOR_TYPE GetBeginIterator(const KeyType &key);
 
+  // iterator over the keys in [lo, hi)
+  INDEXITERATOR_TYPE GetBeginIterator(const KeyType &lo, const KeyType &hi);
+
   INDEXITERATOR_TYPE GetEndIterator();
 
+  // reverse iterators in descending key order, from the largest key or the largest key <= key, e.g. for an
+  // ORDER BY ... DESC LIMIT n; they reach GetEndIterator() after the smallest key
+  INDEXITERATOR_TYPE GetReverseBeginIterator();
+
+  INDEXITERATOR_TYPE GetReverseBeginIterator(const KeyType &key);
+
+  // number of entries whose key is in [lo, hi), e.g. for a COUNT(*) over a key range
+  size_t CountRange(const Tuple &lo, const Tuple &hi);
+
+  // number of entries in the index
+  size_t GetCount();
+
+  // iterator at the entry of the given rank in key order, e.g. for an OFFSET; the end iterator if there is none
+  INDEXITERATOR_TYPE SeekToRank(size_t rank);
+
+  // the change buffer of the index, nullptr if it has none
+  ChangeBuffer<KeyType, KeyComparator> *GetChangeBuffer() { return change_buffer_.get(); }
+
  protected:
+  // build the index key of a key tuple in the key format of the index, throws if the key does not fit into KeyType
+  KeyType MakeKey(const Tuple &key) const;
+
+  // build the index key of an entry, the key tuple followed by rid if the index is not unique
+  KeyType MakeKey(const Tuple &key, const RID &rid) const;
+
+  // merge the buffered changes of the keys in [lo, hi], or all of them, into the tree before a read
+  void MergeChanges(const KeyType &lo, const KeyType &hi);
+  void MergeChanges();
+
+  // apply merged changes of the change buffer to the tree, inserts in one sorted batch
+  void ApplyChanges(const std::vector<typename ChangeBuffer<KeyType, KeyComparator>::Change> &changes);
+
   // comparator for key
   KeyComparator comparator_;
   // container
   BPlusTree<KeyType, ValueType, KeyComparator> container_;
+  // destroyed before container_, it merges the changes that are left
+  std::unique_ptr<ChangeBuffer<KeyType, KeyComparator>> change_buffer_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,78 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// bloom_filter.h
+//
+// Identification: src/include/storage/index/bloom_filter.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace bustub {
+
+/**
+ * BloomFilter is a blocked Bloom filter over the keys of a B+ tree, so that a lookup of an absent key can usually
+ * return without a root-to-leaf descent. A key sets NUM_PROBES bits in one block of BLOCK_BITS bits (one cache line),
+ * so a lookup touches one cache line whatever NUM_PROBES is. It is sized for an expected number of keys with
+ * BITS_PER_KEY bits each; the false positive rate grows once it holds more keys than that.
+ *
+ * The bits are atomic words, inserts and lookups take no latch. A key is inserted into the filter before it is
+ * inserted into the tree, so a lookup that misses in the filter is ordered before the insert of the key. A Bloom filter
+ * cannot forget a key: removed keys keep their bits set and only cost false positives.
+ *
+ * Keys are hashed as bytes, the key format makes the bytes of equal keys equal.
+ */
+template <typename KeyType>
+class BloomFilter {
+ public:
+  /** Bits of a block, a cache line. */
+  static constexpr uint32_t BLOCK_BITS = 512;
+  /** Bits per expected key. */
+  static constexpr size_t BITS_PER_KEY = 10;
+  /** Bits set per key, about ln 2 * BITS_PER_KEY. */
+  static constexpr int NUM_PROBES = 7;
+
+  explicit BloomFilter(size_t expected_keys);
+
+  /** Adds key to the filter. */
+  void Insert(const KeyType &key);
+
+  /** @return false if key was never inserted, true if it may have been; a false result is counted as a negative */
+  bool MayContain(const KeyType &key);
+
+  /** Counts a lookup that MayContain let through but that did not find its key. */
+  void RecordFalsePositive() { false_positives_.fetch_add(1, std::memory_order_relaxed); }
+
+  /** @return number of lookups that the filter answered as definite misses */
+  size_t GetNegatives() const { return negatives_.load(std::memory_order_relaxed); }
+
+  /** @return number of lookups that passed the filter but did not find their key */
+  size_t GetFalsePositives() const { return false_positives_.load(std::memory_order_relaxed); }
+
+  /** @return measured false positive rate: false positives / lookups of absent keys, 0 before any such lookup */
+  double GetFalsePositiveRate() const;
+
+  /** @return false positive rate expected from the fraction of bits set, it counts the bits of all blocks */
+  double EstimateFalsePositiveRate() const;
+
+ private:
+  /** 64 bit hash of the key bytes. */
+  static uint64_t Hash(const KeyType &key);
+
+  static constexpr uint32_t WORDS_PER_BLOCK = BLOCK_BITS / 64;
+
+  size_t num_blocks_;
+  std::unique_ptr<std::atomic<uint64_t>[]> words_;
+  std::atomic<size_t> negatives_{0};
+  std::atomic<size_t> false_positives_{0};
+};
+
+}  // namespace bustub
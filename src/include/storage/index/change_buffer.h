@@ -0,0 +1,108 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// change_buffer.h
+//
+// Identification: src/include/storage/index/change_buffer.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <map>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/rid.h"
+
+namespace bustub {
+
+/**
+ * ChangeBuffer defers the changes of a non-unique secondary index whose leaves are not in the buffer pool (the change
+ * buffer of InnoDB). Instead of fetching the leaf of every inserted or deleted entry, the index buffers the change in
+ * key order here; the changes are merged into the index in sorted batches, by a background thread once there are
+ * merge_threshold of them, and before a read of their key range.
+ *
+ * Keys of a non-unique index end with the rid of their entry, so a change sets whether one entry is in the index and
+ * a newer change of the same key replaces the buffered one. A key that has a buffered change keeps being buffered
+ * until it is merged, so the changes of a key reach the index in order. Merges hold the latch of the buffer while
+ * they apply their changes.
+ */
+template <typename KeyType, typename KeyComparator>
+class ChangeBuffer {
+ public:
+  /** Default number of buffered changes that starts a background merge. */
+  static constexpr size_t DEFAULT_MERGE_THRESHOLD = 4096;
+  /** Number of changes the background thread merges at a time, writers can buffer changes in between. */
+  static constexpr size_t MERGE_BATCH = 256;
+
+  struct Change {
+    KeyType key_;
+    RID rid_;
+    // false for a delete
+    bool insert_;
+  };
+
+  /** Applies changes with distinct keys, in key order, to the index. */
+  using ApplyFunction = std::function<void(const std::vector<Change> &changes)>;
+
+  ChangeBuffer(const KeyComparator &comparator, ApplyFunction apply,
+               size_t merge_threshold = DEFAULT_MERGE_THRESHOLD);
+
+  /** Stops the background thread and merges the buffered changes. */
+  ~ChangeBuffer();
+
+  /**
+   * Buffers a change unless the index should apply it right away, which is when the leaf of key is in the buffer
+   * pool and there is no buffered change of key.
+   * @return false if the caller has to apply the change
+   */
+  bool Buffer(const KeyType &key, const RID &rid, bool insert, bool leaf_resident);
+
+  /** Merges the buffered changes whose keys are in [lo, hi]. */
+  void Merge(const KeyType &lo, const KeyType &hi);
+
+  /** Merges all buffered changes. */
+  void Merge();
+
+  /** @return number of buffered changes */
+  size_t GetSize();
+
+  /** @return number of changes buffered so far, changes that replaced a buffered one included */
+  size_t GetBufferedCount() const { return buffered_.load(); }
+
+  /** @return number of changes merged so far */
+  size_t GetMergedCount() const { return merged_.load(); }
+
+ private:
+  struct KeyLess {
+    const KeyComparator *comparator_;
+    bool operator()(const KeyType &lhs, const KeyType &rhs) const { return (*comparator_)(lhs, rhs) < 0; }
+  };
+
+  // applies and removes the changes in [first, last), the caller holds latch_
+  void MergeLocked(typename std::map<KeyType, Change, KeyLess>::iterator first,
+                   typename std::map<KeyType, Change, KeyLess>::iterator last);
+  void BackgroundMerge();
+
+  KeyComparator comparator_;
+  ApplyFunction apply_;
+  size_t merge_threshold_;
+  std::mutex latch_;
+  std::condition_variable cv_;
+  // buffered changes by key
+  std::map<KeyType, Change, KeyLess> changes_;
+  bool stop_{false};
+  std::atomic<size_t> buffered_{0};
+  std::atomic<size_t> merged_{0};
+  std::thread background_thread_;
+};
+
+}  // namespace bustub
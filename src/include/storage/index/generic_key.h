@@ -12,13 +12,24 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
+#include <vector>
 
+#include "storage/index/key_encoder.h"
 #include "storage/table/tuple.h"
 #include "type/value.h"
 
 namespace bustub {
 
+/**
+ * The smallest and the largest rid in rid order (see RID::Get). A non-unique index keeps all entries of a key tuple
+ * between the keys of the tuple with these rids as their suffix.
+ */
+inline const RID MIN_RID(std::numeric_limits<page_id_t>::min(), 0);
+inline const RID MAX_RID(std::numeric_limits<page_id_t>::max(), std::numeric_limits<uint32_t>::max());
+
 /**
  * Generic key is used for indexing with opaque data.
  *
@@ -29,10 +40,81 @@ namespace bustub {
 template <size_t KeySize>
 class GenericKey {
  public:
-  inline void SetFromKey(const Tuple &tuple) {
+  /** @return false if the tuple is longer than KeySize bytes and was cut off */
+  inline bool SetFromKey(const Tuple &tuple) {
     // intialize to 0
     memset(data_, 0, KeySize);
-    memcpy(data_, tuple.GetData(), tuple.GetLength());
+    memcpy(data_, tuple.GetData(), std::min<size_t>(tuple.GetLength(), KeySize));
+    return tuple.GetLength() <= KeySize;
+  }
+
+  /**
+   * Set the key from a key tuple in the given format, see KeyEncoder for KeyFormat::NORMALIZED.
+   * @return false if the key did not fit into KeySize bytes and was cut off
+   */
+  inline bool SetFromKey(const Tuple &tuple, const Schema *key_schema, KeyFormat format) {
+    if (format == KeyFormat::NORMALIZED) {
+      return KeyEncoder::Encode(tuple, key_schema, data_, KeySize);
+    }
+    return SetFromKey(tuple);
+  }
+
+  /**
+   * Set the key of a non-unique index from a key tuple and the rid of its entry, so that equal key tuples become
+   * distinct keys ordered by rid. In KeyFormat::NORMALIZED the rid directly follows the encoded tuple, big-endian with
+   * the sign bit flipped; in KeyFormat::RAW it takes the last RID_SUFFIX_SIZE bytes of the key, see GenericComparator.
+   * @return false if the key and the rid did not fit into KeySize bytes
+   */
+  inline bool SetFromKey(const Tuple &tuple, const Schema *key_schema, KeyFormat format, const RID &rid) {
+    if constexpr (KeySize < RID_SUFFIX_SIZE) {
+      return false;
+    }
+    if (format == KeyFormat::NORMALIZED) {
+      size_t length;
+      if (!KeyEncoder::Encode(tuple, key_schema, data_, KeySize, &length) || length + RID_SUFFIX_SIZE > KeySize) {
+        return false;
+      }
+      // 编码后的key互不为前缀，相同的key才会比较到rid
+      EncodeRid(rid, data_ + length);
+      return true;
+    }
+    if (!SetFromKey(tuple) || tuple.GetLength() + RID_SUFFIX_SIZE > KeySize) {
+      return false;
+    }
+    int64_t bits = rid.Get();
+    memcpy(data_ + (KeySize - RID_SUFFIX_SIZE), &bits, RID_SUFFIX_SIZE);
+    return true;
+  }
+
+  /** Inverse of SetFromKey. */
+  inline Tuple ToKey(const Schema *key_schema, KeyFormat format) const {
+    Tuple tuple;
+    if (format == KeyFormat::NORMALIZED) {
+      KeyEncoder::Decode(data_, KeySize, key_schema, &tuple);
+      return tuple;
+    }
+    std::vector<Value> values;
+    for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+      values.push_back(ToValue(const_cast<Schema *>(key_schema), i));
+    }
+    return Tuple(values, key_schema);
+  }
+
+  /**
+   * @return the length of the encoded key tuple of a KeyFormat::NORMALIZED key of a non-unique index, i.e. the offset
+   * of its rid suffix; rid is the rid of the entry
+   */
+  inline size_t GetRidSuffixOffset(const RID &rid) const {
+    // 去掉结尾的0之后，key以编码后的rid(同样去掉结尾的0)结束
+    char suffix[RID_SUFFIX_SIZE];
+    EncodeRid(rid, suffix);
+    return SignificantSize(data_, KeySize) - SignificantSize(suffix, RID_SUFFIX_SIZE);
+  }
+
+  /** Replaces everything after the first offset bytes of a KeyFormat::NORMALIZED key by the rid suffix of rid. */
+  inline void SetRidSuffix(size_t offset, const RID &rid) {
+    EncodeRid(rid, data_ + offset);
+    memset(data_ + offset + RID_SUFFIX_SIZE, 0, KeySize - offset - RID_SUFFIX_SIZE);
   }
 
   // NOTE: for test purpose only
@@ -66,17 +148,116 @@ class GenericKey {
     return os;
   }
 
+  /** Bytes the rid takes in the key of a non-unique index. */
+  static constexpr size_t RID_SUFFIX_SIZE = sizeof(int64_t);
+
+  /** Writes the RID_SUFFIX_SIZE bytes of rid in a KeyFormat::NORMALIZED key, their memcmp order is the rid order. */
+  static inline void EncodeRid(const RID &rid, char *dst) {
+    uint64_t bits = static_cast<uint64_t>(rid.Get()) ^ (uint64_t{1} << 63);
+    for (size_t i = 0; i < RID_SUFFIX_SIZE; i++) {
+      dst[i] = static_cast<char>(bits >> (8 * (RID_SUFFIX_SIZE - 1 - i)));
+    }
+  }
+
   // actual location of data, extends past the end.
   char data_[KeySize];
+
+ private:
+  static inline size_t SignificantSize(const char *data, size_t size) {
+    while (size > 0 && data[size - 1] == 0) {
+      size--;
+    }
+    return size;
+  }
 };
 
 /**
  * Function object returns true if lhs < rhs, used for trees
+ *
+ * A key of a single inlined integer column compares as a raw integer instead of going through Value, which is by far
+ * the most common index key and the hottest comparison of a tree descent. Pages can also ask for GetIntegerKeyType to
+ * search their key array without calling the comparator at all, see IntegerKeySearch.
+ *
+ * Keys in KeyFormat::NORMALIZED compare with a single memcmp.
+ *
+ * The comparator of a non-unique index (rid_suffix) breaks ties between equal RAW key tuples by the rid stored at the
+ * end of the key, see GenericKey::SetFromKey. NORMALIZED keys need no tie-break, the rid is part of the memcmp.
  */
 template <size_t KeySize>
 class GenericComparator {
  public:
   inline int operator()(const GenericKey<KeySize> &lhs, const GenericKey<KeySize> &rhs) const {
+    if (format_ == KeyFormat::NORMALIZED) {
+      return memcmp(lhs.data_, rhs.data_, KeySize);
+    }
+    int cmp = CompareTuple(lhs, rhs);
+    if constexpr (KeySize >= GenericKey<KeySize>::RID_SUFFIX_SIZE) {
+      if (cmp == 0 && rid_suffix_) {
+        return CompareInteger<int64_t>(lhs, rhs, KeySize - GenericKey<KeySize>::RID_SUFFIX_SIZE);
+      }
+    }
+    return cmp;
+  }
+
+  GenericComparator(const GenericComparator &other)
+      : key_schema_{other.key_schema_},
+        format_{other.format_},
+        rid_suffix_{other.rid_suffix_},
+        int_key_type_{other.int_key_type_} {}
+
+  // constructor
+  explicit GenericComparator(Schema *key_schema, KeyFormat format = KeyFormat::RAW, bool rid_suffix = false)
+      : key_schema_(key_schema), format_(format), rid_suffix_(rid_suffix) {
+    // 只有一列定长整数，且位于key的开头，才可以直接按整数比较
+    if (format_ != KeyFormat::RAW || key_schema_->GetColumnCount() != 1) {
+      return;
+    }
+    const auto &col = key_schema_->GetColumn(0);
+    switch (col.GetType()) {
+      case TypeId::TINYINT:
+      case TypeId::SMALLINT:
+      case TypeId::INTEGER:
+      case TypeId::BIGINT:
+        if (col.GetOffset() == 0 && col.GetFixedLength() <= KeySize) {
+          int_key_type_ = col.GetType();
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  /**
+   * @return the type of the key if keys compare as a raw integer stored at the start of the key, i.e. the key schema is
+   * a single TINYINT, SMALLINT, INTEGER or BIGINT column of a unique index; TypeId::INVALID otherwise
+   */
+  inline TypeId GetIntegerKeyType() const { return rid_suffix_ ? TypeId::INVALID : int_key_type_; }
+
+  /** @return the format of the keys this comparator compares */
+  inline KeyFormat GetKeyFormat() const { return format_; }
+
+  /** @return true if the keys end with the rid of their entry, i.e. the keys of a non-unique index */
+  inline bool HasRidSuffix() const { return rid_suffix_; }
+
+  /** @return the schema of the key tuples */
+  inline const Schema *GetKeySchema() const { return key_schema_; }
+
+ private:
+  // 按key tuple比较raw格式的key，不看rid
+  inline int CompareTuple(const GenericKey<KeySize> &lhs, const GenericKey<KeySize> &rhs) const {
+    switch (int_key_type_) {
+      case TypeId::TINYINT:
+        return CompareInteger<int8_t>(lhs, rhs);
+      case TypeId::SMALLINT:
+        return CompareInteger<int16_t>(lhs, rhs);
+      case TypeId::INTEGER:
+        return CompareInteger<int32_t>(lhs, rhs);
+      case TypeId::BIGINT:
+        return CompareInteger<int64_t>(lhs, rhs);
+      default:
+        break;
+    }
+
     uint32_t column_count = key_schema_->GetColumnCount();
 
     for (uint32_t i = 0; i < column_count; i++) {
@@ -94,13 +275,85 @@ class GenericComparator {
     return 0;
   }
 
-  GenericComparator(const GenericComparator &other) : key_schema_{other.key_schema_} {}
-
-  // constructor
-  explicit GenericComparator(Schema *key_schema) : key_schema_(key_schema) {}
+  template <typename T>
+  static inline int CompareInteger(const GenericKey<KeySize> &lhs, const GenericKey<KeySize> &rhs, size_t offset = 0) {
+    T l;
+    T r;
+    memcpy(&l, lhs.data_ + offset, sizeof(T));
+    memcpy(&r, rhs.data_ + offset, sizeof(T));
+    return (l > r) - (l < r);
+  }
 
- private:
   Schema *key_schema_;
+  KeyFormat format_;
+  bool rid_suffix_;
+  TypeId int_key_type_{TypeId::INVALID};
+};
+
+/**
+ * KeyTraits tells the B+ tree how to store the keys of a KeyType in its pages. The tree looks it up by its KeyType and
+ * KeyComparator, a key type changes how it is stored by specializing it.
+ *
+ * By default a key is a fixed size array, stored as is in a (key, value) array. A compressible key is a byte string in
+ * key order padded with zero bytes; it is stored in a slotted page instead (see SlottedKeyArray): an entry only takes
+ * the significant bytes of its key, the prefix shared by the page and trailing zero bytes are not stored. Every key
+ * is still a KeyType, so KeyType bounds the length of a key: a key that does not fit is rejected (see
+ * BPlusTreeIndex), also in a compressible format.
+ */
+template <typename KeyType, typename KeyComparator>
+struct KeyTraits {
+  /** @return true if the keys compared by comparator are zero padded byte strings, stored prefix compressed */
+  static bool IsCompressible(const KeyComparator &comparator) { return false; }
+
+  /**
+   * @return true if the keys are a key tuple followed by the rid of their entry, so that the leaves can store them as
+   * posting lists: the key tuple once, followed by the rids of its entries (see BPlusTreeLeafPage)
+   */
+  static bool HasPostingLists(const KeyComparator &comparator) { return false; }
+
+  /** @return the size of the key tuple in key, the rid suffix starts there; rid is the rid of the entry */
+  static int GetTupleSize(const KeyType &key, const RID &rid) { return sizeof(KeyType); }
+
+  /** Sets the rid suffix of a key whose key tuple takes its first tuple_size bytes. */
+  static void SetRid(KeyType *key, int tuple_size, const RID &rid) {}
+
+  /**
+   * @return the number of leading bytes of a key that comparator looks at; the fence keys of the pages only store
+   * those (see BPlusTreeLeafPage)
+   */
+  static int GetFenceSize(const KeyComparator &comparator) { return sizeof(KeyType); }
+};
+
+/**
+ * A GenericKey in KeyFormat::NORMALIZED is a byte string padded with zero bytes, e.g. a VARCHAR is its bytes followed
+ * by a terminator (see KeyEncoder), so it is compressible. A wide GenericKey then only costs its actual length; a
+ * VARCHAR whose key does not fit into KeySize bytes is still rejected.
+ */
+template <size_t KeySize>
+struct KeyTraits<GenericKey<KeySize>, GenericComparator<KeySize>> {
+  static bool IsCompressible(const GenericComparator<KeySize> &comparator) {
+    return comparator.GetKeyFormat() == KeyFormat::NORMALIZED;
+  }
+
+  // 只有normalized格式的rid紧跟在key tuple之后，raw格式的rid在key的末尾
+  static bool HasPostingLists(const GenericComparator<KeySize> &comparator) {
+    return comparator.GetKeyFormat() == KeyFormat::NORMALIZED && comparator.HasRidSuffix();
+  }
+
+  static int GetTupleSize(const GenericKey<KeySize> &key, const RID &rid) {
+    return static_cast<int>(key.GetRidSuffixOffset(rid));
+  }
+
+  static void SetRid(GenericKey<KeySize> *key, int tuple_size, const RID &rid) { key->SetRidSuffix(tuple_size, rid); }
+
+  // raw格式只比较key tuple的定长部分；normalized格式按整个key比较，raw格式的rid在key的末尾，变长列的数据在定长部分之后
+  static int GetFenceSize(const GenericComparator<KeySize> &comparator) {
+    const Schema *key_schema = comparator.GetKeySchema();
+    if (comparator.GetKeyFormat() != KeyFormat::RAW || comparator.HasRidSuffix() || !key_schema->IsInlined()) {
+      return KeySize;
+    }
+    return std::min<int>(KeySize, key_schema->GetLength());
+  }
 };
 
 }  // namespace bustub
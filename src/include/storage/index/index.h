@@ -12,12 +12,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "catalog/schema.h"
+#include "common/exception.h"
+#include "storage/index/key_encoder.h"
 #include "storage/table/tuple.h"
 #include "type/value.h"
 
@@ -37,12 +40,24 @@ class IndexMetadata {
   IndexMetadata() = delete;
 
   IndexMetadata(std::string index_name, std::string table_name, const Schema *tuple_schema,
-                std::vector<uint32_t> key_attrs)
-      : name_(std::move(index_name)), table_name_(std::move(table_name)), key_attrs_(std::move(key_attrs)) {
+                std::vector<uint32_t> key_attrs, KeyFormat key_format = KeyFormat::RAW, bool unique = true,
+                const std::vector<uint32_t> &include_attrs = {})
+      : name_(std::move(index_name)),
+        table_name_(std::move(table_name)),
+        key_attrs_(std::move(key_attrs)),
+        key_format_(key_format),
+        unique_(unique),
+        include_attrs_(include_attrs) {
     key_schema_ = Schema::CopySchema(tuple_schema, key_attrs_);
+    entry_attrs_ = key_attrs_;
+    entry_attrs_.insert(entry_attrs_.end(), include_attrs_.begin(), include_attrs_.end());
+    entry_schema_ = Schema::CopySchema(tuple_schema, entry_attrs_);
   }
 
-  ~IndexMetadata() { delete key_schema_; }
+  ~IndexMetadata() {
+    delete key_schema_;
+    delete entry_schema_;
+  }
 
   inline const std::string &GetName() const { return name_; }
 
@@ -60,6 +75,29 @@ class IndexMetadata {
   //  columns
   inline const std::vector<uint32_t> &GetKeyAttrs() const { return key_attrs_; }
 
+  // Returns how the key tuple is laid out in the index key, only used by indexes over GenericKey
+  inline KeyFormat GetKeyFormat() const { return key_format_; }
+
+  // Returns false if several entries may have the same key, e.g. a secondary index on a non-key column
+  inline bool IsUnique() const { return unique_; }
+
+  // Returns the base table columns that are stored with the entries but not part of the key (covering index)
+  inline const std::vector<uint32_t> &GetIncludeAttrs() const { return include_attrs_; }
+
+  // Returns the columns of an entry tuple: the key columns followed by the included columns. InsertEntry and
+  // DeleteEntry take entry tuples, lookups take key tuples; both are the same if nothing is included
+  inline const std::vector<uint32_t> &GetEntryAttrs() const { return entry_attrs_; }
+
+  inline Schema *GetEntrySchema() const { return entry_schema_; }
+
+  // Returns true if every given base table column is stored in the entries, so that a scan can take them from
+  // Index::ScanEntries instead of fetching the tuples from the table heap
+  bool Covers(const std::vector<uint32_t> &column_ids) const {
+    return std::all_of(column_ids.begin(), column_ids.end(), [this](uint32_t column_id) {
+      return std::find(entry_attrs_.begin(), entry_attrs_.end(), column_id) != entry_attrs_.end();
+    });
+  }
+
   // Get a string representation for debugging
   std::string ToString() const {
     std::stringstream os;
@@ -78,8 +116,17 @@ class IndexMetadata {
   std::string table_name_;
   // The mapping relation between key schema and tuple schema
   const std::vector<uint32_t> key_attrs_;
+  // format of the index key
+  KeyFormat key_format_;
+  // whether a key identifies at most one entry
+  bool unique_;
+  // included columns, and the key columns followed by them
+  const std::vector<uint32_t> include_attrs_;
+  std::vector<uint32_t> entry_attrs_;
   // schema of the indexed key
   Schema *key_schema_;
+  // schema of the entry tuples
+  Schema *entry_schema_;
 };
 
 /////////////////////////////////////////////////////////////////////
@@ -137,6 +184,17 @@ class Index {
 
   virtual void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) = 0;
 
+  // range scan over the keys in [lo, hi), only supported by ordered indexes
+  virtual void ScanRange(const Tuple &lo, const Tuple &hi, std::vector<RID> *result, Transaction *transaction) {
+    throw NotImplementedException("ScanRange is not supported by index " + GetName());
+  }
+
+  // like ScanKey, but returns the entry tuples (see IndexMetadata::GetEntrySchema) along with the rids, only
+  // supported by indexes that can store included columns
+  virtual void ScanEntries(const Tuple &key, std::vector<std::pair<Tuple, RID>> *result, Transaction *transaction) {
+    throw NotImplementedException("ScanEntries is not supported by index " + GetName());
+  }
+
  private:
   //===--------------------------------------------------------------------===//
   //  Data members
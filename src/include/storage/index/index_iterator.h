@@ -13,31 +13,118 @@
  * For range scan of b+ tree
  */
 #pragma once
+#include <functional>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
 
 namespace bustub {
 
 #define INDEXITERATOR_TYPE IndexIterator<KeyType, ValueType, KeyComparator>
 
+/**
+ * IndexIterator walks the leaf level of a B+ tree in key order. It keeps exactly one leaf pinned and read latched:
+ * the leaf of the current entry. When it moves past the last entry of a leaf it releases that leaf before fetching
+ * the next one, so a scan never holds two leaves at a time and does not block writers on leaves it has left.
+ *
+ * The iterator is not a snapshot. Entries inserted or removed behind or ahead of it by concurrent writers may or may
+ * not be seen. A thread must not modify the tree while it holds an iterator that is not at the end, since the held
+ * latch would deadlock with its own writes.
+ *
+ * The next leaf may have been merged into the leaf the iterator left and deleted, or have given entries to it, while
+ * neither was latched. The iterator remembers the high key of the leaf it left; when the next leaf does not start
+ * exactly at that key, it descends from the root again to the leaf of the high key.
+ *
+ * An iterator can carry an exclusive upper bound, then it turns into the end iterator at the first key >= the bound
+ * and releases its leaf right away.
+ *
+ * In a leaf of posting lists the iterator decodes the posting list of the current entry as a whole when it gets to
+ * it, and serves the following entries of the list from there.
+ *
+ * A reverse iterator walks the leaves in descending key order along their prev links; operator++ moves it to the
+ * previous entry. Latching a left sibling while holding a leaf could deadlock with a writer that latches from left to
+ * right, so it releases its leaf before it latches the previous one. The previous leaf may have been split or have
+ * taken over the leaf in between: the iterator remembers the low key of the leaf it left, moves right from the
+ * previous leaf while that leaf ends below the low key, and continues at the last entry below the low key. The leaf
+ * it ends up at has to end exactly at the low key; when it does not, e.g. because the previous leaf was merged into
+ * its own left sibling and deleted, the iterator descends from the root again to the leaf of the low key.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
+  using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
+
  public:
-  // you may define your own constructor based on your member variables
+  /** Creates the end iterator. */
   IndexIterator();
+
+  /**
+   * Creates an iterator positioned at entry index of the leaf in page. The iterator takes over the pin and the read
+   * latch of page. An index past the last entry of the leaf moves the iterator to the next leaf. find_leaf returns the
+   * read latched leaf of a key, or nullptr for an empty tree. The comparator and the tree have to outlive the iterator.
+   *
+   * A reverse iterator starts at entry index as well, an index of -1 moves it to the last entry of the previous leaf.
+   */
+  IndexIterator(BufferPoolManager *buffer_pool_manager, Page *page, int index, const KeyComparator *comparator,
+                std::function<Page *(const KeyType &)> find_leaf, bool reverse = false);
+
+  /** Same as above for a forward iterator with an exclusive upper bound high_key. */
+  IndexIterator(BufferPoolManager *buffer_pool_manager, Page *page, int index, const KeyComparator *comparator,
+                std::function<Page *(const KeyType &)> find_leaf, const KeyType &high_key);
+
   ~IndexIterator();
 
+  // 迭代器持有page的pin和读锁，只能移动不能复制
+  IndexIterator(const IndexIterator &) = delete;
+  IndexIterator &operator=(const IndexIterator &) = delete;
+  IndexIterator(IndexIterator &&other) noexcept;
+  IndexIterator &operator=(IndexIterator &&other) noexcept;
+
   bool isEnd();
 
   const MappingType &operator*();
 
   IndexIterator &operator++();
 
-  bool operator==(const IndexIterator &itr) const { throw std::runtime_error("unimplemented"); }
+  bool operator==(const IndexIterator &itr) const { return page_id_ == itr.page_id_ && index_ == itr.index_; }
 
-  bool operator!=(const IndexIterator &itr) const { throw std::runtime_error("unimplemented"); }
+  bool operator!=(const IndexIterator &itr) const { return !(*this == itr); }
 
  private:
-  // add your own private member variables here
+  /** Skips to the next non empty leaf if the iterator is past the end of its leaf, checks the upper bound. */
+  void Settle();
+
+  /** Skips to the last entry before the current leaf if a reverse iterator is before the start of its leaf. */
+  void SettleReverse();
+
+  /** Takes over the pin and the read latch of page as the current leaf. */
+  void Enter(Page *page);
+
+  /** Unlatches and unpins the current leaf, the iterator becomes the end iterator. */
+  void Release();
+
+  /** Decodes the current entry into item_. */
+  const MappingType &Load();
+
+  BufferPoolManager *buffer_pool_manager_{nullptr};
+  Page *page_{nullptr};
+  LeafPage *leaf_{nullptr};
+  /** Page id of the current leaf, INVALID_PAGE_ID for the end iterator. */
+  page_id_t page_id_{INVALID_PAGE_ID};
+  int index_{0};
+  /** Comparator of the tree, nullptr for the end iterator. */
+  const KeyComparator *comparator_{nullptr};
+  bool reverse_{false};
+  /** Descent from the root to the leaf of a key, when the next or previous leaf changed under the iterator. */
+  std::function<Page *(const KeyType &)> find_leaf_;
+  /** Whether high_key_ is an upper bound, a reverse iterator has none. */
+  bool bounded_{false};
+  KeyType high_key_{};
+  /** The entry operator* returned last, leaves store their entries encoded. */
+  MappingType item_{};
+  /** The decoded posting list of the current entry and the index of its first entry in the leaf. */
+  std::vector<MappingType> posting_list_;
+  int posting_list_begin_{0};
 };
 
 }  // namespace bustub
@@ -0,0 +1,64 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// key_encoder.h
+//
+// Identification: src/include/storage/index/key_encoder.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "catalog/schema.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/** How the columns of an index key are laid out in a GenericKey. */
+enum class KeyFormat {
+  /** The key tuple as is, keys compare column by column through Value. */
+  RAW,
+  /** The order preserving encoding of KeyEncoder, keys compare with memcmp. */
+  NORMALIZED,
+};
+
+/**
+ * KeyEncoder writes a key tuple as bytes whose memcmp order is the order of the tuple, column by column. Each column
+ * starts with a marker byte, 0 for NULL, then NULL sorts first and has no payload, 1 otherwise followed by:
+ * - integers and timestamps: big-endian, the sign bit of signed types flipped
+ * - decimals: the IEEE bits big-endian, all bits flipped for negative numbers and only the sign bit otherwise
+ * - booleans: one byte
+ * - varchars: the bytes with 0x00 escaped as 0x00 0xFF, terminated by 0x00 0x00
+ * The rest of the key is zero filled. No encoded key is a prefix of another one, so bytes appended to an encoded key
+ * (e.g. the RID suffix of a non-unique index key) only order keys whose encodings are equal.
+ */
+class KeyEncoder {
+ public:
+  /**
+   * Encodes a key tuple.
+   * @param key key tuple
+   * @param key_schema schema of key
+   * @param[out] dst encoded key
+   * @param size size of dst
+   * @param[out] length if not null, the number of bytes written before the zero fill
+   * @return false if the encoding was cut off at size bytes, such keys compare by their first size bytes only
+   */
+  static bool Encode(const Tuple &key, const Schema *key_schema, char *dst, size_t size, size_t *length = nullptr);
+
+  /**
+   * Decodes a key written by Encode.
+   * @param src encoded key
+   * @param size size of src
+   * @param key_schema schema of the key
+   * @param[out] key decoded key tuple
+   * @return false if src was cut off
+   */
+  static bool Decode(const char *src, size_t size, const Schema *key_schema, Tuple *key);
+};
+
+}  // namespace bustub
@@ -0,0 +1,61 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// key_search.h
+//
+// Identification: src/include/storage/index/key_search.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "type/type_id.h"
+
+namespace bustub {
+
+/** True if KeyComparator tells whether its keys compare as raw integers, see GenericComparator::GetIntegerKeyType. */
+template <typename KeyComparator, typename = void>
+struct HasIntegerKeyType : std::false_type {};
+
+template <typename KeyComparator>
+struct HasIntegerKeyType<KeyComparator,
+                         std::void_t<decltype(std::declval<const KeyComparator &>().GetIntegerKeyType())>>
+    : std::true_type {};
+
+/**
+ * IntegerKeySearch searches the key array of a B+ tree page whose keys are single integer columns. It reads the keys
+ * in place, so it works on the (key, value) pairs of a page without a packed copy of the keys.
+ *
+ * The search is branchless: a binary search with conditional moves narrows the range to a window of WINDOW keys,
+ * then the keys of the window are compared all at once, with AVX2 gathers for INTEGER and BIGINT keys when the
+ * build targets AVX2, and counted.
+ */
+class IntegerKeySearch {
+ public:
+  /** Number of keys compared at once at the end of a search. */
+  static constexpr int WINDOW = 8;
+
+  /**
+   * @param keys address of the first key
+   * @param stride distance in bytes between two keys
+   * @param count number of keys, sorted in increasing order
+   * @param key key to look for, as returned by ToInteger
+   * @param type TINYINT, SMALLINT, INTEGER or BIGINT
+   * @param upper false to count the keys < key (lower bound), true to count the keys <= key (upper bound)
+   * @return number of keys < key, resp. <= key
+   */
+  static int Rank(const char *keys, size_t stride, int count, int64_t key, TypeId type, bool upper);
+
+  /** @return the integer stored at data as a key of the given type */
+  static int64_t ToInteger(const char *data, TypeId type);
+};
+
+}  // namespace bustub
@@ -0,0 +1,237 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lsm_index.h
+//
+// Identification: src/include/storage/index/lsm_index.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "storage/index/bloom_filter.h"
+#include "storage/index/index.h"
+#include "storage/page/b_plus_tree_page.h"
+#include "storage/page/lsm_run_page.h"
+
+namespace bustub {
+
+/**
+ * The memtable of an LSMIndex: a skip list of (key, rid, tombstone) entries ordered by key, newer entries of a key
+ * first. Entries are never changed or removed, a later write of a key inserts a newer entry in front of the older
+ * ones. One writer at a time (the caller serializes Put), any number of readers concurrently with it and without a
+ * latch: an entry is fully built before the release store that links it into a level.
+ */
+template <typename KeyType, typename KeyComparator>
+class LSMMemTable {
+ public:
+  static constexpr int MAX_HEIGHT = 12;
+
+  explicit LSMMemTable(const KeyComparator &comparator);
+  ~LSMMemTable();
+
+  /** Adds an entry that is newer than all entries of the memtable. */
+  void Put(const KeyType &key, const RID &rid, bool tombstone);
+
+  /** @return true and the newest entry of key if the memtable has one */
+  bool Get(const KeyType &key, RID *rid, bool *tombstone) const;
+
+  /**
+   * Calls visit(key, rid, tombstone) with the newest entry of every key in [lo, hi) in key order, the whole memtable
+   * if lo and hi are nullptr.
+   */
+  template <typename Visitor>
+  void Scan(const KeyType *lo, const KeyType *hi, Visitor &&visit) const;
+
+  /** @return number of entries, a key written n times counts n times */
+  size_t GetSize() const { return size_.load(); }
+
+ private:
+  struct Node {
+    KeyType key_;
+    RID rid_;
+    bool tombstone_;
+    uint64_t sequence_;
+    std::atomic<Node *> next_[MAX_HEIGHT];
+  };
+
+  // (key, sequence) order: keys ascending, then newer entries first
+  bool Before(const Node *node, const KeyType &key, uint64_t sequence) const;
+  // first node whose key is >= key, and if prev is not nullptr the last node before it on every level
+  Node *FindGreaterOrEqual(const KeyType &key, uint64_t sequence, Node **prev) const;
+  int RandomHeight();
+
+  KeyComparator comparator_;
+  Node *head_;
+  std::atomic<int> height_{1};
+  std::atomic<size_t> size_{0};
+  uint64_t next_sequence_{1};
+  uint64_t random_state_{0x9E3779B97F4A7C15ULL};
+};
+
+template <typename KeyType, typename KeyComparator>
+template <typename Visitor>
+void LSMMemTable<KeyType, KeyComparator>::Scan(const KeyType *lo, const KeyType *hi, Visitor &&visit) const {
+  const Node *node = lo == nullptr ? head_->next_[0].load(std::memory_order_acquire)
+                                   : FindGreaterOrEqual(*lo, UINT64_MAX, nullptr);
+  const Node *last = nullptr;
+  for (; node != nullptr; node = node->next_[0].load(std::memory_order_acquire)) {
+    if (hi != nullptr && comparator_(node->key_, *hi) >= 0) {
+      break;
+    }
+    // 同一个key的旧entry跟在最新的后面
+    if (last == nullptr || comparator_(last->key_, node->key_) != 0) {
+      visit(node->key_, node->rid_, node->tombstone_);
+      last = node;
+    }
+  }
+}
+
+#define LSM_INDEX_TYPE LSMIndex<KeyType, ValueType, KeyComparator>
+
+/**
+ * LSMIndex is a log-structured merge index for write-dominated tables (O'Neil et al., "The Log-Structured Merge-Tree",
+ * 1996; the structure of LevelDB). A write never reads: InsertEntry and DeleteEntry add an entry or a tombstone to an
+ * in-memory memtable. A full memtable becomes immutable and a background thread writes it out as a sorted run, pages
+ * of key ordered entries (see LSMRunPage) appended sequentially to a segment of its own through the DiskManager. Once
+ * there are COMPACTION_TRIGGER runs the background thread merges them into one, which drops the tombstones and the
+ * overwritten entries, and drops the segments of the merged runs.
+ *
+ * A lookup checks the memtable, the immutable memtables and the runs from the newest to the oldest, the first entry
+ * of the key decides. Every run has a Bloom filter and the first key of each of its pages in memory, so a run costs
+ * one page read through the buffer pool if it may have the key, and none otherwise.
+ *
+ * Keys are made like in BPlusTreeIndex: a non-unique index appends the rid of the entry to the key, and ScanKey and
+ * ScanRange merge the key ranges of all components. A unique index keeps the last write of a key, InsertEntry does
+ * not check whether the key is already there.
+ *
+ * If writing out a memtable or a compaction fails, the memtable or the merged runs stay in place and still answer
+ * lookups. The next InsertEntry, DeleteEntry or Flush throws the exception of the background thread, which then tries
+ * again.
+ *
+ * The memtable and the run list are not persistent, the runs are dropped with the index.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+class LSMIndex : public Index {
+ public:
+  /** Default max number of entries of a memtable. */
+  static constexpr size_t DEFAULT_MEMTABLE_SIZE = 4096;
+  /** Number of immutable memtables that writers wait for the background thread to write out. */
+  static constexpr size_t MAX_IMMUTABLE_MEMTABLES = 2;
+  /** Number of runs that starts a compaction. */
+  static constexpr size_t COMPACTION_TRIGGER = 4;
+
+  LSMIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager,
+           size_t memtable_size = DEFAULT_MEMTABLE_SIZE);
+
+  ~LSMIndex() override;
+
+  void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
+
+  void DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) override;
+
+  void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
+
+  void ScanRange(const Tuple &lo, const Tuple &hi, std::vector<RID> *result, Transaction *transaction) override;
+
+  /**
+   * Writes out the memtable and waits until the background thread has written out all immutable memtables.
+   * @throws the exception of the background thread if it failed
+   */
+  void Flush();
+
+  /** @return number of sorted runs */
+  size_t GetRunCount();
+
+  /** @return number of compactions so far */
+  size_t GetCompactionCount() const { return compactions_.load(); }
+
+  /** @return number of run lookups that the Bloom filters answered without reading a page */
+  size_t GetFilterNegatives() const { return filter_negatives_.load(); }
+
+ private:
+  using MemTable = LSMMemTable<KeyType, KeyComparator>;
+  using RunPage = LSMRunPage<KeyType>;
+
+  /** A sorted run: its pages are the pages of its segment in key order. */
+  struct SortedRun {
+    BufferPoolManager *buffer_pool_manager_;
+    segment_id_t segment_id_;
+    std::vector<page_id_t> page_ids_;
+    // first key of every page
+    std::vector<KeyType> first_keys_;
+    std::unique_ptr<BloomFilter<KeyType>> filter_;
+    size_t size_{0};
+
+    ~SortedRun();
+  };
+
+  // writes entries in key order into a new run, page by page
+  class RunWriter;
+  // reads the entries of a run in key order
+  struct RunCursor;
+
+  /**
+   * The memtables and runs of the index. A version is never changed, writes of the memtable aside; the background
+   * thread and a writer that switches the memtable install a new one. Readers keep the version they started with, so
+   * its runs and memtables stay alive until they are done.
+   */
+  struct Version {
+    std::shared_ptr<MemTable> memtable_;
+    // newest first
+    std::vector<std::shared_ptr<MemTable>> immutables_;
+    std::vector<std::shared_ptr<SortedRun>> runs_;
+  };
+
+  // build the index key of a key tuple and of an entry, see BPlusTreeIndex
+  KeyType MakeKey(const Tuple &key) const;
+  KeyType MakeKey(const Tuple &key, const RID &rid) const;
+
+  std::shared_ptr<const Version> GetVersion();
+  void Write(const KeyType &key, const RID &rid, bool tombstone);
+  // makes the memtable immutable and starts a new one, waits while there are too many immutable memtables
+  void SwitchMemTable(std::unique_lock<std::mutex> *lock);
+  // rethrows the failure of the background thread if there is one and lets it try again, the caller holds latch_
+  void ThrowBackgroundError();
+  bool Get(const KeyType &key, RID *rid);
+  bool GetFromRun(SortedRun *run, const KeyType &key, RID *rid, bool *tombstone);
+  // the newest entries of the keys in [lo, hi), in key order, tombstones left out
+  void Scan(const KeyType &lo, const KeyType &hi, std::vector<RID> *result);
+  template <typename Visitor>
+  void ScanRun(SortedRun *run, const KeyType &lo, const KeyType &hi, Visitor &&visit);
+
+  void BackgroundWork();
+  std::shared_ptr<SortedRun> WriteRun(const MemTable &memtable);
+  std::shared_ptr<SortedRun> Compact(const std::vector<std::shared_ptr<SortedRun>> &runs);
+
+  KeyComparator comparator_;
+  BufferPoolManager *buffer_pool_manager_;
+  size_t memtable_size_;
+  // serializes the writers of the memtable
+  std::mutex write_latch_;
+  // protects version_, background work waits on cv_
+  std::mutex latch_;
+  std::condition_variable cv_;
+  std::shared_ptr<const Version> version_;
+  bool stop_{false};
+  // failure of the background thread that no writer has seen yet, the background thread waits until one has
+  std::exception_ptr background_error_;
+  size_t next_run_{0};
+  std::atomic<size_t> compactions_{0};
+  std::atomic<size_t> filter_negatives_{0};
+  std::thread background_thread_;
+};
+
+}  // namespace bustub
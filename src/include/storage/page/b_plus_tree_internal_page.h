@@ -11,14 +11,25 @@
 #pragma once
 
 #include <queue>
+#include <vector>
 
 #include "storage/page/b_plus_tree_page.h"
+#include "storage/page/slotted_key_array.h"
 
 namespace bustub {
 
 #define B_PLUS_TREE_INTERNAL_PAGE_TYPE BPlusTreeInternalPage<KeyType, ValueType, KeyComparator>
-#define INTERNAL_PAGE_HEADER_SIZE 24
-#define INTERNAL_PAGE_SIZE ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / (sizeof(MappingType)))
+// fence key宽度为fence_size时header的大小
+#define INTERNAL_PAGE_HEADER_SIZE(fence_size) (44 + 2 * ALIGNED_FENCE_SIZE(fence_size))
+// fence key宽度为fence_size时internal page最多能放的pair数
+#define INTERNAL_PAGE_SIZE_FOR(fence_size) ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE(fence_size)) / (sizeof(MappingType)))
+#define INTERNAL_PAGE_SIZE INTERNAL_PAGE_SIZE_FOR(sizeof(KeyType))
+// 前缀压缩的internal page最多能放的pair数
+#define COMPRESSED_INTERNAL_PAGE_SIZE \
+  ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE(sizeof(KeyType))) / (SlottedKeyArray::SLOT_SIZE + sizeof(ValueType)))
+// 记录子树大小的internal page最多能放的pair数，每个pair多一个计数
+#define COUNTED_INTERNAL_PAGE_SIZE(fence_size) \
+  ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE(fence_size)) / (sizeof(MappingType) + sizeof(uint32_t)))
 /**
  * Store n indexed keys and n+1 child pointers (page_id) within internal page.
  * Pointer PAGE_ID(i) points to a subtree in which all keys K satisfy:
@@ -31,13 +42,27 @@ namespace bustub {
  *  --------------------------------------------------------------------------
  * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
  *  --------------------------------------------------------------------------
+ *
+ * The header is the common header of BPlusTreePage (24 bytes) followed by the right link NextPageId (4), Flags (4),
+ * SlottedKeyArrayHeader (8), FenceSize (4) and the fence keys LowKey and HighKey, laid out as in BPlusTreeLeafPage.
+ * The keys in the subtree of the page are in [LowKey, HighKey). The right link is only maintained by a B-link tree, it
+ * is the next page on the same level, INVALID_PAGE_ID for the rightmost page.
+ *
+ * A compressed page stores its pairs in a SlottedKeyArray like a compressed leaf page. KEY(0) is stored as well: it
+ * is the low key of the page or, for the leftmost page, a key without prefix.
+ *
+ * A counted page also keeps COUNT(i), the number of pairs in the subtree of PAGE_ID(i). The counts move with their
+ * pairs on every insert, remove, split, merge and redistribution of the page; the tree keeps them up to date when the
+ * subtrees change. They are a uint32_t array at the end of the page (which lowers the max size of the page to
+ * COUNTED_INTERNAL_PAGE_SIZE), or, in a compressed page, part of the value of each entry.
  */
 // template <typename KeyType, typename ValueType, typename KeyComparator>
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeInternalPage : public BPlusTreePage {
  public:
   // must call initialize method after "create" a new node
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = INTERNAL_PAGE_SIZE);
+  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = INTERNAL_PAGE_SIZE,
+            bool compressed = false, bool counted = false, int fence_size = sizeof(KeyType));
 
   KeyType KeyAt(int index) const;
   void SetKeyAt(int index, const KeyType &key);
@@ -45,10 +70,30 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   ValueType ValueAt(int index) const;
 
   ValueType Lookup(const KeyType &key, const KeyComparator &comparator) const;
+  int LookupIndex(const KeyType &key, const KeyComparator &comparator) const;
   void PopulateNewRoot(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value);
   int InsertNodeAfter(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value);
   void Remove(int index);
   ValueType RemoveAndReturnOnlyChild();
+  // 在尾部追加一个pair，只用于bulk loading；count是孩子子树的pair数
+  void Append(const KeyType &key, const ValueType &value, uint32_t count = 0);
+
+  // B-link tree的右指针
+  page_id_t GetNextPageId() const;
+  void SetNextPageId(page_id_t next_page_id);
+  // fence key，和leaf page相同
+  KeyType GetLowKey() const;
+  KeyType GetHighKey() const;
+  bool HasLowKey() const;
+  bool HasHighKey() const;
+  void SetFences(const KeyType *low_key, const KeyType *high_key);
+  bool IsCompressed() const;
+  // 子树大小，只有counted的page维护
+  bool IsCounted() const;
+  uint32_t CountAt(int index) const;
+  void SetCountAt(int index, uint32_t count);
+  // 所有孩子子树的pair数之和
+  size_t GetTotalCount() const;
 
   // Split and Merge utility methods
   void MoveAllTo(BPlusTreeInternalPage *recipient, const KeyType &middle_key, BufferPoolManager *buffer_pool_manager);
@@ -57,11 +102,38 @@ class BPlusTreeInternalPage : public BPlusTreePage {
                         BufferPoolManager *buffer_pool_manager);
   void MoveLastToFrontOf(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                          BufferPoolManager *buffer_pool_manager);
+  // 返回recipient能否放下自己、middle_key和本page的所有pair
+  bool CanMoveAllTo(const BPlusTreeInternalPage *recipient, const KeyType &middle_key) const;
 
  private:
-  void CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager);
-  void CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
-  void CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
-  MappingType array_[0];  // std::pair<KeyType, ValueType>
+  void CopyNFrom(const MappingType *items, const uint32_t *counts, int size, BufferPoolManager *buffer_pool_manager);
+  void CopyLastFrom(const MappingType &pair, uint32_t count, BufferPoolManager *buffer_pool_manager);
+  void CopyFirstFrom(const MappingType &pair, uint32_t count, BufferPoolManager *buffer_pool_manager);
+  // 两种格式共用的插入、删除，前缀压缩的page之后更新max size；计数和pair一起移动
+  void InsertAt(int index, const MappingType &item, uint32_t count);
+  void RemoveAt(int index);
+  std::vector<MappingType> Items(int begin, int end) const;
+  std::vector<uint32_t> Counts(int begin, int end) const;
+  // fence key只存前fence_size_个字节，其余字节为0
+  KeyType FenceKey(int index) const;
+  // pair数组紧跟在fence key之后
+  MappingType *Array() const;
+  SlottedKeyArray Slots() const;
+  // 前缀压缩的page中entry的value：page id，counted时后面跟着计数
+  int ValueSize() const;
+  // 没有前缀压缩的page的计数数组，位于page的末尾
+  uint32_t *CountArray() const;
+  void UpdateMaxSize();
+  int GetPrefixSize(const KeyType *low_key, const KeyType *high_key) const;
+
+  page_id_t next_page_id_;
+  bool compressed_;
+  bool has_low_key_;
+  bool has_high_key_;
+  bool counted_;
+  SlottedKeyArrayHeader slots_header_;
+  uint32_t fence_size_;
+  // low key和high key各占fence_size_个字节，之后是pair数组std::pair<KeyType, ValueType>
+  char fences_[0];
 };
 }  // namespace bustub
@@ -15,12 +15,22 @@
 
 #include "common/logger.h"
 #include "storage/page/b_plus_tree_page.h"
+#include "storage/page/posting_list_array.h"
+#include "storage/page/slotted_key_array.h"
 
 namespace bustub {
 
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>
-#define LEAF_PAGE_HEADER_SIZE 28
-#define LEAF_PAGE_SIZE ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(MappingType))
+// fence key宽度为fence_size时header的大小
+#define LEAF_PAGE_HEADER_SIZE(fence_size) (48 + 2 * ALIGNED_FENCE_SIZE(fence_size))
+// fence key宽度为fence_size时leaf最多能放的pair数
+#define LEAF_PAGE_SIZE_FOR(fence_size) ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE(fence_size)) / sizeof(MappingType))
+#define LEAF_PAGE_SIZE LEAF_PAGE_SIZE_FOR(sizeof(KeyType))
+// 前缀压缩的leaf最多能放的pair数，此时key全部被压缩掉
+#define COMPRESSED_LEAF_PAGE_SIZE \
+  ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE(sizeof(KeyType))) / (SlottedKeyArray::SLOT_SIZE + sizeof(ValueType)))
+// 存放posting list的leaf最多能放的pair数，每个rid至少占一个字节
+#define POSTING_LEAF_PAGE_SIZE (PAGE_SIZE - LEAF_PAGE_HEADER_SIZE(sizeof(KeyType)))
 
 /**
  * Store indexed key and record id(record id = page id combined with slot id,
@@ -32,26 +42,62 @@ namespace bustub {
  * | HEADER | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
  *  ----------------------------------------------------------------------
  *
- *  Header format (size in byte, 28 bytes in total):
+ *  Header format (size in byte, 48 bytes + 2 * fence size in total):
  *  ---------------------------------------------------------------------
  * | PageType (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
  *  ---------------------------------------------------------------------
- *  -----------------------------------------------
- * | ParentPageId (4) | PageId (4) | NextPageId (4)
- *  -----------------------------------------------
+ *  ----------------------------------------------------------------------------------------------------------
+ * | ParentPageId (4) | PageId (4) | NextPageId (4) | PrevPageId (4) | Flags (4) | SlottedKeyArrayHeader (8) |
+ *  ----------------------------------------------------------------------------------------------------------
+ *  -------------------------------------------------------
+ * | FenceSize (4) | LowKey (fence) | HighKey (fence) |
+ *  -------------------------------------------------------
+ *  LowKey and HighKey are the fence keys of the page, every key of the page is in [LowKey, HighKey). The leftmost
+ *  page has no LowKey, the rightmost page has no HighKey. Split and merge maintain them. A fence only stores the first
+ *  FenceSize bytes of its key, the bytes the comparator of the tree looks at (see KeyTraits::GetFenceSize), the other
+ *  bytes read as zero; compressed and posting list pages store whole keys. So a tree whose keys are much shorter than
+ *  KeyType does not lose pairs to its fences.
+ *  NextPageId and PrevPageId link the leaves in key order in both directions, for forward and reverse scans. The
+ *  leftmost page has no PrevPageId, the rightmost page no NextPageId.
+ *
+ *  A page initialized as compressed stores its pairs in a SlottedKeyArray instead: the common prefix of the fence
+ *  keys is left out of every key. This needs keys whose byte order is their key order, i.e. KeyFormat::NORMALIZED.
+ *  The max size of a compressed page follows its free space: it is the current size plus the number of largest
+ *  possible entries that still fit, capped by the max size the page was initialized with. So a page that is not full
+ *  always has room for one more pair, as the tree expects.
+ *
+ *  A page initialized with posting lists stores the pairs of keys that end with the rid of their entry (see
+ *  KeyTraits::HasPostingLists) in a PostingListArray: every key tuple once, followed by the delta encoded rids of its
+ *  entries. Its max size follows its free space like the one of a compressed page, it is not prefix compressed. A page
+ *  of a non-unique index with many entries per key holds several times as many pairs this way. KeyAt and GetItem
+ *  decode the posting list of a pair up to the pair, DecodePostingList decodes a whole posting list at once for scans.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeLeafPage : public BPlusTreePage {
  public:
   // After creating a new leaf page from buffer pool, must call initialize
   // method to set default values
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = LEAF_PAGE_SIZE - 1);
+  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = LEAF_PAGE_SIZE - 1,
+            bool compressed = false, bool posting = false, int fence_size = sizeof(KeyType));
   // helper methods
   page_id_t GetNextPageId() const;
   void SetNextPageId(page_id_t next_page_id);
+  page_id_t GetPrevPageId() const;
+  void SetPrevPageId(page_id_t prev_page_id);
+  // fence key，GetNextPageId()为INVALID_PAGE_ID时上界为+inf
+  KeyType GetLowKey() const;
+  KeyType GetHighKey() const;
+  bool HasLowKey() const;
+  bool HasHighKey() const;
+  // 设置fence key，nullptr表示-inf/+inf；前缀压缩的page会按新的前缀重新编码
+  void SetFences(const KeyType *low_key, const KeyType *high_key);
+  bool IsCompressed() const;
+  bool IsPostingList() const;
   KeyType KeyAt(int index) const;
   int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
-  const MappingType &GetItem(int index);
+  MappingType GetItem(int index) const;
+  // 把index所在的posting list整个解码成pair，返回它第一个pair的下标
+  int DecodePostingList(int index, std::vector<MappingType> *items) const;
 
   // insert and delete methods
   int Insert(const KeyType &key, const ValueType &value, const KeyComparator &comparator);
@@ -59,16 +105,47 @@ class BPlusTreeLeafPage : public BPlusTreePage {
   int RemoveAndDeleteRecord(const KeyType &key, const KeyComparator &comparator);
 
   // Split and Merge utility methods
+  // 分裂时前缀压缩的page用后缀截断选出最短的分隔key，作为recipient的LowKey
   void MoveHalfTo(BPlusTreeLeafPage *recipient);
   void MoveAllTo(BPlusTreeLeafPage *recipient);
   void MoveFirstToEndOf(BPlusTreeLeafPage *recipient);
   void MoveLastToFrontOf(BPlusTreeLeafPage *recipient);
+  // 前缀压缩的page合并时上下界变宽，前缀可能变短，返回recipient能否放下自己和本page的所有pair
+  bool CanMoveAllTo(const BPlusTreeLeafPage *recipient) const;
 
  private:
-  void CopyNFrom(MappingType *items, int size);
+  void CopyNFrom(const MappingType *items, int size);
   void CopyLastFrom(const MappingType &item);
   void CopyFirstFrom(const MappingType &item);
+  // 两种格式共用的插入、删除，前缀压缩的page之后更新max size
+  void InsertAt(int index, const MappingType &item);
+  void RemoveAt(int index);
+  std::vector<MappingType> Items(int begin, int end) const;
+  // fence key只存前fence_size_个字节，其余字节为0
+  KeyType FenceKey(int index) const;
+  // pair数组紧跟在fence key之后
+  MappingType *Array() const;
+  SlottedKeyArray Slots() const;
+  PostingListArray PostingLists() const;
+  // 用key tuple和rid还原posting list中的key
+  static KeyType MakeKey(const char *tuple, int tuple_size, int64_t rid);
+  // 在posting list的尾部追加pair，放不下时返回false
+  static bool AppendPosting(PostingListArray *posting_lists, const MappingType &item);
+  // 用items重建posting list
+  void SetPostingItems(const std::vector<MappingType> &items);
+  // 前缀压缩的page按空闲空间更新max size
+  void UpdateMaxSize();
+  int GetPrefixSize(const KeyType *low_key, const KeyType *high_key) const;
+
   page_id_t next_page_id_;
-  MappingType array_[0];
+  page_id_t prev_page_id_;
+  bool compressed_;
+  bool has_low_key_;
+  bool has_high_key_;
+  bool posting_;
+  SlottedKeyArrayHeader slots_header_;
+  uint32_t fence_size_;
+  // low key和high key各占fence_size_个字节，之后是pair数组
+  char fences_[0];
 };
 }  // namespace bustub
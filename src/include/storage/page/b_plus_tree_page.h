@@ -25,6 +25,9 @@ namespace bustub {
 
 #define INDEX_TEMPLATE_ARGUMENTS template <typename KeyType, typename ValueType, typename KeyComparator>
 
+// page中一个fence key占用的字节数，按4字节对齐，使后面的pair数组对齐
+#define ALIGNED_FENCE_SIZE(fence_size) (((fence_size) + 3) / 4 * 4)
+
 // define page type enum
 enum class IndexPageType { INVALID_INDEX_PAGE = -11, LEAF_PAGE, INTERNAL_PAGE };
 
@@ -0,0 +1,87 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lsm_run_page.h
+//
+// Identification: src/include/storage/page/lsm_run_page.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+
+#include "common/config.h"
+#include "common/rid.h"
+
+namespace bustub {
+
+/**
+ * A page of a sorted run of an LSMIndex. Runs are written once, sequentially, and never change afterwards.
+ *
+ * Run page format (entries are stored in key order, a key appears at most once per run):
+ *  ---------------------------------------------------------------------------------
+ * | Size (4) | Padding (4) | KEY(1) + RID(1) + TOMBSTONE(1) | ... | KEY(n) + RID(n) + TOMBSTONE(n) |
+ *  ---------------------------------------------------------------------------------
+ *
+ * A tombstone entry records that the key was deleted, it hides the entries of the key in older runs.
+ */
+template <typename KeyType>
+class LSMRunPage {
+ public:
+  struct Entry {
+    KeyType key_;
+    RID rid_;
+    uint32_t tombstone_;
+  };
+
+  /** Max number of entries of a page. */
+  static constexpr int MAX_SIZE = (PAGE_SIZE - 8) / sizeof(Entry);
+
+  LSMRunPage() = delete;
+
+  void Init() { size_ = 0; }
+
+  int GetSize() const { return size_; }
+
+  const KeyType &KeyAt(int index) const { return entries_[index].key_; }
+
+  RID RidAt(int index) const { return entries_[index].rid_; }
+
+  bool IsTombstone(int index) const { return entries_[index].tombstone_ != 0; }
+
+  /** Appends an entry, its key has to be larger than all keys of the page. @return false if the page is full */
+  bool Append(const KeyType &key, const RID &rid, bool tombstone) {
+    if (size_ == MAX_SIZE) {
+      return false;
+    }
+    entries_[size_++] = {key, rid, tombstone ? 1U : 0U};
+    return true;
+  }
+
+  /** @return index of the first key >= key, GetSize() if there is none */
+  template <typename KeyComparator>
+  int LowerBound(const KeyType &key, const KeyComparator &comparator) const {
+    int lo = 0;
+    int hi = size_;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (comparator(entries_[mid].key_, key) < 0) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+ private:
+  int32_t size_;
+  int32_t padding_;
+  Entry entries_[0];
+};
+
+}  // namespace bustub
@@ -32,8 +32,8 @@ class Page {
   friend class BufferPoolManager;
 
  public:
-  /** Constructor. Zeros out the page data. */
-  Page() { ResetMemory(); }
+  /** Constructor. The page data is attached later by the buffer pool manager, see BufferPoolManager(). */
+  Page() = default;
 
   /** Default destructor. */
   ~Page() = default;
@@ -80,8 +80,11 @@ class Page {
   /** Zeroes out the data that is held within the page. */
   inline void ResetMemory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }  // 将data_的PAGE_SIZE个字节填充为0
 
-  /** The actual data that is stored within a page. */
-  char data_[PAGE_SIZE]{};
+  /**
+   * The actual data that is stored within a page. It points into the PAGE_SIZE-aligned frame arena owned by the
+   * buffer pool manager, so that the frame can be handed to the disk manager directly for O_DIRECT I/O.
+   */
+  char *data_{nullptr};
   /** The ID of this page. */
   page_id_t page_id_ = INVALID_PAGE_ID;
   /** The pin count of this page. */
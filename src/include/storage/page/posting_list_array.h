@@ -0,0 +1,141 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// posting_list_array.h
+//
+// Identification: src/include/storage/page/posting_list_array.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace bustub {
+
+/** State of a PostingListArray, kept at the start of its area. */
+struct PostingListHeader {
+  /** Number of posting lists. */
+  uint16_t group_count_;
+  /** Offset of the first free byte after the posting lists, from the start of the area. */
+  uint16_t data_end_;
+};
+
+/**
+ * PostingListArray is the entry array of a B+ tree leaf page whose keys are a key tuple followed by the rid of their
+ * entry (see KeyTraits::HasPostingLists). The entries of a key tuple are stored as one posting list: the bytes of the
+ * key tuple once, followed by the sorted rids of its entries. The first and the last rid are stored as is, the rids
+ * after the first one as the difference to the previous rid in a varint, mostly one or two bytes for the rids of a
+ * table. The array works on key tuples as bytes and rids as RID::Get(), the page turns them back into keys.
+ *
+ *  --------------------------------------------------------------------------------------------
+ * | HEADER | GROUP(1) | GROUP(2) | ... | GROUP(m) | free space | DIR(m) | ... | DIR(2) | DIR(1) |
+ *  --------------------------------------------------------------------------------------------
+ * GROUP = rid count (2) + tuple size (2) + key tuple + first rid (8) + last rid (8) + deltas (varint each)
+ * DIR = group offset (2) + index of the first entry of the group (2)
+ *
+ * Appending to the last posting list takes constant time. Inserting or removing an entry elsewhere re-encodes its
+ * posting list and moves the posting lists behind it. Removing an entry never makes the array larger.
+ *
+ * The array is a view over a page, it does not own anything.
+ */
+class PostingListArray {
+ public:
+  /** Size of a directory entry in bytes. */
+  static constexpr int DIRECTORY_ENTRY_SIZE = 2 * sizeof(uint16_t);
+  /** Size of a posting list without its key tuple and deltas. */
+  static constexpr int GROUP_HEADER_SIZE = 2 * sizeof(uint16_t) + 2 * sizeof(int64_t);
+
+  /**
+   * @param data start of the area, the header is stored there
+   * @param size size of the area
+   */
+  PostingListArray(char *data, int size) : data_(data), size_(size) {}
+
+  /** Empties the array. */
+  void Reset();
+
+  /** @return number of posting lists */
+  int GetGroupCount() const { return Header()->group_count_; }
+
+  /** @return number of entries of all posting lists */
+  int GetSize() const;
+
+  /**
+   * Appends an entry after all entries, to the last posting list if it has the same key tuple. The entry has to be
+   * larger than the last entry.
+   * @return false if the entry does not fit
+   */
+  bool Append(const char *tuple, int tuple_size, int64_t rid);
+
+  /**
+   * Inserts an entry at index, the entry has to be larger than entry index - 1 and smaller than entry index.
+   * @return false if the entry does not fit
+   */
+  bool Insert(int index, const char *tuple, int tuple_size, int64_t rid);
+
+  /** Removes entry index. */
+  void Remove(int index);
+
+  /** @return the posting list that holds entry index */
+  int FindGroup(int index) const;
+
+  /** @return index of the first entry of a posting list */
+  int GetFirstIndex(int group) const;
+
+  /** @return number of entries of a posting list */
+  int GetCount(int group) const;
+
+  /** @return the key tuple of a posting list, its size in tuple_size */
+  const char *GetTuple(int group, int *tuple_size) const;
+
+  int64_t GetFirstRid(int group) const;
+
+  int64_t GetLastRid(int group) const;
+
+  /** @return the rid at position of a posting list, decodes the deltas up to position */
+  int64_t GetRid(int group, int position) const;
+
+  /** Decodes all rids of a posting list. */
+  void GetRids(int group, std::vector<int64_t> *rids) const;
+
+  /** @return free bytes of the area */
+  int GetFreeSize() const;
+
+  /** @return bytes that one more entry takes at most (a new posting list), with keys of key_size bytes */
+  static int GetMaxEntrySize(int key_size) { return DIRECTORY_ENTRY_SIZE + GROUP_HEADER_SIZE + key_size; }
+
+ private:
+  struct DirectoryEntry {
+    uint16_t offset_;
+    uint16_t first_index_;
+  };
+
+  PostingListHeader *Header() const { return reinterpret_cast<PostingListHeader *>(data_); }
+  DirectoryEntry GetEntry(int group) const;
+  void SetEntry(int group, DirectoryEntry entry);
+  /** @return offset of the deltas of a posting list */
+  int DeltasOffset(int group) const;
+  /** @return offset of the end of a posting list */
+  int GroupEnd(int group) const;
+  /** Replaces the rids of a posting list by rids, moves the posting lists behind it. @return false if out of space */
+  bool SetRids(int group, const std::vector<int64_t> &rids);
+  /** Moves the bytes from offset to the end of the data by delta bytes, and the directory offsets with them. */
+  void MoveData(int offset, int delta);
+  /** Adds delta to the first index of the posting lists from group on. */
+  void MoveFirstIndexes(int group, int delta);
+
+  template <typename T>
+  T Read(int offset) const;
+  template <typename T>
+  void Write(int offset, T value);
+
+  char *data_;
+  int size_;
+};
+
+}  // namespace bustub
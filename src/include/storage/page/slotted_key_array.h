@@ -0,0 +1,143 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// slotted_key_array.h
+//
+// Identification: src/include/storage/page/slotted_key_array.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/** State of a SlottedKeyArray, kept in the header of the page. */
+struct SlottedKeyArrayHeader {
+  /** Number of leading key bytes shared by every key of the page, they are not stored in the entries. */
+  uint16_t prefix_size_;
+  /** Offset of the first heap byte from the start of the page, the heap grows down from the end of the page. */
+  uint16_t heap_begin_;
+  /** Bytes of removed entries that are still inside the heap, they are reclaimed by Compact. */
+  uint16_t garbage_size_;
+  /** The max size the page was initialized with. */
+  uint16_t size_limit_;
+};
+
+/**
+ * SlottedKeyArray is the entry array of a prefix compressed B+ tree page. It works on fixed size keys whose byte order
+ * is their key order (KeyFormat::NORMALIZED), so that a key is fully described by its bytes:
+ *
+ *  - the prefix shared by all keys of the page is stored once, in the fence keys of the page, not in the entries;
+ *  - trailing zero bytes of a key are not stored, a separator produced by suffix truncation mostly consists of them.
+ *
+ * Entries have variable size, the page is slotted:
+ *  -------------------------------------------------------------------------------------
+ * | HEADER | SLOT(1) | SLOT(2) | ... | SLOT(n) | free space | ENTRY(n) | ... | ENTRY(1) |
+ *  -------------------------------------------------------------------------------------
+ * SLOT = entry offset (2) + stored key size (2), ENTRY = stored key bytes + value.
+ *
+ * The array is a view over a page, it does not own anything. The caller keeps the number of entries.
+ */
+class SlottedKeyArray {
+ public:
+  /** Size of a slot in bytes. */
+  static constexpr int SLOT_SIZE = 2 * sizeof(uint16_t);
+
+  /**
+   * @param page start of the page
+   * @param header layout state inside the page header
+   * @param slots start of the slot array, right after the page header
+   * @param size number of entries
+   * @param key_size size of a full key
+   * @param value_size size of a value
+   * @param prefix the prefix of the keys, at least header->prefix_size_ bytes
+   */
+  SlottedKeyArray(char *page, SlottedKeyArrayHeader *header, char *slots, int size, int key_size, int value_size,
+                  const char *prefix)
+      : page_(page),
+        header_(header),
+        slots_(slots),
+        size_(size),
+        key_size_(key_size),
+        value_size_(value_size),
+        prefix_(prefix) {}
+
+  /** Empties the heap of an array. */
+  static void Reset(SlottedKeyArrayHeader *header) {
+    header->heap_begin_ = PAGE_SIZE;
+    header->garbage_size_ = 0;
+  }
+
+  /** @return the length of the common prefix of two byte strings of length n */
+  static int CommonPrefix(const char *lhs, const char *rhs, int n);
+
+  /** @return the length of key without its trailing zero bytes */
+  static int SignificantSize(const char *key, int key_size);
+
+  /**
+   * Compares a full key with the key of an entry.
+   * @param key a full key
+   * @param significant_size SignificantSize of key
+   * @return < 0, 0, > 0 as key is less than, equal to, greater than the key of entry index
+   */
+  int Compare(const char *key, int significant_size, int index) const;
+
+  /** @return the first index in [begin, size) whose key is >= key (upper = false) or > key (upper = true) */
+  int Search(const char *key, int begin, bool upper) const;
+
+  /** Writes the full key of entry index into key. */
+  void GetKey(int index, char *key) const;
+
+  /** @return the value bytes of entry index, they are not aligned */
+  const char *GetValue(int index) const;
+
+  /** Overwrites the value of entry index. */
+  void SetValue(int index, const char *value);
+
+  /**
+   * Inserts an entry at index, the key has to start with the prefix of the page.
+   * @return false if the entry does not fit into the page
+   */
+  bool Insert(int index, const char *key, const char *value);
+
+  /** Removes entry index. */
+  void Remove(int index);
+
+  /** @return bytes an entry with key takes, slot included */
+  int GetEntrySize(const char *key) const;
+
+  /** @return bytes the largest entry takes, slot included */
+  int GetMaxEntrySize() const { return SLOT_SIZE + key_size_ - header_->prefix_size_ + value_size_; }
+
+  /** @return free bytes of the page, including garbage in the heap */
+  int GetFreeSize() const { return header_->heap_begin_ - SlotsEnd() + header_->garbage_size_; }
+
+ private:
+  struct Slot {
+    uint16_t offset_;
+    uint16_t key_size_;
+  };
+
+  Slot GetSlot(int index) const;
+  void SetSlot(int index, Slot slot);
+  int SlotsEnd() const { return static_cast<int>(slots_ - page_) + size_ * SLOT_SIZE; }
+  /** Moves all entries to the end of the page, so that the free space is contiguous. */
+  void Compact();
+
+  char *page_;
+  SlottedKeyArrayHeader *header_;
+  char *slots_;
+  int size_;
+  int key_size_;
+  int value_size_;
+  const char *prefix_;
+};
+
+}  // namespace bustub
@@ -35,7 +35,7 @@ class TableHeap {
    * @param buffer_pool_manager the buffer pool manager
    * @param lock_manager the lock manager
    * @param log_manager the log manager
-   * @param first_page_id the id of the first page
+   * @param first_page_id the id of the first page, new pages go to the segment of this page
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
             page_id_t first_page_id);
@@ -46,9 +46,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param txn the creating transaction
+   * @param segment_id segment (tablespace file) to allocate the pages of the table from
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            Transaction *txn);
+            Transaction *txn, segment_id_t segment_id = DEFAULT_SEGMENT_ID);
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
@@ -113,6 +114,7 @@ class TableHeap {
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  segment_id_t segment_id_;
 };
 
 }  // namespace bustub
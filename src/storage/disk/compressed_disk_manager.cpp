@@ -0,0 +1,478 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compressed_disk_manager.cpp
+//
+// Identification: src/storage/disk/compressed_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/compressed_disk_manager.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include "common/logger.h"
+
+namespace bustub {
+
+/** Matches shorter than this are emitted as literals. */
+static constexpr size_t MIN_MATCH = 4;
+/** Offsets are stored in two bytes. */
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr int HASH_BITS = 12;
+
+static uint32_t Load32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t HashSequence(uint32_t sequence) { return (sequence * 2654435761U) >> (32 - HASH_BITS); }
+
+/*
+ * 长度字段：token中的4 bit存不下时（等于15），后面追加若干字节，每个字节255表示还有后续
+ */
+static bool EmitLength(size_t length, char *dst, size_t capacity, size_t *out) {
+  while (length >= 255) {
+    if (*out >= capacity) {
+      return false;
+    }
+    dst[(*out)++] = static_cast<char>(255);
+    length -= 255;
+  }
+  if (*out >= capacity) {
+    return false;
+  }
+  dst[(*out)++] = static_cast<char>(length);
+  return true;
+}
+
+/*
+ * 一个sequence：token(高4位literal长度，低4位match长度-4) | literal长度扩展 | literals | offset(2字节) | match长度扩展
+ * 最后一个sequence只有literals，解码时以输入结束来识别
+ */
+static bool EmitSequence(const char *literals, size_t literal_length, size_t offset, size_t match_length, char *dst,
+                         size_t capacity, size_t *out) {
+  if (*out >= capacity) {
+    return false;
+  }
+  size_t token_out = (*out)++;
+  auto token = static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4);
+  if (literal_length >= 15 && !EmitLength(literal_length - 15, dst, capacity, out)) {
+    return false;
+  }
+  if (*out + literal_length > capacity) {
+    return false;
+  }
+  memcpy(dst + *out, literals, literal_length);
+  *out += literal_length;
+  if (match_length > 0) {
+    if (*out + 2 > capacity) {
+      return false;
+    }
+    dst[(*out)++] = static_cast<char>(offset & 0xFF);
+    dst[(*out)++] = static_cast<char>(offset >> 8);
+    size_t length = match_length - MIN_MATCH;
+    token |= static_cast<uint8_t>(std::min<size_t>(length, 15));
+    if (length >= 15 && !EmitLength(length - 15, dst, capacity, out)) {
+      return false;
+    }
+  }
+  dst[token_out] = static_cast<char>(token);
+  return true;
+}
+
+size_t PageCodec::Compress(const char *src, size_t size, char *dst, size_t capacity) {
+  std::array<int32_t, 1 << HASH_BITS> table;
+  table.fill(-1);
+  size_t anchor = 0;
+  size_t out = 0;
+  size_t i = 0;
+  while (i + MIN_MATCH <= size) {
+    uint32_t sequence = Load32(src + i);
+    uint32_t hash = HashSequence(sequence);
+    int32_t candidate = table[hash];
+    table[hash] = static_cast<int32_t>(i);
+    if (candidate < 0 || i - candidate > MAX_OFFSET || Load32(src + candidate) != sequence) {
+      i++;
+      continue;
+    }
+    // the match may overlap the current position, that is how runs are encoded
+    size_t match_length = MIN_MATCH;
+    while (i + match_length < size && src[candidate + match_length] == src[i + match_length]) {
+      match_length++;
+    }
+    if (!EmitSequence(src + anchor, i - anchor, i - candidate, match_length, dst, capacity, &out)) {
+      return 0;
+    }
+    i += match_length;
+    anchor = i;
+  }
+  if (!EmitSequence(src + anchor, size - anchor, 0, 0, dst, capacity, &out)) {
+    return 0;
+  }
+  return out;
+}
+
+static bool ReadLength(const char *src, size_t size, size_t *in, size_t *length) {
+  uint8_t byte;
+  do {
+    if (*in >= size) {
+      return false;
+    }
+    byte = static_cast<uint8_t>(src[(*in)++]);
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool PageCodec::Decompress(const char *src, size_t size, char *dst, size_t dst_size) {
+  size_t in = 0;
+  size_t out = 0;
+  while (in < size) {
+    auto token = static_cast<uint8_t>(src[in++]);
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !ReadLength(src, size, &in, &literal_length)) {
+      return false;
+    }
+    if (in + literal_length > size || out + literal_length > dst_size) {
+      return false;
+    }
+    memcpy(dst + out, src + in, literal_length);
+    in += literal_length;
+    out += literal_length;
+    if (in == size) {
+      break;
+    }
+    if (in + 2 > size) {
+      return false;
+    }
+    size_t offset = static_cast<uint8_t>(src[in]) | static_cast<size_t>(static_cast<uint8_t>(src[in + 1])) << 8;
+    in += 2;
+    size_t match_length = token & 15;
+    if (match_length == 15 && !ReadLength(src, size, &in, &match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > out || out + match_length > dst_size) {
+      return false;
+    }
+    // byte by byte, the source of an overlapping match is still being written
+    for (size_t k = 0; k < match_length; k++) {
+      dst[out + k] = dst[out - offset + k];
+    }
+    out += match_length;
+  }
+  return out == dst_size;
+}
+
+CompressedDiskManager::CompressedDiskManager(const std::string &db_file)
+    : DiskManager(db_file, false), allocators_(MAX_SEGMENTS) {
+  preallocate_extents_ = false;
+  std::string::size_type n = file_name_.rfind('.');
+  if (n == std::string::npos) {
+    return;
+  }
+  page_map_name_ = file_name_.substr(0, n) + ".pagemap";
+  LoadPageMap();
+}
+
+CompressedDiskManager::~CompressedDiskManager() {
+  if (!page_map_saved_) {
+    SavePageMap();
+  }
+}
+
+void CompressedDiskManager::ShutDown() {
+  SavePageMap();
+  DiskManager::ShutDown();
+}
+
+uint16_t CompressedDiskManager::GetSizeClass(size_t stored_size) {
+  uint16_t size_class = 0;
+  while ((static_cast<size_t>(MIN_SLOT_SIZE) << size_class) < stored_size) {
+    size_class++;
+  }
+  return size_class;
+}
+
+uint64_t CompressedDiskManager::AllocateSlot(segment_id_t segment_id, uint16_t size_class) {
+  SlotAllocator &allocator = allocators_[segment_id];
+  auto &free_slots = allocator.free_slots_[size_class];
+  if (!free_slots.empty()) {
+    uint64_t offset = free_slots.back();
+    free_slots.pop_back();
+    return offset;
+  }
+  uint64_t offset = allocator.end_;
+  allocator.end_ += MIN_SLOT_SIZE << size_class;
+  return offset;
+}
+
+/**
+ * Compress the page and write it into a slot of the matching size class
+ * 每次写都分配新slot，不原地覆盖：已保存的page map可能还指向旧slot和旧的stored_size_，
+ * 覆盖之后crash会按旧长度读新数据。旧slot等不再引用它的page map保存之后才复用
+ */
+void CompressedDiskManager::WritePageImpl(page_id_t page_id, const char *page_data) {
+  std::shared_ptr<Segment> segment;
+  int fd = GetPageFd(page_id, &segment);
+  if (fd < 0) {
+    LOG_DEBUG("I/O error while writing, no file for page %d", page_id);
+    return;
+  }
+  char buffer[PAGE_SIZE];
+  auto start = std::chrono::steady_clock::now();
+  // a page has to shrink to half a page at least, otherwise decompressing it on every read does not pay off
+  size_t stored_size = PageCodec::Compress(page_data, PAGE_SIZE, buffer, PAGE_SIZE / 2);
+  compress_ns_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  const char *stored_data = buffer;
+  if (stored_size == 0) {
+    stored_size = PAGE_SIZE;
+    stored_data = page_data;
+    pages_stored_raw_ += 1;
+  }
+
+  uint16_t size_class = GetSizeClass(stored_size);
+  segment_id_t segment_id = GetSegmentId(page_id);
+  Slot slot;
+  {
+    std::scoped_lock lock{map_latch_};
+    auto iter = page_map_.find(page_id);
+    if (iter != page_map_.end()) {
+      // the saved page map may still point at the old slot, it is reused once the page map has been saved
+      allocators_[segment_id].pending_free_slots_[iter->second.size_class_].push_back(iter->second.offset_);
+    }
+    slot.offset_ = AllocateSlot(segment_id, size_class);
+    slot.size_class_ = size_class;
+    slot.stored_size_ = static_cast<uint16_t>(stored_size);
+    page_map_[page_id] = slot;
+  }
+
+  pages_written_ += 1;
+  bytes_stored_ += MIN_SLOT_SIZE << size_class;
+  ssize_t write_count = pwrite(fd, stored_data, stored_size, static_cast<off_t>(slot.offset_));
+  if (write_count != static_cast<ssize_t>(stored_size)) {
+    LOG_DEBUG("I/O error while writing");
+  }
+}
+
+/**
+ * Read the slot of the page and decompress it into the given memory area
+ */
+void CompressedDiskManager::ReadPageImpl(page_id_t page_id, char *page_data) {
+  Slot slot;
+  {
+    std::scoped_lock lock{map_latch_};
+    auto iter = page_map_.find(page_id);
+    if (iter == page_map_.end()) {
+      memset(page_data, 0, PAGE_SIZE);
+      return;
+    }
+    slot = iter->second;
+  }
+  std::shared_ptr<Segment> segment;
+  int fd = GetPageFd(page_id, &segment);
+  if (fd < 0) {
+    LOG_DEBUG("I/O error while reading, no file for page %d", page_id);
+    return;
+  }
+  if (slot.stored_size_ == PAGE_SIZE) {
+    if (pread(fd, page_data, PAGE_SIZE, static_cast<off_t>(slot.offset_)) != PAGE_SIZE) {
+      LOG_DEBUG("I/O error while reading");
+    }
+    return;
+  }
+  char buffer[PAGE_SIZE];
+  if (pread(fd, buffer, slot.stored_size_, static_cast<off_t>(slot.offset_)) != slot.stored_size_) {
+    LOG_DEBUG("I/O error while reading");
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  if (!PageCodec::Decompress(buffer, slot.stored_size_, page_data, PAGE_SIZE)) {
+    LOG_DEBUG("corrupt compressed page %d", page_id);
+    memset(page_data, 0, PAGE_SIZE);
+  }
+  decompress_ns_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CompressedDiskManager::SyncImpl() {
+  DiskManager::SyncImpl();
+  SavePageMap();
+}
+
+void CompressedDiskManager::ClearSegment(segment_id_t segment_id) {
+  for (auto iter = page_map_.begin(); iter != page_map_.end();) {
+    if (GetSegmentId(iter->first) == segment_id) {
+      iter = page_map_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  allocators_[segment_id] = SlotAllocator();
+}
+
+/*
+ * 先保存不含该段的page map，再删除/截断文件，已保存的page map不会指向被覆盖的slot
+ */
+void CompressedDiskManager::DropSegment(segment_id_t segment_id) {
+  {
+    std::scoped_lock lock{save_latch_, map_latch_};
+    ClearSegment(segment_id);
+  }
+  SavePageMap();
+  DiskManager::DropSegment(segment_id);
+}
+
+void CompressedDiskManager::TruncateSegment(segment_id_t segment_id) {
+  {
+    std::scoped_lock lock{save_latch_, map_latch_};
+    ClearSegment(segment_id);
+  }
+  SavePageMap();
+  DiskManager::TruncateSegment(segment_id);
+}
+
+CompressionStats CompressedDiskManager::GetCompressionStats() const {
+  CompressionStats stats;
+  stats.pages_written_ = pages_written_;
+  stats.pages_stored_raw_ = pages_stored_raw_;
+  stats.bytes_in_ = stats.pages_written_ * PAGE_SIZE;
+  stats.bytes_stored_ = bytes_stored_;
+  stats.compress_ns_ = compress_ns_;
+  stats.decompress_ns_ = decompress_ns_;
+  return stats;
+}
+
+uint64_t CompressedDiskManager::GetStoredSize() {
+  std::scoped_lock lock{map_latch_};
+  uint64_t size = 0;
+  for (const auto &allocator : allocators_) {
+    size += allocator.end_;
+  }
+  return size;
+}
+
+/*
+ * page map文件：每个page一条定长记录 (page_id, offset, size_class, stored_size)
+ * free slot不保存，加载时由已用slot之间的空隙重建
+ */
+void CompressedDiskManager::LoadPageMap() {
+  std::ifstream in(page_map_name_, std::ios::binary);
+  page_id_t page_id;
+  Slot slot;
+  while (in.read(reinterpret_cast<char *>(&page_id), sizeof(page_id)) &&
+         in.read(reinterpret_cast<char *>(&slot.offset_), sizeof(slot.offset_)) &&
+         in.read(reinterpret_cast<char *>(&slot.size_class_), sizeof(slot.size_class_)) &&
+         in.read(reinterpret_cast<char *>(&slot.stored_size_), sizeof(slot.stored_size_))) {
+    page_map_[page_id] = slot;
+  }
+
+  std::vector<std::vector<std::pair<uint64_t, uint64_t>>> used(MAX_SEGMENTS);
+  for (const auto &[id, s] : page_map_) {
+    used[GetSegmentId(id)].emplace_back(s.offset_, s.offset_ + (MIN_SLOT_SIZE << s.size_class_));
+  }
+  for (segment_id_t segment_id = 0; segment_id < MAX_SEGMENTS; segment_id++) {
+    auto &slots = used[segment_id];
+    std::sort(slots.begin(), slots.end());
+    SlotAllocator &allocator = allocators_[segment_id];
+    for (const auto &[begin, end] : slots) {
+      // slot sizes and offsets are multiples of MIN_SLOT_SIZE, so every gap splits into whole slots
+      while (allocator.end_ < begin) {
+        uint16_t size_class = NUM_SIZE_CLASSES - 1;
+        while ((static_cast<uint64_t>(MIN_SLOT_SIZE) << size_class) > begin - allocator.end_) {
+          size_class--;
+        }
+        allocator.free_slots_[size_class].push_back(allocator.end_);
+        allocator.end_ += MIN_SLOT_SIZE << size_class;
+      }
+      allocator.end_ = end;
+    }
+  }
+
+  // a compressed segment file is smaller than its page count, the next page number comes from the page map
+  std::scoped_lock lock{segment_latch_};
+  for (segment_id_t segment_id = DEFAULT_SEGMENT_ID + 1; segment_id < MAX_SEGMENTS; segment_id++) {
+    if (segments_[segment_id] != nullptr) {
+      segments_[segment_id]->next_page_no_ = 0;
+    }
+  }
+  for (const auto &entry : page_map_) {
+    Segment *segment = GetSegment(GetSegmentId(entry.first));
+    if (segment != nullptr) {
+      segment->next_page_no_ = std::max(segment->next_page_no_, GetPageNumber(entry.first) + 1);
+    }
+  }
+}
+
+/**
+ * Write the page map to a temporary file first and rename it, so a crash never leaves a torn page map
+ * 写出page map时取走各段的pending slot，新page map落盘后它们才进入free list；保存失败则放回pending
+ */
+void CompressedDiskManager::SavePageMap() {
+  std::scoped_lock save_lock{save_latch_};
+  page_map_saved_ = true;
+  std::vector<std::array<std::vector<uint64_t>, NUM_SIZE_CLASSES>> released(MAX_SEGMENTS);
+  bool saved = false;
+  {
+    std::scoped_lock lock{map_latch_};
+    for (segment_id_t segment_id = 0; segment_id < MAX_SEGMENTS; segment_id++) {
+      released[segment_id].swap(allocators_[segment_id].pending_free_slots_);
+    }
+  }
+  if (page_map_name_.empty()) {
+    // nothing is saved, so there is no page map a slot could be referenced by
+    saved = true;
+  } else {
+    std::string tmp_name = page_map_name_ + ".tmp";
+    {
+      std::scoped_lock lock{map_latch_};
+      std::ofstream out(tmp_name, std::ios::binary | std::ios::trunc);
+      for (const auto &[page_id, slot] : page_map_) {
+        out.write(reinterpret_cast<const char *>(&page_id), sizeof(page_id));
+        out.write(reinterpret_cast<const char *>(&slot.offset_), sizeof(slot.offset_));
+        out.write(reinterpret_cast<const char *>(&slot.size_class_), sizeof(slot.size_class_));
+        out.write(reinterpret_cast<const char *>(&slot.stored_size_), sizeof(slot.stored_size_));
+      }
+      out.close();
+      saved = out.good();
+    }
+    // the new page map has to be on disk before the slots it no longer refers to are overwritten
+    int fd = saved ? open(tmp_name.c_str(), O_RDONLY) : -1;
+    saved = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (!saved) {
+      LOG_DEBUG("I/O error while writing %s", tmp_name.c_str());
+    } else if (rename(tmp_name.c_str(), page_map_name_.c_str()) != 0) {
+      LOG_DEBUG("I/O error while replacing %s", page_map_name_.c_str());
+      saved = false;
+    }
+  }
+
+  std::scoped_lock lock{map_latch_};
+  for (segment_id_t segment_id = 0; segment_id < MAX_SEGMENTS; segment_id++) {
+    SlotAllocator &allocator = allocators_[segment_id];
+    for (int size_class = 0; size_class < NUM_SIZE_CLASSES; size_class++) {
+      auto &slots = released[segment_id][size_class];
+      auto &target = saved ? allocator.free_slots_[size_class] : allocator.pending_free_slots_[size_class];
+      target.insert(target.end(), slots.begin(), slots.end());
+    }
+  }
+}
+
+}  // namespace bustub
@@ -10,33 +10,53 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <iostream>
 #include <string>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "common/exception.h"
 #include "common/logger.h"
+#include "common/macros.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
 
 static char *buffer_used;
 
+/** Segment files grow by extents of this many pages (256 KiB). */
+static constexpr page_id_t SEGMENT_EXTENT_PAGES = 64;
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
+ * @input direct_io: open the database file with O_DIRECT
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), next_page_id_(0), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
+DiskManager::DiskManager(const std::string &db_file, bool direct_io)
+    : db_fd_(-1),
+      file_name_(db_file),
+      direct_io_(direct_io),
+      next_page_id_(0),
+      num_flushes_(0),
+      num_writes_(0),
+      flush_log_(false),
+      flush_log_f_(nullptr) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  segment_dir_name_ = file_name_.substr(0, n) + ".segments";
 
   log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
   // directory or file does not exist
@@ -52,70 +72,248 @@ DiskManager::DiskManager(const std::string &db_file)
     }
   }
 
-  db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-    if (!db_io_.is_open()) {
-      throw Exception("can't open db file");
-    }
+  int flags = O_RDWR | O_CREAT;
+  if (direct_io_) {
+    flags |= O_DIRECT;
+  }
+  db_fd_ = open(db_file.c_str(), flags, 0644);
+  // some file systems (e.g. tmpfs) reject O_DIRECT, fall back to buffered I/O there
+  if (db_fd_ < 0 && direct_io_ && errno == EINVAL) {
+    LOG_WARN("O_DIRECT is not supported for %s, falling back to buffered I/O", db_file.c_str());
+    direct_io_ = false;
+    db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  }
+  if (db_fd_ < 0) {
+    throw Exception("can't open db file");
   }
   buffer_used = nullptr;
+  segments_.resize(MAX_SEGMENTS);
+  LoadSegmentDirectory();
+}
+
+DiskManager::DiskManager()
+    : db_fd_(-1),
+      direct_io_(false),
+      next_page_id_(0),
+      num_flushes_(0),
+      num_writes_(0),
+      flush_log_(false),
+      flush_log_f_(nullptr) {
+  buffer_used = nullptr;
+  segments_.resize(MAX_SEGMENTS);
+}
+
+DiskManager::~DiskManager() {
+  if (db_fd_ >= 0) {
+    close(db_fd_);
+  }
+}
+
+DiskManager::Segment::~Segment() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
 }
 
 /**
  * Close all file streams
  */
 void DiskManager::ShutDown() {
-  db_io_.close();
+  if (db_fd_ >= 0) {
+    close(db_fd_);
+    db_fd_ = -1;
+  }
+  {
+    std::scoped_lock lock{segment_latch_};
+    for (auto &segment : segments_) {
+      if (segment != nullptr && segment->fd_ >= 0) {
+        close(segment->fd_);
+        segment->fd_ = -1;
+      }
+    }
+  }
   log_io_.close();
 }
 
 /**
- * Write the contents of the specified page into disk file
+ * O_DIRECT requires the user buffer to be aligned to the logical block size. Frames of the buffer pool always are,
+ * other callers (e.g. a page buffer on the stack) go through an aligned bounce buffer instead.
+ */
+static bool NeedsBounceBuffer(bool direct_io, const char *page_data) {
+  return direct_io && reinterpret_cast<uintptr_t>(page_data) % PAGE_SIZE != 0;
+}
+
+static std::unique_ptr<char, decltype(&free)> AllocateBounceBuffer() {
+  return {static_cast<char *>(aligned_alloc(PAGE_SIZE, PAGE_SIZE)), &free};
+}
+
+/*
+ * 以下四个函数负责统计：排队深度、延迟、字节数和trace，真正的I/O由子类可以覆盖的*Impl完成
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
-  size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
-  // set write cursor to offset
+  uint64_t queue_depth = ++in_flight_;
+  auto start = std::chrono::steady_clock::now();
+  WritePageImpl(page_id, page_data);
+  auto latency = std::chrono::steady_clock::now() - start;
+  in_flight_--;
   num_writes_ += 1;
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
+  RecordRequest(IOKind::WRITE, page_id, PAGE_SIZE, latency, queue_depth);
+}
+
+void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  uint64_t queue_depth = ++in_flight_;
+  auto start = std::chrono::steady_clock::now();
+  ReadPageImpl(page_id, page_data);
+  auto latency = std::chrono::steady_clock::now() - start;
+  in_flight_--;
+  RecordRequest(IOKind::READ, page_id, PAGE_SIZE, latency, queue_depth);
+}
+
+void DiskManager::WriteLog(char *log_data, int size) {
+  if (size == 0) {
+    // nothing is written, but the implementation still checks the buffer swap
+    WriteLogImpl(log_data, size);
+    return;
+  }
+  uint64_t queue_depth = ++in_flight_;
+  auto start = std::chrono::steady_clock::now();
+  WriteLogImpl(log_data, size);
+  auto latency = std::chrono::steady_clock::now() - start;
+  in_flight_--;
+  RecordRequest(IOKind::LOG_WRITE, INVALID_PAGE_ID, size, latency, queue_depth);
+}
+
+void DiskManager::Sync() {
+  uint64_t queue_depth = ++in_flight_;
+  auto start = std::chrono::steady_clock::now();
+  SyncImpl();
+  auto latency = std::chrono::steady_clock::now() - start;
+  in_flight_--;
+  RecordRequest(IOKind::SYNC, INVALID_PAGE_ID, 0, latency, queue_depth);
+}
+
+void DiskManager::RecordRequest(IOKind kind, page_id_t page_id, uint64_t bytes, std::chrono::nanoseconds latency,
+                                uint64_t queue_depth) {
+  auto k = static_cast<int>(kind);
+  requests_[k].fetch_add(1, std::memory_order_relaxed);
+  bytes_[k].fetch_add(bytes, std::memory_order_relaxed);
+  latencies_[k].Record(latency);
+  queue_depth_sum_.fetch_add(queue_depth, std::memory_order_relaxed);
+  uint64_t max_queue_depth = max_queue_depth_.load(std::memory_order_relaxed);
+  while (queue_depth > max_queue_depth && !max_queue_depth_.compare_exchange_weak(max_queue_depth, queue_depth)) {
+  }
+  if (tracing_.load(std::memory_order_relaxed)) {
+    auto trace = std::atomic_load(&trace_);
+    if (trace != nullptr) {
+      trace->Record(page_id, kind, latency);
+    }
+  }
+}
+
+DiskStats DiskManager::GetStats() const {
+  DiskStats stats;
+  stats.reads_ = requests_[static_cast<int>(IOKind::READ)];
+  stats.writes_ = requests_[static_cast<int>(IOKind::WRITE)];
+  stats.bytes_read_ = bytes_[static_cast<int>(IOKind::READ)];
+  stats.bytes_written_ = bytes_[static_cast<int>(IOKind::WRITE)];
+  stats.log_writes_ = requests_[static_cast<int>(IOKind::LOG_WRITE)];
+  stats.log_bytes_written_ = bytes_[static_cast<int>(IOKind::LOG_WRITE)];
+  stats.fsyncs_ = requests_[static_cast<int>(IOKind::SYNC)];
+  stats.queue_depth_sum_ = queue_depth_sum_;
+  stats.max_queue_depth_ = max_queue_depth_;
+  return stats;
+}
+
+void DiskManager::ResetStats() {
+  for (int k = 0; k < NUM_IO_KINDS; k++) {
+    requests_[k] = 0;
+    bytes_[k] = 0;
+    latencies_[k].Reset();
+  }
+  queue_depth_sum_ = 0;
+  max_queue_depth_ = 0;
+}
+
+void DiskManager::EnableTrace(size_t capacity) {
+  std::atomic_store(&trace_, std::make_shared<IOTrace>(capacity));
+  tracing_ = true;
+}
+
+void DiskManager::DisableTrace() {
+  tracing_ = false;
+  std::atomic_store(&trace_, std::shared_ptr<IOTrace>());
+}
+
+std::vector<IOTraceRecord> DiskManager::GetTrace() const {
+  auto trace = std::atomic_load(&trace_);
+  return trace == nullptr ? std::vector<IOTraceRecord>() : trace->GetRecords();
+}
+
+bool DiskManager::DumpTrace(const std::string &file_name) const {
+  auto trace = std::atomic_load(&trace_);
+  return trace != nullptr && trace->Dump(file_name);
+}
+
+/**
+ * Write the contents of the specified page into disk file
+ */
+void DiskManager::WritePageImpl(page_id_t page_id, const char *page_data) {
+  std::shared_ptr<Segment> segment;
+  int fd = GetPageFd(page_id, &segment);
+  if (fd < 0) {
+    LOG_DEBUG("I/O error while writing, no file for page %d", page_id);
+    return;
+  }
+  off_t offset = static_cast<off_t>(GetPageNumber(page_id)) * PAGE_SIZE;
+  std::unique_ptr<char, decltype(&free)> bounce(nullptr, &free);
+  if (NeedsBounceBuffer(direct_io_, page_data)) {
+    bounce = AllocateBounceBuffer();
+    memcpy(bounce.get(), page_data, PAGE_SIZE);
+    page_data = bounce.get();
+  }
+  // pwrite does not move a shared cursor, so concurrent writers to different pages do not interfere
+  ssize_t write_count = pwrite(fd, page_data, PAGE_SIZE, offset);
   // check for I/O error
-  if (db_io_.bad()) {
+  if (write_count != PAGE_SIZE) {
     LOG_DEBUG("I/O error while writing");
     return;
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
 }
 
 /**
  * Read the contents of the specified page into the given memory area
  */
-void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
-  int offset = page_id * PAGE_SIZE;
+void DiskManager::ReadPageImpl(page_id_t page_id, char *page_data) {
+  std::shared_ptr<Segment> segment;
+  int fd = GetPageFd(page_id, &segment);
+  if (fd < 0) {
+    LOG_DEBUG("I/O error while reading, no file for page %d", page_id);
+    return;
+  }
+  off_t offset = static_cast<off_t>(GetPageNumber(page_id)) * PAGE_SIZE;
+  struct stat stat_buf;
   // check if read beyond file length
-  if (offset > GetFileSize(file_name_)) {
+  if (fstat(fd, &stat_buf) != 0 || offset > stat_buf.st_size) {
     LOG_DEBUG("I/O error reading past end of file");
     // std::cerr << "I/O error while reading" << std::endl;
   } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    if (db_io_.bad()) {
+    char *target = page_data;
+    std::unique_ptr<char, decltype(&free)> bounce(nullptr, &free);
+    if (NeedsBounceBuffer(direct_io_, page_data)) {
+      bounce = AllocateBounceBuffer();
+      target = bounce.get();
+    }
+    ssize_t read_count = pread(fd, target, PAGE_SIZE, offset);
+    if (read_count < 0) {
       LOG_DEBUG("I/O error while reading");
       return;
     }
+    if (target != page_data) {
+      memcpy(page_data, target, read_count);
+    }
     // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
     if (read_count < PAGE_SIZE) {
       LOG_DEBUG("Read less than a page");
-      db_io_.clear();
       // std::cerr << "Read less than a page" << std::endl;
       memset(page_data + read_count, 0, PAGE_SIZE - read_count);
     }
@@ -126,13 +324,59 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
  */
-void DiskManager::WriteLog(char *log_data, int size) {
+void DiskManager::WriteLogImpl(char *log_data, int size) {
+  if (!BeginLogFlush(log_data, size)) {
+    return;
+  }
+  // sequence write
+  log_io_.write(log_data, size);
+
+  // check for I/O error
+  if (log_io_.bad()) {
+    LOG_DEBUG("I/O error while writing log");
+    return;
+  }
+  // needs to flush to keep disk file in sync
+  log_io_.flush();
+  flush_log_ = false;
+}
+
+/**
+ * Flush the db file and every segment file to the device
+ */
+void DiskManager::SyncImpl() {
+  if (db_fd_ >= 0 && fsync(db_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing %s", file_name_.c_str());
+  }
+  // fsync时不持有segment_latch_，不阻塞段的读写；shared_ptr让被drop的段的文件保持打开直到fsync结束
+  std::vector<std::shared_ptr<Segment>> segments;
+  {
+    std::scoped_lock lock{segment_latch_};
+    for (auto &segment : segments_) {
+      if (segment != nullptr) {
+        segments.push_back(segment);
+      }
+    }
+  }
+  for (auto &segment : segments) {
+    if (segment->fd_ >= 0 && fsync(segment->fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing %s", segment->file_name_.c_str());
+    }
+  }
+}
+
+/**
+ * Enforce swapping of the log buffer and wait for a pending non-blocking flush
+ * Sets flush_log_, the caller resets it once the log data is written
+ * @return: false means the log buffer is empty and there is nothing to write
+ */
+bool DiskManager::BeginLogFlush(char *log_data, int size) {
   // enforce swap log buffer
   assert(log_data != buffer_used);
   buffer_used = log_data;
 
   if (size == 0) {  // no effect on num_flushes_ if log buffer is empty
-    return;
+    return false;
   }
 
   flush_log_ = true;
@@ -143,17 +387,7 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
 
   num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
-
-  // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
-  }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
-  flush_log_ = false;
+  return true;
 }
 
 /**
@@ -188,7 +422,195 @@ bool DiskManager::ReadLog(char *log_data, int size, int offset) {
  * Allocate new page (operations like create index/table)
  * For now just keep an increasing counter
  */
-page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
+page_id_t DiskManager::AllocatePage() {
+  page_id_t page_id = next_page_id_++;
+  // a larger id would carry a segment id and alias a page of another segment
+  BUSTUB_ASSERT(page_id < (1 << SEGMENT_PAGE_BITS), "db file is full");
+  return page_id;
+}
+
+/**
+ * Allocate new page in a segment file
+ * 每次跨过已预分配的范围时，用fallocate再预留一个extent，同一对象的page在磁盘上保持连续
+ */
+page_id_t DiskManager::AllocatePage(segment_id_t segment_id) {
+  if (segment_id == DEFAULT_SEGMENT_ID) {
+    return AllocatePage();
+  }
+  std::scoped_lock lock{segment_latch_};
+  Segment *segment = GetSegment(segment_id);
+  if (segment == nullptr || segment->next_page_no_ == (1 << SEGMENT_PAGE_BITS)) {
+    LOG_DEBUG("can't allocate a page in segment %d", segment_id);
+    return INVALID_PAGE_ID;
+  }
+  page_id_t page_no = segment->next_page_no_++;
+  if (preallocate_extents_ && page_no >= segment->preallocated_pages_) {
+    // FALLOC_FL_KEEP_SIZE reserves the blocks without moving the end of file, so the file size still tells how many
+    // pages were written when the segment is reopened
+    if (fallocate(segment->fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(segment->preallocated_pages_) * PAGE_SIZE,
+                  static_cast<off_t>(SEGMENT_EXTENT_PAGES) * PAGE_SIZE) != 0) {
+      LOG_DEBUG("can't preallocate an extent for %s", segment->file_name_.c_str());
+    }
+    segment->preallocated_pages_ += SEGMENT_EXTENT_PAGES;
+  }
+  return MakePageId(segment_id, page_no);
+}
+
+/**
+ * Open or create the tablespace file of a table/index
+ */
+segment_id_t DiskManager::CreateSegment(const std::string &name) {
+  if (name.empty() || name.find_first_of("/ \t\n") != std::string::npos) {
+    throw Exception("invalid segment name: " + name);
+  }
+  std::scoped_lock lock{segment_latch_};
+  segment_id_t free_slot = -1;
+  for (segment_id_t i = DEFAULT_SEGMENT_ID + 1; i < MAX_SEGMENTS; i++) {
+    if (segments_[i] == nullptr) {
+      if (free_slot < 0) {
+        free_slot = i;
+      }
+    } else if (segments_[i]->name_ == name) {
+      return i;
+    }
+  }
+  if (free_slot < 0) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "too many segments");
+  }
+  auto segment = std::make_shared<Segment>();
+  segment->name_ = name;
+  segment->file_name_ = GetSegmentFileName(name);
+  segment->fd_ = OpenSegmentFile(segment->file_name_);
+  segments_[free_slot] = std::move(segment);
+  SaveSegmentDirectory();
+  return free_slot;
+}
+
+/**
+ * Drop a segment by unlinking its file
+ */
+void DiskManager::DropSegment(segment_id_t segment_id) {
+  BUSTUB_ASSERT(segment_id != DEFAULT_SEGMENT_ID, "the db file can't be dropped");
+  std::scoped_lock lock{segment_latch_};
+  Segment *segment = GetSegment(segment_id);
+  if (segment == nullptr) {
+    return;
+  }
+  // the file is closed once the reads and writes that still use it are done
+  unlink(segment->file_name_.c_str());
+  segments_[segment_id].reset();
+  SaveSegmentDirectory();
+}
+
+/**
+ * Truncate a segment file to zero pages, which also releases its preallocated extents
+ */
+void DiskManager::TruncateSegment(segment_id_t segment_id) {
+  BUSTUB_ASSERT(segment_id != DEFAULT_SEGMENT_ID, "the db file can't be truncated");
+  std::scoped_lock lock{segment_latch_};
+  Segment *segment = GetSegment(segment_id);
+  if (segment == nullptr) {
+    return;
+  }
+  if (ftruncate(segment->fd_, 0) != 0) {
+    LOG_DEBUG("I/O error while truncating %s", segment->file_name_.c_str());
+    return;
+  }
+  segment->next_page_no_ = 0;
+  segment->preallocated_pages_ = 0;
+}
+
+int DiskManager::GetPageFd(page_id_t page_id, std::shared_ptr<Segment> *segment) {
+  segment_id_t segment_id = GetSegmentId(page_id);
+  if (segment_id == DEFAULT_SEGMENT_ID) {
+    return db_fd_;
+  }
+  std::scoped_lock lock{segment_latch_};
+  if (GetSegment(segment_id) == nullptr) {
+    return -1;
+  }
+  *segment = segments_[segment_id];
+  return (*segment)->fd_;
+}
+
+DiskManager::Segment *DiskManager::GetSegment(segment_id_t segment_id) {
+  if (segment_id <= DEFAULT_SEGMENT_ID || segment_id >= static_cast<segment_id_t>(segments_.size())) {
+    return nullptr;
+  }
+  return segments_[segment_id].get();
+}
+
+/*
+ * 段文件名为 <db文件名去掉扩展名>.<name><db文件扩展名>，例如 test.db 的 orders 段为 test.orders.db
+ */
+std::string DiskManager::GetSegmentFileName(const std::string &name) const {
+  std::string::size_type n = file_name_.rfind('.');
+  return file_name_.substr(0, n) + "." + name + file_name_.substr(n);
+}
+
+int DiskManager::OpenSegmentFile(const std::string &file_name) {
+  int fd = open(file_name.c_str(), O_RDWR | O_CREAT | (direct_io_ ? O_DIRECT : 0), 0644);
+  // 和db文件一样，文件系统不支持O_DIRECT时退回buffered I/O
+  if (fd < 0 && direct_io_ && errno == EINVAL) {
+    LOG_WARN("O_DIRECT is not supported for %s, falling back to buffered I/O", file_name.c_str());
+    fd = open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+  }
+  if (fd < 0) {
+    throw Exception("can't open segment file " + file_name);
+  }
+  return fd;
+}
+
+/**
+ * The directory has one "<segment id> <name>" line per segment
+ * 已写入的page数由文件大小推出（预分配使用FALLOC_FL_KEEP_SIZE，不改变文件大小）
+ */
+void DiskManager::LoadSegmentDirectory() {
+  std::ifstream dir(segment_dir_name_);
+  segment_id_t segment_id;
+  std::string name;
+  while (dir >> segment_id >> name) {
+    if (segment_id <= DEFAULT_SEGMENT_ID || segment_id >= MAX_SEGMENTS) {
+      LOG_WARN("ignoring segment %d in %s", segment_id, segment_dir_name_.c_str());
+      continue;
+    }
+    auto segment = std::make_shared<Segment>();
+    segment->name_ = name;
+    segment->file_name_ = GetSegmentFileName(name);
+    segment->fd_ = OpenSegmentFile(segment->file_name_);
+    struct stat stat_buf;
+    if (fstat(segment->fd_, &stat_buf) == 0) {
+      segment->next_page_no_ = static_cast<page_id_t>((stat_buf.st_size + PAGE_SIZE - 1) / PAGE_SIZE);
+      segment->preallocated_pages_ = segment->next_page_no_;
+    }
+    segments_[segment_id] = std::move(segment);
+  }
+}
+
+/**
+ * Write the directory to a temporary file first and rename it, so a crash never leaves a torn directory
+ */
+void DiskManager::SaveSegmentDirectory() {
+  if (segment_dir_name_.empty()) {
+    return;
+  }
+  std::string tmp_name = segment_dir_name_ + ".tmp";
+  {
+    std::ofstream dir(tmp_name, std::ios::trunc);
+    for (segment_id_t i = DEFAULT_SEGMENT_ID + 1; i < static_cast<segment_id_t>(segments_.size()); i++) {
+      if (segments_[i] != nullptr) {
+        dir << i << ' ' << segments_[i]->name_ << '\n';
+      }
+    }
+    if (!dir.good()) {
+      LOG_DEBUG("I/O error while writing %s", tmp_name.c_str());
+      return;
+    }
+  }
+  if (rename(tmp_name.c_str(), segment_dir_name_.c_str()) != 0) {
+    LOG_DEBUG("I/O error while replacing %s", segment_dir_name_.c_str());
+  }
+}
 
 /**
  * Deallocate page (operations like drop index/table)
@@ -0,0 +1,119 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_stats.cpp
+//
+// Identification: src/storage/disk/disk_stats.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/disk_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace bustub {
+
+const char *IOKindToString(IOKind kind) {
+  switch (kind) {
+    case IOKind::READ:
+      return "read";
+    case IOKind::WRITE:
+      return "write";
+    case IOKind::LOG_WRITE:
+      return "log_write";
+    case IOKind::SYNC:
+      return "sync";
+  }
+  UNREACHABLE("unknown IOKind");
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+  auto ns = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+  // floor(log2(ns)), 0 and 1 ns both land in bucket 0
+  int bucket = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+  buckets_[std::min(bucket, NUM_BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+  uint64_t count = 0;
+  for (const auto &bucket : buckets_) {
+    count += bucket.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetMean() const {
+  uint64_t count = GetCount();
+  return std::chrono::nanoseconds(count == 0 ? 0 : sum_ns_.load(std::memory_order_relaxed) / count);
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetPercentile(double p) const {
+  uint64_t count = GetCount();
+  if (count == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  auto rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(p * static_cast<double>(count))), 1);
+  uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return std::chrono::nanoseconds((int64_t{1} << (i + 1)) - 1);
+    }
+  }
+  return std::chrono::nanoseconds((int64_t{1} << NUM_BUCKETS) - 1);
+}
+
+void LatencyHistogram::Reset() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  sum_ns_.store(0, std::memory_order_relaxed);
+}
+
+static thread_local const char *current_tag = nullptr;
+
+IOTraceTag::IOTraceTag(const char *tag) : previous_(current_tag) { current_tag = tag; }
+
+IOTraceTag::~IOTraceTag() { current_tag = previous_; }
+
+const char *IOTraceTag::Current() { return current_tag; }
+
+IOTrace::IOTrace(size_t capacity) : start_(std::chrono::steady_clock::now()), records_(std::max<size_t>(capacity, 1)) {}
+
+void IOTrace::Record(page_id_t page_id, IOKind kind, std::chrono::nanoseconds latency) {
+  auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+  IOTraceRecord record{static_cast<uint64_t>(timestamp.count()), page_id, kind,
+                       static_cast<uint64_t>(latency.count()), IOTraceTag::Current()};
+  std::scoped_lock lock{latch_};
+  records_[next_ % records_.size()] = record;
+  next_++;
+}
+
+std::vector<IOTraceRecord> IOTrace::GetRecords() const {
+  std::scoped_lock lock{latch_};
+  std::vector<IOTraceRecord> records;
+  uint64_t first = next_ > records_.size() ? next_ - records_.size() : 0;
+  records.reserve(next_ - first);
+  for (uint64_t i = first; i < next_; i++) {
+    records.push_back(records_[i % records_.size()]);
+  }
+  return records;
+}
+
+bool IOTrace::Dump(const std::string &file_name) const {
+  std::ofstream out(file_name, std::ios::trunc);
+  out << "timestamp_ns,page_id,kind,latency_ns,tag\n";
+  for (const auto &record : GetRecords()) {
+    out << record.timestamp_ns_ << ',' << record.page_id_ << ',' << IOKindToString(record.kind_) << ','
+        << record.latency_ns_ << ',' << (record.tag_ == nullptr ? "" : record.tag_) << '\n';
+  }
+  return out.good();
+}
+
+}  // namespace bustub
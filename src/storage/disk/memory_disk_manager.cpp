@@ -0,0 +1,238 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// memory_disk_manager.cpp
+//
+// Identification: src/storage/disk/memory_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/memory_disk_manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/** Latencies below this threshold are spun, sleep_for cannot wake up that precisely. */
+static constexpr std::chrono::microseconds SPIN_THRESHOLD{100};
+
+DiskLatencyModel::DiskLatencyModel(std::chrono::nanoseconds read_median, std::chrono::nanoseconds write_median,
+                                   double sigma, uint64_t seed)
+    : read_median_(read_median), write_median_(write_median), sigma_(sigma), engine_(seed) {}
+
+DiskLatencyModel DiskLatencyModel::ForDevice(Device device, uint64_t seed) {
+  using std::chrono::microseconds;
+  switch (device) {
+    case Device::HDD:
+      // dominated by seek time and rotational delay, hence the wide spread
+      return DiskLatencyModel(microseconds(4000), microseconds(4500), 0.5, seed);
+    case Device::SATA_SSD:
+      return DiskLatencyModel(microseconds(90), microseconds(40), 0.3, seed);
+    case Device::NVME:
+      return DiskLatencyModel(microseconds(15), microseconds(10), 0.25, seed);
+  }
+  UNREACHABLE("unknown device");
+}
+
+/*
+ * 对数正态分布：latency = median * exp(sigma * N(0, 1))
+ */
+std::chrono::nanoseconds DiskLatencyModel::Next(std::chrono::nanoseconds median) {
+  if (sigma_ == 0) {
+    return median;
+  }
+  std::normal_distribution<double> normal(0, sigma_);
+  double factor;
+  {
+    std::scoped_lock lock{latch_};
+    factor = std::exp(normal(engine_));
+  }
+  return std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(median.count()) * factor));
+}
+
+MemoryDiskManager::MemoryDiskManager(std::unique_ptr<DiskLatencyModel> latency_model)
+    : latency_model_(std::move(latency_model)),
+      arena_(MAX_SEGMENTS),
+      segment_names_(MAX_SEGMENTS),
+      segment_sizes_(MAX_SEGMENTS, 0) {}
+
+void MemoryDiskManager::InjectLatency(std::chrono::nanoseconds latency) {
+  if (latency < SPIN_THRESHOLD) {
+    auto deadline = std::chrono::steady_clock::now() + latency;
+    while (std::chrono::steady_clock::now() < deadline) {
+    }
+    return;
+  }
+  std::this_thread::sleep_for(latency);
+}
+
+char *MemoryDiskManager::GetPageLocation(page_id_t page_id) {
+  auto &chunks = arena_[GetSegmentId(page_id)];
+  auto page_no = static_cast<size_t>(GetPageNumber(page_id));
+  size_t chunk = page_no / PAGES_PER_CHUNK;
+  while (chunks.size() <= chunk) {
+    // make_unique<char[]> value-initializes, so unwritten pages read as zeroes
+    chunks.emplace_back(std::make_unique<char[]>(PAGES_PER_CHUNK * PAGE_SIZE));
+  }
+  return chunks[chunk].get() + (page_no % PAGES_PER_CHUNK) * PAGE_SIZE;
+}
+
+bool MemoryDiskManager::HasSegment(segment_id_t segment_id) const {
+  return segment_id == DEFAULT_SEGMENT_ID ||
+         (segment_id > DEFAULT_SEGMENT_ID && segment_id < MAX_SEGMENTS && !segment_names_[segment_id].empty());
+}
+
+/**
+ * Write the contents of the specified page into the arena
+ */
+void MemoryDiskManager::WritePageImpl(page_id_t page_id, const char *page_data) {
+  {
+    std::scoped_lock lock{latch_};
+    if (page_id < 0 || !HasSegment(GetSegmentId(page_id))) {
+      LOG_DEBUG("I/O error while writing");
+      return;
+    }
+    memcpy(GetPageLocation(page_id), page_data, PAGE_SIZE);
+  }
+  // the latch is released first, so that concurrent requests overlap like they would in a device queue
+  if (latency_model_ != nullptr) {
+    InjectLatency(latency_model_->NextWrite());
+  }
+}
+
+/**
+ * Read the contents of the specified page from the arena
+ */
+void MemoryDiskManager::ReadPageImpl(page_id_t page_id, char *page_data) {
+  {
+    std::scoped_lock lock{latch_};
+    if (page_id < 0 || !HasSegment(GetSegmentId(page_id))) {
+      LOG_DEBUG("I/O error while reading");
+      return;
+    }
+    size_t chunk = static_cast<size_t>(GetPageNumber(page_id)) / PAGES_PER_CHUNK;
+    if (chunk < arena_[GetSegmentId(page_id)].size()) {
+      memcpy(page_data, GetPageLocation(page_id), PAGE_SIZE);
+    } else {
+      memset(page_data, 0, PAGE_SIZE);
+    }
+  }
+  if (latency_model_ != nullptr) {
+    InjectLatency(latency_model_->NextRead());
+  }
+}
+
+/**
+ * Append the contents of the log buffer to the in-memory log
+ */
+void MemoryDiskManager::WriteLogImpl(char *log_data, int size) {
+  if (!BeginLogFlush(log_data, size)) {
+    return;
+  }
+  {
+    std::scoped_lock lock{latch_};
+    log_.insert(log_.end(), log_data, log_data + size);
+  }
+  if (latency_model_ != nullptr) {
+    InjectLatency(latency_model_->NextWrite());
+  }
+  flush_log_ = false;
+}
+
+void MemoryDiskManager::SyncImpl() {
+  if (latency_model_ != nullptr) {
+    InjectLatency(latency_model_->NextWrite());
+  }
+}
+
+/**
+ * Read the contents of the log into the given memory area
+ * @return: false means already reach the end
+ */
+bool MemoryDiskManager::ReadLog(char *log_data, int size, int offset) {
+  std::scoped_lock lock{latch_};
+  if (offset < 0 || static_cast<size_t>(offset) >= log_.size()) {
+    return false;
+  }
+  size_t read_count = std::min(static_cast<size_t>(size), log_.size() - offset);
+  memcpy(log_data, log_.data() + offset, read_count);
+  // if log ends before reading "size"
+  memset(log_data + read_count, 0, size - read_count);
+  return true;
+}
+
+page_id_t MemoryDiskManager::AllocatePage(segment_id_t segment_id) {
+  if (segment_id == DEFAULT_SEGMENT_ID) {
+    return AllocatePage();
+  }
+  std::scoped_lock lock{latch_};
+  if (!HasSegment(segment_id) || segment_sizes_[segment_id] == (1 << SEGMENT_PAGE_BITS)) {
+    LOG_DEBUG("can't allocate a page in segment %d", segment_id);
+    return INVALID_PAGE_ID;
+  }
+  return MakePageId(segment_id, segment_sizes_[segment_id]++);
+}
+
+segment_id_t MemoryDiskManager::CreateSegment(const std::string &name) {
+  if (name.empty()) {
+    throw Exception("invalid segment name: " + name);
+  }
+  std::scoped_lock lock{latch_};
+  segment_id_t free_slot = -1;
+  for (segment_id_t i = DEFAULT_SEGMENT_ID + 1; i < MAX_SEGMENTS; i++) {
+    if (segment_names_[i] == name) {
+      return i;
+    }
+    if (segment_names_[i].empty() && free_slot < 0) {
+      free_slot = i;
+    }
+  }
+  if (free_slot < 0) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "too many segments");
+  }
+  segment_names_[free_slot] = name;
+  return free_slot;
+}
+
+void MemoryDiskManager::DropSegment(segment_id_t segment_id) {
+  BUSTUB_ASSERT(segment_id != DEFAULT_SEGMENT_ID, "the db file can't be dropped");
+  std::scoped_lock lock{latch_};
+  if (!HasSegment(segment_id)) {
+    return;
+  }
+  segment_names_[segment_id].clear();
+  segment_sizes_[segment_id] = 0;
+  arena_[segment_id].clear();
+}
+
+void MemoryDiskManager::TruncateSegment(segment_id_t segment_id) {
+  BUSTUB_ASSERT(segment_id != DEFAULT_SEGMENT_ID, "the db file can't be truncated");
+  std::scoped_lock lock{latch_};
+  if (!HasSegment(segment_id)) {
+    return;
+  }
+  segment_sizes_[segment_id] = 0;
+  arena_[segment_id].clear();
+}
+
+size_t MemoryDiskManager::GetArenaSize() {
+  std::scoped_lock lock{latch_};
+  size_t num_chunks = 0;
+  for (const auto &chunks : arena_) {
+    num_chunks += chunks.size();
+  }
+  return num_chunks * PAGES_PER_CHUNK * PAGE_SIZE;
+}
+
+}  // namespace bustub
@@ -0,0 +1,134 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// adaptive_hash_index.cpp
+//
+// Identification: src/storage/index/adaptive_hash_index.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/adaptive_hash_index.h"
+
+#include <mutex>  // NOLINT
+
+#include "storage/index/generic_key.h"
+
+namespace bustub {
+
+template <typename KeyType>
+bool AdaptiveHashIndex<KeyType>::Lookup(const KeyType &key, page_id_t *page_id, int *slot) {
+  std::shared_lock lock{latch_};
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  *page_id = it->second.page_id_;
+  *slot = it->second.slot_;
+  hits_++;
+  return true;
+}
+
+template <typename KeyType>
+bool AdaptiveHashIndex<KeyType>::Contains(const KeyType &key, page_id_t page_id) const {
+  std::shared_lock lock{latch_};
+  auto it = entries_.find(key);
+  return it != entries_.end() && it->second.page_id_ == page_id;
+}
+
+template <typename KeyType>
+void AdaptiveHashIndex<KeyType>::RecordDescent(const KeyType &key, page_id_t page_id, int slot) {
+  std::scoped_lock lock{latch_};
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    // 已经是热点key，entry过期了(leaf分裂或者重新分配过)，直接指向新的位置
+    if (it->second.page_id_ != page_id) {
+      AddPageKey(page_id, key);
+    }
+    it->second = Entry{page_id, slot};
+    return;
+  }
+  if (descents_.size() >= max_entries_) {
+    // 统计只需要最近的访问，满了之后重新开始计数
+    descents_.clear();
+  }
+  if (++descents_[key] < BUILD_THRESHOLD) {
+    return;
+  }
+  descents_.erase(key);
+  if (entries_.size() >= max_entries_) {
+    // 满了之后替换掉任意一个key
+    entries_.erase(entries_.begin());
+  }
+  entries_.emplace(key, Entry{page_id, slot});
+  AddPageKey(page_id, key);
+}
+
+template <typename KeyType>
+void AdaptiveHashIndex<KeyType>::Erase(const KeyType &key) {
+  // 大多数不存在的key本来就没有entry，不需要写锁
+  {
+    std::shared_lock lock{latch_};
+    if (entries_.find(key) == entries_.end()) {
+      return;
+    }
+  }
+  std::scoped_lock lock{latch_};
+  entries_.erase(key);
+}
+
+template <typename KeyType>
+void AdaptiveHashIndex<KeyType>::DropPage(page_id_t page_id) {
+  std::scoped_lock lock{latch_};
+  auto keys = page_keys_.find(page_id);
+  if (keys == page_keys_.end()) {
+    return;
+  }
+  // key可能已经移到别的leaf，只删除仍然指向这个leaf的entry
+  for (const auto &key : keys->second) {
+    auto it = entries_.find(key);
+    if (it != entries_.end() && it->second.page_id_ == page_id) {
+      entries_.erase(it);
+    }
+  }
+  page_key_count_ -= keys->second.size();
+  page_keys_.erase(keys);
+}
+
+template <typename KeyType>
+void AdaptiveHashIndex<KeyType>::AddPageKey(page_id_t page_id, const KeyType &key) {
+  page_keys_[page_id].push_back(key);
+  page_key_count_++;
+  if (page_key_count_ <= 2 * max_entries_) {
+    return;
+  }
+  // 移动过或者被替换掉的key留在旧leaf的列表中，按当前的entry重建
+  page_keys_.clear();
+  for (const auto &[entry_key, entry] : entries_) {
+    page_keys_[entry.page_id_].push_back(entry_key);
+  }
+  page_key_count_ = entries_.size();
+}
+
+template <typename KeyType>
+size_t AdaptiveHashIndex<KeyType>::GetSize() const {
+  std::shared_lock lock{latch_};
+  return entries_.size();
+}
+
+template <typename KeyType>
+size_t AdaptiveHashIndex<KeyType>::GetHits() const {
+  return hits_;
+}
+
+template class AdaptiveHashIndex<GenericKey<4>>;
+template class AdaptiveHashIndex<GenericKey<8>>;
+template class AdaptiveHashIndex<GenericKey<16>>;
+template class AdaptiveHashIndex<GenericKey<32>>;
+template class AdaptiveHashIndex<GenericKey<64>>;
+template class AdaptiveHashIndex<GenericKey<128>>;
+template class AdaptiveHashIndex<GenericKey<256>>;
+
+}  // namespace bustub
@@ -0,0 +1,881 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// art_index.cpp
+//
+// Identification: src/storage/index/art_index.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/art_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <thread>  // NOLINT
+
+#include "common/exception.h"
+#include "storage/index/key_encoder.h"
+
+namespace bustub {
+
+enum class ARTNodeType : uint8_t { LEAF, NODE4, NODE16, NODE48, NODE256 };
+
+/**
+ * Header of all nodes. The version of an inner node has the obsolete bit at bit 0 and the lock bit at bit 1, the
+ * rest counts the write unlocks. Leaves never change after they are created and do not use their version.
+ */
+struct ARTNode {
+  explicit ARTNode(ARTNodeType type) : type_(type) {}
+  virtual ~ARTNode() = default;
+
+  std::atomic<uint64_t> version_{0};
+  const ARTNodeType type_;
+  uint8_t prefix_len_{0};
+  std::atomic<uint16_t> count_{0};
+  uint8_t prefix_[ARTIndex::MAX_PREFIX]{};
+
+  bool IsLeaf() const { return type_ == ARTNodeType::LEAF; }
+  void SetPrefix(const uint8_t *prefix, size_t length) {
+    memcpy(prefix_, prefix, length);
+    prefix_len_ = static_cast<uint8_t>(length);
+  }
+};
+
+struct ARTLeaf : public ARTNode {
+  ARTLeaf(std::string key, RID rid) : ARTNode(ARTNodeType::LEAF), key_(std::move(key)), rid_(rid) {}
+  const std::string key_;
+  const RID rid_;
+};
+
+/** Node4 and Node16: the key bytes of the children in ascending order. */
+template <int N>
+struct ARTSortedNode : public ARTNode {
+  ARTSortedNode() : ARTNode(N == 4 ? ARTNodeType::NODE4 : ARTNodeType::NODE16) {}
+  uint8_t keys_[N]{};
+  std::atomic<ARTNode *> children_[N]{};
+};
+using ARTNode4 = ARTSortedNode<4>;
+using ARTNode16 = ARTSortedNode<16>;
+
+/** Node48: the slot (+1, 0 for none) of the child of each key byte. */
+struct ARTNode48 : public ARTNode {
+  ARTNode48() : ARTNode(ARTNodeType::NODE48) {}
+  uint8_t child_index_[256]{};
+  std::atomic<ARTNode *> children_[48]{};
+};
+
+struct ARTNode256 : public ARTNode {
+  ARTNode256() : ARTNode(ARTNodeType::NODE256) {}
+  std::atomic<ARTNode *> children_[256]{};
+};
+
+namespace {
+
+constexpr uint64_t OBSOLETE_BIT = 1;
+constexpr uint64_t LOCK_BIT = 2;
+
+/*
+ * 读一个节点之前取得它的version，节点被写锁住时等待；节点已经被替换时返回false
+ */
+bool ReadLock(ARTNode *node, uint64_t *version) {
+  uint64_t v = node->version_.load(std::memory_order_acquire);
+  while ((v & LOCK_BIT) != 0) {
+    std::this_thread::yield();
+    v = node->version_.load(std::memory_order_acquire);
+  }
+  if ((v & OBSOLETE_BIT) != 0) {
+    return false;
+  }
+  *version = v;
+  return true;
+}
+
+/*
+ * 读完节点之后确认version没有变，读到的内容是一致的
+ */
+bool Validate(ARTNode *node, uint64_t version) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return node->version_.load(std::memory_order_relaxed) == version;
+}
+
+/*
+ * 按读到的version加写锁，节点在此之后被修改过时失败
+ */
+bool Upgrade(ARTNode *node, uint64_t version) {
+  return node->version_.compare_exchange_strong(version, version + LOCK_BIT, std::memory_order_acquire);
+}
+
+void WriteUnlock(ARTNode *node) { node->version_.fetch_add(LOCK_BIT, std::memory_order_release); }
+
+void WriteUnlockObsolete(ARTNode *node) {
+  node->version_.fetch_add(LOCK_BIT | OBSOLETE_BIT, std::memory_order_release);
+}
+
+/*
+ * 乐观读时count可能是被并发修改中的值，限制在数组大小以内
+ */
+int ReadCount(const ARTNode *node, int capacity) {
+  return std::min<int>(node->count_.load(std::memory_order_relaxed), capacity);
+}
+
+/*
+ * Node4和Node16的key byte数组，孩子数组和容量
+ */
+uint8_t *SortedKeys(ARTNode *node) {
+  return node->type_ == ARTNodeType::NODE4 ? static_cast<ARTNode4 *>(node)->keys_
+                                           : static_cast<ARTNode16 *>(node)->keys_;
+}
+
+std::atomic<ARTNode *> *SortedChildren(ARTNode *node) {
+  return node->type_ == ARTNodeType::NODE4 ? static_cast<ARTNode4 *>(node)->children_
+                                           : static_cast<ARTNode16 *>(node)->children_;
+}
+
+int SortedCapacity(const ARTNode *node) { return node->type_ == ARTNodeType::NODE4 ? 4 : 16; }
+
+ARTNode *FindChild(ARTNode *node, uint8_t byte) {
+  switch (node->type_) {
+    case ARTNodeType::NODE4:
+    case ARTNodeType::NODE16: {
+      uint8_t *keys = SortedKeys(node);
+      std::atomic<ARTNode *> *children = SortedChildren(node);
+      int count = ReadCount(node, SortedCapacity(node));
+      for (int i = 0; i < count; i++) {
+        if (keys[i] == byte) {
+          return children[i].load(std::memory_order_relaxed);
+        }
+      }
+      return nullptr;
+    }
+    case ARTNodeType::NODE48: {
+      auto node48 = static_cast<ARTNode48 *>(node);
+      int index = node48->child_index_[byte];
+      return index == 0 ? nullptr : node48->children_[index - 1].load(std::memory_order_relaxed);
+    }
+    case ARTNodeType::NODE256:
+      return static_cast<ARTNode256 *>(node)->children_[byte].load(std::memory_order_relaxed);
+    default:
+      return nullptr;
+  }
+}
+
+bool IsFull(const ARTNode *node) {
+  uint16_t count = node->count_.load(std::memory_order_relaxed);
+  switch (node->type_) {
+    case ARTNodeType::NODE4:
+      return count == 4;
+    case ARTNodeType::NODE16:
+      return count == 16;
+    case ARTNodeType::NODE48:
+      return count == 48;
+    default:
+      return false;
+  }
+}
+
+/*
+ * 删掉一个孩子之后节点能不能换成小一号的节点，留出余量避免在边界上反复增长和收缩
+ */
+bool IsUnderfullAfterRemove(const ARTNode *node) {
+  int count = node->count_.load(std::memory_order_relaxed) - 1;
+  switch (node->type_) {
+    case ARTNodeType::NODE16:
+      return count <= 3;
+    case ARTNodeType::NODE48:
+      return count <= 12;
+    case ARTNodeType::NODE256:
+      return count <= 37;
+    default:
+      return false;
+  }
+}
+
+/*
+ * 以下修改节点的函数都要求持有节点的写锁，节点没有满
+ */
+void AddChild(ARTNode *node, uint8_t byte, ARTNode *child) {
+  uint16_t count = node->count_.load(std::memory_order_relaxed);
+  switch (node->type_) {
+    case ARTNodeType::NODE4:
+    case ARTNodeType::NODE16: {
+      uint8_t *keys = SortedKeys(node);
+      std::atomic<ARTNode *> *children = SortedChildren(node);
+      int pos = count;
+      while (pos > 0 && keys[pos - 1] > byte) {
+        keys[pos] = keys[pos - 1];
+        children[pos].store(children[pos - 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        pos--;
+      }
+      keys[pos] = byte;
+      children[pos].store(child, std::memory_order_relaxed);
+      break;
+    }
+    case ARTNodeType::NODE48: {
+      auto node48 = static_cast<ARTNode48 *>(node);
+      int slot = 0;
+      while (node48->children_[slot].load(std::memory_order_relaxed) != nullptr) {
+        slot++;
+      }
+      node48->children_[slot].store(child, std::memory_order_relaxed);
+      node48->child_index_[byte] = static_cast<uint8_t>(slot + 1);
+      break;
+    }
+    case ARTNodeType::NODE256:
+      static_cast<ARTNode256 *>(node)->children_[byte].store(child, std::memory_order_relaxed);
+      break;
+    default:
+      return;
+  }
+  node->count_.store(count + 1, std::memory_order_relaxed);
+}
+
+void ChangeChild(ARTNode *node, uint8_t byte, ARTNode *child) {
+  switch (node->type_) {
+    case ARTNodeType::NODE4:
+    case ARTNodeType::NODE16: {
+      uint8_t *keys = SortedKeys(node);
+      std::atomic<ARTNode *> *children = SortedChildren(node);
+      int count = ReadCount(node, SortedCapacity(node));
+      for (int i = 0; i < count; i++) {
+        if (keys[i] == byte) {
+          children[i].store(child, std::memory_order_relaxed);
+          return;
+        }
+      }
+      return;
+    }
+    case ARTNodeType::NODE48: {
+      auto node48 = static_cast<ARTNode48 *>(node);
+      node48->children_[node48->child_index_[byte] - 1].store(child, std::memory_order_relaxed);
+      return;
+    }
+    case ARTNodeType::NODE256:
+      static_cast<ARTNode256 *>(node)->children_[byte].store(child, std::memory_order_relaxed);
+      return;
+    default:
+      return;
+  }
+}
+
+void RemoveChild(ARTNode *node, uint8_t byte) {
+  uint16_t count = node->count_.load(std::memory_order_relaxed);
+  switch (node->type_) {
+    case ARTNodeType::NODE4:
+    case ARTNodeType::NODE16: {
+      uint8_t *keys = SortedKeys(node);
+      std::atomic<ARTNode *> *children = SortedChildren(node);
+      int pos = 0;
+      while (pos < count && keys[pos] != byte) {
+        pos++;
+      }
+      for (; pos + 1 < count; pos++) {
+        keys[pos] = keys[pos + 1];
+        children[pos].store(children[pos + 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+      break;
+    }
+    case ARTNodeType::NODE48: {
+      auto node48 = static_cast<ARTNode48 *>(node);
+      node48->children_[node48->child_index_[byte] - 1].store(nullptr, std::memory_order_relaxed);
+      node48->child_index_[byte] = 0;
+      break;
+    }
+    case ARTNodeType::NODE256:
+      static_cast<ARTNode256 *>(node)->children_[byte].store(nullptr, std::memory_order_relaxed);
+      break;
+    default:
+      return;
+  }
+  node->count_.store(count - 1, std::memory_order_relaxed);
+}
+
+/*
+ * 按key byte的顺序取出所有孩子
+ */
+void GetChildren(ARTNode *node, std::vector<std::pair<uint8_t, ARTNode *>> *children) {
+  switch (node->type_) {
+    case ARTNodeType::NODE4:
+    case ARTNodeType::NODE16: {
+      uint8_t *keys = SortedKeys(node);
+      std::atomic<ARTNode *> *node_children = SortedChildren(node);
+      int count = ReadCount(node, SortedCapacity(node));
+      for (int i = 0; i < count; i++) {
+        children->emplace_back(keys[i], node_children[i].load(std::memory_order_relaxed));
+      }
+      return;
+    }
+    case ARTNodeType::NODE48: {
+      auto node48 = static_cast<ARTNode48 *>(node);
+      for (int byte = 0; byte < 256; byte++) {
+        int index = node48->child_index_[byte];
+        if (index != 0) {
+          children->emplace_back(byte, node48->children_[index - 1].load(std::memory_order_relaxed));
+        }
+      }
+      return;
+    }
+    case ARTNodeType::NODE256: {
+      auto node256 = static_cast<ARTNode256 *>(node);
+      for (int byte = 0; byte < 256; byte++) {
+        ARTNode *child = node256->children_[byte].load(std::memory_order_relaxed);
+        if (child != nullptr) {
+          children->emplace_back(byte, child);
+        }
+      }
+      return;
+    }
+    default:
+      return;
+  }
+}
+
+/*
+ * 把节点的孩子和前缀复制到另一种大小的新节点，用于增长和收缩
+ */
+ARTNode *Resize(ARTNode *node, ARTNodeType type) {
+  ARTNode *resized;
+  switch (type) {
+    case ARTNodeType::NODE4:
+      resized = new ARTNode4();
+      break;
+    case ARTNodeType::NODE16:
+      resized = new ARTNode16();
+      break;
+    case ARTNodeType::NODE48:
+      resized = new ARTNode48();
+      break;
+    default:
+      resized = new ARTNode256();
+      break;
+  }
+  resized->SetPrefix(node->prefix_, node->prefix_len_);
+  std::vector<std::pair<uint8_t, ARTNode *>> children;
+  GetChildren(node, &children);
+  for (const auto &[byte, child] : children) {
+    AddChild(resized, byte, child);
+  }
+  return resized;
+}
+
+ARTNode *Grow(ARTNode *node) {
+  switch (node->type_) {
+    case ARTNodeType::NODE4:
+      return Resize(node, ARTNodeType::NODE16);
+    case ARTNodeType::NODE16:
+      return Resize(node, ARTNodeType::NODE48);
+    default:
+      return Resize(node, ARTNodeType::NODE256);
+  }
+}
+
+ARTNode *Shrink(ARTNode *node) {
+  switch (node->type_) {
+    case ARTNodeType::NODE256:
+      return Resize(node, ARTNodeType::NODE48);
+    case ARTNodeType::NODE48:
+      return Resize(node, ARTNodeType::NODE16);
+    default:
+      return Resize(node, ARTNodeType::NODE4);
+  }
+}
+
+/*
+ * key从depth开始和节点前缀相同的字节数
+ */
+size_t MatchPrefix(const ARTNode *node, const std::string &key, size_t depth) {
+  size_t length = std::min<size_t>(node->prefix_len_, ARTIndex::MAX_PREFIX);
+  size_t matched = 0;
+  while (matched < length && depth + matched < key.size() &&
+         static_cast<uint8_t>(key[depth + matched]) == node->prefix_[matched]) {
+    matched++;
+  }
+  return matched;
+}
+
+uint8_t ByteAt(const std::string &key, size_t pos) { return static_cast<uint8_t>(key[pos]); }
+
+/*
+ * 两个leaf的key在depth之前相同，建一个在它们第一个不同的字节处分叉的Node4。
+ * 公共前缀超过MAX_PREFIX时，上面用只有一个孩子的Node4连成一条链，每个节点存MAX_PREFIX字节加上孩子的一个字节
+ */
+ARTNode *MakeBranch(ARTLeaf *a, ARTLeaf *b, size_t depth) {
+  const std::string &key = a->key_;
+  size_t diff = depth;
+  while (diff < key.size() && diff < b->key_.size() && key[diff] == b->key_[diff]) {
+    diff++;
+  }
+  BUSTUB_ASSERT(diff < key.size() && diff < b->key_.size(), "An encoded key cannot be a prefix of another one");
+  size_t start = diff - std::min(diff - depth, ARTIndex::MAX_PREFIX);
+  auto bottom = new ARTNode4();
+  bottom->SetPrefix(reinterpret_cast<const uint8_t *>(key.data()) + start, diff - start);
+  AddChild(bottom, ByteAt(key, diff), a);
+  AddChild(bottom, ByteAt(b->key_, diff), b);
+  ARTNode *top = bottom;
+  while (start > depth) {
+    size_t byte_pos = start - 1;
+    size_t chain_start = byte_pos - std::min(byte_pos - depth, ARTIndex::MAX_PREFIX);
+    auto chain = new ARTNode4();
+    chain->SetPrefix(reinterpret_cast<const uint8_t *>(key.data()) + chain_start, byte_pos - chain_start);
+    AddChild(chain, ByteAt(key, byte_pos), top);
+    top = chain;
+    start = chain_start;
+  }
+  return top;
+}
+
+void FreeSubtree(ARTNode *node) {
+  if (!node->IsLeaf()) {
+    std::vector<std::pair<uint8_t, ARTNode *>> children;
+    GetChildren(node, &children);
+    for (const auto &child : children) {
+      FreeSubtree(child.second);
+    }
+  }
+  delete node;
+}
+
+}  // namespace
+
+ARTIndex::ARTIndex(IndexMetadata *metadata) : Index(metadata), root_(new ARTNode256()) {}
+
+ARTIndex::~ARTIndex() {
+  FreeSubtree(root_);
+  for (const auto &retired : retired_) {
+    delete retired.first;
+  }
+}
+
+/*****************************************************************************
+ * EPOCH
+ *****************************************************************************/
+/*
+ * 操作开始时在一个空闲的slot里登记当前的epoch，slot按线程id选择，被占用时往后找。
+ * 超过NUM_EPOCH_SLOTS个线程同时操作时，多出来的线程每找完一圈就让出CPU，等别的操作结束释放slot
+ */
+ARTIndex::EpochGuard::EpochGuard(ARTIndex *index) : index_(index) {
+  slot_ = std::hash<std::thread::id>()(std::this_thread::get_id()) % NUM_EPOCH_SLOTS;
+  const size_t first_slot = slot_;
+  while (true) {
+    uint64_t free = 0;
+    if (index_->epoch_slots_[slot_].epoch_.compare_exchange_strong(free, index_->global_epoch_.load())) {
+      return;
+    }
+    slot_ = (slot_ + 1) % NUM_EPOCH_SLOTS;
+    if (slot_ == first_slot) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+ARTIndex::EpochGuard::~EpochGuard() { index_->epoch_slots_[slot_].epoch_.store(0); }
+
+/*
+ * 节点在从树上摘下来之后retire。攒够一批时推进epoch，释放比所有进行中的操作的epoch都早retire的节点：
+ * 那些操作都是在节点被摘下之后才开始的，不可能再拿到它的指针
+ */
+void ARTIndex::Retire(ARTNode *node) {
+  std::scoped_lock lock{retired_latch_};
+  retired_.emplace_back(node, global_epoch_.load());
+  if (retired_.size() < RECLAIM_BATCH) {
+    return;
+  }
+  global_epoch_++;
+  uint64_t min_epoch = std::numeric_limits<uint64_t>::max();
+  for (const auto &slot : epoch_slots_) {
+    uint64_t epoch = slot.epoch_.load();
+    if (epoch != 0) {
+      min_epoch = std::min(min_epoch, epoch);
+    }
+  }
+  auto reclaimable = std::partition(retired_.begin(), retired_.end(),
+                                    [min_epoch](const auto &retired) { return retired.second >= min_epoch; });
+  for (auto it = reclaimable; it != retired_.end(); ++it) {
+    delete it->first;
+  }
+  retired_.erase(reclaimable, retired_.end());
+}
+
+/*****************************************************************************
+ * KEYS
+ *****************************************************************************/
+std::string ARTIndex::EncodeKey(const Tuple &key) const {
+  std::string bytes(64, '\0');
+  size_t length;
+  while (!KeyEncoder::Encode(key, GetKeySchema(), bytes.data(), bytes.size(), &length)) {
+    bytes.assign(2 * bytes.size(), '\0');
+  }
+  bytes.resize(length);
+  return bytes;
+}
+
+/*
+ * 非唯一索引的key后面接上大端序的rid，同一个key tuple的entry在同一个子树中
+ */
+std::string ARTIndex::EncodeKey(const Tuple &key, const RID &rid) const {
+  std::string bytes = EncodeKey(key);
+  if (!GetMetadata()->IsUnique()) {
+    auto page_id = static_cast<uint32_t>(rid.GetPageId());
+    uint32_t slot_num = rid.GetSlotNum();
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      bytes.push_back(static_cast<char>(page_id >> shift));
+    }
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      bytes.push_back(static_cast<char>(slot_num >> shift));
+    }
+  }
+  return bytes;
+}
+
+/*****************************************************************************
+ * INDEX
+ *****************************************************************************/
+void ARTIndex::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
+  std::string index_key = EncodeKey(key, rid);
+  EpochGuard guard(this);
+  bool inserted;
+  while (!TryInsert(index_key, rid, &inserted)) {
+  }
+  if (inserted) {
+    size_++;
+  }
+}
+
+void ARTIndex::DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) {
+  std::string index_key = EncodeKey(key, rid);
+  EpochGuard guard(this);
+  bool removed;
+  while (!TryRemove(index_key, &removed)) {
+  }
+  if (removed) {
+    size_--;
+  }
+}
+
+void ARTIndex::ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) {
+  std::string index_key = EncodeKey(key);
+  EpochGuard guard(this);
+  if (GetMetadata()->IsUnique()) {
+    RID rid;
+    bool found;
+    while (!TryLookup(index_key, &rid, &found)) {
+    }
+    if (found) {
+      result->push_back(rid);
+    }
+    return;
+  }
+  // 非唯一索引收集key tuple下面的整个子树，重来时丢掉已经收集的rid
+  size_t size = result->size();
+  while (!TryScanPrefix(index_key, result)) {
+    result->resize(size);
+  }
+}
+
+/*****************************************************************************
+ * TREE
+ *****************************************************************************/
+bool ARTIndex::TryLookup(const std::string &key, RID *rid, bool *found) {
+  *found = false;
+  ARTNode *node = root_;
+  uint64_t version;
+  if (!ReadLock(node, &version)) {
+    return false;
+  }
+  size_t depth = 0;
+  while (true) {
+    if (MatchPrefix(node, key, depth) < node->prefix_len_) {
+      return Validate(node, version);
+    }
+    depth += node->prefix_len_;
+    if (depth >= key.size()) {
+      return Validate(node, version);
+    }
+    ARTNode *child = FindChild(node, ByteAt(key, depth));
+    if (!Validate(node, version)) {
+      return false;
+    }
+    if (child == nullptr) {
+      return true;
+    }
+    if (child->IsLeaf()) {
+      // leaf创建后不再修改，被摘下后也要等到epoch结束才释放
+      auto leaf = static_cast<ARTLeaf *>(child);
+      if (leaf->key_ == key) {
+        *rid = leaf->rid_;
+        *found = true;
+      }
+      return true;
+    }
+    uint64_t child_version;
+    if (!ReadLock(child, &child_version) || !Validate(node, version)) {
+      return false;
+    }
+    node = child;
+    version = child_version;
+    depth++;
+  }
+}
+
+/*
+ * 乐观地下降到key所在的位置，只锁要修改的节点：
+ * 1 key在节点前缀中分叉：在父节点和节点之间插入一个新的Node4，锁父节点和节点
+ * 2 没有对应的孩子：节点未满时直接加入leaf，只锁节点；满了时换成大一号的节点，锁父节点和节点
+ * 3 孩子是另一个key的leaf：在两个key分叉的地方建新的Node4替换这个leaf，只锁节点
+ * 加锁时version变了说明读到的节点已经被修改，从root重来
+ */
+bool ARTIndex::TryInsert(const std::string &key, RID rid, bool *inserted) {
+  *inserted = false;
+  ARTNode *parent = nullptr;
+  uint64_t parent_version = 0;
+  uint8_t parent_byte = 0;
+  ARTNode *node = root_;
+  uint64_t version;
+  if (!ReadLock(node, &version)) {
+    return false;
+  }
+  size_t depth = 0;
+  while (true) {
+    size_t matched = MatchPrefix(node, key, depth);
+    if (matched < node->prefix_len_) {
+      // root没有前缀，这里一定有父节点
+      if (!Upgrade(parent, parent_version)) {
+        return false;
+      }
+      if (!Upgrade(node, version)) {
+        WriteUnlock(parent);
+        return false;
+      }
+      BUSTUB_ASSERT(depth + matched < key.size(), "An encoded key cannot be a prefix of another one");
+      auto branch = new ARTNode4();
+      branch->SetPrefix(node->prefix_, matched);
+      AddChild(branch, node->prefix_[matched], node);
+      AddChild(branch, ByteAt(key, depth + matched), new ARTLeaf(key, rid));
+      // 节点的前缀去掉分叉节点的前缀和分叉的字节
+      uint8_t remaining = node->prefix_len_ - static_cast<uint8_t>(matched + 1);
+      memmove(node->prefix_, node->prefix_ + matched + 1, remaining);
+      node->prefix_len_ = remaining;
+      ChangeChild(parent, parent_byte, branch);
+      WriteUnlock(node);
+      WriteUnlock(parent);
+      *inserted = true;
+      return true;
+    }
+    depth += node->prefix_len_;
+    if (depth >= key.size()) {
+      return Validate(node, version);
+    }
+    uint8_t byte = ByteAt(key, depth);
+    ARTNode *child = FindChild(node, byte);
+    if (!Validate(node, version)) {
+      return false;
+    }
+    if (child == nullptr) {
+      if (IsFull(node)) {
+        if (!Upgrade(parent, parent_version)) {
+          return false;
+        }
+        if (!Upgrade(node, version)) {
+          WriteUnlock(parent);
+          return false;
+        }
+        ARTNode *grown = Grow(node);
+        AddChild(grown, byte, new ARTLeaf(key, rid));
+        ChangeChild(parent, parent_byte, grown);
+        WriteUnlockObsolete(node);
+        WriteUnlock(parent);
+        Retire(node);
+      } else {
+        if (!Upgrade(node, version)) {
+          return false;
+        }
+        AddChild(node, byte, new ARTLeaf(key, rid));
+        WriteUnlock(node);
+      }
+      *inserted = true;
+      return true;
+    }
+    if (child->IsLeaf()) {
+      auto leaf = static_cast<ARTLeaf *>(child);
+      if (leaf->key_ == key) {
+        // key已经存在
+        return true;
+      }
+      if (!Upgrade(node, version)) {
+        return false;
+      }
+      ChangeChild(node, byte, MakeBranch(leaf, new ARTLeaf(key, rid), depth + 1));
+      WriteUnlock(node);
+      *inserted = true;
+      return true;
+    }
+    uint64_t child_version;
+    if (!ReadLock(child, &child_version) || !Validate(node, version)) {
+      return false;
+    }
+    parent = node;
+    parent_version = version;
+    parent_byte = byte;
+    node = child;
+    version = child_version;
+    depth++;
+  }
+}
+
+/*
+ * 乐观地下降到key的leaf并记下路径上每个节点的version。删掉leaf之后变空的节点一起摘下：
+ * 从下往上找到第一个还有其他孩子的节点(或root)，从它开始往下按记下的version加写锁，它删掉路径上的孩子，下面的节点标记为obsolete。
+ * 它删掉孩子之后过空时换成小一号的节点，这时它的父节点也要锁住
+ */
+bool ARTIndex::TryRemove(const std::string &key, bool *removed) {
+  *removed = false;
+  struct PathEntry {
+    ARTNode *node_;
+    uint64_t version_;
+    uint8_t byte_;
+  };
+  std::vector<PathEntry> path;
+  ARTNode *node = root_;
+  uint64_t version;
+  if (!ReadLock(node, &version)) {
+    return false;
+  }
+  size_t depth = 0;
+  ARTNode *leaf = nullptr;
+  while (true) {
+    if (MatchPrefix(node, key, depth) < node->prefix_len_) {
+      return Validate(node, version);
+    }
+    depth += node->prefix_len_;
+    if (depth >= key.size()) {
+      return Validate(node, version);
+    }
+    uint8_t byte = ByteAt(key, depth);
+    ARTNode *child = FindChild(node, byte);
+    if (!Validate(node, version)) {
+      return false;
+    }
+    if (child == nullptr) {
+      return true;
+    }
+    path.push_back({node, version, byte});
+    if (child->IsLeaf()) {
+      if (static_cast<ARTLeaf *>(child)->key_ != key) {
+        return true;
+      }
+      leaf = child;
+      break;
+    }
+    uint64_t child_version;
+    if (!ReadLock(child, &child_version) || !Validate(node, version)) {
+      return false;
+    }
+    node = child;
+    version = child_version;
+    depth++;
+  }
+  // count是在version验证之前读到的，加锁成功说明它没有变
+  size_t top = path.size() - 1;
+  while (top > 0 && path[top].node_->count_.load(std::memory_order_relaxed) == 1) {
+    top--;
+  }
+  ARTNode *target = path[top].node_;
+  bool shrink = top > 0 && IsUnderfullAfterRemove(target);
+  size_t first = shrink ? top - 1 : top;
+  for (size_t i = first; i < path.size(); i++) {
+    if (!Upgrade(path[i].node_, path[i].version_)) {
+      for (size_t j = first; j < i; j++) {
+        WriteUnlock(path[j].node_);
+      }
+      return false;
+    }
+  }
+  RemoveChild(target, path[top].byte_);
+  for (size_t i = top + 1; i < path.size(); i++) {
+    WriteUnlockObsolete(path[i].node_);
+  }
+  if (shrink) {
+    ChangeChild(path[first].node_, path[first].byte_, Shrink(target));
+    WriteUnlockObsolete(target);
+    WriteUnlock(path[first].node_);
+  } else {
+    WriteUnlock(target);
+  }
+  for (size_t i = top + 1; i < path.size(); i++) {
+    Retire(path[i].node_);
+  }
+  if (shrink) {
+    Retire(target);
+  }
+  Retire(leaf);
+  *removed = true;
+  return true;
+}
+
+/*
+ * 下降到prefix结束的位置，收集下面的所有leaf；prefix可以在节点的前缀中间结束
+ */
+bool ARTIndex::TryScanPrefix(const std::string &prefix, std::vector<RID> *result) {
+  ARTNode *node = root_;
+  uint64_t version;
+  if (!ReadLock(node, &version)) {
+    return false;
+  }
+  size_t depth = 0;
+  while (true) {
+    size_t matched = MatchPrefix(node, prefix, depth);
+    if (depth + matched >= prefix.size()) {
+      return CollectLeaves(node, version, result);
+    }
+    if (matched < node->prefix_len_) {
+      return Validate(node, version);
+    }
+    depth += node->prefix_len_;
+    ARTNode *child = FindChild(node, ByteAt(prefix, depth));
+    if (!Validate(node, version)) {
+      return false;
+    }
+    if (child == nullptr) {
+      return true;
+    }
+    if (child->IsLeaf()) {
+      auto leaf = static_cast<ARTLeaf *>(child);
+      if (leaf->key_.compare(0, prefix.size(), prefix) == 0) {
+        result->push_back(leaf->rid_);
+      }
+      return true;
+    }
+    uint64_t child_version;
+    if (!ReadLock(child, &child_version) || !Validate(node, version)) {
+      return false;
+    }
+    node = child;
+    version = child_version;
+    depth++;
+  }
+}
+
+bool ARTIndex::CollectLeaves(ARTNode *node, uint64_t version, std::vector<RID> *result) {
+  std::vector<std::pair<uint8_t, ARTNode *>> children;
+  GetChildren(node, &children);
+  if (!Validate(node, version)) {
+    return false;
+  }
+  for (const auto &[byte, child] : children) {
+    if (child->IsLeaf()) {
+      result->push_back(static_cast<ARTLeaf *>(child)->rid_);
+      continue;
+    }
+    uint64_t child_version;
+    if (!ReadLock(child, &child_version) || !CollectLeaves(child, child_version, result)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace bustub
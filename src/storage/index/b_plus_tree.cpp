@@ -9,7 +9,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <string>
+#include <thread>  // NOLINT
 
 #include "common/exception.h"
 #include "common/rid.h"
@@ -20,19 +24,88 @@ namespace bustub {
 
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                          int leaf_max_size, int internal_max_size)
+                          int leaf_max_size, int internal_max_size, segment_id_t segment_id, bool b_link,
+                          bool counted, bool adaptive_hash, size_t filter_keys)
     : index_name_(std::move(name)),
       root_page_id_(INVALID_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
       leaf_max_size_(leaf_max_size),
-      internal_max_size_(internal_max_size) {}
+      internal_max_size_(internal_max_size),
+      segment_id_(segment_id),
+      b_link_(b_link),
+      compress_keys_(KeyTraits<KeyType, KeyComparator>::IsCompressible(comparator)),
+      posting_lists_(KeyTraits<KeyType, KeyComparator>::HasPostingLists(comparator)),
+      fence_size_(KeyTraits<KeyType, KeyComparator>::GetFenceSize(comparator)),
+      counted_(counted),
+      adaptive_hash_index_(adaptive_hash ? std::make_unique<AdaptiveHashIndex<KeyType>>() : nullptr),
+      bloom_filter_(filter_keys > 0 ? std::make_unique<BloomFilter<KeyType>>(filter_keys) : nullptr) {
+  if (b_link_ && counted_) {
+    throw Exception(ExceptionType::NOT_IMPLEMENTED, "BPlusTree: a B-link tree cannot keep subtree counts");
+  }
+}
 
 /*
  * Helper function to decide whether current b+tree is empty
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::IsEmpty() const { return root_page_id_ == INVALID_PAGE_ID; }
+/*
+ * 只下降到leaf的上一层，从那里的孩子page id判断leaf是否在buffer pool中。height_只是提示：
+ * 下降时树长高了，最后判断的是一个internal page；变矮了，会先遇到leaf，它已经被fetch进来了
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsLeafResident(const KeyType &key) {
+  root_latch_.lock();
+  if (IsEmpty()) {
+    root_latch_.unlock();
+    return true;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    root_latch_.unlock();
+    return false;
+  }
+  int level = height_ - 1;
+  page->RLatch();
+  root_latch_.unlock();
+  bool resident = true;
+  while (true) {
+    auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    if (node->IsLeafPage()) {
+      break;
+    }
+    page_id_t child_page_id = reinterpret_cast<InternalPage *>(node)->Lookup(key, comparator_);
+    if (level <= 1) {
+      resident = buffer_pool_manager_->IsResident(child_page_id);
+      break;
+    }
+    // 和CollectSeparators一样，B-link mode先释放父节点
+    if (b_link_) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    }
+    Page *child_page = buffer_pool_manager_->FetchPage(child_page_id);
+    if (child_page == nullptr) {
+      if (!b_link_) {
+        page->RUnlatch();
+        buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+      }
+      return false;
+    }
+    child_page->RLatch();
+    if (!b_link_) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    }
+    page = child_page;
+    level--;
+  }
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  return resident;
+}
+
 /*****************************************************************************
  * SEARCH 最终要实现的目标函数之一
  *****************************************************************************/
@@ -46,24 +119,85 @@ bool BPLUSTREE_TYPE::IsEmpty() const { return root_page_id_ == INVALID_PAGE_ID;
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction) {
-  // 1 先找到leaf page，这里面会调用fetch page
-  auto leaf_page = reinterpret_cast<LeafPage *>(FindLeafPageByOperation(key, Operation::FIND, transaction).first);
-  // 为空说明fetch失败
-  if (leaf_page == nullptr) {
+  // 0 Bloom filter确定key不存在时不用下降
+  if (bloom_filter_ != nullptr && !bloom_filter_->MayContain(key)) {
+    return false;
+  }
+  // 热点key直接从adaptive hash index找到leaf
+  if (adaptive_hash_index_ != nullptr && GetValueAdaptive(key, result)) {
+    return true;
+  }
+  // 1 先找到leaf page，这里面会调用fetch page，返回的leaf page持有读锁
+  Page *page = FindLeafPageByOperation(key, Operation::FIND, transaction).first;
+  // 为空说明树为空
+  if (page == nullptr) {
     return false;
   }
+  auto leaf_page = reinterpret_cast<LeafPage *>(page->GetData());
   // 2 在leaf page里找这个key
   ValueType temp;
-  bool ans = leaf_page->Lookup(key, &temp, comparator_);
-  // 3 page用完后记得unpin page
-  buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+  bool ans;
+  if (adaptive_hash_index_ == nullptr) {
+    ans = leaf_page->Lookup(key, &temp, comparator_);
+  } else {
+    // 持有leaf的读锁时记录下降，leaf在删除之前会先删掉它的entry
+    int index = leaf_page->KeyIndex(key, comparator_);
+    ans = index < leaf_page->GetSize() && comparator_(leaf_page->KeyAt(index), key) == 0;
+    if (ans) {
+      temp = leaf_page->GetItem(index).second;
+      adaptive_hash_index_->RecordDescent(key, page->GetPageId(), index);
+    } else {
+      adaptive_hash_index_->Erase(key);
+    }
+  }
+  // 3 page用完后记得解锁并unpin page
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
   // 将得到的value添加到result中
   if (ans) {
     result->push_back(temp);
+  } else if (bloom_filter_ != nullptr) {
+    bloom_filter_->RecordFalsePositive();
   }
   return ans;
 }
 
+/*
+ * 按adaptive hash index的entry找到leaf，先看entry记录的slot，不是key时在leaf中查找
+ * entry在拿到leaf的读锁之前可能被删除了(leaf被合并)，此时page可能已经被删除，所以拿到读锁之后先确认entry仍然指向它
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::GetValueAdaptive(const KeyType &key, std::vector<ValueType> *result) {
+  page_id_t page_id;
+  int slot;
+  if (!adaptive_hash_index_->Lookup(key, &page_id, &slot)) {
+    return false;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    return false;
+  }
+  page->RLatch();
+  bool found = false;
+  if (adaptive_hash_index_->Contains(key, page_id)) {
+    auto leaf = reinterpret_cast<LeafPage *>(page->GetData());
+    int index = slot;
+    if (index >= leaf->GetSize() || comparator_(leaf->KeyAt(index), key) != 0) {
+      index = leaf->KeyIndex(key, comparator_);
+    }
+    if (index < leaf->GetSize() && comparator_(leaf->KeyAt(index), key) == 0) {
+      result->push_back(leaf->GetItem(index).second);
+      found = true;
+      if (index != slot) {
+        adaptive_hash_index_->RecordDescent(key, page_id, index);
+      }
+    }
+  }
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, false);
+  return found;
+}
+
 /*****************************************************************************
  * INSERTION 最终要实现的目标函数之一
  *****************************************************************************/
@@ -79,9 +213,24 @@ INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transaction *transaction) {
   // 将{key, value} 插入树中
   // 如果已经key已经存在， 那么返回false, 否则返回true
-  if (IsEmpty()) {
-    StartNewTree(key, value);
-    return true;
+  // key在进入leaf之前先加入Bloom filter，之后的GetValue不会被filter挡住；key已存在时重复加入没有影响
+  if (bloom_filter_ != nullptr) {
+    bloom_filter_->Insert(key);
+  }
+  {
+    std::scoped_lock lock{root_latch_};
+    if (IsEmpty()) {
+      StartNewTree(key, value);
+      return true;
+    }
+  }
+  if (b_link_) {
+    return InsertBLink(key, value);
+  }
+  // 写操作需要用事务的page set记录加了写锁的祖先节点，调用者没有提供事务时使用临时事务
+  if (transaction == nullptr) {
+    Transaction local_transaction(INVALID_TXN_ID);
+    return InsertIntoLeaf(key, value, &local_transaction);
   }
   return InsertIntoLeaf(key, value, transaction);
 }
@@ -94,21 +243,21 @@ bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
-  LOG_INFO("StartNewTree() begin, new tree is set");
-  // 创建一棵新树，将{key, value}插入
+  // 创建一棵新树，将{key, value}插入，调用者持有root_latch_
   // 1.向buffer pool申请一个page用做root page
   page_id_t root_page_id;
-  auto new_page = buffer_pool_manager_->NewPage(&root_page_id);
+  auto new_page = buffer_pool_manager_->NewPage(&root_page_id, segment_id_);
   if (new_page == nullptr) {
-    std::runtime_error("out of memory");
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "StartNewTree: out of memory");
   }
   // 2.更新root_page_id_
   root_page_id_ = root_page_id;
+  height_ = 1;
   //参数1代表在root page中插入pair而不是更新pair
   UpdateRootPageId(1);
   // 3.插入新pair
-  auto leaf_page = reinterpret_cast<LeafPage *>(new_page);
-  leaf_page->Init(root_page_id, INVALID_PAGE_ID, leaf_max_size_);
+  auto leaf_page = reinterpret_cast<LeafPage *>(new_page->GetData());
+  leaf_page->Init(root_page_id, INVALID_PAGE_ID, leaf_max_size_, compress_keys_, posting_lists_, fence_size_);
   leaf_page->Insert(key, value, comparator_);
   buffer_pool_manager_->UnpinPage(root_page_id, true);
 }
@@ -123,10 +272,35 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction) {
-  LOG_INFO("InsertIntoLeaf()  begin");
   // 专用于向叶子节点中插入的函数
-  // 1.根据key找到待插入的叶子节点
-  auto [leaf_page, root_is_latched] = FindLeafPageByOperation(key, Operation::FIND, transaction);
+  // 1.乐观插入：读锁下降，只对leaf加写锁，绝大多数插入不会引起分裂，只需要这一步
+  // counted的树每次插入都要修改路径上的计数，直接悲观下降
+  if (!counted_) {
+    Page *optimistic_page = FindLeafPageOptimistic(key);
+    if (optimistic_page == nullptr) {
+      // 树在这期间被其他线程删空了，重新开始
+      return Insert(key, value, transaction);
+    }
+    LeafPage *optimistic_leaf = reinterpret_cast<LeafPage *>(optimistic_page->GetData());
+    ValueType existing_value;
+    bool is_duplicate = optimistic_leaf->Lookup(key, &existing_value, comparator_);
+    if (is_duplicate || IsSafe(optimistic_leaf, Operation::INSERT)) {
+      if (!is_duplicate) {
+        optimistic_leaf->Insert(key, value, comparator_);
+      }
+      optimistic_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(optimistic_page->GetPageId(), !is_duplicate);
+      return !is_duplicate;
+    }
+    optimistic_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(optimistic_page->GetPageId(), false);
+  }
+
+  // 2.leaf可能分裂，悲观地重新下降：对路径加写锁，不安全的祖先节点持有写锁并记录在page set中
+  auto [leaf_page, root_is_latched] = FindLeafPageByOperation(key, Operation::INSERT, transaction);
+  if (leaf_page == nullptr) {
+    return Insert(key, value, transaction);
+  }
   LeafPage *leaf_node = reinterpret_cast<LeafPage *>(leaf_page->GetData());
   int size = leaf_node->GetSize();
 
@@ -134,38 +308,124 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
   int new_size = leaf_node->Insert(key, value, comparator_);
   // 2.1有重复的key, 插入失败
   if (new_size == size) {
-    // 在FindLeafPageByOperation中fetch了叶子节点
-    buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), true);
-    LOG_INFO("有重复的key, 插入失败");
+    ReleaseWriteLatches(leaf_page, false, transaction, root_is_latched);
     return false;
   }
+  UpdatePathCounts(key, 1, transaction);
   // 2.2插入成功，并且不需要进行分裂
   if (new_size < leaf_node->GetMaxSize()) {
-    buffer_pool_manager_->UnpinPage(leaf_node->GetPageId(), true);
-    LOG_INFO("插入成功，不需要进行分裂");
+    ReleaseWriteLatches(leaf_page, true, transaction, root_is_latched);
     return true;
   }
   // 2.3插入成功， 但是需要进行分裂(new_size = left_node->GetMaxSize())
-  // 分裂当前叶子节点
-  LOG_INFO("分裂当前叶子节点, page_id = %d", leaf_node->GetPageId());
+  // 分裂当前叶子节点，新节点只能通过持有写锁的节点访问到，因此不需要加锁
   LeafPage *new_leaf_node = Split(leaf_node);
-  // 将新节点中的最小key送往parent
-  // 锁的问题暂且搁置
-  bool *pointer_root_is_latched = new bool(root_is_latched);
-
-  InsertIntoParent(leaf_node, new_leaf_node->KeyAt(0), new_leaf_node, transaction, pointer_root_is_latched);
-  delete pointer_root_is_latched;
-
-  buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), true);
+  // 将新节点的下界送往parent，前缀压缩时它是截断后的分隔key
+  InsertIntoParent(leaf_node, new_leaf_node->GetLowKey(), new_leaf_node, transaction, &root_is_latched);
   buffer_pool_manager_->UnpinPage(new_leaf_node->GetPageId(), true);
-
+  ReleaseWriteLatches(leaf_page, true, transaction, root_is_latched);
   return true;
 }
 
+/*
+ * Insert pairs sorted by key. Neighbouring pairs that fall into the same leaf share one descent: the leaf is found
+ * with the optimistic descent together with its upper fence key, then the following pairs go straight into the write
+ * latched leaf as long as they are below the fence and the leaf does not have to split. A pair that would split the
+ * leaf takes the regular Insert path. Pairs out of order are inserted correctly as well, they only save nothing.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::InsertBatch(const std::vector<MappingType> &pairs, Transaction *transaction,
+                                   size_t *descents_saved) {
+  size_t inserted = 0;
+  size_t saved = 0;
+  // counted的树不能只锁leaf插入，逐个插入
+  if (counted_) {
+    for (const auto &pair : pairs) {
+      inserted += Insert(pair.first, pair.second, transaction) ? 1 : 0;
+    }
+    if (descents_saved != nullptr) {
+      *descents_saved = 0;
+    }
+    return inserted;
+  }
+  // 直接插入leaf的pair不经过Insert，先把所有key加入Bloom filter
+  for (size_t j = 0; bloom_filter_ != nullptr && j < pairs.size(); j++) {
+    bloom_filter_->Insert(pairs[j].first);
+  }
+  size_t i = 0;
+  while (i < pairs.size()) {
+    KeyType high_key;
+    bool has_high_key;
+    Page *page = FindLeafPageOptimistic(pairs[i].first, &high_key, &has_high_key);
+    if (page == nullptr) {
+      // 空树
+      inserted += Insert(pairs[i].first, pairs[i].second, transaction) ? 1 : 0;
+      i++;
+      continue;
+    }
+    LeafPage *leaf = reinterpret_cast<LeafPage *>(page->GetData());
+    bool is_dirty = false;
+    size_t first = i;
+    // 同一个leaf中的pair共用这一次下降：key不小于前一个key(不低于leaf的下界)且小于上界，并且插入后leaf不会分裂
+    while (i < pairs.size()) {
+      const KeyType &key = pairs[i].first;
+      if (i > first && comparator_(key, pairs[i - 1].first) < 0) {
+        break;
+      }
+      if (has_high_key && comparator_(key, high_key) >= 0) {
+        break;
+      }
+      if (!IsSafe(leaf, Operation::INSERT)) {
+        // leaf满了，重复的key仍然可以直接跳过
+        ValueType existing_value;
+        if (!leaf->Lookup(key, &existing_value, comparator_)) {
+          break;
+        }
+        i++;
+        continue;
+      }
+      int size = leaf->GetSize();
+      if (leaf->Insert(key, pairs[i].second, comparator_) != size) {
+        inserted++;
+        is_dirty = true;
+      }
+      i++;
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), is_dirty);
+    if (i > first) {
+      saved += i - first - 1;
+      continue;
+    }
+    // leaf已满，这一个pair走普通插入路径，由它完成分裂
+    inserted += Insert(pairs[i].first, pairs[i].second, transaction) ? 1 : 0;
+    i++;
+  }
+  if (descents_saved != nullptr) {
+    *descents_saved = saved;
+  }
+  return inserted;
+}
+
+/*
+ * 修改leaf的前驱指针。调用者持有leaf左边兄弟的写锁，按从左到右的顺序加锁，和迭代器、其他写操作不会死锁
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetLeafPrevPageId(page_id_t page_id, page_id_t prev_page_id) {
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "SetLeafPrevPageId: cannot fetch leaf");
+  }
+  page->WLatch();
+  reinterpret_cast<LeafPage *>(page->GetData())->SetPrevPageId(prev_page_id);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
 /*
  * 将传入的一个node拆分(Split)成两个结点，会产生一个新结点
  * 注意要区分叶子结点和内部结点
- * 如果node为internal page，则产生的新结点作为其孩子结点（疑问：？）
+ * 如果node为internal page，则新结点接管node后一半的孩子，并成为这些孩子的父结点
  * 如果node为leaf page，则产生的新结点要连接原结点，即更新这两个结点的next page id
  * Split input page and return newly created page.
  * Using template N to represent either internal page or leaf page.
@@ -179,31 +439,48 @@ N *BPLUSTREE_TYPE::Split(N *node) {
   // 该函数用于在进行insert操作而节点满了的情况下会会使用到
   // 分为叶子节点和内部节点两种情况
   page_id_t new_page_id;
-  auto new_page = buffer_pool_manager_->NewPage(&new_page_id);
+  auto new_page = buffer_pool_manager_->NewPage(&new_page_id, segment_id_);
   if (new_page == nullptr) {
-    return nullptr;
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "Split: out of memory");
   }
-  // new_node->SetPageType(old_node->GetPageType());
   N *ans;
   // 叶子节点
   if (node->IsLeafPage()) {
     LeafPage *old_node = reinterpret_cast<LeafPage *>(node);
     LeafPage *new_node = reinterpret_cast<LeafPage *>(new_page->GetData());
-    // 新产生的叶子节点和旧节点具有相同的parent
-    new_node->Init(new_page_id, old_node->GetParentPageId(), leaf_max_size_);
-    // 将旧节点的后一半数据拷贝到新节点
+    // 新产生的叶子节点和旧节点具有相同的parent，B-link mode不维护parent
+    new_node->Init(new_page_id, b_link_ ? INVALID_PAGE_ID : old_node->GetParentPageId(), leaf_max_size_,
+                   compress_keys_, posting_lists_, fence_size_);
+    // 将旧节点的后一半数据拷贝到新节点，新节点继承旧节点的上界，旧节点的上界变为分隔key
     old_node->MoveHalfTo(new_node);
-    //更新叶子结点的链表指针
+    // 一半的key移到了新节点，删除旧节点在adaptive hash index中的entry
+    if (adaptive_hash_index_ != nullptr) {
+      adaptive_hash_index_->DropPage(old_node->GetPageId());
+    }
+    //更新叶子结点的链表指针，原来的后继节点的前驱变为新节点
     new_node->SetNextPageId(old_node->GetNextPageId());
+    new_node->SetPrevPageId(old_node->GetPageId());
     old_node->SetNextPageId(new_page_id);
+    if (new_node->GetNextPageId() != INVALID_PAGE_ID) {
+      SetLeafPrevPageId(new_node->GetNextPageId(), new_page_id);
+    }
     ans = reinterpret_cast<N *>(new_node);
   } else {
     // 内部节点
     // 内部节点相对于叶子节点少了更新链表的过程
     InternalPage *old_node = reinterpret_cast<InternalPage *>(node);
     InternalPage *new_node = reinterpret_cast<InternalPage *>(new_page->GetData());
-    new_node->Init(new_page_id, old_node->GetParentPageId(), internal_max_size_);
-    old_node->MoveHalfTo(new_node, buffer_pool_manager_);
+    if (b_link_) {
+      // B-link mode不维护parent，移动的孩子也不需要更新parent page id
+      new_node->Init(new_page_id, INVALID_PAGE_ID, internal_max_size_, compress_keys_, counted_, fence_size_);
+      old_node->MoveHalfTo(new_node, nullptr);
+      new_node->SetNextPageId(old_node->GetNextPageId());
+      old_node->SetNextPageId(new_page_id);
+    } else {
+      new_node->Init(new_page_id, old_node->GetParentPageId(), internal_max_size_, compress_keys_, counted_,
+                     fence_size_);
+      old_node->MoveHalfTo(new_node, buffer_pool_manager_);
+    }
     ans = reinterpret_cast<N *>(new_node);
   }
   return ans;
@@ -225,51 +502,55 @@ N *BPLUSTREE_TYPE::Split(N *node) {
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node,
                                       Transaction *transaction, bool *root_is_latched) {
-  LOG_INFO("InsertIntoParent() begin");
   // 1.如果old_node是根节点，那么就需要创建一个新的根节点
+  // old_node不安全时一定持有root_latch_，因此可以修改root_page_id_
   if (old_node->IsRootPage()) {
-    LOG_INFO("old_node 为根节点, 准备创建新节点");
     page_id_t new_page_id = INVALID_PAGE_ID;
-    Page *new_page = buffer_pool_manager_->NewPage(&new_page_id);
+    Page *new_page = buffer_pool_manager_->NewPage(&new_page_id, segment_id_);
+    if (new_page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "InsertIntoParent: out of memory");
+    }
     InternalPage *new_root_page = reinterpret_cast<InternalPage *>(new_page->GetData());
-    // 更新root
-    root_page_id_ = new_page_id;
-    // 更新header page中的root page
-    UpdateRootPageId(0);
-    new_root_page->Init(root_page_id_, INVALID_PAGE_ID, internal_max_size_);
+    new_root_page->Init(new_page_id, INVALID_PAGE_ID, internal_max_size_, compress_keys_, counted_, fence_size_);
     // 修改根节点的指针
     new_root_page->PopulateNewRoot(old_node->GetPageId(), key, new_node->GetPageId());
+    if (counted_) {
+      new_root_page->SetCountAt(0, SubtreeCount(old_node));
+      new_root_page->SetCountAt(1, SubtreeCount(new_node));
+    }
     // 修改孩子的parent id
     old_node->SetParentPageId(new_page_id);
     new_node->SetParentPageId(new_page_id);
+    // 更新root以及header page中的root page
+    root_page_id_ = new_page_id;
+    height_++;
+    UpdateRootPageId(0);
 
-    // 这里只Unpin root page即可，其余两个子page留在insert主函数进行Unpin
+    // 这里只Unpin root page即可，其余两个子page由调用者进行Unpin
     buffer_pool_manager_->UnpinPage(new_page_id, true);
-    LOG_INFO("new root is setted, new_page_id is %d", new_page_id);
     return;
   }
   // 2.old_node不是根节点， 那么直接将{key, new_node->GetPageId()}插入父节点
-  // 此时父节点可能会满，如果父节点在插入之前已经满了，那么就需要进行Split, 得到
-  // 新节点， 再次调用InsertIntoParent进行递归操作
-  LOG_INFO("old_node为非根节点");
+  // 父节点已经在page set中持有写锁，这里只是再pin一次
+  // 此时父节点可能会满，如果满了那么就需要进行Split, 得到新节点， 再次调用InsertIntoParent进行递归操作
   Page *parent_page = buffer_pool_manager_->FetchPage(old_node->GetParentPageId());
-  InternalPage *parent_node = reinterpret_cast<InternalPage *>(parent_page);
+  InternalPage *parent_node = reinterpret_cast<InternalPage *>(parent_page->GetData());
   // 将{key, new_node->GetPageId()}插入父亲节点
   // 注意， new_node一定是紧插在old_node之后的
   parent_node->InsertNodeAfter(old_node->GetPageId(), key, new_node->GetPageId());
+  if (counted_) {
+    UpdateChildCount(parent_node, old_node);
+    UpdateChildCount(parent_node, new_node);
+  }
 
-  // 父节点插入之前没有满
+  // 父节点插入之后没有满
   if (parent_node->GetSize() < parent_node->GetMaxSize()) {
     buffer_pool_manager_->UnpinPage(parent_node->GetPageId(), true);
     return;
   }
-  // 父节点插入之前已经满了
-  // 分裂出新节点
-  LOG_INFO("父节点满， 准备分裂");
+  // 父节点插入之后满了，分裂出新节点
   InternalPage *parent_new_node = Split(parent_node);
-  bool *pointer_root_is_latched = new bool(root_is_latched);
-  InsertIntoParent(parent_node, parent_new_node->KeyAt(0), parent_new_node);
-  delete pointer_root_is_latched;
+  InsertIntoParent(parent_node, parent_new_node->GetLowKey(), parent_new_node, transaction, root_is_latched);
 
   buffer_pool_manager_->UnpinPage(parent_node->GetPageId(), true);
   buffer_pool_manager_->UnpinPage(parent_new_node->GetPageId(), true);
@@ -288,26 +569,60 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
   // 该函数用于从索引树中删除指定key
-  if (IsEmpty()) {
+  if (b_link_) {
+    RemoveBLink(key);
     return;
   }
+  if (transaction == nullptr) {
+    Transaction local_transaction(INVALID_TXN_ID);
+    Remove(key, &local_transaction);
+    return;
+  }
+  // 1.乐观删除：读锁下降，只对leaf加写锁，leaf删除后不会合并时只需要这一步；counted的树直接悲观下降
+  if (!counted_) {
+    Page *optimistic_page = FindLeafPageOptimistic(key);
+    if (optimistic_page == nullptr) {
+      return;
+    }
+    LeafPage *optimistic_leaf = reinterpret_cast<LeafPage *>(optimistic_page->GetData());
+    ValueType existing_value;
+    bool is_found = optimistic_leaf->Lookup(key, &existing_value, comparator_);
+    if (!is_found || IsSafe(optimistic_leaf, Operation::DELETE)) {
+      if (is_found) {
+        optimistic_leaf->RemoveAndDeleteRecord(key, comparator_);
+      }
+      optimistic_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(optimistic_page->GetPageId(), is_found);
+      return;
+    }
+    optimistic_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(optimistic_page->GetPageId(), false);
+  }
+
+  // 2.leaf可能合并或重新分配，悲观地重新下降
   auto [leaf_page, root_is_latched] = FindLeafPageByOperation(key, Operation::DELETE, transaction);
+  if (leaf_page == nullptr) {
+    return;
+  }
   LeafPage *leaf_node = reinterpret_cast<LeafPage *>(leaf_page->GetData());
   int old_size = leaf_node->GetSize();
   int new_size = leaf_node->RemoveAndDeleteRecord(key, comparator_);
 
   // 1.删除失败
   if (new_size == old_size) {
-    buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+    ReleaseWriteLatches(leaf_page, false, transaction, root_is_latched);
     return;
   }
-  // 2.删除成功
-  bool *pointer_root_is_latched = new bool(root_is_latched);
-  CoalesceOrRedistribute(leaf_node, transaction, pointer_root_is_latched);
-  delete pointer_root_is_latched;
-
-  // leaf page可能是被重新分配也可能是被删除，但总之得确保其被unpin
-  buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), true);
+  // 2.删除成功，需要被删除的page会被记录在事务的deleted page set中
+  UpdatePathCounts(key, -1, transaction);
+  CoalesceOrRedistribute(leaf_node, transaction, &root_is_latched);
+  ReleaseWriteLatches(leaf_page, true, transaction, root_is_latched);
+
+  // 3.所有锁都释放之后再删除page
+  for (page_id_t page_id : *transaction->GetDeletedPageSet()) {
+    buffer_pool_manager_->DeletePage(page_id);
+  }
+  transaction->GetDeletedPageSet()->clear();
 }
 
 /*
@@ -323,35 +638,52 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction, b
   // 该函数用于判断是进行合并还是进行重新分配的操作, 如果node需要被删除那么返回true,否则返回false
   // 情形1: node是根节点
   if (node->IsRootPage()) {
-    return AdjustRoot(node);
+    bool delete_root = AdjustRoot(node);
+    if (delete_root) {
+      transaction->AddIntoDeletedPageSet(node->GetPageId());
+    }
+    return delete_root;
   }
   // 情形2: 删除之后节点中的内容依旧大于等于minsize, 不需要调整，直接返回
   if (node->GetSize() >= node->GetMinSize()) {
     return false;
   }
   // 情形3: 删除之后节点中的内容小于minsize
-
+  // node不安全，所以parent在page set中持有写锁
   auto parent_page_id = node->GetParentPageId();
   auto parent = reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(parent_page_id)->GetData());
   int index = parent->ValueIndex(node->GetPageId());
-  // 如果一个节点放不下自己和兄弟节点的pair, 尝试从兄弟节点中借, 这里尽量向前面一个兄弟节点借
-  // 如果node在parent page是第一个节点的话就向后面一个节点借
+  // 尽量和前面一个兄弟节点调整，如果node在parent page是第一个节点的话就和后面一个节点调整
   int sibling_index = index > 0 ? index - 1 : 1;
   auto sibling_page_id = parent->ValueAt(sibling_index);
-  auto sibling_node = reinterpret_cast<N *>(buffer_pool_manager_->FetchPage(sibling_page_id));
-
-  if (node->GetSize() + sibling_node->GetSize() >= node->GetMaxSize()) {
+  Page *sibling_page = buffer_pool_manager_->FetchPage(sibling_page_id);
+  sibling_page->WLatch();
+  auto sibling_node = reinterpret_cast<N *>(sibling_page->GetData());
+
+  bool node_deleted = false;
+  if (compress_keys_) {
+    // 前缀压缩的节点按空间而不是pair数判断能否合并；放不下时只在兄弟节点更大时借一个pair，
+    // 否则node保持不足半满。internal节点因此至少有两个孩子，它的孩子总能找到兄弟节点
+    N *left = index == 0 ? node : sibling_node;
+    N *right = index == 0 ? sibling_node : node;
+    if (CanCoalesce(left, right, parent->KeyAt(std::max(index, 1)))) {
+      Coalesce(&sibling_node, &node, &parent, index, transaction, root_is_latched);
+      node_deleted = index > 0;
+    } else if (sibling_node->GetSize() > node->GetSize() + 1) {
+      Redistribute(sibling_node, node, index);
+    }
+  } else if (node->GetSize() + sibling_node->GetSize() >= node->GetMaxSize()) {
+    // 如果一个节点放不下自己和兄弟节点的pair, 从兄弟节点中借
     Redistribute(sibling_node, node, index);
-    buffer_pool_manager_->UnpinPage(parent_page_id, true);
-    buffer_pool_manager_->UnpinPage(sibling_page_id, true);
-    return false;
+  } else {
+    // 进行node与neighbor_node之间的合并，合并后位于右边的节点被删除
+    Coalesce(&sibling_node, &node, &parent, index, transaction, root_is_latched);
+    node_deleted = index > 0;
   }
-  // 进行node与neighbor_node之间的合并
-  Coalesce(&sibling_node, &node, &parent, index, transaction, root_is_latched);  // 返回值是parent是否需要被删除
-
-  buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
-  buffer_pool_manager_->UnpinPage(sibling_node->GetPageId(), true);
-  return true;
+  sibling_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(sibling_page_id, true);
+  buffer_pool_manager_->UnpinPage(parent_page_id, true);
+  return node_deleted;
 }
 
 /*
@@ -386,8 +718,17 @@ bool BPLUSTREE_TYPE::Coalesce(N **neighbor_node, N **node,
     LeafPage *leaf_node = reinterpret_cast<LeafPage *>(*node);
     LeafPage *neighbor_leaf_node = reinterpret_cast<LeafPage *>(*neighbor_node);
     leaf_node->MoveAllTo(neighbor_leaf_node);
-    // 设置叶子节点链表指针
+    // node在持有写锁时删除它的entry，之后按entry找到node的GetValue会发现entry已经不存在
+    if (adaptive_hash_index_ != nullptr) {
+      adaptive_hash_index_->DropPage(leaf_node->GetPageId());
+    }
+    // 设置叶子节点链表指针，node的后继节点的前驱变为neighbor_node
     neighbor_leaf_node->SetNextPageId(leaf_node->GetNextPageId());
+    if (leaf_node->GetNextPageId() != INVALID_PAGE_ID) {
+      SetLeafPrevPageId(leaf_node->GetNextPageId(), neighbor_leaf_node->GetPageId());
+    }
+    // 删除的leaf没有fence key，反向迭代器按前驱指针到达它时会发现它已经不在树中；后继指针留给正向迭代器
+    leaf_node->SetFences(nullptr, nullptr);
   } else {
     // 将node中的值以及middle key送往neighbor_node
     // 之所以要送middle key是因为node中key与value的值是不相等的
@@ -395,13 +736,28 @@ bool BPLUSTREE_TYPE::Coalesce(N **neighbor_node, N **node,
     InternalPage *neighbor_internal_node = reinterpret_cast<InternalPage *>(*neighbor_node);
     internal_node->MoveAllTo(neighbor_internal_node, middle_key, buffer_pool_manager_);
   }
-  // 删除node节点
-  // 这里直接将node从父节点中删除即可，在主函数中共对node进行Unpin操作
+  // 将node从父节点中删除，node在释放所有锁之后才真正被删除
   (*parent)->Remove(key_index);
+  if (counted_) {
+    UpdateChildCount(*parent, *neighbor_node);
+  }
+  transaction->AddIntoDeletedPageSet((*node)->GetPageId());
   // 由于父节点中删除了node, 所以需要进行递归判断
   return CoalesceOrRedistribute(*parent, transaction, root_is_latched);
 }
 
+/*
+ * 判断right能否合并到left中，middle_key是父节点中right的分隔key
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+bool BPLUSTREE_TYPE::CanCoalesce(N *left, N *right, const KeyType &middle_key) {
+  if (left->IsLeafPage()) {
+    return reinterpret_cast<LeafPage *>(right)->CanMoveAllTo(reinterpret_cast<LeafPage *>(left));
+  }
+  return reinterpret_cast<InternalPage *>(right)->CanMoveAllTo(reinterpret_cast<InternalPage *>(left), middle_key);
+}
+
 /*
  * Redistribute key & value pairs from one page to its sibling page. If index ==
  * 0, move sibling page's first key & value pair into end of input "node",
@@ -445,9 +801,13 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index) {
     } else {
       // neighbor_node是前驱节点
       neighbor_internal_node->MoveLastToFrontOf(internal_node, parent_node->KeyAt(index), buffer_pool_manager_);
-      parent_node->SetKeyAt(1, internal_node->KeyAt(0));
+      parent_node->SetKeyAt(index, internal_node->KeyAt(0));
     }
   }
+  if (counted_) {
+    UpdateChildCount(parent_node, node);
+    UpdateChildCount(parent_node, neighbor_node);
+  }
   buffer_pool_manager_->UnpinPage(parent_page_id, true);
 }
 /*
@@ -463,6 +823,7 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index) {
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
   // 该函数用于调整root page，当对root进行删除过后，使用该函数来进行root_page_id的调整, 只用于coalesceOrRedistribute()中
+  // root page需要调整时root不安全，调用者一定持有root_latch_
   // 情形1：old_root_node为根节点，并且其size == 1， 即含有一个指针
   if (!old_root_node->IsLeafPage() && old_root_node->GetSize() == 1) {
     InternalPage *internal_node = reinterpret_cast<InternalPage *>(old_root_node);
@@ -470,16 +831,22 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
 
     // 更新root_page_id
     root_page_id_ = child_page_id;
+    height_--;
     UpdateRootPageId(0);
     // 取出新root page， 更新其父指针
-    auto new_root_page = reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(root_page_id_)->GetData());
+    auto new_root_page = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(root_page_id_)->GetData());
     new_root_page->SetParentPageId(INVALID_PAGE_ID);
+    buffer_pool_manager_->UnpinPage(root_page_id_, true);
     return true;
   }
 
   // 情形2：old_root是叶子节点，并且删除之后size为0, 表明整个索引树清空了
   if (old_root_node->IsLeafPage() && old_root_node->GetSize() == 0) {
+    if (adaptive_hash_index_ != nullptr) {
+      adaptive_hash_index_->DropPage(old_root_node->GetPageId());
+    }
     root_page_id_ = INVALID_PAGE_ID;
+    height_ = 0;
     UpdateRootPageId(0);
     return true;
   }
@@ -488,6 +855,377 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
   return false;
 }
 
+/*****************************************************************************
+ * SUBTREE COUNTS
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::SubtreeCount(BPlusTreePage *node) const {
+  if (node->IsLeafPage()) {
+    return node->GetSize();
+  }
+  return reinterpret_cast<InternalPage *>(node)->GetTotalCount();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UpdatePathCounts(const KeyType &key, int delta, Transaction *transaction) {
+  if (!counted_) {
+    return;
+  }
+  // counted的树下降时不释放祖先节点，page set中是从root到leaf的parent的整条路径，ReleaseWriteLatches把它们按脏页unpin
+  for (Page *page : *transaction->GetPageSet()) {
+    auto internal = reinterpret_cast<InternalPage *>(page->GetData());
+    int index = internal->LookupIndex(key, comparator_);
+    internal->SetCountAt(index, internal->CountAt(index) + delta);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UpdateChildCount(InternalPage *parent, BPlusTreePage *node) {
+  parent->SetCountAt(parent->ValueIndex(node->GetPageId()), SubtreeCount(node));
+}
+
+/*
+ * 从root下降到key所在的leaf，每一层加上key所在孩子左边的孩子的计数，最后加上leaf中小于key的个数
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::Rank(const KeyType &key) {
+  root_latch_.lock();
+  if (IsEmpty()) {
+    root_latch_.unlock();
+    return 0;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  page->RLatch();
+  root_latch_.unlock();
+
+  size_t rank = 0;
+  auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  while (!node->IsLeafPage()) {
+    auto internal = reinterpret_cast<InternalPage *>(node);
+    int index = internal->LookupIndex(key, comparator_);
+    for (int i = 0; i < index; i++) {
+      rank += internal->CountAt(i);
+    }
+    Page *child_page = buffer_pool_manager_->FetchPage(internal->ValueAt(index));
+    child_page->RLatch();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    page = child_page;
+    node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  }
+  rank += reinterpret_cast<LeafPage *>(node)->KeyIndex(key, comparator_);
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  return rank;
+}
+
+/*
+ * Number of keys in [lo, hi), the difference of the ranks of hi and lo
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::CountRange(const KeyType &lo, const KeyType &hi) {
+  if (comparator_(lo, hi) >= 0) {
+    return 0;
+  }
+  if (!counted_) {
+    size_t count = 0;
+    for (auto iterator = Begin(lo, hi); !iterator.isEnd(); ++iterator) {
+      count++;
+    }
+    return count;
+  }
+  // 两次下降之间可能有并发的写，结果不会小于0
+  size_t lo_rank = Rank(lo);
+  size_t hi_rank = Rank(hi);
+  return hi_rank > lo_rank ? hi_rank - lo_rank : 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::GetCount() {
+  if (!counted_) {
+    size_t count = 0;
+    for (auto iterator = begin(); !iterator.isEnd(); ++iterator) {
+      count++;
+    }
+    return count;
+  }
+  root_latch_.lock();
+  if (IsEmpty()) {
+    root_latch_.unlock();
+    return 0;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  page->RLatch();
+  root_latch_.unlock();
+  size_t count = SubtreeCount(reinterpret_cast<BPlusTreePage *>(page->GetData()));
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  return count;
+}
+
+/*
+ * 从root下降，每一层跳过计数之和不超过rank的孩子，rank减去跳过的pair数，到leaf时rank就是leaf中的下标
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::SeekToRank(size_t rank) {
+  if (!counted_) {
+    auto iterator = begin();
+    for (size_t i = 0; i < rank && !iterator.isEnd(); i++) {
+      ++iterator;
+    }
+    return iterator;
+  }
+  root_latch_.lock();
+  if (IsEmpty()) {
+    root_latch_.unlock();
+    return INDEXITERATOR_TYPE();
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  page->RLatch();
+  root_latch_.unlock();
+
+  auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (rank >= SubtreeCount(node)) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    return INDEXITERATOR_TYPE();
+  }
+  while (!node->IsLeafPage()) {
+    auto internal = reinterpret_cast<InternalPage *>(node);
+    int index = 0;
+    while (index + 1 < internal->GetSize() && rank >= internal->CountAt(index)) {
+      rank -= internal->CountAt(index);
+      index++;
+    }
+    Page *child_page = buffer_pool_manager_->FetchPage(internal->ValueAt(index));
+    child_page->RLatch();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    page = child_page;
+    node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  }
+  // 迭代器接管leaf page的读锁和pin
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, static_cast<int>(rank), &comparator_, FindLeafFunction());
+}
+
+/*****************************************************************************
+ * BULK LOADING
+ *****************************************************************************/
+/*
+ * Build the tree bottom-up from a stream of pairs in strictly increasing key order
+ * 自底向上构建：leaf按顺序装满到fill factor，每个leaf确定之后把它的第一个key交给上一层，
+ * 上一层的internal节点同样按顺序装满，再交给更上一层。每一层只有最右边的两个节点保持pin，
+ * 输入结束时调整这两个节点，避免最右边的节点过空。
+ * page按key的顺序分配，写回磁盘时基本是顺序写
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BulkLoad(const std::function<bool(KeyType *, ValueType *)> &next_pair, double fill_factor) {
+  std::scoped_lock lock{root_latch_};
+  if (!IsEmpty()) {
+    return false;
+  }
+  // leaf的size达到max size就会分裂，internal同理，所以节点最多装max size - 1个pair
+  // 至少装到min size，internal节点至少有两个孩子
+  fill_factor = std::clamp(fill_factor, 0.0, 1.0);
+  auto capacity = [fill_factor](int max_size, int min_size) {
+    int stable_size = max_size - 1;
+    auto packed = static_cast<int>(std::lround(fill_factor * stable_size));
+    return std::clamp(packed, std::min(min_size, stable_size), stable_size);
+  };
+  BulkLoadContext context;
+  context.leaf_capacity_ = std::max(capacity(leaf_max_size_, leaf_max_size_ / 2), 1);
+  context.internal_capacity_ = std::max(capacity(internal_max_size_, std::max(internal_max_size_ / 2, 2)), 2);
+  context.levels_.emplace_back();
+
+  KeyType key;
+  ValueType value;
+  KeyType last_key;
+  bool has_last_key = false;
+  while (next_pair(&key, &value)) {
+    if (has_last_key && comparator_(last_key, key) >= 0) {
+      // 输入不是严格递增的
+      BulkAbort(&context);
+      return false;
+    }
+    Page *cur = context.levels_[0].cur_;
+    if (cur == nullptr || BulkIsFull(reinterpret_cast<LeafPage *>(cur->GetData()), context.leaf_capacity_)) {
+      Page *page = BulkNewNode(&context, true);
+      if (cur != nullptr) {
+        reinterpret_cast<LeafPage *>(cur->GetData())->SetNextPageId(page->GetPageId());
+        reinterpret_cast<LeafPage *>(page->GetData())->SetPrevPageId(cur->GetPageId());
+      }
+      BulkPushNode(&context, 0, page);
+      cur = page;
+    }
+    // key比leaf中所有key都大，Insert直接追加在尾部
+    reinterpret_cast<LeafPage *>(cur->GetData())->Insert(key, value, comparator_);
+    if (bloom_filter_ != nullptr) {
+      bloom_filter_->Insert(key);
+    }
+    last_key = key;
+    has_last_key = true;
+  }
+  if (!has_last_key) {
+    return true;
+  }
+  root_page_id_ = BulkFinish(&context, 0);
+  height_ = static_cast<int>(context.levels_.size());
+  // 反向迭代器按leaf的下界移动到前一个leaf，所有节点都要设置fence key；前缀压缩的节点设置之后按前缀重新编码
+  std::vector<page_id_t> last_at_level;
+  SetFences(root_page_id_, nullptr, nullptr, 0, &last_at_level);
+  UpdateRootPageId(1);
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BulkLoad(const std::vector<MappingType> &pairs, double fill_factor) {
+  size_t next = 0;
+  return BulkLoad(
+      [&pairs, &next](KeyType *key, ValueType *value) {
+        if (next == pairs.size()) {
+          return false;
+        }
+        *key = pairs[next].first;
+        *value = pairs[next].second;
+        next++;
+        return true;
+      },
+      fill_factor);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+bool BPLUSTREE_TYPE::BulkIsFull(N *node, int capacity) {
+  // 前缀压缩的节点在设置fence key之前没有前缀，按空间判断是否已满
+  return node->GetSize() >= capacity || node->GetSize() >= node->GetMaxSize() - 1;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::BulkNewNode(BulkLoadContext *context, bool is_leaf) {
+  page_id_t page_id;
+  Page *page = buffer_pool_manager_->NewPage(&page_id, segment_id_);
+  if (page == nullptr) {
+    BulkAbort(context);
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "BulkLoad: out of memory");
+  }
+  context->allocated_.push_back(page_id);
+  if (is_leaf) {
+    reinterpret_cast<LeafPage *>(page->GetData())
+        ->Init(page_id, INVALID_PAGE_ID, leaf_max_size_, compress_keys_, posting_lists_, fence_size_);
+  } else {
+    reinterpret_cast<InternalPage *>(page->GetData())
+        ->Init(page_id, INVALID_PAGE_ID, internal_max_size_, compress_keys_, counted_, fence_size_);
+  }
+  return page;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkPushNode(BulkLoadContext *context, size_t level, Page *page) {
+  // 注意：BulkFinalize可能会在levels_末尾追加新的一层，不能持有levels_中元素的引用
+  Page *finalized = context->levels_[level].prev_;
+  context->levels_[level].prev_ = context->levels_[level].cur_;
+  context->levels_[level].cur_ = page;
+  if (finalized != nullptr) {
+    BulkFinalize(context, level, finalized);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkFinalize(BulkLoadContext *context, size_t level, Page *page) {
+  if (context->levels_.size() == level + 1) {
+    context->levels_.emplace_back();
+  }
+  // leaf的第一个key，或者internal节点自身的分隔key(KeyAt(0))
+  auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  KeyType first_key = node->IsLeafPage() ? reinterpret_cast<LeafPage *>(node)->KeyAt(0)
+                                         : reinterpret_cast<InternalPage *>(node)->KeyAt(0);
+  page_id_t parent_page_id =
+      BulkAppendChild(context, level + 1, first_key, page->GetPageId(), static_cast<uint32_t>(SubtreeCount(node)));
+  node->SetParentPageId(parent_page_id);
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t BPLUSTREE_TYPE::BulkAppendChild(BulkLoadContext *context, size_t level, const KeyType &key,
+                                          page_id_t child, uint32_t count) {
+  Page *cur = context->levels_[level].cur_;
+  if (cur == nullptr || BulkIsFull(reinterpret_cast<InternalPage *>(cur->GetData()), context->internal_capacity_)) {
+    cur = BulkNewNode(context, false);
+    BulkPushNode(context, level, cur);
+  }
+  reinterpret_cast<InternalPage *>(cur->GetData())->Append(key, child, count);
+  return cur->GetPageId();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t BPLUSTREE_TYPE::BulkFinish(BulkLoadContext *context, size_t level) {
+  Page *prev = context->levels_[level].prev_;
+  Page *cur = context->levels_[level].cur_;
+  context->levels_[level] = BulkLoadLevel();
+  auto cur_node = reinterpret_cast<BPlusTreePage *>(cur->GetData());
+  bool is_leaf = cur_node->IsLeafPage();
+
+  if (prev != nullptr) {
+    auto prev_node = reinterpret_cast<BPlusTreePage *>(prev->GetData());
+    KeyType middle_key = is_leaf ? KeyType() : reinterpret_cast<InternalPage *>(cur_node)->KeyAt(0);
+    if (CanCoalesce(prev_node, cur_node, middle_key)) {
+      // 1 最右边的两个节点可以合并成一个节点
+      if (is_leaf) {
+        reinterpret_cast<LeafPage *>(cur_node)->MoveAllTo(reinterpret_cast<LeafPage *>(prev_node));
+        reinterpret_cast<LeafPage *>(prev_node)->SetNextPageId(INVALID_PAGE_ID);
+      } else {
+        auto cur_internal = reinterpret_cast<InternalPage *>(cur_node);
+        cur_internal->MoveAllTo(reinterpret_cast<InternalPage *>(prev_node), cur_internal->KeyAt(0),
+                                buffer_pool_manager_);
+      }
+      buffer_pool_manager_->UnpinPage(cur->GetPageId(), false);
+      buffer_pool_manager_->DeletePage(cur->GetPageId());
+      cur = prev;
+      cur_node = prev_node;
+      prev = nullptr;
+    } else {
+      // 2 从前一个节点借pair，让两个节点大小均衡；前缀压缩的节点pair大小不同，不能借到cur放不下
+      while (cur_node->GetSize() < prev_node->GetSize() - 1 && cur_node->GetSize() < cur_node->GetMaxSize() - 1) {
+        if (is_leaf) {
+          reinterpret_cast<LeafPage *>(prev_node)->MoveLastToFrontOf(reinterpret_cast<LeafPage *>(cur_node));
+        } else {
+          auto cur_internal = reinterpret_cast<InternalPage *>(cur_node);
+          reinterpret_cast<InternalPage *>(prev_node)->MoveLastToFrontOf(cur_internal, cur_internal->KeyAt(0),
+                                                                           buffer_pool_manager_);
+        }
+      }
+    }
+  }
+
+  // 这一层只有一个节点，并且没有交给过上一层，它就是root
+  if (prev == nullptr && context->levels_.size() == level + 1) {
+    cur_node->SetParentPageId(INVALID_PAGE_ID);
+    buffer_pool_manager_->UnpinPage(cur->GetPageId(), true);
+    return cur->GetPageId();
+  }
+  if (prev != nullptr) {
+    BulkFinalize(context, level, prev);
+  }
+  BulkFinalize(context, level, cur);
+  return BulkFinish(context, level + 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkAbort(BulkLoadContext *context) {
+  for (auto &level : context->levels_) {
+    for (Page *page : {level.prev_, level.cur_}) {
+      if (page != nullptr) {
+        buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+      }
+    }
+    level = BulkLoadLevel();
+  }
+  for (page_id_t page_id : context->allocated_) {
+    buffer_pool_manager_->DeletePage(page_id);
+  }
+  context->allocated_.clear();
+}
+
 /*****************************************************************************
  * INDEX ITERATOR
  *****************************************************************************/
@@ -497,7 +1235,14 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::begin() { return INDEXITERATOR_TYPE(); }
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::begin() {
+  Page *page = FindLeafPageByOperation(KeyType(), Operation::FIND, nullptr, true).first;
+  if (page == nullptr) {
+    return INDEXITERATOR_TYPE();
+  }
+  // 迭代器接管leaf page的读锁和pin
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, 0, &comparator_, FindLeafFunction());
+}
 
 /*
  * Input parameter is low key, find the leaf page that contains the input key
@@ -505,7 +1250,30 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::begin() { return INDEXITERATOR_TYPE(); }
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) { return INDEXITERATOR_TYPE(); }
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) {
+  Page *page = FindLeafPageByOperation(key, Operation::FIND).first;
+  if (page == nullptr) {
+    return INDEXITERATOR_TYPE();
+  }
+  // 定位到leaf中第一个>=key的位置，如果key大于leaf中所有key，迭代器会移动到下一个leaf
+  int index = reinterpret_cast<LeafPage *>(page->GetData())->KeyIndex(key, comparator_);
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, index, &comparator_, FindLeafFunction());
+}
+
+/*
+ * Input parameters are the bounds of a range [lo, hi), find the leaf page that
+ * contains lo first, then construct an index iterator that ends before hi
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &lo, const KeyType &hi) {
+  Page *page = FindLeafPageByOperation(lo, Operation::FIND).first;
+  if (page == nullptr) {
+    return INDEXITERATOR_TYPE();
+  }
+  int index = reinterpret_cast<LeafPage *>(page->GetData())->KeyIndex(lo, comparator_);
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, index, &comparator_, FindLeafFunction(), hi);
+}
 
 /*
  * Input parameter is void, construct an index iterator representing the end
@@ -515,6 +1283,174 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) { return INDEXITERA
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::end() { return INDEXITERATOR_TYPE(); }
 
+/*
+ * Input parameter is void, find the rightmost leaf page first, then construct
+ * a reverse index iterator at its last key
+ * @return : reverse index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::RBegin() {
+  Page *page = FindLeafPageByOperation(KeyType(), Operation::FIND, nullptr, false, true).first;
+  if (page == nullptr) {
+    return INDEXITERATOR_TYPE();
+  }
+  // 最右边的leaf可能是空的(B-link mode)，下标为-1时迭代器会移动到前一个leaf
+  int index = reinterpret_cast<LeafPage *>(page->GetData())->GetSize() - 1;
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, index, &comparator_, FindLeafFunction(), true);
+}
+
+/*
+ * Input parameter is high key, find the leaf page that contains the input key
+ * first, then construct a reverse index iterator at the largest key <= high key
+ * @return : reverse index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::RBegin(const KeyType &key) {
+  Page *page = FindLeafPageByOperation(key, Operation::FIND).first;
+  if (page == nullptr) {
+    return INDEXITERATOR_TYPE();
+  }
+  // 第一个>=key的位置不等于key时，从它前面的key开始
+  auto leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  int index = leaf->KeyIndex(key, comparator_);
+  if (index == leaf->GetSize() || comparator_(leaf->KeyAt(index), key) > 0) {
+    index--;
+  }
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, index, &comparator_, FindLeafFunction(), true);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::function<Page *(const KeyType &)> BPLUSTREE_TYPE::FindLeafFunction() {
+  return [this](const KeyType &key) { return FindLeafPageByOperation(key, Operation::FIND).first; };
+}
+
+/*
+ * Range scan over [lo, hi), append the values in key order to result
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ScanRange(const KeyType &lo, const KeyType &hi, std::vector<ValueType> *result,
+                               Transaction *transaction) {
+  for (auto iterator = Begin(lo, hi); !iterator.isEnd(); ++iterator) {
+    result->push_back((*iterator).second);
+  }
+}
+
+/*
+ * Split [lo, hi) into sub-ranges with the keys of the internal levels, the highest level that has enough keys in the
+ * range wins. The keys of one level are evenly spread over the leaves below it, so evenly spaced keys of a level cut
+ * the range into sub-ranges of about the same number of leaves.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<KeyType> BPLUSTREE_TYPE::PartitionRange(const KeyType &lo, const KeyType &hi, size_t parts) {
+  std::vector<KeyType> separators;
+  if (parts < 2 || comparator_(lo, hi) >= 0) {
+    return separators;
+  }
+  // 从root开始逐层加深，直到分隔key足够或者到达leaf的上一层
+  for (int depth = 0;; depth++) {
+    root_latch_.lock();
+    if (IsEmpty() || depth > height_ - 2) {
+      root_latch_.unlock();
+      break;
+    }
+    Page *root_page = buffer_pool_manager_->FetchPage(root_page_id_);
+    root_page->RLatch();
+    root_latch_.unlock();
+    separators.clear();
+    CollectSeparators(root_page, lo, hi, depth, &separators);
+    if (separators.size() + 1 >= parts) {
+      break;
+    }
+  }
+  // 不同层的key可能相同，排序去重之后均匀地选出parts - 1个
+  std::sort(separators.begin(), separators.end(),
+            [this](const KeyType &a, const KeyType &b) { return comparator_(a, b) < 0; });
+  separators.erase(std::unique(separators.begin(), separators.end(),
+                               [this](const KeyType &a, const KeyType &b) { return comparator_(a, b) == 0; }),
+                   separators.end());
+  if (separators.size() + 1 <= parts) {
+    return separators;
+  }
+  std::vector<KeyType> chosen;
+  for (size_t i = 1; i < parts; i++) {
+    chosen.push_back(separators[i * (separators.size() + 1) / parts - 1]);
+  }
+  return chosen;
+}
+
+/*
+ * 收集page及其depth层以内的后代中落在(lo, hi)中的分隔key。调用者持有page的读锁和pin，返回前释放
+ * 下降时持有祖先的读锁，和悲观下降的写操作一样从上到下加锁，孩子不会在读到它的page id之后被删除；
+ * B-link mode的写操作从下到上加锁，所以先释放父节点，page不会被删除
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::CollectSeparators(Page *page, const KeyType &lo, const KeyType &hi, int depth,
+                                       std::vector<KeyType> *separators) {
+  auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  std::vector<page_id_t> children;
+  if (!node->IsLeafPage()) {
+    // 孩子i的范围是[key(i), key(i + 1))，first和last是和[lo, hi)相交的第一个和最后一个孩子
+    auto internal = reinterpret_cast<InternalPage *>(node);
+    int first = internal->LookupIndex(lo, comparator_);
+    int last = internal->LookupIndex(hi, comparator_);
+    if (last > first && comparator_(internal->KeyAt(last), hi) == 0) {
+      last--;
+    }
+    for (int i = first; i <= last; i++) {
+      if (i > first) {
+        separators->push_back(internal->KeyAt(i));
+      }
+      if (depth > 0) {
+        children.push_back(internal->ValueAt(i));
+      }
+    }
+  }
+  if (b_link_) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  }
+  for (page_id_t child_page_id : children) {
+    Page *child_page = buffer_pool_manager_->FetchPage(child_page_id);
+    if (child_page == nullptr) {
+      break;
+    }
+    child_page->RLatch();
+    CollectSeparators(child_page, lo, hi, depth - 1, separators);
+  }
+  if (!b_link_) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  }
+}
+
+/*
+ * Range scan over [lo, hi) with parts threads, each one scans a sub-range of PartitionRange with its own iterator
+ * over its own leaves, the results are appended in key order
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ParallelScanRange(const KeyType &lo, const KeyType &hi, size_t parts,
+                                       std::vector<ValueType> *result) {
+  std::vector<KeyType> bounds{lo};
+  for (const auto &separator : PartitionRange(lo, hi, parts)) {
+    bounds.push_back(separator);
+  }
+  bounds.push_back(hi);
+  size_t ranges = bounds.size() - 1;
+  std::vector<std::vector<ValueType>> results(ranges);
+  std::vector<std::thread> workers;
+  // 第一个子范围在当前线程中扫描
+  for (size_t i = 1; i < ranges; i++) {
+    workers.emplace_back([this, &bounds, &results, i] { ScanRange(bounds[i], bounds[i + 1], &results[i]); });
+  }
+  ScanRange(bounds[0], bounds[1], &results[0]);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (const auto &range_result : results) {
+    result->insert(result->end(), range_result.begin(), range_result.end());
+  }
+}
+
 /*****************************************************************************
  * UTILITIES AND DEBUG
  * 从整个B+树的根结点开始，一直向下找到叶子结点
@@ -524,8 +1460,10 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::end() { return INDEXITERATOR_TYPE(); }
 /*
  * Find leaf page containing particular key, if leftMost flag == true, find
  * the left most leaf page
+ * 查找时使用latch crabbing：FIND操作对结点加读锁，拿到孩子的读锁之后就释放父结点
+ * INSERT/DELETE操作对结点加写锁，孩子安全时释放所有祖先结点(包括root_latch_)，否则把父结点记录到page set中
+ * 返回的leaf page持有锁并被pin，second表示返回时是否仍持有root_latch_；树为空时返回nullptr
  */
-
 INDEX_TEMPLATE_ARGUMENTS
 std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &key, Operation operation,
                                                                 Transaction *transaction, bool leftMost,
@@ -533,26 +1471,30 @@ std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &k
   // 该函数用于查找索引树中包含key的叶子节点, 除了以下两种情况
   // 如果leftMost为真，那么只返回最左边的叶子节点
   // 如果rightMost为真，那么返回最右边的叶子节点
-  LOG_INFO("FindLeafPageByOperation() begin");
   assert(operation == Operation::FIND ? !(leftMost && rightMost) : transaction != nullptr);
+  if (b_link_ && operation == Operation::FIND) {
+    return std::make_pair(FindLeafPageBLink(key, false, nullptr, leftMost, rightMost), false);
+  }
 
-  // LOG_INFO("BEGIN FindLeafPage key=%ld Thread=%lu Operation=%d", key.ToString(), getThreadId(),
-  //          OpToString(operation));  // DEBUG
-
+  root_latch_.lock();
   bool is_root_page_id_latched = true;
+  if (IsEmpty()) {
+    root_latch_.unlock();
+    return std::make_pair(nullptr, false);
+  }
 
   Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
   BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
 
   if (operation == Operation::FIND) {
-    // page->RLatch();
+    page->RLatch();
     is_root_page_id_latched = false;
-    // root_latch_.unlock();
+    root_latch_.unlock();
   } else {
-    // page->WLatch();
+    page->WLatch();
     if (IsSafe(node, operation)) {
       is_root_page_id_latched = false;
-      // root_latch_.unlock();
+      root_latch_.unlock();
     }
   }
 
@@ -572,19 +1514,22 @@ std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &k
     auto child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
 
     if (operation == Operation::FIND) {
-      // child_page->RLatch();
-      // page->RUnlatch();
+      child_page->RLatch();
+      page->RUnlatch();
       buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
     } else {
-      // child_page->WLatch();
+      child_page->WLatch();
       transaction->AddIntoPageSet(page);
       // child node is safe, release all locks on ancestors
       if (IsSafe(child_node, operation)) {
         if (is_root_page_id_latched) {
           is_root_page_id_latched = false;
-          //     root_latch_.unlock();
+          root_latch_.unlock();
+        }
+        // counted的树要修改路径上所有节点的计数，祖先节点一直持有写锁
+        if (!counted_) {
+          UnlockUnpinPages(transaction);
         }
-        UnlockUnpinPages(transaction);
       }
     }
 
@@ -592,61 +1537,361 @@ std::pair<Page *, bool> BPLUSTREE_TYPE::FindLeafPageByOperation(const KeyType &k
     node = child_node;
   }  // end while
 
-  // LOG_INFO("END FindLeafPage key=%ld Thread=%lu Operation=%d", key.ToString(), getThreadId(),
-  //          OpToString(operation));  // DEBUG
-
   return std::make_pair(page, is_root_page_id_latched);
 }
 
-/* unlock and unpin all pages */
+/*
+ * 乐观latch crabbing：和FIND一样对内部节点加读锁，拿到孩子的锁之后释放父节点，只对leaf加写锁
+ * 父节点持有读锁时孩子不会被删除，节点的类型在其生命周期内不变，所以可以在加锁之前判断孩子是否为leaf
+ * 返回的leaf page持有写锁并被pin；树为空时返回nullptr
+ * high_key不为空时返回leaf的key上界(不含)，leaf是最右边的leaf时has_high_key为false
+ */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::UnlockUnpinPages(Transaction *transaction) {
-  // LOG_INFO("ENTER UnlockUnpinPages Thread=%ld", getThreadId());
+Page *BPLUSTREE_TYPE::FindLeafPageOptimistic(const KeyType &key, KeyType *high_key, bool *has_high_key) {
+  if (has_high_key != nullptr) {
+    *has_high_key = false;
+  }
+  if (b_link_) {
+    // leaf自己记录了上界
+    Page *page = FindLeafPageBLink(key, true);
+    auto leaf = page == nullptr ? nullptr : reinterpret_cast<LeafPage *>(page->GetData());
+    if (leaf != nullptr && has_high_key != nullptr && leaf->GetNextPageId() != INVALID_PAGE_ID) {
+      *high_key = leaf->GetHighKey();
+      *has_high_key = true;
+    }
+    return page;
+  }
+  root_latch_.lock();
+  if (IsEmpty()) {
+    root_latch_.unlock();
+    return nullptr;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (node->IsLeafPage()) {
+    page->WLatch();
+  } else {
+    page->RLatch();
+  }
+  root_latch_.unlock();
 
-  if (transaction == nullptr) {
+  while (!node->IsLeafPage()) {
+    auto i_node = reinterpret_cast<InternalPage *>(node);
+    int child_index = i_node->LookupIndex(key, comparator_);
+    page_id_t child_page_id = i_node->ValueAt(child_index);
+    // 越往下的上界越紧，leaf的上界是路径上最后一个右侧key
+    if (has_high_key != nullptr && child_index + 1 < i_node->GetSize()) {
+      *high_key = i_node->KeyAt(child_index + 1);
+      *has_high_key = true;
+    }
+    Page *child_page = buffer_pool_manager_->FetchPage(child_page_id);
+    auto child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
+    if (child_node->IsLeafPage()) {
+      child_page->WLatch();
+    } else {
+      child_page->RLatch();
+    }
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    page = child_page;
+    node = child_node;
+  }
+  return page;
+}
+
+/*****************************************************************************
+ * B-LINK MODE
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeafPageBLink(const KeyType &key, bool exclusive, std::vector<page_id_t> *stack,
+                                        bool left_most, bool right_most) {
+  root_latch_.lock();
+  if (IsEmpty()) {
+    root_latch_.unlock();
+    return nullptr;
+  }
+  page_id_t page_id = root_page_id_;
+  root_latch_.unlock();
+
+  // root可能在这之后分裂，旧的root仍然是它那一层最左边的节点，向右移动即可找到key
+  // 节点的类型在其生命周期内不变，并且B-link mode下不会删除page，所以可以在加锁之前判断是否为leaf
+  // 分裂时旧节点留在左边，所以最左边的节点不会改变，left_most时不需要向右移动
+  while (true) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    bool is_leaf = node->IsLeafPage();
+    if (is_leaf && exclusive) {
+      page->WLatch();
+    } else {
+      page->RLatch();
+    }
+    if (!left_most) {
+      page = MoveRightBLink(page, key, is_leaf && exclusive, right_most);
+    }
+    if (is_leaf) {
+      return page;
+    }
+    if (stack != nullptr) {
+      stack->push_back(page->GetPageId());
+    }
+    auto internal = reinterpret_cast<InternalPage *>(page->GetData());
+    if (left_most) {
+      page_id = internal->ValueAt(0);
+    } else if (right_most) {
+      page_id = internal->ValueAt(internal->GetSize() - 1);
+    } else {
+      page_id = internal->Lookup(key, comparator_);
+    }
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::MoveRightBLink(Page *page, const KeyType &key, bool exclusive, bool right_most) {
+  while (true) {
+    auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page_id_t next_page_id;
+    KeyType high_key;
+    if (node->IsLeafPage()) {
+      next_page_id = reinterpret_cast<LeafPage *>(node)->GetNextPageId();
+      high_key = reinterpret_cast<LeafPage *>(node)->GetHighKey();
+    } else {
+      next_page_id = reinterpret_cast<InternalPage *>(node)->GetNextPageId();
+      high_key = reinterpret_cast<InternalPage *>(node)->GetHighKey();
+    }
+    if (next_page_id == INVALID_PAGE_ID || (!right_most && comparator_(key, high_key) < 0)) {
+      return page;
+    }
+    // 同一层总是从左向右加锁，不会死锁
+    Page *next_page = buffer_pool_manager_->FetchPage(next_page_id);
+    if (exclusive) {
+      next_page->WLatch();
+      page->WUnlatch();
+    } else {
+      next_page->RLatch();
+      page->RUnlatch();
+    }
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    page = next_page;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::FindAncestorsBLink(const KeyType &key, int level, std::vector<page_id_t> *stack) {
+  root_latch_.lock();
+  page_id_t page_id = root_page_id_;
+  int page_level = height_ - 1;
+  root_latch_.unlock();
+  for (; page_level >= level; page_level--) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    page->RLatch();
+    page = MoveRightBLink(page, key, false);
+    stack->push_back(page->GetPageId());
+    page_id = reinterpret_cast<InternalPage *>(page->GetData())->Lookup(key, comparator_);
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  }
+}
+
+/*
+ * Lehman-Yao insertion: the leaf is found without holding latches on the path, a split of a page first links the
+ * new right sibling into its level, then latches the parent (moving right from the page on the descent stack) before
+ * it releases the split page, and inserts the separator there. At most the split page and its parent are latched.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::InsertBLink(const KeyType &key, const ValueType &value) {
+  std::vector<page_id_t> stack;
+  Page *page = FindLeafPageBLink(key, true, &stack);
+  auto leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  int size = leaf->GetSize();
+  int new_size = leaf->Insert(key, value, comparator_);
+  if (new_size == size || new_size < leaf->GetMaxSize()) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), new_size != size);
+    return new_size != size;
+  }
+
+  // page持有写锁并且已满，逐层向上分裂
+  auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  for (int level = 0;; level++) {
+    BPlusTreePage *new_node;
+    KeyType separator;
+    if (node->IsLeafPage()) {
+      auto new_leaf = Split(reinterpret_cast<LeafPage *>(node));
+      separator = new_leaf->GetLowKey();
+      new_node = new_leaf;
+    } else {
+      auto new_internal = Split(reinterpret_cast<InternalPage *>(node));
+      separator = new_internal->GetLowKey();
+      new_node = new_internal;
+    }
+    page_id_t new_page_id = new_node->GetPageId();
+
+    if (stack.empty()) {
+      std::unique_lock root_lock{root_latch_};
+      if (root_page_id_ == node->GetPageId()) {
+        // node是root，创建新的root
+        page_id_t root_page_id;
+        Page *root_page = buffer_pool_manager_->NewPage(&root_page_id, segment_id_);
+        if (root_page == nullptr) {
+          throw Exception(ExceptionType::OUT_OF_MEMORY, "InsertBLink: out of memory");
+        }
+        auto root = reinterpret_cast<InternalPage *>(root_page->GetData());
+        root->Init(root_page_id, INVALID_PAGE_ID, internal_max_size_, compress_keys_, counted_, fence_size_);
+        root->PopulateNewRoot(node->GetPageId(), separator, new_page_id);
+        root_page_id_ = root_page_id;
+        height_++;
+        UpdateRootPageId(0);
+        buffer_pool_manager_->UnpinPage(root_page_id, true);
+        buffer_pool_manager_->UnpinPage(new_page_id, true);
+        page->WUnlatch();
+        buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+        return true;
+      }
+      root_lock.unlock();
+      // 下降时node所在的层就是root，此后root已经分裂，从新的root找到上一层
+      FindAncestorsBLink(separator, level + 1, &stack);
+    }
+
+    // 先锁住父节点再释放node，保证同一个父节点上的分隔key按分裂的顺序插入
+    Page *parent_page = buffer_pool_manager_->FetchPage(stack.back());
+    stack.pop_back();
+    parent_page->WLatch();
+    parent_page = MoveRightBLink(parent_page, separator, true);
+    buffer_pool_manager_->UnpinPage(new_page_id, true);
+    page_id_t old_page_id = node->GetPageId();
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(old_page_id, true);
+
+    auto parent = reinterpret_cast<InternalPage *>(parent_page->GetData());
+    assert(parent->ValueIndex(old_page_id) >= 0);
+    parent->InsertNodeAfter(old_page_id, separator, new_page_id);
+    if (parent->GetSize() < parent->GetMaxSize()) {
+      parent_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), true);
+      return true;
+    }
+    page = parent_page;
+    node = parent;
+  }
+}
+
+/*
+ * B-link mode只从leaf中删除，不合并也不重新分配
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::RemoveBLink(const KeyType &key) {
+  Page *page = FindLeafPageBLink(key, true);
+  if (page == nullptr) {
     return;
   }
+  auto leaf = reinterpret_cast<LeafPage *>(page->GetData());
+  int size = leaf->GetSize();
+  bool is_dirty = leaf->RemoveAndDeleteRecord(key, comparator_) != size;
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), is_dirty);
+}
 
-  // auto pages = transaction->GetPageSet().get();
-  // LOG_INFO("transaction page set size = %d", (int)pages->size());
+/*
+ * 按key的顺序深度优先遍历，同一层的节点按从左到右的顺序访问，B-link mode访问节点时把它设为同一层前一个节点的右指针
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetFences(page_id_t page_id, const KeyType *low_key, const KeyType *high_key, size_t level,
+                               std::vector<page_id_t> *last_at_level) {
+  if (last_at_level->size() == level) {
+    last_at_level->push_back(INVALID_PAGE_ID);
+  }
+  page_id_t prev_page_id = (*last_at_level)[level];
+  if (b_link_ && prev_page_id != INVALID_PAGE_ID) {
+    auto prev = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(prev_page_id)->GetData());
+    if (prev->IsLeafPage()) {
+      reinterpret_cast<LeafPage *>(prev)->SetNextPageId(page_id);
+    } else {
+      reinterpret_cast<InternalPage *>(prev)->SetNextPageId(page_id);
+    }
+    buffer_pool_manager_->UnpinPage(prev_page_id, true);
+  }
+  (*last_at_level)[level] = page_id;
+
+  auto node = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(page_id)->GetData());
+  if (node->IsLeafPage()) {
+    auto leaf = reinterpret_cast<LeafPage *>(node);
+    if (b_link_) {
+      leaf->SetNextPageId(INVALID_PAGE_ID);
+    }
+    leaf->SetFences(low_key, high_key);
+  } else {
+    auto internal = reinterpret_cast<InternalPage *>(node);
+    if (b_link_) {
+      internal->SetNextPageId(INVALID_PAGE_ID);
+    }
+    internal->SetFences(low_key, high_key);
+    // 孩子i的范围是[key(i), key(i + 1))，第一个孩子的下界和最后一个孩子的上界是本节点的
+    // 每一层最左/右边的节点没有下/上界
+    for (int i = 0; i < internal->GetSize(); i++) {
+      KeyType child_low = internal->KeyAt(i);
+      KeyType child_high = i + 1 == internal->GetSize() ? KeyType() : internal->KeyAt(i + 1);
+      SetFences(internal->ValueAt(i), i == 0 ? low_key : &child_low,
+                i + 1 == internal->GetSize() ? high_key : &child_high, level + 1, last_at_level);
+    }
+  }
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+/* unlock and unpin all pages */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UnlockUnpinPages(Transaction *transaction, bool is_dirty) {
+  if (transaction == nullptr) {
+    return;
+  }
 
   // unlock 和 unpin 事务经过的所有parent page
   for (Page *page : *transaction->GetPageSet()) {  // 前面加*是因为page set是shared_ptr类型
-
     page->WUnlatch();
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);  // 疑问：此处dirty为false还是true？
-    // 应该是false，此函数只在向下find leaf page时使用，向上进行修改时是手动一步步unpin true，这里是一次性unpin
+    // 向上进行修改时是手动fetch并unpin true，这里是一次性unpin；只有counted的树的计数直接修改page set中的page
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), is_dirty);
   }
   transaction->GetPageSet()->clear();  // 清空page set
 }
 
+/* 写操作结束时释放leaf page、page set中的祖先结点以及root_latch_ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReleaseWriteLatches(Page *leaf_page, bool is_dirty, Transaction *transaction,
+                                         bool root_is_latched) {
+  if (root_is_latched) {
+    root_latch_.unlock();
+  }
+  leaf_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), is_dirty);
+  // counted的树写成功时修改了路径上所有祖先的计数
+  UnlockUnpinPages(transaction, is_dirty && counted_);
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
 bool BPLUSTREE_TYPE::IsSafe(N *node, Operation op) {
   // 该函数用于确定执行各种操作是否安全，所谓安全是指是否可以直接进行插入、删除等操作而不用进行分裂、合并
-  if (node->IsRootPage()) {
-    return (op == Operation::INSERT && node->GetSize() < node->GetMaxSize() - 1) ||
-           (op == Operation::DELETE && node->GetSize() > 2);
-  }
-
   if (op == Operation::INSERT) {
-    // 疑问：maxsize要减1吗？
+    // 插入之后size达到maxsize就会分裂
     return node->GetSize() < node->GetMaxSize() - 1;
   }
 
   if (op == Operation::DELETE) {
-    // 此处逻辑需要和coalesce函数对应
+    if (node->IsRootPage()) {
+      // 根为叶子时删空才需要调整，根为内部结点时只剩一个孩子就需要调整
+      return node->IsLeafPage() ? node->GetSize() > 1 : node->GetSize() > 2;
+    }
+    // 此处逻辑需要和CoalesceOrRedistribute函数对应
     return node->GetSize() > node->GetMinSize();
   }
 
-  // LOG_INFO("IsSafe Thread=%ld", getThreadId());
-
   return true;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost) {
-  // 该函数用于在索引树中找到包含key的叶子节点
+  // 该函数用于在索引树中找到包含key的叶子节点，返回的page持有读锁
   // 如果leftMost为true, 那么就只返回最左边的叶子节点
   return FindLeafPageByOperation(key, Operation::FIND, nullptr, leftMost, false).first;
 }
@@ -664,15 +1909,15 @@ INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
   // 这个Header用来记录元数据
   HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
-  if (insert_record != 0) {
-    // 当insert_record不为0时表示正在建立一个新的索引
-    // create a new record<index_name + root_page_id> in header_page
-    header_page->InsertRecord(index_name_, root_page_id_);
-  } else {
-    //当insert_record为0时表示更新原有索引的root_page_id
+  // header page被所有索引共享，修改时需要加写锁
+  header_page->WLatch();
+  // 当insert_record不为0时表示正在建立一个新的索引，create a new record<index_name + root_page_id> in header_page
+  // 当insert_record为0时表示更新原有索引的root_page_id，树被删空后重建时记录已经存在，同样只需要更新
+  if (insert_record == 0 || !header_page->InsertRecord(index_name_, root_page_id_)) {
     // update root_page_id in header_page
     header_page->UpdateRecord(index_name_, root_page_id_);
   }
+  header_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
 
@@ -681,13 +1926,30 @@ void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
  * Read data from file and insert one by one
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::InsertFromFile(const std::string &file_name, Transaction *transaction) {}
+void BPLUSTREE_TYPE::InsertFromFile(const std::string &file_name, Transaction *transaction) {
+  int64_t key;
+  std::ifstream input(file_name);
+  while (input >> key) {
+    KeyType index_key;
+    index_key.SetFromInteger(key);
+    RID rid(key);
+    Insert(index_key, rid, transaction);
+  }
+}
 /*
  * This method is used for test only
  * Read data from file and remove one by one
  */
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::RemoveFromFile(const std::string &file_name, Transaction *transaction) {}
+void BPLUSTREE_TYPE::RemoveFromFile(const std::string &file_name, Transaction *transaction) {
+  int64_t key;
+  std::ifstream input(file_name);
+  while (input >> key) {
+    KeyType index_key;
+    index_key.SetFromInteger(key);
+    Remove(index_key, transaction);
+  }
+}
 
 /**
  * This method is used for debug only, You don't  need to modify
@@ -818,5 +2080,7 @@ template class BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTree<GenericKey<16>, RID, GenericComparator<16>>;
 template class BPlusTree<GenericKey<32>, RID, GenericComparator<32>>;
 template class BPlusTree<GenericKey<64>, RID, GenericComparator<64>>;
+template class BPlusTree<GenericKey<128>, RID, GenericComparator<128>>;
+template class BPlusTree<GenericKey<256>, RID, GenericComparator<256>>;
 
 }  // namespace bustub
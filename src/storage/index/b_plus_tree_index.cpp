@@ -9,58 +9,265 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <string>
+
+#include "common/exception.h"
 #include "storage/index/b_plus_tree_index.h"
 
 namespace bustub {
+
 /*
  * Constructor
  */
 INDEX_TEMPLATE_ARGUMENTS
-BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager)
+BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager,
+                                     segment_id_t segment_id, bool counted, bool adaptive_hash, size_t filter_keys,
+                                     size_t change_buffer_size)
     : Index(metadata),
-      comparator_(metadata->GetKeySchema()),
-      container_(metadata->GetName(), buffer_pool_manager, comparator_) {}
+      comparator_(metadata->GetKeySchema(), metadata->GetKeyFormat(), !metadata->IsUnique()),
+      // 可压缩的key的节点使用前缀压缩，posting list的leaf也一样，pair数由空间决定；其余的page由fence key的宽度决定
+      container_(metadata->GetName(), buffer_pool_manager, comparator_,
+                 KeyTraits<KeyType, KeyComparator>::HasPostingLists(comparator_)    ? POSTING_LEAF_PAGE_SIZE
+                 : KeyTraits<KeyType, KeyComparator>::IsCompressible(comparator_)
+                     ? COMPRESSED_LEAF_PAGE_SIZE
+                     : LEAF_PAGE_SIZE_FOR((KeyTraits<KeyType, KeyComparator>::GetFenceSize(comparator_))),
+                 KeyTraits<KeyType, KeyComparator>::IsCompressible(comparator_)
+                     ? COMPRESSED_INTERNAL_PAGE_SIZE
+                     : INTERNAL_PAGE_SIZE_FOR((KeyTraits<KeyType, KeyComparator>::GetFenceSize(comparator_))),
+                 // 非唯一索引的ScanKey按key tuple扫描，不查完整key，filter没有用；
+                 // 覆盖索引的key带着included列，和查找用的key tuple字节不同，filter和adaptive hash都按字节哈希
+                 segment_id, false, counted, adaptive_hash && metadata->GetIncludeAttrs().empty(),
+                 metadata->IsUnique() && metadata->GetIncludeAttrs().empty() ? filter_keys : 0) {
+  // normalized格式按整个key的字节比较，included列会参与比较
+  if (!metadata->GetIncludeAttrs().empty() && metadata->GetKeyFormat() != KeyFormat::RAW) {
+    throw Exception(ExceptionType::NOT_IMPLEMENTED, "index " + GetName() + ": included columns need KeyFormat::RAW");
+  }
+  if (change_buffer_size > 0 && !metadata->IsUnique()) {
+    change_buffer_ = std::make_unique<ChangeBuffer<KeyType, KeyComparator>>(
+        comparator_, [this](const auto &changes) { ApplyChanges(changes); }, change_buffer_size);
+  }
+}
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
   // construct insert index key
-  KeyType index_key;
-  index_key.SetFromKey(key);
+  KeyType index_key = MakeKey(key, rid);
 
+  // leaf不在buffer pool中时先记到change buffer里，不去读leaf
+  if (change_buffer_ != nullptr &&
+      change_buffer_->Buffer(index_key, rid, true, container_.IsLeafResident(index_key))) {
+    return;
+  }
   container_.Insert(index_key, rid, transaction);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) {
   // construct delete index key
-  KeyType index_key;
-  index_key.SetFromKey(key);
+  KeyType index_key = MakeKey(key, rid);
 
+  if (change_buffer_ != nullptr &&
+      change_buffer_->Buffer(index_key, rid, false, container_.IsLeafResident(index_key))) {
+    return;
+  }
   container_.Remove(index_key, transaction);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) {
-  // construct scan index key
+  if (GetMetadata()->IsUnique()) {
+    // construct scan index key
+    KeyType index_key = MakeKey(key);
+
+    container_.GetValue(index_key, result, transaction);
+    return;
+  }
+  // 从第一个entry开始扫描，直到key tuple不同
+  KeyType lo_key = MakeKey(key, MIN_RID);
+  KeyType hi_key = MakeKey(key, MAX_RID);
+  MergeChanges(lo_key, hi_key);
+  for (auto iterator = container_.Begin(lo_key); !iterator.isEnd(); ++iterator) {
+    const auto &[index_key, rid] = *iterator;
+    if (comparator_(index_key, hi_key) > 0) {
+      break;
+    }
+    result->push_back(rid);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ScanRange(const Tuple &lo, const Tuple &hi, std::vector<RID> *result,
+                                     Transaction *transaction) {
+  // construct range scan index keys, before all entries of lo and hi
+  KeyType lo_key = MakeKey(lo, MIN_RID);
+  KeyType hi_key = MakeKey(hi, MIN_RID);
+  MergeChanges(lo_key, hi_key);
+
+  container_.ScanRange(lo_key, hi_key, result, transaction);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ScanEntries(const Tuple &key, std::vector<std::pair<Tuple, RID>> *result,
+                                       Transaction *transaction) {
+  // 唯一索引的lo和hi是同一个key
+  KeyType lo_key = MakeKey(key, MIN_RID);
+  KeyType hi_key = MakeKey(key, MAX_RID);
+  MergeChanges(lo_key, hi_key);
+  for (auto iterator = container_.Begin(lo_key); !iterator.isEnd(); ++iterator) {
+    const auto &[index_key, rid] = *iterator;
+    if (comparator_(index_key, hi_key) > 0) {
+      break;
+    }
+    result->emplace_back(index_key.ToKey(GetMetadata()->GetEntrySchema(), comparator_.GetKeyFormat()), rid);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ParallelScanRange(const Tuple &lo, const Tuple &hi, size_t parts, std::vector<RID> *result) {
+  KeyType lo_key = MakeKey(lo, MIN_RID);
+  KeyType hi_key = MakeKey(hi, MIN_RID);
+  MergeChanges(lo_key, hi_key);
+
+  container_.ParallelScanRange(lo_key, hi_key, parts, result);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_INDEX_TYPE::BulkLoad(const std::vector<std::pair<Tuple, RID>> &entries, double fill_factor) {
+  MergeChanges();
+  // construct index keys, then sort them
+  std::vector<MappingType> pairs;
+  pairs.reserve(entries.size());
+  for (const auto &[key, rid] : entries) {
+    pairs.emplace_back(MakeKey(key, rid), rid);
+  }
+  std::sort(pairs.begin(), pairs.end(),
+            [this](const MappingType &lhs, const MappingType &rhs) { return comparator_(lhs.first, rhs.first) < 0; });
+
+  return container_.BulkLoad(pairs, fill_factor);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_INDEX_TYPE::RebuildFrom(BPlusTreeIndex *source, double fill_factor) {
+  // 按source的格式还原出key tuple，再按本索引的格式重新编码、批量构建
+  std::vector<std::pair<Tuple, RID>> entries;
+  for (auto iterator = source->GetBeginIterator(); !iterator.isEnd(); ++iterator) {
+    const auto &[key, rid] = *iterator;
+    entries.emplace_back(key.ToKey(source->GetKeySchema(), source->comparator_.GetKeyFormat()), rid);
+  }
+  return BulkLoad(entries, fill_factor);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType BPLUSTREE_INDEX_TYPE::MakeKey(const Tuple &key) const {
   KeyType index_key;
-  index_key.SetFromKey(key);
+  // 截断的key会和其他key混淆，raw格式的varchar还会指向key之外，不能放进索引
+  if (!index_key.SetFromKey(key, GetKeySchema(), comparator_.GetKeyFormat())) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "index " + GetName() + ": key does not fit into the index key");
+  }
+  return index_key;
+}
 
-  container_.GetValue(index_key, result, transaction);
+INDEX_TEMPLATE_ARGUMENTS
+KeyType BPLUSTREE_INDEX_TYPE::MakeKey(const Tuple &key, const RID &rid) const {
+  if (GetMetadata()->IsUnique()) {
+    return MakeKey(key);
+  }
+  KeyType index_key;
+  if (!index_key.SetFromKey(key, GetKeySchema(), comparator_.GetKeyFormat(), rid)) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "index " + GetName() + ": key and rid do not fit into the index key");
+  }
+  return index_key;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator() { return container_.begin(); }
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator() {
+  MergeChanges();
+  return container_.begin();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator(const KeyType &key) {
+  MergeChanges();
+  return container_.Begin(key);
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator(const KeyType &key) { return container_.Begin(key); }
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator(const KeyType &lo, const KeyType &hi) {
+  MergeChanges(lo, hi);
+  return container_.Begin(lo, hi);
+}
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetEndIterator() { return container_.end(); }
 
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetReverseBeginIterator() {
+  MergeChanges();
+  return container_.RBegin();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetReverseBeginIterator(const KeyType &key) {
+  MergeChanges();
+  return container_.RBegin(key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_INDEX_TYPE::CountRange(const Tuple &lo, const Tuple &hi) {
+  KeyType lo_key = MakeKey(lo, MIN_RID);
+  KeyType hi_key = MakeKey(hi, MIN_RID);
+  MergeChanges(lo_key, hi_key);
+  return container_.CountRange(lo_key, hi_key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_INDEX_TYPE::GetCount() {
+  MergeChanges();
+  return container_.GetCount();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::SeekToRank(size_t rank) {
+  MergeChanges();
+  return container_.SeekToRank(rank);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::MergeChanges(const KeyType &lo, const KeyType &hi) {
+  if (change_buffer_ != nullptr) {
+    change_buffer_->Merge(lo, hi);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::MergeChanges() {
+  if (change_buffer_ != nullptr) {
+    change_buffer_->Merge();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ApplyChanges(
+    const std::vector<typename ChangeBuffer<KeyType, KeyComparator>::Change> &changes) {
+  // 每个key只有一个change，delete和insert的先后没有关系
+  std::vector<MappingType> pairs;
+  for (const auto &change : changes) {
+    if (change.insert_) {
+      pairs.emplace_back(change.key_, change.rid_);
+    } else {
+      container_.Remove(change.key_);
+    }
+  }
+  container_.InsertBatch(pairs);
+}
+
 template class BPlusTreeIndex<GenericKey<4>, RID, GenericComparator<4>>;
 template class BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTreeIndex<GenericKey<16>, RID, GenericComparator<16>>;
 template class BPlusTreeIndex<GenericKey<32>, RID, GenericComparator<32>>;
 template class BPlusTreeIndex<GenericKey<64>, RID, GenericComparator<64>>;
+template class BPlusTreeIndex<GenericKey<128>, RID, GenericComparator<128>>;
+template class BPlusTreeIndex<GenericKey<256>, RID, GenericComparator<256>>;
 
 }  // namespace bustub
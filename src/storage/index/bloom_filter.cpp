@@ -0,0 +1,108 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// bloom_filter.cpp
+//
+// Identification: src/storage/index/bloom_filter.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/bloom_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string_view>
+
+#include "storage/index/generic_key.h"
+
+namespace bustub {
+
+template <typename KeyType>
+BloomFilter<KeyType>::BloomFilter(size_t expected_keys)
+    : num_blocks_(std::max<size_t>((std::max<size_t>(expected_keys, 1) * BITS_PER_KEY + BLOCK_BITS - 1) / BLOCK_BITS,
+                                   1)),
+      words_(new std::atomic<uint64_t>[num_blocks_ * WORDS_PER_BLOCK]) {
+  for (size_t i = 0; i < num_blocks_ * WORDS_PER_BLOCK; i++) {
+    words_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+template <typename KeyType>
+uint64_t BloomFilter<KeyType>::Hash(const KeyType &key) {
+  uint64_t hash =
+      std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char *>(&key), sizeof(KeyType)));
+  // 再混合一次，std::hash的低位和高位都要用到
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/*
+ * 高32位选block，低32位按double hashing生成block内的NUM_PROBES个bit
+ */
+template <typename KeyType>
+void BloomFilter<KeyType>::Insert(const KeyType &key) {
+  uint64_t hash = Hash(key);
+  std::atomic<uint64_t> *block = &words_[((hash >> 32) % num_blocks_) * WORDS_PER_BLOCK];
+  auto h1 = static_cast<uint32_t>(hash);
+  uint32_t h2 = (h1 >> 17) | (h1 << 15) | 1;
+  for (int i = 0; i < NUM_PROBES; i++) {
+    uint32_t bit = (h1 + i * h2) % BLOCK_BITS;
+    // release：看到这个bit的lookup也能看到之前的写
+    block[bit / 64].fetch_or(uint64_t{1} << (bit % 64), std::memory_order_release);
+  }
+}
+
+template <typename KeyType>
+bool BloomFilter<KeyType>::MayContain(const KeyType &key) {
+  uint64_t hash = Hash(key);
+  const std::atomic<uint64_t> *block = &words_[((hash >> 32) % num_blocks_) * WORDS_PER_BLOCK];
+  auto h1 = static_cast<uint32_t>(hash);
+  uint32_t h2 = (h1 >> 17) | (h1 << 15) | 1;
+  for (int i = 0; i < NUM_PROBES; i++) {
+    uint32_t bit = (h1 + i * h2) % BLOCK_BITS;
+    if ((block[bit / 64].load(std::memory_order_acquire) & (uint64_t{1} << (bit % 64))) == 0) {
+      negatives_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename KeyType>
+double BloomFilter<KeyType>::GetFalsePositiveRate() const {
+  size_t false_positives = GetFalsePositives();
+  size_t absent = false_positives + GetNegatives();
+  return absent == 0 ? 0.0 : static_cast<double>(false_positives) / static_cast<double>(absent);
+}
+
+/*
+ * 一个不存在的key通过过滤的概率约为它的block中bit被置位的比例的NUM_PROBES次方，按block取平均
+ */
+template <typename KeyType>
+double BloomFilter<KeyType>::EstimateFalsePositiveRate() const {
+  double rate = 0;
+  for (size_t block = 0; block < num_blocks_; block++) {
+    int bits = 0;
+    for (uint32_t word = 0; word < WORDS_PER_BLOCK; word++) {
+      bits += __builtin_popcountll(words_[block * WORDS_PER_BLOCK + word].load(std::memory_order_relaxed));
+    }
+    rate += std::pow(static_cast<double>(bits) / BLOCK_BITS, NUM_PROBES);
+  }
+  return rate / static_cast<double>(num_blocks_);
+}
+
+template class BloomFilter<GenericKey<4>>;
+template class BloomFilter<GenericKey<8>>;
+template class BloomFilter<GenericKey<16>>;
+template class BloomFilter<GenericKey<32>>;
+template class BloomFilter<GenericKey<64>>;
+template class BloomFilter<GenericKey<128>>;
+template class BloomFilter<GenericKey<256>>;
+
+}  // namespace bustub
@@ -0,0 +1,127 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// change_buffer.cpp
+//
+// Identification: src/storage/index/change_buffer.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/change_buffer.h"
+
+#include <utility>
+
+#include "storage/index/generic_key.h"
+
+namespace bustub {
+
+template <typename KeyType, typename KeyComparator>
+ChangeBuffer<KeyType, KeyComparator>::ChangeBuffer(const KeyComparator &comparator, ApplyFunction apply,
+                                                   size_t merge_threshold)
+    : comparator_(comparator),
+      apply_(std::move(apply)),
+      merge_threshold_(merge_threshold),
+      changes_(KeyLess{&comparator_}) {
+  background_thread_ = std::thread(&ChangeBuffer::BackgroundMerge, this);
+}
+
+template <typename KeyType, typename KeyComparator>
+ChangeBuffer<KeyType, KeyComparator>::~ChangeBuffer() {
+  {
+    std::scoped_lock lock{latch_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  background_thread_.join();
+  Merge();
+}
+
+template <typename KeyType, typename KeyComparator>
+bool ChangeBuffer<KeyType, KeyComparator>::Buffer(const KeyType &key, const RID &rid, bool insert,
+                                                  bool leaf_resident) {
+  std::scoped_lock lock{latch_};
+  auto it = changes_.find(key);
+  if (it == changes_.end()) {
+    if (leaf_resident) {
+      return false;
+    }
+    changes_.emplace(key, Change{key, rid, insert});
+  } else {
+    // 新的change决定entry在不在索引中，替换旧的
+    it->second = Change{key, rid, insert};
+  }
+  buffered_.fetch_add(1, std::memory_order_relaxed);
+  if (changes_.size() == merge_threshold_) {
+    cv_.notify_all();
+  }
+  return true;
+}
+
+template <typename KeyType, typename KeyComparator>
+void ChangeBuffer<KeyType, KeyComparator>::Merge(const KeyType &lo, const KeyType &hi) {
+  std::scoped_lock lock{latch_};
+  MergeLocked(changes_.lower_bound(lo), changes_.upper_bound(hi));
+}
+
+template <typename KeyType, typename KeyComparator>
+void ChangeBuffer<KeyType, KeyComparator>::Merge() {
+  std::scoped_lock lock{latch_};
+  MergeLocked(changes_.begin(), changes_.end());
+}
+
+template <typename KeyType, typename KeyComparator>
+size_t ChangeBuffer<KeyType, KeyComparator>::GetSize() {
+  std::scoped_lock lock{latch_};
+  return changes_.size();
+}
+
+template <typename KeyType, typename KeyComparator>
+void ChangeBuffer<KeyType, KeyComparator>::MergeLocked(typename std::map<KeyType, Change, KeyLess>::iterator first,
+                                                       typename std::map<KeyType, Change, KeyLess>::iterator last) {
+  if (first == last) {
+    return;
+  }
+  std::vector<Change> changes;
+  for (auto it = first; it != last; ++it) {
+    changes.push_back(it->second);
+  }
+  // 持有latch时应用，同一个key的新change要等这次合并结束才能buffer或者直接写入
+  apply_(changes);
+  changes_.erase(first, last);
+  merged_.fetch_add(changes.size(), std::memory_order_relaxed);
+}
+
+template <typename KeyType, typename KeyComparator>
+void ChangeBuffer<KeyType, KeyComparator>::BackgroundMerge() {
+  std::unique_lock lock{latch_};
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || changes_.size() >= merge_threshold_; });
+    if (stop_) {
+      return;
+    }
+    // 按key顺序分批合并，批之间释放latch让写者继续buffer
+    while (!stop_ && !changes_.empty()) {
+      auto last = changes_.begin();
+      for (size_t i = 0; i < MERGE_BATCH && last != changes_.end(); i++) {
+        ++last;
+      }
+      MergeLocked(changes_.begin(), last);
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+    }
+  }
+}
+
+template class ChangeBuffer<GenericKey<4>, GenericComparator<4>>;
+template class ChangeBuffer<GenericKey<8>, GenericComparator<8>>;
+template class ChangeBuffer<GenericKey<16>, GenericComparator<16>>;
+template class ChangeBuffer<GenericKey<32>, GenericComparator<32>>;
+template class ChangeBuffer<GenericKey<64>, GenericComparator<64>>;
+template class ChangeBuffer<GenericKey<128>, GenericComparator<128>>;
+template class ChangeBuffer<GenericKey<256>, GenericComparator<256>>;
+
+}  // namespace bustub
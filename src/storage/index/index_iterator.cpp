@@ -2,29 +2,236 @@
  * index_iterator.cpp
  */
 #include <cassert>
+#include <utility>
 
+#include "common/exception.h"
 #include "storage/index/index_iterator.h"
 
 namespace bustub {
 
-/*
- * NOTE: you can change the destructor/constructor method here
- * set your own input parameters
- */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator() = default;
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::~IndexIterator() = default;
+INDEXITERATOR_TYPE::IndexIterator(BufferPoolManager *buffer_pool_manager, Page *page, int index,
+                                  const KeyComparator *comparator, std::function<Page *(const KeyType &)> find_leaf,
+                                  bool reverse)
+    : buffer_pool_manager_(buffer_pool_manager),
+      page_(page),
+      leaf_(reinterpret_cast<LeafPage *>(page->GetData())),
+      page_id_(page->GetPageId()),
+      index_(index),
+      comparator_(comparator),
+      reverse_(reverse),
+      find_leaf_(std::move(find_leaf)) {
+  if (reverse_) {
+    SettleReverse();
+  } else {
+    Settle();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(BufferPoolManager *buffer_pool_manager, Page *page, int index,
+                                  const KeyComparator *comparator, std::function<Page *(const KeyType &)> find_leaf,
+                                  const KeyType &high_key)
+    : buffer_pool_manager_(buffer_pool_manager),
+      page_(page),
+      leaf_(reinterpret_cast<LeafPage *>(page->GetData())),
+      page_id_(page->GetPageId()),
+      index_(index),
+      comparator_(comparator),
+      find_leaf_(std::move(find_leaf)),
+      bounded_(true),
+      high_key_(high_key) {
+  Settle();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::~IndexIterator() { Release(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(IndexIterator &&other) noexcept
+    : buffer_pool_manager_(other.buffer_pool_manager_),
+      page_(other.page_),
+      leaf_(other.leaf_),
+      page_id_(other.page_id_),
+      index_(other.index_),
+      comparator_(other.comparator_),
+      reverse_(other.reverse_),
+      find_leaf_(std::move(other.find_leaf_)),
+      bounded_(other.bounded_),
+      high_key_(other.high_key_),
+      item_(other.item_),
+      posting_list_(std::move(other.posting_list_)),
+      posting_list_begin_(other.posting_list_begin_) {
+  other.page_ = nullptr;
+  other.leaf_ = nullptr;
+  other.page_id_ = INVALID_PAGE_ID;
+  other.index_ = 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator=(IndexIterator &&other) noexcept {
+  if (this != &other) {
+    Release();
+    buffer_pool_manager_ = other.buffer_pool_manager_;
+    page_ = std::exchange(other.page_, nullptr);
+    leaf_ = std::exchange(other.leaf_, nullptr);
+    page_id_ = std::exchange(other.page_id_, INVALID_PAGE_ID);
+    index_ = std::exchange(other.index_, 0);
+    comparator_ = other.comparator_;
+    reverse_ = other.reverse_;
+    find_leaf_ = std::move(other.find_leaf_);
+    bounded_ = other.bounded_;
+    high_key_ = other.high_key_;
+    item_ = other.item_;
+    posting_list_ = std::move(other.posting_list_);
+    posting_list_begin_ = other.posting_list_begin_;
+  }
+  return *this;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool INDEXITERATOR_TYPE::isEnd() { return page_ == nullptr; }
 
 INDEX_TEMPLATE_ARGUMENTS
-bool INDEXITERATOR_TYPE::isEnd() { throw std::runtime_error("unimplemented"); }
+const MappingType &INDEXITERATOR_TYPE::operator*() {
+  assert(!isEnd());
+  return Load();
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &INDEXITERATOR_TYPE::operator*() { throw std::runtime_error("unimplemented"); }
+INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++() {
+  assert(!isEnd());
+  if (reverse_) {
+    index_--;
+    SettleReverse();
+    return *this;
+  }
+  index_++;
+  Settle();
+  return *this;
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++() { throw std::runtime_error("unimplemented"); }
+void INDEXITERATOR_TYPE::Settle() {
+  // 当前leaf已经遍历完，先释放当前leaf，再去fetch下一个leaf，任何时候只持有一个leaf
+  while (page_ != nullptr && index_ >= leaf_->GetSize()) {
+    page_id_t next_page_id = leaf_->GetNextPageId();
+    if (next_page_id == INVALID_PAGE_ID) {
+      Release();
+      return;
+    }
+    bool has_high_key = leaf_->HasHighKey();
+    KeyType high_key = has_high_key ? leaf_->GetHighKey() : KeyType{};
+    Release();
+    Page *next_page = buffer_pool_manager_->FetchPage(next_page_id);
+    if (next_page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "IndexIterator: cannot fetch next leaf");
+    }
+    next_page->RLatch();
+    Enter(next_page);
+    // 只有下界等于high_key的leaf紧挨在high_key之后。后继可能合并到了刚离开的leaf中并被删除(删除的leaf没有fence key)，
+    // 也可能和刚离开的leaf重新分配了entry，这时从root重新下降到high_key所在的leaf
+    if (has_high_key &&
+        (!leaf_->IsLeafPage() || !leaf_->HasLowKey() || (*comparator_)(leaf_->GetLowKey(), high_key) != 0)) {
+      Release();
+      Page *page = find_leaf_(high_key);
+      if (page == nullptr) {
+        return;
+      }
+      Enter(page);
+      index_ = leaf_->KeyIndex(high_key, *comparator_);
+    }
+  }
+  // 超出上界[lo, hi)，提前释放leaf
+  if (page_ != nullptr && bounded_ && (*comparator_)(Load().first, high_key_) >= 0) {
+    Release();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SettleReverse() {
+  while (page_ != nullptr && index_ < 0) {
+    // 最左边的leaf没有下界；先释放当前leaf再锁前驱，任何时候只持有一个leaf
+    if (!leaf_->HasLowKey() || leaf_->GetPrevPageId() == INVALID_PAGE_ID) {
+      Release();
+      return;
+    }
+    KeyType low_key = leaf_->GetLowKey();
+    page_id_t prev_page_id = leaf_->GetPrevPageId();
+    Release();
+    Page *prev_page = buffer_pool_manager_->FetchPage(prev_page_id);
+    if (prev_page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "IndexIterator: cannot fetch previous leaf");
+    }
+    prev_page->RLatch();
+    Enter(prev_page);
+    // 释放锁期间前驱可能分裂了，low_key之前的key在它右边的新节点中：向右移动，先锁右边的节点再释放当前节点
+    while (leaf_->IsLeafPage() && leaf_->HasHighKey() && leaf_->GetNextPageId() != INVALID_PAGE_ID &&
+           (*comparator_)(leaf_->GetHighKey(), low_key) < 0) {
+      Page *next_page = buffer_pool_manager_->FetchPage(leaf_->GetNextPageId());
+      if (next_page == nullptr) {
+        Release();
+        throw Exception(ExceptionType::OUT_OF_MEMORY, "IndexIterator: cannot fetch next leaf");
+      }
+      next_page->RLatch();
+      Release();
+      Enter(next_page);
+    }
+    // 只有上界等于low_key的leaf紧挨在low_key之前。前驱可能合并到了它左边的兄弟中并被删除(删除的leaf没有fence key)，
+    // 也可能合并了刚离开的leaf，这时从root重新下降到low_key所在的leaf
+    if (!leaf_->IsLeafPage() || !leaf_->HasHighKey() || (*comparator_)(leaf_->GetHighKey(), low_key) != 0) {
+      Release();
+      Page *page = find_leaf_(low_key);
+      if (page == nullptr) {
+        return;
+      }
+      Enter(page);
+    }
+    // 从low_key之前的最后一个entry继续；leaf中没有这样的entry时继续向左
+    index_ = leaf_->KeyIndex(low_key, *comparator_) - 1;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Enter(Page *page) {
+  page_ = page;
+  leaf_ = reinterpret_cast<LeafPage *>(page->GetData());
+  page_id_ = page->GetPageId();
+  index_ = 0;
+  posting_list_.clear();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Release() {
+  if (page_ == nullptr) {
+    return;
+  }
+  page_->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id_, false);
+  page_ = nullptr;
+  leaf_ = nullptr;
+  page_id_ = INVALID_PAGE_ID;
+  index_ = 0;
+  posting_list_.clear();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+const MappingType &INDEXITERATOR_TYPE::Load() {
+  // 前缀压缩的leaf没有完整的pair，解码到迭代器中；posting list一次解码整个list
+  if (!leaf_->IsPostingList()) {
+    item_ = leaf_->GetItem(index_);
+    return item_;
+  }
+  int position = index_ - posting_list_begin_;
+  if (position < 0 || position >= static_cast<int>(posting_list_.size())) {
+    posting_list_begin_ = leaf_->DecodePostingList(index_, &posting_list_);
+    position = index_ - posting_list_begin_;
+  }
+  return posting_list_[position];
+}
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
 
@@ -36,4 +243,8 @@ template class IndexIterator<GenericKey<32>, RID, GenericComparator<32>>;
 
 template class IndexIterator<GenericKey<64>, RID, GenericComparator<64>>;
 
+template class IndexIterator<GenericKey<128>, RID, GenericComparator<128>>;
+
+template class IndexIterator<GenericKey<256>, RID, GenericComparator<256>>;
+
 }  // namespace bustub
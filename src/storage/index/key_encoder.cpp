@@ -0,0 +1,280 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// key_encoder.cpp
+//
+// Identification: src/storage/index/key_encoder.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/key_encoder.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/exception.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+constexpr uint8_t NULL_MARKER = 0x00;
+constexpr uint8_t VALUE_MARKER = 0x01;
+constexpr uint8_t ESCAPE = 0xFF;
+
+/** Appends bytes to a fixed size buffer, remembers whether anything was cut off. */
+class KeyWriter {
+ public:
+  KeyWriter(char *dst, size_t size) : dst_(dst), size_(size) {}
+
+  void Put(uint8_t byte) {
+    if (pos_ < size_) {
+      dst_[pos_++] = static_cast<char>(byte);
+    } else {
+      truncated_ = true;
+    }
+  }
+
+  // 大端写入，保证按字节比较的顺序与数值顺序一致
+  void PutBigEndian(uint64_t bits, size_t width) {
+    for (size_t i = width; i > 0; i--) {
+      Put(static_cast<uint8_t>(bits >> (8 * (i - 1))));
+    }
+  }
+
+  size_t Size() const { return pos_; }
+
+  bool Finish() {
+    memset(dst_ + pos_, 0, size_ - pos_);
+    return !truncated_;
+  }
+
+ private:
+  char *dst_;
+  size_t size_;
+  size_t pos_{0};
+  bool truncated_{false};
+};
+
+/** Reads what KeyWriter wrote. */
+class KeyReader {
+ public:
+  KeyReader(const char *src, size_t size) : src_(src), size_(size) {}
+
+  bool Get(uint8_t *byte) {
+    if (pos_ >= size_) {
+      return false;
+    }
+    *byte = static_cast<uint8_t>(src_[pos_++]);
+    return true;
+  }
+
+  bool GetBigEndian(size_t width, uint64_t *bits) {
+    *bits = 0;
+    for (size_t i = 0; i < width; i++) {
+      uint8_t byte;
+      if (!Get(&byte)) {
+        return false;
+      }
+      *bits = (*bits << 8) | byte;
+    }
+    return true;
+  }
+
+ private:
+  const char *src_;
+  size_t size_;
+  size_t pos_{0};
+};
+
+/** @return the bytes of a signed integer of width bytes with the sign bit flipped */
+uint64_t FlipSign(int64_t value, size_t width) {
+  uint64_t sign = uint64_t{1} << (8 * width - 1);
+  uint64_t mask = width == 8 ? ~uint64_t{0} : (uint64_t{1} << (8 * width)) - 1;
+  return (static_cast<uint64_t>(value) & mask) ^ sign;
+}
+
+/** Inverse of FlipSign. */
+int64_t UnflipSign(uint64_t bits, size_t width) {
+  uint64_t sign = uint64_t{1} << (8 * width - 1);
+  bits ^= sign;
+  // 符号扩展
+  if ((bits & sign) != 0 && width < 8) {
+    bits |= ~((uint64_t{1} << (8 * width)) - 1);
+  }
+  return static_cast<int64_t>(bits);
+}
+
+size_t IntegerWidth(TypeId type) {
+  switch (type) {
+    case TypeId::BOOLEAN:
+    case TypeId::TINYINT:
+      return 1;
+    case TypeId::SMALLINT:
+      return 2;
+    case TypeId::INTEGER:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+}  // namespace
+
+bool KeyEncoder::Encode(const Tuple &key, const Schema *key_schema, char *dst, size_t size, size_t *length) {
+  KeyWriter writer(dst, size);
+  for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+    Value value = key.GetValue(key_schema, i);
+    if (value.IsNull()) {
+      writer.Put(NULL_MARKER);
+      continue;
+    }
+    writer.Put(VALUE_MARKER);
+    TypeId type = value.GetTypeId();
+    switch (type) {
+      case TypeId::BOOLEAN:
+        writer.Put(static_cast<uint8_t>(value.GetAs<int8_t>()));
+        break;
+      case TypeId::TINYINT:
+        writer.PutBigEndian(FlipSign(value.GetAs<int8_t>(), 1), 1);
+        break;
+      case TypeId::SMALLINT:
+        writer.PutBigEndian(FlipSign(value.GetAs<int16_t>(), 2), 2);
+        break;
+      case TypeId::INTEGER:
+        writer.PutBigEndian(FlipSign(value.GetAs<int32_t>(), 4), 4);
+        break;
+      case TypeId::BIGINT:
+        writer.PutBigEndian(FlipSign(value.GetAs<int64_t>(), 8), 8);
+        break;
+      case TypeId::TIMESTAMP:
+        writer.PutBigEndian(value.GetAs<uint64_t>(), 8);
+        break;
+      case TypeId::DECIMAL: {
+        // -0.0与0.0相等，统一编码为0.0
+        double d = value.GetAs<double>() == 0 ? 0.0 : value.GetAs<double>();
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        bits = (bits >> 63) != 0 ? ~bits : bits ^ (uint64_t{1} << 63);
+        writer.PutBigEndian(bits, 8);
+        break;
+      }
+      case TypeId::VARCHAR: {
+        const char *data = value.GetData();
+        uint32_t len = value.GetLength();
+        // varchar的长度包含结尾的'\0'
+        if (len > 0 && data[len - 1] == '\0') {
+          len--;
+        }
+        for (uint32_t j = 0; j < len; j++) {
+          auto byte = static_cast<uint8_t>(data[j]);
+          writer.Put(byte);
+          if (byte == 0) {
+            writer.Put(ESCAPE);
+          }
+        }
+        writer.Put(0);
+        writer.Put(0);
+        break;
+      }
+      default:
+        throw Exception(ExceptionType::UNKNOWN_TYPE, "KeyEncoder: cannot encode key column type");
+    }
+  }
+  if (length != nullptr) {
+    *length = writer.Size();
+  }
+  return writer.Finish();
+}
+
+bool KeyEncoder::Decode(const char *src, size_t size, const Schema *key_schema, Tuple *key) {
+  KeyReader reader(src, size);
+  std::vector<Value> values;
+  for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+    TypeId type = key_schema->GetColumn(i).GetType();
+    uint8_t marker;
+    if (!reader.Get(&marker)) {
+      return false;
+    }
+    if (marker == NULL_MARKER) {
+      values.push_back(type == TypeId::TIMESTAMP ? Value(type, BUSTUB_TIMESTAMP_NULL)
+                                                 : ValueFactory::GetNullValueByType(type));
+      continue;
+    }
+    uint64_t bits;
+    switch (type) {
+      case TypeId::BOOLEAN:
+      case TypeId::TINYINT:
+      case TypeId::SMALLINT:
+      case TypeId::INTEGER:
+      case TypeId::BIGINT: {
+        size_t width = IntegerWidth(type);
+        if (!reader.GetBigEndian(width, &bits)) {
+          return false;
+        }
+        int64_t v = type == TypeId::BOOLEAN ? static_cast<int64_t>(bits) : UnflipSign(bits, width);
+        if (width == 1) {
+          values.emplace_back(type, static_cast<int8_t>(v));
+        } else if (width == 2) {
+          values.emplace_back(type, static_cast<int16_t>(v));
+        } else if (width == 4) {
+          values.emplace_back(type, static_cast<int32_t>(v));
+        } else {
+          values.emplace_back(type, v);
+        }
+        break;
+      }
+      case TypeId::TIMESTAMP:
+        if (!reader.GetBigEndian(8, &bits)) {
+          return false;
+        }
+        values.emplace_back(type, bits);
+        break;
+      case TypeId::DECIMAL: {
+        if (!reader.GetBigEndian(8, &bits)) {
+          return false;
+        }
+        bits = (bits >> 63) != 0 ? bits ^ (uint64_t{1} << 63) : ~bits;
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        values.emplace_back(type, d);
+        break;
+      }
+      case TypeId::VARCHAR: {
+        std::string str;
+        while (true) {
+          uint8_t byte;
+          if (!reader.Get(&byte)) {
+            return false;
+          }
+          if (byte != 0) {
+            str.push_back(static_cast<char>(byte));
+            continue;
+          }
+          // 0x00 0xFF是转义的'\0'，0x00 0x00是结尾
+          uint8_t next;
+          if (!reader.Get(&next)) {
+            return false;
+          }
+          if (next == 0) {
+            break;
+          }
+          str.push_back('\0');
+        }
+        values.emplace_back(ValueFactory::GetVarcharValue(str));
+        break;
+      }
+      default:
+        throw Exception(ExceptionType::UNKNOWN_TYPE, "KeyEncoder: cannot decode key column type");
+    }
+  }
+  *key = Tuple(values, key_schema);
+  return true;
+}
+
+}  // namespace bustub
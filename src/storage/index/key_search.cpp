@@ -0,0 +1,129 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// key_search.cpp
+//
+// Identification: src/storage/index/key_search.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/key_search.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "common/macros.h"
+
+namespace bustub {
+
+namespace {
+
+template <typename T>
+inline int64_t Load(const char *data) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+/** @return number of keys of the window at keys that are < key, resp. <= key */
+template <typename T>
+inline int CountWindow(const char *keys, size_t stride, int64_t key, bool upper) {
+#ifdef __AVX2__
+  // gather的下标是字节偏移，scale为1
+  auto s = static_cast<int>(stride);
+  if constexpr (std::is_same_v<T, int64_t>) {
+    __m128i lo_index = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+    __m128i hi_index = _mm_add_epi32(lo_index, _mm_set1_epi32(4 * s));
+    const auto *base = reinterpret_cast<const long long *>(keys);  // NOLINT
+    __m256i lo = _mm256_i32gather_epi64(base, lo_index, 1);
+    __m256i hi = _mm256_i32gather_epi64(base, hi_index, 1);
+    __m256i target = _mm256_set1_epi64x(key);
+    // lower bound数k < key，即key > k；upper bound数k <= key，即!(k > key)
+    __m256i lo_cmp = upper ? _mm256_cmpgt_epi64(lo, target) : _mm256_cmpgt_epi64(target, lo);
+    __m256i hi_cmp = upper ? _mm256_cmpgt_epi64(hi, target) : _mm256_cmpgt_epi64(target, hi);
+    int bits = _mm256_movemask_pd(_mm256_castsi256_pd(lo_cmp)) | (_mm256_movemask_pd(_mm256_castsi256_pd(hi_cmp)) << 4);
+    int n = __builtin_popcount(bits);
+    return upper ? IntegerKeySearch::WINDOW - n : n;
+  }
+  if constexpr (std::is_same_v<T, int32_t>) {
+    __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(s));
+    __m256i k = _mm256_i32gather_epi32(reinterpret_cast<const int *>(keys), index, 1);
+    __m256i target = _mm256_set1_epi32(static_cast<int32_t>(key));
+    __m256i cmp = upper ? _mm256_cmpgt_epi32(k, target) : _mm256_cmpgt_epi32(target, k);
+    int n = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(cmp)));
+    return upper ? IntegerKeySearch::WINDOW - n : n;
+  }
+#endif
+  int n = 0;
+  for (int i = 0; i < IntegerKeySearch::WINDOW; i++) {
+    int64_t k = Load<T>(keys + i * stride);
+    n += static_cast<int>(upper ? k <= key : k < key);
+  }
+  return n;
+}
+
+template <typename T>
+int RankImpl(const char *keys, size_t stride, int count, int64_t key, bool upper) {
+  if (count < IntegerKeySearch::WINDOW) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+      int64_t k = Load<T>(keys + i * stride);
+      n += static_cast<int>(upper ? k <= key : k < key);
+    }
+    return n;
+  }
+  // 不变式：结果位于[base, base + n]，比较结果只决定base是否右移，编译为cmov
+  int base = 0;
+  int n = count;
+  while (n > IntegerKeySearch::WINDOW) {
+    int half = n / 2;
+    int64_t k = Load<T>(keys + (base + half) * stride);
+    bool right = upper ? k <= key : k < key;
+    base = right ? base + half : base;
+    n -= half;
+  }
+  // 窗口固定为WINDOW个key，靠近末尾时左移窗口，窗口左侧多出的key都满足条件，计数仍然正确
+  int start = std::min(base, count - IntegerKeySearch::WINDOW);
+  return start + CountWindow<T>(keys + start * stride, stride, key, upper);
+}
+
+}  // namespace
+
+int IntegerKeySearch::Rank(const char *keys, size_t stride, int count, int64_t key, TypeId type, bool upper) {
+  switch (type) {
+    case TypeId::TINYINT:
+      return RankImpl<int8_t>(keys, stride, count, key, upper);
+    case TypeId::SMALLINT:
+      return RankImpl<int16_t>(keys, stride, count, key, upper);
+    case TypeId::INTEGER:
+      return RankImpl<int32_t>(keys, stride, count, key, upper);
+    case TypeId::BIGINT:
+      return RankImpl<int64_t>(keys, stride, count, key, upper);
+    default:
+      UNREACHABLE("IntegerKeySearch: not an integer key type");
+  }
+}
+
+int64_t IntegerKeySearch::ToInteger(const char *data, TypeId type) {
+  switch (type) {
+    case TypeId::TINYINT:
+      return Load<int8_t>(data);
+    case TypeId::SMALLINT:
+      return Load<int16_t>(data);
+    case TypeId::INTEGER:
+      return Load<int32_t>(data);
+    case TypeId::BIGINT:
+      return Load<int64_t>(data);
+    default:
+      UNREACHABLE("IntegerKeySearch: not an integer key type");
+  }
+}
+
+}  // namespace bustub
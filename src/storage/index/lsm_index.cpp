@@ -0,0 +1,597 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lsm_index.cpp
+//
+// Identification: src/storage/index/lsm_index.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/lsm_index.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "common/exception.h"
+#include "storage/index/generic_key.h"
+
+namespace bustub {
+
+/*****************************************************************************
+ * MEMTABLE
+ *****************************************************************************/
+
+template <typename KeyType, typename KeyComparator>
+LSMMemTable<KeyType, KeyComparator>::LSMMemTable(const KeyComparator &comparator)
+    : comparator_(comparator), head_(new Node{}) {}
+
+template <typename KeyType, typename KeyComparator>
+LSMMemTable<KeyType, KeyComparator>::~LSMMemTable() {
+  Node *node = head_;
+  while (node != nullptr) {
+    Node *next = node->next_[0].load(std::memory_order_relaxed);
+    delete node;
+    node = next;
+  }
+}
+
+template <typename KeyType, typename KeyComparator>
+void LSMMemTable<KeyType, KeyComparator>::Put(const KeyType &key, const RID &rid, bool tombstone) {
+  uint64_t sequence = next_sequence_++;
+  Node *prev[MAX_HEIGHT];
+  // 新entry的sequence最大，排在这个key所有旧entry的前面
+  FindGreaterOrEqual(key, sequence, prev);
+
+  int height = RandomHeight();
+  int current_height = height_.load(std::memory_order_relaxed);
+  if (height > current_height) {
+    for (int level = current_height; level < height; level++) {
+      prev[level] = head_;
+    }
+    // 读者看到新高度时head_在这些层上可能还是nullptr，会直接下到下一层
+    height_.store(height, std::memory_order_relaxed);
+  }
+
+  auto *node = new Node{key, rid, tombstone, sequence, {}};
+  for (int level = 0; level < height; level++) {
+    node->next_[level].store(prev[level]->next_[level].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // release: 读者经过这个指针时node已经完整
+    prev[level]->next_[level].store(node, std::memory_order_release);
+  }
+  size_.fetch_add(1);
+}
+
+template <typename KeyType, typename KeyComparator>
+bool LSMMemTable<KeyType, KeyComparator>::Get(const KeyType &key, RID *rid, bool *tombstone) const {
+  Node *node = FindGreaterOrEqual(key, UINT64_MAX, nullptr);
+  if (node == nullptr || comparator_(node->key_, key) != 0) {
+    return false;
+  }
+  *rid = node->rid_;
+  *tombstone = node->tombstone_;
+  return true;
+}
+
+template <typename KeyType, typename KeyComparator>
+bool LSMMemTable<KeyType, KeyComparator>::Before(const Node *node, const KeyType &key, uint64_t sequence) const {
+  if (node == nullptr) {
+    return false;
+  }
+  int cmp = comparator_(node->key_, key);
+  return cmp < 0 || (cmp == 0 && node->sequence_ > sequence);
+}
+
+template <typename KeyType, typename KeyComparator>
+typename LSMMemTable<KeyType, KeyComparator>::Node *LSMMemTable<KeyType, KeyComparator>::FindGreaterOrEqual(
+    const KeyType &key, uint64_t sequence, Node **prev) const {
+  Node *node = head_;
+  int level = height_.load(std::memory_order_relaxed) - 1;
+  while (true) {
+    Node *next = node->next_[level].load(std::memory_order_acquire);
+    if (Before(next, key, sequence)) {
+      node = next;
+      continue;
+    }
+    if (prev != nullptr) {
+      prev[level] = node;
+    }
+    if (level == 0) {
+      return next;
+    }
+    level--;
+  }
+}
+
+template <typename KeyType, typename KeyComparator>
+int LSMMemTable<KeyType, KeyComparator>::RandomHeight() {
+  // xorshift, 每层的概率是下一层的1/4
+  int height = 1;
+  while (height < MAX_HEIGHT) {
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 7;
+    random_state_ ^= random_state_ << 17;
+    if ((random_state_ & 3) != 0) {
+      break;
+    }
+    height++;
+  }
+  return height;
+}
+
+/*****************************************************************************
+ * SORTED RUNS
+ *****************************************************************************/
+
+INDEX_TEMPLATE_ARGUMENTS
+LSM_INDEX_TYPE::SortedRun::~SortedRun() { buffer_pool_manager_->DropSegment(segment_id_); }
+
+INDEX_TEMPLATE_ARGUMENTS
+class LSM_INDEX_TYPE::RunWriter {
+ public:
+  RunWriter(LSMIndex *index, size_t expected_size) : index_(index), run_(std::make_shared<SortedRun>()) {
+    DiskManager *disk_manager = index->buffer_pool_manager_->GetDiskManager();
+    run_->buffer_pool_manager_ = index->buffer_pool_manager_;
+    run_->segment_id_ = disk_manager->CreateSegment(index->GetName() + ".lsm" + std::to_string(index->next_run_++));
+    // 同名的segment可能是之前的进程留下的
+    index->buffer_pool_manager_->TruncateSegment(run_->segment_id_);
+    run_->filter_ = std::make_unique<BloomFilter<KeyType>>(expected_size);
+    Page().Init();
+  }
+
+  void Append(const KeyType &key, const RID &rid, bool tombstone) {
+    if (!Page().Append(key, rid, tombstone)) {
+      WritePage();
+      Page().Append(key, rid, tombstone);
+    }
+    run_->filter_->Insert(key);
+    run_->size_++;
+  }
+
+  /** @return the run, nullptr (and the segment dropped) if nothing was appended */
+  std::shared_ptr<SortedRun> Finish() {
+    if (Page().GetSize() > 0) {
+      WritePage();
+    }
+    if (run_->size_ == 0) {
+      return nullptr;
+    }
+    return std::move(run_);
+  }
+
+ private:
+  RunPage &Page() { return *reinterpret_cast<RunPage *>(buffer_); }
+
+  // 页按顺序追加到segment末尾，不经过buffer pool
+  void WritePage() {
+    DiskManager *disk_manager = index_->buffer_pool_manager_->GetDiskManager();
+    page_id_t page_id = disk_manager->AllocatePage(run_->segment_id_);
+    if (page_id == INVALID_PAGE_ID) {
+      throw Exception(ExceptionType::OUT_OF_RANGE, "LSMIndex " + index_->GetName() + ": run segment is full");
+    }
+    disk_manager->WritePage(page_id, buffer_);
+    run_->page_ids_.push_back(page_id);
+    run_->first_keys_.push_back(Page().KeyAt(0));
+    Page().Init();
+  }
+
+  LSMIndex *index_;
+  std::shared_ptr<SortedRun> run_;
+  char buffer_[PAGE_SIZE]{};
+};
+
+INDEX_TEMPLATE_ARGUMENTS
+struct LSM_INDEX_TYPE::RunCursor {
+  RunCursor(SortedRun *run, BufferPoolManager *buffer_pool_manager)
+      : run_(run), buffer_pool_manager_(buffer_pool_manager) {
+    Load();
+  }
+
+  ~RunCursor() {
+    if (page_ != nullptr) {
+      buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+    }
+  }
+
+  bool IsEnd() const { return page_ == nullptr; }
+  const RunPage &Page() const { return *reinterpret_cast<const RunPage *>(page_->GetData()); }
+
+  void Next() {
+    if (++index_ < Page().GetSize()) {
+      return;
+    }
+    buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+    page_ = nullptr;
+    page_index_++;
+    index_ = 0;
+    Load();
+  }
+
+  void Load() {
+    if (page_index_ == run_->page_ids_.size()) {
+      return;
+    }
+    page_ = buffer_pool_manager_->FetchPage(run_->page_ids_[page_index_]);
+    if (page_ == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "LSMIndex: cannot fetch run page");
+    }
+  }
+
+  SortedRun *run_;
+  BufferPoolManager *buffer_pool_manager_;
+  size_t page_index_{0};
+  int index_{0};
+  bustub::Page *page_{nullptr};
+};
+
+/*****************************************************************************
+ * INDEX
+ *****************************************************************************/
+
+INDEX_TEMPLATE_ARGUMENTS
+LSM_INDEX_TYPE::LSMIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager, size_t memtable_size)
+    : Index(metadata),
+      comparator_(metadata->GetKeySchema(), metadata->GetKeyFormat(), !metadata->IsUnique()),
+      buffer_pool_manager_(buffer_pool_manager),
+      memtable_size_(memtable_size) {
+  auto version = std::make_shared<Version>();
+  version->memtable_ = std::make_shared<MemTable>(comparator_);
+  version_ = std::move(version);
+  background_thread_ = std::thread(&LSMIndex::BackgroundWork, this);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+LSM_INDEX_TYPE::~LSMIndex() {
+  {
+    std::scoped_lock lock{latch_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  background_thread_.join();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
+  Write(MakeKey(key, rid), rid, false);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) {
+  Write(MakeKey(key, rid), rid, true);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) {
+  if (GetMetadata()->IsUnique()) {
+    RID rid;
+    if (Get(MakeKey(key), &rid)) {
+      result->push_back(rid);
+    }
+    return;
+  }
+  // MAX_RID本身不会是entry的rid，可以作为开区间的上界
+  Scan(MakeKey(key, MIN_RID), MakeKey(key, MAX_RID), result);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::ScanRange(const Tuple &lo, const Tuple &hi, std::vector<RID> *result,
+                               Transaction *transaction) {
+  Scan(MakeKey(lo, MIN_RID), MakeKey(hi, MIN_RID), result);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::Flush() {
+  std::scoped_lock write_lock{write_latch_};
+  std::unique_lock lock{latch_};
+  if (version_->memtable_->GetSize() > 0) {
+    SwitchMemTable(&lock);
+  }
+  cv_.wait(lock, [this] { return version_->immutables_.empty() || background_error_ != nullptr; });
+  ThrowBackgroundError();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t LSM_INDEX_TYPE::GetRunCount() { return GetVersion()->runs_.size(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType LSM_INDEX_TYPE::MakeKey(const Tuple &key) const {
+  KeyType index_key;
+  if (!index_key.SetFromKey(key, GetKeySchema(), comparator_.GetKeyFormat())) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "index " + GetName() + ": key does not fit into the index key");
+  }
+  return index_key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType LSM_INDEX_TYPE::MakeKey(const Tuple &key, const RID &rid) const {
+  if (GetMetadata()->IsUnique()) {
+    return MakeKey(key);
+  }
+  KeyType index_key;
+  if (!index_key.SetFromKey(key, GetKeySchema(), comparator_.GetKeyFormat(), rid)) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "index " + GetName() + ": key and rid do not fit into the index key");
+  }
+  return index_key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::shared_ptr<const typename LSM_INDEX_TYPE::Version> LSM_INDEX_TYPE::GetVersion() {
+  std::scoped_lock lock{latch_};
+  return version_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::Write(const KeyType &key, const RID &rid, bool tombstone) {
+  std::scoped_lock write_lock{write_latch_};
+  // 只有持有write_latch_的线程会换memtable，不用担心version在写之前过时
+  std::shared_ptr<const Version> version;
+  {
+    std::scoped_lock lock{latch_};
+    ThrowBackgroundError();
+    version = version_;
+  }
+  version->memtable_->Put(key, rid, tombstone);
+  if (version->memtable_->GetSize() >= memtable_size_) {
+    std::unique_lock lock{latch_};
+    SwitchMemTable(&lock);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::SwitchMemTable(std::unique_lock<std::mutex> *lock) {
+  // 后台线程跟不上时让写者等待，不让immutable memtable无限堆积。后台线程失败时entry已经写进了memtable，
+  // 写者收到异常，memtable等后台线程重试之后再换
+  cv_.wait(*lock, [this] {
+    return version_->immutables_.size() < MAX_IMMUTABLE_MEMTABLES || background_error_ != nullptr;
+  });
+  ThrowBackgroundError();
+  auto version = std::make_shared<Version>(*version_);
+  version->immutables_.insert(version->immutables_.begin(), version->memtable_);
+  version->memtable_ = std::make_shared<MemTable>(comparator_);
+  version_ = std::move(version);
+  cv_.notify_all();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::ThrowBackgroundError() {
+  if (background_error_ == nullptr) {
+    return;
+  }
+  std::exception_ptr error = std::move(background_error_);
+  background_error_ = nullptr;
+  // 每个失败只报告给一个写者，之后后台线程重试
+  cv_.notify_all();
+  std::rethrow_exception(error);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool LSM_INDEX_TYPE::Get(const KeyType &key, RID *rid) {
+  std::shared_ptr<const Version> version = GetVersion();
+  bool tombstone;
+  if (version->memtable_->Get(key, rid, &tombstone)) {
+    return !tombstone;
+  }
+  for (const auto &memtable : version->immutables_) {
+    if (memtable->Get(key, rid, &tombstone)) {
+      return !tombstone;
+    }
+  }
+  for (const auto &run : version->runs_) {
+    if (GetFromRun(run.get(), key, rid, &tombstone)) {
+      return !tombstone;
+    }
+  }
+  return false;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool LSM_INDEX_TYPE::GetFromRun(SortedRun *run, const KeyType &key, RID *rid, bool *tombstone) {
+  if (!run->filter_->MayContain(key)) {
+    filter_negatives_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  // 最后一个first key <= key的页
+  auto it = std::upper_bound(run->first_keys_.begin(), run->first_keys_.end(), key,
+                             [this](const KeyType &lhs, const KeyType &rhs) { return comparator_(lhs, rhs) < 0; });
+  if (it == run->first_keys_.begin()) {
+    run->filter_->RecordFalsePositive();
+    return false;
+  }
+  page_id_t page_id = run->page_ids_[it - run->first_keys_.begin() - 1];
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "LSMIndex: cannot fetch run page");
+  }
+  // run的页写完后不再改变，读时不用加页latch
+  auto *run_page = reinterpret_cast<const RunPage *>(page->GetData());
+  int index = run_page->LowerBound(key, comparator_);
+  bool found = index < run_page->GetSize() && comparator_(run_page->KeyAt(index), key) == 0;
+  if (found) {
+    *rid = run_page->RidAt(index);
+    *tombstone = run_page->IsTombstone(index);
+  } else {
+    run->filter_->RecordFalsePositive();
+  }
+  buffer_pool_manager_->UnpinPage(page_id, false);
+  return found;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::Scan(const KeyType &lo, const KeyType &hi, std::vector<RID> *result) {
+  std::shared_ptr<const Version> version = GetVersion();
+  auto less = [this](const KeyType &lhs, const KeyType &rhs) { return comparator_(lhs, rhs) < 0; };
+  std::map<KeyType, std::pair<RID, bool>, decltype(less)> entries(less);
+  // 从新到旧访问各部分，emplace不覆盖已有的key，留下的就是最新的entry
+  auto visit = [&entries](const KeyType &key, const RID &rid, bool tombstone) {
+    entries.emplace(key, std::make_pair(rid, tombstone));
+  };
+  version->memtable_->Scan(&lo, &hi, visit);
+  for (const auto &memtable : version->immutables_) {
+    memtable->Scan(&lo, &hi, visit);
+  }
+  for (const auto &run : version->runs_) {
+    ScanRun(run.get(), lo, hi, visit);
+  }
+  for (const auto &[key, entry] : entries) {
+    if (!entry.second) {
+      result->push_back(entry.first);
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+template <typename Visitor>
+void LSM_INDEX_TYPE::ScanRun(SortedRun *run, const KeyType &lo, const KeyType &hi, Visitor &&visit) {
+  auto it = std::upper_bound(run->first_keys_.begin(), run->first_keys_.end(), lo,
+                             [this](const KeyType &lhs, const KeyType &rhs) { return comparator_(lhs, rhs) < 0; });
+  for (size_t page_index = it == run->first_keys_.begin() ? 0 : it - run->first_keys_.begin() - 1;
+       page_index < run->page_ids_.size(); page_index++) {
+    if (comparator_(run->first_keys_[page_index], hi) >= 0) {
+      return;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(run->page_ids_[page_index]);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "LSMIndex: cannot fetch run page");
+    }
+    auto *run_page = reinterpret_cast<const RunPage *>(page->GetData());
+    for (int index = run_page->LowerBound(lo, comparator_);
+         index < run_page->GetSize() && comparator_(run_page->KeyAt(index), hi) < 0; index++) {
+      visit(run_page->KeyAt(index), run_page->RidAt(index), run_page->IsTombstone(index));
+    }
+    buffer_pool_manager_->UnpinPage(run->page_ids_[page_index], false);
+  }
+}
+
+/*****************************************************************************
+ * BACKGROUND WORK
+ *****************************************************************************/
+
+INDEX_TEMPLATE_ARGUMENTS
+void LSM_INDEX_TYPE::BackgroundWork() {
+  std::unique_lock lock{latch_};
+  while (true) {
+    cv_.wait(lock, [this] {
+      return stop_ || (background_error_ == nullptr &&
+                       (!version_->immutables_.empty() || version_->runs_.size() >= COMPACTION_TRIGGER));
+    });
+    if (stop_) {
+      return;
+    }
+
+    // run太多时先合并，读要查的run不会无限增加，写者在immutable memtable满了之后等待
+    if (version_->runs_.size() >= COMPACTION_TRIGGER) {
+      // 只有这个线程会添加run，合并期间run列表不会改变
+      std::vector<std::shared_ptr<SortedRun>> runs = version_->runs_;
+      lock.unlock();
+      std::shared_ptr<SortedRun> merged;
+      try {
+        merged = Compact(runs);
+      } catch (...) {
+        // 旧run留在version里，写了一半的run连同它的segment已经drop
+        lock.lock();
+        background_error_ = std::current_exception();
+        cv_.notify_all();
+        continue;
+      }
+      runs.clear();
+      lock.lock();
+      auto version = std::make_shared<Version>(*version_);
+      version->runs_.clear();
+      if (merged != nullptr) {
+        version->runs_.push_back(std::move(merged));
+      }
+      // 旧run在最后一个持有旧version的读者结束后drop
+      version_ = std::move(version);
+      compactions_.fetch_add(1);
+      cv_.notify_all();
+      continue;
+    }
+
+    // 先写最老的immutable memtable，run的顺序才和写入顺序一致
+    std::shared_ptr<MemTable> memtable = version_->immutables_.back();
+    lock.unlock();
+    std::shared_ptr<SortedRun> run;
+    try {
+      run = WriteRun(*memtable);
+    } catch (...) {
+      // immutable memtable留在version里，读者照样能查到它的entry
+      lock.lock();
+      background_error_ = std::current_exception();
+      cv_.notify_all();
+      continue;
+    }
+    lock.lock();
+    auto version = std::make_shared<Version>(*version_);
+    version->immutables_.pop_back();
+    version->runs_.insert(version->runs_.begin(), std::move(run));
+    version_ = std::move(version);
+    cv_.notify_all();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::shared_ptr<typename LSM_INDEX_TYPE::SortedRun> LSM_INDEX_TYPE::WriteRun(const MemTable &memtable) {
+  RunWriter writer(this, memtable.GetSize());
+  memtable.Scan(nullptr, nullptr,
+                [&writer](const KeyType &key, const RID &rid, bool tombstone) { writer.Append(key, rid, tombstone); });
+  return writer.Finish();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::shared_ptr<typename LSM_INDEX_TYPE::SortedRun> LSM_INDEX_TYPE::Compact(
+    const std::vector<std::shared_ptr<SortedRun>> &runs) {
+  size_t size = 0;
+  std::vector<std::unique_ptr<RunCursor>> cursors;
+  for (const auto &run : runs) {
+    size += run->size_;
+    cursors.push_back(std::make_unique<RunCursor>(run.get(), buffer_pool_manager_));
+  }
+  RunWriter writer(this, size);
+  // k路归并，runs从新到旧，相同key取下标最小的cursor
+  while (true) {
+    RunCursor *newest = nullptr;
+    for (auto &cursor : cursors) {
+      if (!cursor->IsEnd() &&
+          (newest == nullptr || comparator_(cursor->Page().KeyAt(cursor->index_),
+                                            newest->Page().KeyAt(newest->index_)) < 0)) {
+        newest = cursor.get();
+      }
+    }
+    if (newest == nullptr) {
+      break;
+    }
+    KeyType key = newest->Page().KeyAt(newest->index_);
+    // 合并的是全部run，没有更老的entry需要遮挡，tombstone可以丢掉
+    if (!newest->Page().IsTombstone(newest->index_)) {
+      writer.Append(key, newest->Page().RidAt(newest->index_), false);
+    }
+    for (auto &cursor : cursors) {
+      if (!cursor->IsEnd() && comparator_(cursor->Page().KeyAt(cursor->index_), key) == 0) {
+        cursor->Next();
+      }
+    }
+  }
+  return writer.Finish();
+}
+
+template class LSMMemTable<GenericKey<4>, GenericComparator<4>>;
+template class LSMMemTable<GenericKey<8>, GenericComparator<8>>;
+template class LSMMemTable<GenericKey<16>, GenericComparator<16>>;
+template class LSMMemTable<GenericKey<32>, GenericComparator<32>>;
+template class LSMMemTable<GenericKey<64>, GenericComparator<64>>;
+template class LSMMemTable<GenericKey<128>, GenericComparator<128>>;
+template class LSMMemTable<GenericKey<256>, GenericComparator<256>>;
+
+template class LSMIndex<GenericKey<4>, RID, GenericComparator<4>>;
+template class LSMIndex<GenericKey<8>, RID, GenericComparator<8>>;
+template class LSMIndex<GenericKey<16>, RID, GenericComparator<16>>;
+template class LSMIndex<GenericKey<32>, RID, GenericComparator<32>>;
+template class LSMIndex<GenericKey<64>, RID, GenericComparator<64>>;
+template class LSMIndex<GenericKey<128>, RID, GenericComparator<128>>;
+template class LSMIndex<GenericKey<256>, RID, GenericComparator<256>>;
+
+}  // namespace bustub
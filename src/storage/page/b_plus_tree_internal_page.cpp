@@ -21,10 +21,13 @@
  * 内部页面的第一个key（即array[0]）是无效的，任何search/lookup都忽略第一个key
  */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
 #include "common/exception.h"
+#include "storage/index/key_search.h"
 #include "storage/page/b_plus_tree_internal_page.h"
 
 namespace bustub {
@@ -37,7 +40,8 @@ namespace bustub {
  * max page size
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size, bool compressed,
+                                          bool counted, int fence_size) {
   // 用于初始化
   // 缺省：page_id_t parent_id = INVALID_PAGE_ID, int max_size = INTERNAL_PAGE_SIZE);
   // 注意这里并没有实际为array分配空间，因为Internal page使用的时候就是将Page经过reinterpret_cast转换得到
@@ -45,8 +49,117 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id
   SetPageId(page_id);
   SetSize(0);
   SetPageType(IndexPageType::INTERNAL_PAGE);
+  // 前缀压缩的page从fence key取前缀，存完整的fence key
+  fence_size_ = compressed ? sizeof(KeyType) : ALIGNED_FENCE_SIZE(fence_size);
+  if (counted && !compressed) {
+    // 计数数组占用page末尾的空间
+    max_size = std::min<int>(max_size, COUNTED_INTERNAL_PAGE_SIZE(fence_size_));
+  }
   SetMaxSize(max_size);
   SetParentPageId(parent_id);
+  SetNextPageId(INVALID_PAGE_ID);
+  compressed_ = compressed;
+  counted_ = counted;
+  has_low_key_ = false;
+  has_high_key_ = false;
+  slots_header_.prefix_size_ = 0;
+  slots_header_.size_limit_ = static_cast<uint16_t>(std::clamp<int>(max_size, 1, UINT16_MAX));
+  SlottedKeyArray::Reset(&slots_header_);
+  UpdateMaxSize();
+}
+
+/*
+ * Helper methods to get/set the right link of a B-link tree and the fence keys
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetNextPageId() const { return next_page_id_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetLowKey() const { return FenceKey(0); }
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetHighKey() const { return FenceKey(1); }
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_INTERNAL_PAGE_TYPE::HasLowKey() const { return has_low_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_INTERNAL_PAGE_TYPE::HasHighKey() const { return has_high_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetFences(const KeyType *low_key, const KeyType *high_key) {
+  // 先按旧的前缀解码，再按新的前缀重新编码；参数可能指向自己的fence key，先复制
+  std::vector<MappingType> items;
+  std::vector<uint32_t> counts;
+  if (compressed_) {
+    items = Items(0, GetSize());
+    counts = Counts(0, GetSize());
+  }
+  KeyType low = low_key == nullptr ? KeyType() : *low_key;
+  KeyType high = high_key == nullptr ? KeyType() : *high_key;
+  has_low_key_ = low_key != nullptr;
+  has_high_key_ = high_key != nullptr;
+  memcpy(fences_, &low, fence_size_);
+  memcpy(fences_ + fence_size_, &high, fence_size_);
+  if (!compressed_) {
+    return;
+  }
+  slots_header_.prefix_size_ = GetPrefixSize(low_key, high_key);
+  SlottedKeyArray::Reset(&slots_header_);
+  SetSize(0);
+  for (size_t i = 0; i < items.size(); i++) {
+    InsertAt(GetSize(), items[i], counts[i]);
+  }
+  UpdateMaxSize();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_INTERNAL_PAGE_TYPE::IsCompressed() const { return compressed_; }
+
+/*
+ * Helper methods to get/set the number of pairs in the subtree of a child, only a counted page keeps them
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_INTERNAL_PAGE_TYPE::IsCounted() const { return counted_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+uint32_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::CountAt(int index) const {
+  if (!counted_) {
+    return 0;
+  }
+  if (compressed_) {
+    uint32_t count;
+    memcpy(&count, Slots().GetValue(index) + sizeof(ValueType), sizeof(uint32_t));
+    return count;
+  }
+  return CountArray()[index];
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetCountAt(int index, uint32_t count) {
+  if (!counted_) {
+    return;
+  }
+  if (compressed_) {
+    char value[sizeof(ValueType) + sizeof(uint32_t)];
+    memcpy(value, Slots().GetValue(index), sizeof(ValueType));
+    memcpy(value + sizeof(ValueType), &count, sizeof(uint32_t));
+    Slots().SetValue(index, value);
+    return;
+  }
+  CountArray()[index] = count;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetTotalCount() const {
+  size_t total = 0;
+  for (int i = 0; i < GetSize(); i++) {
+    total += CountAt(i);
+  }
+  return total;
 }
 /*
  * Helper method to get/set the key associated with input "index"(a.k.a
@@ -56,13 +169,26 @@ INDEX_TEMPLATE_ARGUMENTS
 KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const {
   // replace with your own code
   // 用于返回index处的key
-  return array_[index].first;
+  if (compressed_) {
+    KeyType key;
+    Slots().GetKey(index, reinterpret_cast<char *>(&key));
+    return key;
+  }
+  return Array()[index].first;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) {
   // 用于设置index处的key
-  array_[index].first = key;
+  if (compressed_) {
+    // key的长度可能变化，删除后重新插入
+    ValueType value = ValueAt(index);
+    uint32_t count = CountAt(index);
+    RemoveAt(index);
+    InsertAt(index, MappingType{key, value}, count);
+    return;
+  }
+  Array()[index].first = key;
 }
 
 /*
@@ -75,7 +201,7 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const {
   // 对于内部页面，key有序可以比较，但value无法比较，只能顺序查找
   // 这里的value是指page id
   for (int i = 0; i < this->GetSize(); i++) {
-    if (array_[i].second == value) {
+    if (ValueAt(i) == value) {
       return i;
     }
   }
@@ -89,7 +215,127 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const {
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const {
   // 返回index处的value
-  return array_[index].second;
+  if (compressed_) {
+    ValueType value;
+    memcpy(&value, Slots().GetValue(index), sizeof(ValueType));
+    return value;
+  }
+  return Array()[index].second;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertAt(int index, const MappingType &item, uint32_t count) {
+  if (compressed_) {
+    char value[sizeof(ValueType) + sizeof(uint32_t)];
+    memcpy(value, &item.second, sizeof(ValueType));
+    memcpy(value + sizeof(ValueType), &count, sizeof(uint32_t));
+    bool inserted = Slots().Insert(index, reinterpret_cast<const char *>(&item.first), value);
+    if (!inserted) {
+      throw Exception(ExceptionType::OUT_OF_RANGE, "BPlusTreeInternalPage: page is full");
+    }
+    IncreaseSize(1);
+    UpdateMaxSize();
+    return;
+  }
+  for (int i = GetSize(); i > index; i--) {
+    Array()[i] = Array()[i - 1];
+  }
+  Array()[index] = item;
+  if (counted_) {
+    uint32_t *counts = CountArray();
+    memmove(counts + index + 1, counts + index, (GetSize() - index) * sizeof(uint32_t));
+    counts[index] = count;
+  }
+  IncreaseSize(1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAt(int index) {
+  if (compressed_) {
+    Slots().Remove(index);
+    IncreaseSize(-1);
+    UpdateMaxSize();
+    return;
+  }
+  for (int i = index; i < GetSize() - 1; i++) {
+    Array()[i] = Array()[i + 1];
+  }
+  if (counted_) {
+    uint32_t *counts = CountArray();
+    memmove(counts + index, counts + index + 1, (GetSize() - index - 1) * sizeof(uint32_t));
+  }
+  IncreaseSize(-1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<MappingType> B_PLUS_TREE_INTERNAL_PAGE_TYPE::Items(int begin, int end) const {
+  std::vector<MappingType> items;
+  items.reserve(end - begin);
+  for (int i = begin; i < end; i++) {
+    items.emplace_back(KeyAt(i), ValueAt(i));
+  }
+  return items;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<uint32_t> B_PLUS_TREE_INTERNAL_PAGE_TYPE::Counts(int begin, int end) const {
+  std::vector<uint32_t> counts;
+  counts.reserve(end - begin);
+  for (int i = begin; i < end; i++) {
+    counts.push_back(CountAt(i));
+  }
+  return counts;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::FenceKey(int index) const {
+  KeyType key;
+  memset(&key, 0, sizeof(KeyType));
+  memcpy(&key, fences_ + index * fence_size_, fence_size_);
+  return key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+MappingType *B_PLUS_TREE_INTERNAL_PAGE_TYPE::Array() const {
+  auto self = const_cast<BPlusTreeInternalPage *>(this);
+  return reinterpret_cast<MappingType *>(self->fences_ + 2 * fence_size_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+SlottedKeyArray B_PLUS_TREE_INTERNAL_PAGE_TYPE::Slots() const {
+  auto self = const_cast<BPlusTreeInternalPage *>(this);
+  return SlottedKeyArray(reinterpret_cast<char *>(self), &self->slots_header_, reinterpret_cast<char *>(Array()),
+                         GetSize(), sizeof(KeyType), ValueSize(), fences_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueSize() const {
+  return sizeof(ValueType) + (counted_ ? sizeof(uint32_t) : 0);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+uint32_t *B_PLUS_TREE_INTERNAL_PAGE_TYPE::CountArray() const {
+  // pair数组最多size_limit_个pair，计数数组紧随其后
+  return reinterpret_cast<uint32_t *>(reinterpret_cast<char *>(Array()) +
+                                      slots_header_.size_limit_ * sizeof(MappingType));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::UpdateMaxSize() {
+  if (!compressed_) {
+    return;
+  }
+  SlottedKeyArray slots = Slots();
+  SetMaxSize(std::min<int>(slots_header_.size_limit_, GetSize() + slots.GetFreeSize() / slots.GetMaxEntrySize()));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetPrefixSize(const KeyType *low_key, const KeyType *high_key) const {
+  if (low_key == nullptr || high_key == nullptr) {
+    return 0;
+  }
+  return SlottedKeyArray::CommonPrefix(reinterpret_cast<const char *>(low_key),
+                                       reinterpret_cast<const char *>(high_key), sizeof(KeyType));
 }
 
 /*****************************************************************************
@@ -98,7 +344,7 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const {
 /*
  * 查找internal page的array中第一个>key(注意不是>=)的下标，然后据其确定value
  * 注意：value指向的是子树，或者说指向的是当前内部结点的下一层某个结点
- * 假设arraty_[i]的子树中的所有key为subtree(value(i))，array_[i]的关键字为key(i)
+ * 假设arraty_[i]的子树中的所有key为subtree(value(i))，Array()[i]的关键字为key(i)
  * 那么满足 key(i) <= subtree(value(i)) < key(i + 1)
  * 其实就是任意两个key之间的指针所指向的子树的key均位于它们之间
  * Find and return the child pointer(page_id) which points to the child page
@@ -107,6 +353,14 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const {
  */
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyComparator &comparator) const {
+  return ValueAt(LookupIndex(key, comparator));
+}
+
+/*
+ * 同Lookup，返回孩子指针的下标，孩子的key范围是[key(index), key(index + 1))
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::LookupIndex(const KeyType &key, const KeyComparator &comparator) const {
   // 查找内部节点中最后一个<=给定key的下标
   // 正常来说下标范围是[0,size-1]，但是0位置设为无效
   // 所以直接从1位置开始，作为下界，下标范围是[1,size-1]
@@ -115,6 +369,20 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyCo
   // 正常来说下标范围是[0,size-1]，但是0位置设为无效
   // 所以直接从1位置开始，作为下界，下标范围是[1,size-1]
   // assert(GetSize() >= 1);  // 这里总是容易出现错误
+  if (compressed_) {
+    // 第一个>key的下标减1
+    return Slots().Search(reinterpret_cast<const char *>(&key), 1, true) - 1;
+  }
+  if constexpr (HasIntegerKeyType<KeyComparator>::value) {
+    // 整数key直接在array中做无分支查找，不调用comparator；<=key的个数r即upper_bound下标1+r，返回下标r
+    TypeId type = comparator.GetIntegerKeyType();
+    if (type != TypeId::INVALID) {
+      int64_t target = IntegerKeySearch::ToInteger(reinterpret_cast<const char *>(&key), type);
+      int rank = IntegerKeySearch::Rank(reinterpret_cast<const char *>(&Array()[1].first), sizeof(MappingType),
+                                        GetSize() - 1, target, type, true);
+      return rank;
+    }
+  }
   int left = 1;
   int right = GetSize() - 1;
   while (left <= right) {
@@ -128,7 +396,7 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyCo
   int target_index = left;
   assert(target_index - 1 >= 0);
   // 注意，返回的value下标要减1，这样才能满足key(i-1) <= subtree(value(i)) < key(i)
-  return ValueAt(target_index - 1);
+  return target_index - 1;
 }
 
 /*****************************************************************************
@@ -144,9 +412,11 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::PopulateNewRoot(const ValueType &old_value, const KeyType &new_key,
                                                      const ValueType &new_value) {
   // 只有root节点能够使用该函数，即该函数就是用来填充自身的page的
-  array_[0] = {KeyType(), old_value};
-  array_[1] = {new_key, new_value};
-  SetSize(2);
+  // root没有fence key，前缀为空
+  SetSize(0);
+  SlottedKeyArray::Reset(&slots_header_);
+  InsertAt(0, MappingType{KeyType(), old_value}, 0);
+  InsertAt(1, MappingType{new_key, new_value}, 0);
 }
 /*
  * Insert new_key & new_value pair right after the pair with its value ==
@@ -167,12 +437,7 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(const ValueType &old_value,
   insert_index++;  // 插入位置在 =old_value的下标 的后面一个
   // 数组下标>=insert_index的元素整体后移1位
   // [insert_index, size - 1] --> [insert_index + 1, size]
-  for (int i = GetSize(); i > insert_index; i--) {
-    // 这里不考虑越界问题
-    array_[i] = array_[i - 1];
-  }
-  array_[insert_index] = MappingType{new_key, new_value};  // insert pair
-  IncreaseSize(1);
+  InsertAt(insert_index, MappingType{new_key, new_value}, 0);  // insert pair，计数由调用者设置
   return GetSize();
 }
 
@@ -194,9 +459,18 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(BPlusTreeInternalPage *recipient
 
   int start_index = GetMinSize();
   int size = GetSize() - start_index;
-  recipient->CopyNFrom(array_ + start_index, size, buffer_pool_manager);
-  // 记得改变size
-  IncreaseSize(-size);
+  std::vector<MappingType> items = Items(start_index, GetSize());
+  std::vector<uint32_t> counts = Counts(start_index, GetSize());
+  for (int i = GetSize() - 1; i >= start_index; i--) {
+    RemoveAt(i);
+  }
+  // 中间的key是分隔key，recipient为空，先设置fence key
+  KeyType separator = items[0].first;
+  KeyType low_key = GetLowKey();
+  KeyType high_key = GetHighKey();
+  recipient->SetFences(&separator, has_high_key_ ? &high_key : nullptr);
+  recipient->CopyNFrom(items.data(), counts.data(), size, buffer_pool_manager);
+  SetFences(has_low_key_ ? &low_key : nullptr, &separator);
 }
 
 /*
@@ -205,19 +479,23 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(BPlusTreeInternalPage *recipient
  * Copy entries into me, starting from {items} and copy {size} entries.
  * Since it is an internal page, for all entries (pages) moved, their parents page now changes to me.
  * So I need to 'adopt' them by changing their parent page id, which needs to be persisted with BufferPoolManger
+ * 一个B-link tree不维护parent page id，此时buffer_pool_manager为nullptr
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager) {
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(const MappingType *items, const uint32_t *counts, int size,
+                                               BufferPoolManager *buffer_pool_manager) {
   // 该函数将items所指节点的pair对拷贝size个到当前node, 原来节点中的对应pair不需要删除，但是其孩子的父节点需要重新改变
-  for (int i = GetSize(); i < GetSize() + size; i++) {
-    array_[i] = items[i - GetSize()];
-    auto child_page = buffer_pool_manager->FetchPage(array_[i].second);
-    auto child_node = reinterpret_cast<BPlusTreeInternalPage *>(child_page);
+  for (int i = 0; i < size; i++) {
+    InsertAt(GetSize(), items[i], counts[i]);
+    if (buffer_pool_manager == nullptr) {
+      continue;
+    }
+    auto child_page = buffer_pool_manager->FetchPage(items[i].second);
+    auto child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
     // 修正子节点的parent page
     child_node->SetParentPageId(GetPageId());
-    buffer_pool_manager->UnpinPage(array_[i].second, true);
+    buffer_pool_manager->UnpinPage(items[i].second, true);
   }
-  IncreaseSize(size);
 }
 
 /*****************************************************************************
@@ -234,10 +512,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
   if (index < 0 || index >= GetSize()) {
     return;
   }
-  for (int i = index; i < GetSize(); i++) {
-    array_[i] = array_[i + 1];
-  }
-  IncreaseSize(-1);
+  RemoveAt(index);
 }
 
 /*
@@ -246,10 +521,20 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAndReturnOnlyChild() {
-  auto ans = array_[0].second;
+  auto ans = ValueAt(0);
   Remove(0);
   return ans;
 }
+/*
+ * Append key & value pair at the end of the page, the caller guarantees that the
+ * keys stay ordered. For the first pair the key is the separation key of the page
+ * itself, as with the first key of a page produced by MoveHalfTo.
+ * NOTE: only call this method within BulkLoad()(in b_plus_tree.cpp)
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Append(const KeyType &key, const ValueType &value, uint32_t count) {
+  InsertAt(GetSize(), MappingType{key, value}, count);
+}
 /*****************************************************************************
  * MERGE
  *****************************************************************************/
@@ -265,9 +550,41 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient,
                                                BufferPoolManager *buffer_pool_manager) {
   // 当前node的第一个key(即array[0].first)本是无效值(因为是内部结点)，但由于要移动当前node的整个array到recipient
   // 那么必须在移动前将当前node的第一个key 赋值为 父结点中下标为index的middle_key
-  SetKeyAt(0, middle_key);  // 将分隔key设置在0的位置
-  recipient->CopyNFrom(array_, GetSize(), buffer_pool_manager);
+  std::vector<MappingType> items = Items(0, GetSize());
+  std::vector<uint32_t> counts = Counts(0, GetSize());
+  items[0].first = middle_key;  // 将分隔key设置在0的位置
+  // recipient在左边，合并后的上界是本page的上界
+  KeyType low_key = recipient->GetLowKey();
+  KeyType high_key = GetHighKey();
+  recipient->SetFences(recipient->has_low_key_ ? &low_key : nullptr, has_high_key_ ? &high_key : nullptr);
+  recipient->CopyNFrom(items.data(), counts.data(), GetSize(), buffer_pool_manager);
   SetSize(0);
+  SlottedKeyArray::Reset(&slots_header_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_INTERNAL_PAGE_TYPE::CanMoveAllTo(const BPlusTreeInternalPage *recipient,
+                                                  const KeyType &middle_key) const {
+  if (!compressed_) {
+    return GetSize() + recipient->GetSize() < recipient->GetMaxSize();
+  }
+  // 按合并后的前缀计算两个page的pair占用的空间，合并后的page还要能再放下一个pair
+  KeyType low_key = recipient->GetLowKey();
+  KeyType high_key = GetHighKey();
+  int prefix_size =
+      GetPrefixSize(recipient->has_low_key_ ? &low_key : nullptr, has_high_key_ ? &high_key : nullptr);
+  int used_size = 0;
+  for (const BPlusTreeInternalPage *page : {recipient, this}) {
+    for (int i = 0; i < page->GetSize(); i++) {
+      KeyType key = page == this && i == 0 ? middle_key : page->KeyAt(i);
+      int key_size = SlottedKeyArray::SignificantSize(reinterpret_cast<const char *>(&key), sizeof(KeyType));
+      used_size += SlottedKeyArray::SLOT_SIZE + std::max(key_size - prefix_size, 0) + ValueSize();
+    }
+  }
+  int max_entry_size = SlottedKeyArray::SLOT_SIZE + sizeof(KeyType) - prefix_size + ValueSize();
+  int size = GetSize() + recipient->GetSize();
+  return size + 1 < slots_header_.size_limit_ &&
+         used_size + max_entry_size <= static_cast<int>(PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE(fence_size_));
 }
 
 /*****************************************************************************
@@ -287,12 +604,19 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *rec
   // 将当前节点的首部的pair移动到recipient
   // 当前node的第一个key本是无效值(因为是内部结点)，但由于要移动当前node的array[0]到recipient尾部
   // 那么必须在移动前将当前node的第一个key 赋值为 父结点中下标为1的middle_key
-  SetKeyAt(0, middle_key);
   // first item (array[0]) of this page array copied to recipient page last
-  // 此时的array_[0]是{middle_key, array_[0].second}
-  recipient->CopyLastFrom(array_[0], buffer_pool_manager);
+  // 此时的array_[0]是{middle_key, Array()[0].second}
+  MappingType first_pair{middle_key, ValueAt(0)};
+  uint32_t first_count = CountAt(0);
+  // 新的分隔key是本page的第二个key，移动之后成为KeyAt(0)
+  KeyType separator = KeyAt(1);
   // delete array[0]
   Remove(0);  // 函数复用
+  KeyType high_key = GetHighKey();
+  KeyType low_key = recipient->GetLowKey();
+  SetFences(&separator, has_high_key_ ? &high_key : nullptr);
+  recipient->SetFences(recipient->has_low_key_ ? &low_key : nullptr, &separator);
+  recipient->CopyLastFrom(first_pair, first_count, buffer_pool_manager);
 }
 
 /* Append an entry at the end.
@@ -300,17 +624,16 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *rec
  * So I need to 'adopt' it by changing its parent page id, which needs to be persisted with BufferPoolManger
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(const MappingType &pair, uint32_t count,
+                                                  BufferPoolManager *buffer_pool_manager) {
   // 在当前节点的尾部新加一个条目
-  array_[GetSize()] = pair;
+  InsertAt(GetSize(), pair, count);
 
   // update parent page id of child page
-  Page *child_page = buffer_pool_manager->FetchPage(ValueAt(GetSize()));
+  Page *child_page = buffer_pool_manager->FetchPage(pair.second);
   BPlusTreePage *child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
   child_node->SetParentPageId(GetPageId());
   buffer_pool_manager->UnpinPage(child_page->GetPageId(), true);
-
-  IncreaseSize(1);
 }
 
 /*
@@ -324,9 +647,15 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                                                        BufferPoolManager *buffer_pool_manager) {
   recipient->SetKeyAt(0, middle_key);
-  auto last_pair = array_[GetSize() - 1];
-  recipient->CopyFirstFrom(last_pair, buffer_pool_manager);
-  IncreaseSize(-1);
+  auto last_pair = MappingType{KeyAt(GetSize() - 1), ValueAt(GetSize() - 1)};
+  uint32_t last_count = CountAt(GetSize() - 1);
+  RemoveAt(GetSize() - 1);
+  // 新的分隔key就是移动的key
+  KeyType low_key = GetLowKey();
+  KeyType high_key = recipient->GetHighKey();
+  SetFences(has_low_key_ ? &low_key : nullptr, &last_pair.first);
+  recipient->SetFences(&last_pair.first, recipient->has_high_key_ ? &high_key : nullptr);
+  recipient->CopyFirstFrom(last_pair, last_count, buffer_pool_manager);
 }
 
 /* Append an entry at the beginning.
@@ -334,22 +663,18 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeInternalPage *re
  * So I need to 'adopt' it by changing its parent page id, which needs to be persisted with BufferPoolManger
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyFirstFrom(const MappingType &pair, uint32_t count,
+                                                   BufferPoolManager *buffer_pool_manager) {
   // 将pair拷贝到array_的首部
   // move array after index=0 to back by 1 size
-  for (int i = GetSize(); i >= 0; i--) {
-    array_[i + 1] = array_[i];
-  }
   // insert item to array[0]
-  array_[0] = pair;
+  InsertAt(0, pair, count);
 
   // update parent page id of child page
   Page *child_page = buffer_pool_manager->FetchPage(ValueAt(0));
   BPlusTreePage *child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
   child_node->SetParentPageId(GetPageId());
   buffer_pool_manager->UnpinPage(child_page->GetPageId(), true);
-
-  IncreaseSize(1);
 }
 
 // valuetype for internalNode should be page id_t
@@ -358,4 +683,6 @@ template class BPlusTreeInternalPage<GenericKey<8>, page_id_t, GenericComparator
 template class BPlusTreeInternalPage<GenericKey<16>, page_id_t, GenericComparator<16>>;
 template class BPlusTreeInternalPage<GenericKey<32>, page_id_t, GenericComparator<32>>;
 template class BPlusTreeInternalPage<GenericKey<64>, page_id_t, GenericComparator<64>>;
+template class BPlusTreeInternalPage<GenericKey<128>, page_id_t, GenericComparator<128>>;
+template class BPlusTreeInternalPage<GenericKey<256>, page_id_t, GenericComparator<256>>;
 }  // namespace bustub
@@ -19,10 +19,14 @@
  * 然后将其重新解释为叶或内部页面，并在任何写入或读取操作后取消固定(unpin)页面。
  */
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <sstream>
 
 #include "common/exception.h"
 #include "common/rid.h"
+#include "storage/index/key_search.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
 
 namespace bustub {
@@ -37,8 +41,11 @@ namespace bustub {
  * next page id and set max size
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size, bool compressed,
+                                      bool posting, int fence_size) {
   // 缺省：page_id_t parent_id = INVALID_PAGE_ID, int max_size = LEAF_PAGE_SIZE;
+  // 前缀压缩和posting list的page从fence key取前缀、截断分隔key，存完整的fence key
+  fence_size_ = compressed || posting ? sizeof(KeyType) : ALIGNED_FENCE_SIZE(fence_size);
   SetMaxSize(max_size);  //这里的最大size需要注意，由于在进行split的时候需要先插入一个元素，导致
                          //越界，所以这里在进行初始化的时候，不妨
   SetPageId(page_id);
@@ -46,20 +53,80 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, in
   SetSize(0);
   SetPageType(IndexPageType::LEAF_PAGE);
   SetNextPageId(INVALID_PAGE_ID);
+  SetPrevPageId(INVALID_PAGE_ID);
+  // posting list的page不做前缀压缩
+  compressed_ = compressed && !posting;
+  posting_ = posting;
+  has_low_key_ = false;
+  has_high_key_ = false;
+  slots_header_.prefix_size_ = 0;
+  slots_header_.size_limit_ = static_cast<uint16_t>(std::clamp<int>(max_size, 1, UINT16_MAX));
+  SlottedKeyArray::Reset(&slots_header_);
+  if (posting_) {
+    PostingLists().Reset();
+  }
+  UpdateMaxSize();
 }
 
 /**
- * Helper methods to set/get next page id
+ * Helper methods to set/get next and prev page id
  */
 INDEX_TEMPLATE_ARGUMENTS
 page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetNextPageId() const { return next_page_id_; }
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) {
-  LOG_INFO("叶子节点 page_id: %d 的 nexe_page为%d", GetPageId(), next_page_id);
-  next_page_id_ = next_page_id;
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrevPageId() const { return prev_page_id_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPrevPageId(page_id_t prev_page_id) { prev_page_id_ = prev_page_id; }
+
+/*
+ * Helper methods to get/set the fence keys
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetLowKey() const { return FenceKey(0); }
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetHighKey() const { return FenceKey(1); }
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::HasLowKey() const { return has_low_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::HasHighKey() const { return has_high_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetFences(const KeyType *low_key, const KeyType *high_key) {
+  // 先按旧的前缀解码，再按新的前缀重新编码；参数可能指向自己的fence key，先复制
+  std::vector<MappingType> items;
+  if (compressed_) {
+    items = Items(0, GetSize());
+  }
+  KeyType low = low_key == nullptr ? KeyType() : *low_key;
+  KeyType high = high_key == nullptr ? KeyType() : *high_key;
+  has_low_key_ = low_key != nullptr;
+  has_high_key_ = high_key != nullptr;
+  memcpy(fences_, &low, fence_size_);
+  memcpy(fences_ + fence_size_, &high, fence_size_);
+  if (!compressed_) {
+    return;
+  }
+  slots_header_.prefix_size_ = GetPrefixSize(low_key, high_key);
+  SlottedKeyArray::Reset(&slots_header_);
+  SetSize(0);
+  CopyNFrom(items.data(), static_cast<int>(items.size()));
+  UpdateMaxSize();
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::IsCompressed() const { return compressed_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::IsPostingList() const { return posting_; }
+
 /**
  * 返回leaf page的array中第一个>=key的下标
  * Helper method to find the first index i so that array[i].first >= key
@@ -72,11 +139,58 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator
   // array类型为std::pair<KeyType, ValueType>
   // 叶结点的下标范围是[0,size-1]
   // std::scoped_lock lock{latch_};  // DEBUG
+  if (compressed_) {
+    // 只比较前缀之后存储的字节
+    return Slots().Search(reinterpret_cast<const char *>(&key), 0, false);
+  }
+  if (posting_) {
+    // 先按每个posting list的第一个key找到key所在的posting list，再在其中顺序查找
+    PostingListArray posting_lists = PostingLists();
+    int left = 0;
+    int right = posting_lists.GetGroupCount();
+    int tuple_size;
+    while (left < right) {
+      int mid = left + (right - left) / 2;
+      const char *tuple = posting_lists.GetTuple(mid, &tuple_size);
+      if (comparator(MakeKey(tuple, tuple_size, posting_lists.GetFirstRid(mid)), key) > 0) {
+        right = mid;
+      } else {
+        left = mid + 1;
+      }
+    }
+    int group = left - 1;
+    if (group < 0) {
+      return 0;
+    }
+    int end = posting_lists.GetFirstIndex(group) + posting_lists.GetCount(group);
+    const char *tuple = posting_lists.GetTuple(group, &tuple_size);
+    if (comparator(MakeKey(tuple, tuple_size, posting_lists.GetLastRid(group)), key) < 0) {
+      return end;
+    }
+    // 解码整个posting list，再二分查找
+    std::vector<int64_t> rids;
+    posting_lists.GetRids(group, &rids);
+    KeyType group_key = MakeKey(tuple, tuple_size, rids[0]);
+    auto position = std::partition_point(rids.begin(), rids.end(), [&](int64_t rid) {
+      KeyTraits<KeyType, KeyComparator>::SetRid(&group_key, tuple_size, RID(rid));
+      return comparator(group_key, key) < 0;
+    });
+    return posting_lists.GetFirstIndex(group) + static_cast<int>(position - rids.begin());
+  }
+  if constexpr (HasIntegerKeyType<KeyComparator>::value) {
+    // 整数key直接在array中做无分支查找，<key的个数即lower_bound下标
+    TypeId type = comparator.GetIntegerKeyType();
+    if (type != TypeId::INVALID) {
+      int64_t target = IntegerKeySearch::ToInteger(reinterpret_cast<const char *>(&key), type);
+      return IntegerKeySearch::Rank(reinterpret_cast<const char *>(&Array()[0].first), sizeof(MappingType), GetSize(),
+                                    target, type, false);
+    }
+  }
   int left = 0;
   int right = GetSize() - 1;
   while (left <= right) {
     int mid = left + (right - left) / 2;
-    if (comparator(KeyAt(mid), key) >= 0) {  // 下标还需要减小
+    if (comparator(Array()[mid].first, key) >= 0) {  // 下标还需要减小
       right = mid - 1;
     } else {  // 下标还需要增大
       left = mid + 1;
@@ -92,8 +206,15 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator
  */
 INDEX_TEMPLATE_ARGUMENTS
 KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const {
-  // replace with your own code
-  return array_[index].first;
+  if (compressed_) {
+    KeyType key;
+    Slots().GetKey(index, reinterpret_cast<char *>(&key));
+    return key;
+  }
+  if (posting_) {
+    return GetItem(index).first;
+  }
+  return Array()[index].first;
 }
 
 /*
@@ -101,10 +222,195 @@ KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const {
  * "index"(a.k.a array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) {
-  // replace with your own code
-  // 返回index处的pair
-  return array_[index];
+MappingType B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) const {
+  // 返回index处的pair，前缀压缩的page需要解码
+  if (compressed_) {
+    MappingType item;
+    SlottedKeyArray slots = Slots();
+    slots.GetKey(index, reinterpret_cast<char *>(&item.first));
+    memcpy(&item.second, slots.GetValue(index), sizeof(ValueType));
+    return item;
+  }
+  if (posting_) {
+    PostingListArray posting_lists = PostingLists();
+    int group = posting_lists.FindGroup(index);
+    int tuple_size;
+    const char *tuple = posting_lists.GetTuple(group, &tuple_size);
+    int64_t rid = posting_lists.GetRid(group, index - posting_lists.GetFirstIndex(group));
+    return MappingType{MakeKey(tuple, tuple_size, rid), ValueType(rid)};
+  }
+  return Array()[index];
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::DecodePostingList(int index, std::vector<MappingType> *items) const {
+  assert(posting_);
+  PostingListArray posting_lists = PostingLists();
+  int group = posting_lists.FindGroup(index);
+  int tuple_size;
+  const char *tuple = posting_lists.GetTuple(group, &tuple_size);
+  std::vector<int64_t> rids;
+  posting_lists.GetRids(group, &rids);
+  items->clear();
+  items->reserve(rids.size());
+  KeyType key = MakeKey(tuple, tuple_size, rids[0]);
+  for (int64_t rid : rids) {
+    KeyTraits<KeyType, KeyComparator>::SetRid(&key, tuple_size, RID(rid));
+    items->emplace_back(key, ValueType(rid));
+  }
+  return posting_lists.GetFirstIndex(group);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::InsertAt(int index, const MappingType &item) {
+  if (compressed_) {
+    bool inserted = Slots().Insert(index, reinterpret_cast<const char *>(&item.first),
+                                   reinterpret_cast<const char *>(&item.second));
+    if (!inserted) {
+      throw Exception(ExceptionType::OUT_OF_RANGE, "BPlusTreeLeafPage: page is full");
+    }
+    IncreaseSize(1);
+    UpdateMaxSize();
+    return;
+  }
+  if (posting_) {
+    RID rid(item.second);
+    int tuple_size = KeyTraits<KeyType, KeyComparator>::GetTupleSize(item.first, rid);
+    if (!PostingLists().Insert(index, reinterpret_cast<const char *>(&item.first), tuple_size, rid.Get())) {
+      throw Exception(ExceptionType::OUT_OF_RANGE, "BPlusTreeLeafPage: page is full");
+    }
+    IncreaseSize(1);
+    UpdateMaxSize();
+    return;
+  }
+  // 数组下标>=index的元素整体后移1位
+  // [index, size - 1] --> [index + 1, size]
+  for (int i = GetSize(); i > index; i--) {
+    Array()[i] = Array()[i - 1];
+  }
+  Array()[index] = item;
+  IncreaseSize(1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAt(int index) {
+  if (compressed_) {
+    Slots().Remove(index);
+    IncreaseSize(-1);
+    UpdateMaxSize();
+    return;
+  }
+  if (posting_) {
+    PostingLists().Remove(index);
+    IncreaseSize(-1);
+    UpdateMaxSize();
+    return;
+  }
+  for (int j = index + 1; j < GetSize(); j++) {
+    Array()[j - 1] = Array()[j];
+  }
+  IncreaseSize(-1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<MappingType> B_PLUS_TREE_LEAF_PAGE_TYPE::Items(int begin, int end) const {
+  std::vector<MappingType> items;
+  items.reserve(end - begin);
+  if (posting_) {
+    // 逐个posting list解码，不为每个pair重新解码
+    std::vector<MappingType> group_items;
+    int i = begin;
+    while (i < end) {
+      int first_index = DecodePostingList(i, &group_items);
+      int last = std::min(end - first_index, static_cast<int>(group_items.size()));
+      items.insert(items.end(), group_items.begin() + (i - first_index), group_items.begin() + last);
+      i = first_index + last;
+    }
+    return items;
+  }
+  for (int i = begin; i < end; i++) {
+    items.push_back(GetItem(i));
+  }
+  return items;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::FenceKey(int index) const {
+  KeyType key;
+  memset(&key, 0, sizeof(KeyType));
+  memcpy(&key, fences_ + index * fence_size_, fence_size_);
+  return key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+MappingType *B_PLUS_TREE_LEAF_PAGE_TYPE::Array() const {
+  auto self = const_cast<BPlusTreeLeafPage *>(this);
+  return reinterpret_cast<MappingType *>(self->fences_ + 2 * fence_size_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+SlottedKeyArray B_PLUS_TREE_LEAF_PAGE_TYPE::Slots() const {
+  // 前缀取自fence key，有前缀时两个fence key都存在并且前缀相同；前缀压缩的page存完整的fence key
+  auto self = const_cast<BPlusTreeLeafPage *>(this);
+  return SlottedKeyArray(reinterpret_cast<char *>(self), &self->slots_header_, reinterpret_cast<char *>(Array()),
+                         GetSize(), sizeof(KeyType), sizeof(ValueType), fences_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+PostingListArray B_PLUS_TREE_LEAF_PAGE_TYPE::PostingLists() const {
+  return PostingListArray(reinterpret_cast<char *>(Array()), PAGE_SIZE - LEAF_PAGE_HEADER_SIZE(fence_size_));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::MakeKey(const char *tuple, int tuple_size, int64_t rid) {
+  KeyType key;
+  memset(static_cast<void *>(&key), 0, sizeof(KeyType));
+  memcpy(static_cast<void *>(&key), tuple, tuple_size);
+  KeyTraits<KeyType, KeyComparator>::SetRid(&key, tuple_size, RID(rid));
+  return key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::AppendPosting(PostingListArray *posting_lists, const MappingType &item) {
+  RID rid(item.second);
+  int tuple_size = KeyTraits<KeyType, KeyComparator>::GetTupleSize(item.first, rid);
+  return posting_lists->Append(reinterpret_cast<const char *>(&item.first), tuple_size, rid.Get());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPostingItems(const std::vector<MappingType> &items) {
+  PostingListArray posting_lists = PostingLists();
+  posting_lists.Reset();
+  for (const auto &item : items) {
+    if (!AppendPosting(&posting_lists, item)) {
+      throw Exception(ExceptionType::OUT_OF_RANGE, "BPlusTreeLeafPage: page is full");
+    }
+  }
+  SetSize(static_cast<int>(items.size()));
+  UpdateMaxSize();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::UpdateMaxSize() {
+  if (posting_) {
+    int max_entry_size = PostingListArray::GetMaxEntrySize(sizeof(KeyType));
+    SetMaxSize(std::min<int>(slots_header_.size_limit_, GetSize() + PostingLists().GetFreeSize() / max_entry_size));
+    return;
+  }
+  if (!compressed_) {
+    return;
+  }
+  SlottedKeyArray slots = Slots();
+  SetMaxSize(std::min<int>(slots_header_.size_limit_, GetSize() + slots.GetFreeSize() / slots.GetMaxEntrySize()));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrefixSize(const KeyType *low_key, const KeyType *high_key) const {
+  if (low_key == nullptr || high_key == nullptr) {
+    return 0;
+  }
+  return SlottedKeyArray::CommonPrefix(reinterpret_cast<const char *>(low_key),
+                                       reinterpret_cast<const char *>(high_key), sizeof(KeyType));
 }
 
 /*****************************************************************************
@@ -118,18 +424,10 @@ INDEX_TEMPLATE_ARGUMENTS int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &k
                                                                 const KeyComparator &comparator) {
   int insert_index = KeyIndex(key, comparator);  // 查找第一个>=key的的下标
 
-  if (comparator(KeyAt(insert_index), key) == 0) {  // 重复的key
+  if (insert_index < GetSize() && comparator(KeyAt(insert_index), key) == 0) {  // 重复的key
     return GetSize();
   }
-
-  // 数组下标>=insert_index的元素整体后移1位
-  // [insert_index, size - 1] --> [insert_index + 1, size]
-  for (int i = GetSize(); i > insert_index; i--) {
-    array_[i] = array_[i - 1];
-  }
-  array_[insert_index] = MappingType{key, value};  // insert pair
-  LOG_INFO("new key is inserted, insert index is :%d, page_id:%d", insert_index, GetPageId());
-  IncreaseSize(1);
+  InsertAt(insert_index, MappingType{key, value});  // insert pair
   return GetSize();
 }
 
@@ -143,20 +441,39 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(BPlusTreeLeafPage *recipient) {
   int start_index = GetSize() / 2;
   int size = GetSize() - start_index;
-  recipient->CopyNFrom(array_ + start_index, size);
-  IncreaseSize(-size);
+  std::vector<MappingType> items = Items(start_index, GetSize());
+  KeyType separator = items[0].first;
+  if ((compressed_ || posting_) && start_index > 0) {
+    // 后缀截断：分隔key只需要大于左边最后一个key，取右边第一个key到第一个不同字节为止，其余字节为0
+    KeyType last_key = KeyAt(start_index - 1);
+    auto first = reinterpret_cast<char *>(&separator);
+    int common = SlottedKeyArray::CommonPrefix(reinterpret_cast<const char *>(&last_key), first, sizeof(KeyType));
+    memset(first + common + 1, 0, sizeof(KeyType) - common - 1);
+  }
+  if (posting_) {
+    SetPostingItems(Items(0, start_index));
+  } else {
+    for (int i = GetSize() - 1; i >= start_index; i--) {
+      RemoveAt(i);
+    }
+  }
+  // recipient为空，先设置fence key，这样它用更长的前缀存储移过去的pair
+  KeyType low_key = GetLowKey();
+  KeyType high_key = GetHighKey();
+  recipient->SetFences(&separator, has_high_key_ ? &high_key : nullptr);
+  recipient->CopyNFrom(items.data(), size);
+  SetFences(has_low_key_ ? &low_key : nullptr, &separator);
 }
 
 /*
  * Copy starting from items, and copy {size} number of elements into me.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(MappingType *items, int size) {
+void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(const MappingType *items, int size) {
   // 复制后空间增大了size
-  for (int i = GetSize(); i < GetSize() + size; i++) {
-    array_[i] = items[i - GetSize()];
+  for (int i = 0; i < size; i++) {
+    InsertAt(GetSize(), items[i]);
   }
-  IncreaseSize(size);
 }
 
 /*****************************************************************************
@@ -170,11 +487,10 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(MappingType *items, int size) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool B_PLUS_TREE_LEAF_PAGE_TYPE::Lookup(const KeyType &key, ValueType *value, const KeyComparator &comparator) const {
-  for (int i = 0; i < GetSize(); i++) {
-    if (comparator(key, KeyAt(i)) == 0) {
-      *value = array_[i].second;
-      return true;
-    }
+  int index = KeyIndex(key, comparator);
+  if (index < GetSize() && comparator(key, KeyAt(index)) == 0) {
+    *value = GetItem(index).second;
+    return true;
   }
   return false;
 }
@@ -191,14 +507,12 @@ bool B_PLUS_TREE_LEAF_PAGE_TYPE::Lookup(const KeyType &key, ValueType *value, co
  */
 INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(const KeyType &key, const KeyComparator &comparator) {
-  for (int i = 0; i < GetSize(); i++) {
-    if (comparator(key, KeyAt(i)) == 0) {
-      for (int j = i + 1; j < GetSize(); j++) {
-        array_[j - 1] = array_[j];
-      }
-    }
+  int index = KeyIndex(key, comparator);
+  // key不存在，直接返回
+  if (index == GetSize() || comparator(key, KeyAt(index)) != 0) {
+    return GetSize();
   }
-  IncreaseSize(-1);
+  RemoveAt(index);
   return GetSize();
 }
 
@@ -211,8 +525,56 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(const KeyType &key, const
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient) {
-  recipient->CopyNFrom(array_, GetSize());
+  // recipient在左边，合并后的上界是本page的上界
+  std::vector<MappingType> items = Items(0, GetSize());
+  KeyType low_key = recipient->GetLowKey();
+  KeyType high_key = GetHighKey();
+  recipient->SetFences(recipient->has_low_key_ ? &low_key : nullptr, has_high_key_ ? &high_key : nullptr);
+  recipient->CopyNFrom(items.data(), GetSize());
   SetSize(0);
+  SlottedKeyArray::Reset(&slots_header_);
+  if (posting_) {
+    PostingLists().Reset();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::CanMoveAllTo(const BPlusTreeLeafPage *recipient) const {
+  if (posting_) {
+    // 在临时的page中按合并后的样子重新编码，合并后的page还要能再放下一个pair
+    char buffer[PAGE_SIZE];
+    PostingListArray merged(buffer, PAGE_SIZE - LEAF_PAGE_HEADER_SIZE(fence_size_));
+    merged.Reset();
+    for (const BPlusTreeLeafPage *page : {recipient, this}) {
+      for (const auto &item : page->Items(0, page->GetSize())) {
+        if (!AppendPosting(&merged, item)) {
+          return false;
+        }
+      }
+    }
+    return GetSize() + recipient->GetSize() + 1 < slots_header_.size_limit_ &&
+           merged.GetFreeSize() >= PostingListArray::GetMaxEntrySize(sizeof(KeyType));
+  }
+  if (!compressed_) {
+    return GetSize() + recipient->GetSize() < recipient->GetMaxSize();
+  }
+  // 按合并后的前缀计算两个page的pair占用的空间，合并后的page还要能再放下一个pair
+  KeyType low_key = recipient->GetLowKey();
+  KeyType high_key = GetHighKey();
+  int prefix_size =
+      GetPrefixSize(recipient->has_low_key_ ? &low_key : nullptr, has_high_key_ ? &high_key : nullptr);
+  int used_size = 0;
+  for (const BPlusTreeLeafPage *page : {recipient, this}) {
+    for (int i = 0; i < page->GetSize(); i++) {
+      KeyType key = page->KeyAt(i);
+      int key_size = SlottedKeyArray::SignificantSize(reinterpret_cast<const char *>(&key), sizeof(KeyType));
+      used_size += SlottedKeyArray::SLOT_SIZE + std::max(key_size - prefix_size, 0) + sizeof(ValueType);
+    }
+  }
+  int max_entry_size = SlottedKeyArray::SLOT_SIZE + sizeof(KeyType) - prefix_size + sizeof(ValueType);
+  int size = GetSize() + recipient->GetSize();
+  return size + 1 < slots_header_.size_limit_ &&
+         used_size + max_entry_size <= static_cast<int>(PAGE_SIZE - LEAF_PAGE_HEADER_SIZE(fence_size_));
 }
 
 /*****************************************************************************
@@ -228,11 +590,14 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient) {
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient) {
   // 将当前page的{key, value}移动到最后一个recipient 的最后一个位置
+  // 新的分隔key是本page移动之后的第一个key
   auto first_pair = GetItem(0);
-  for (int i = 1; i < GetSize(); i++) {
-    array_[i - 1] = array_[i];
-  }
-  IncreaseSize(-1);
+  RemoveAt(0);
+  KeyType separator = KeyAt(0);
+  KeyType high_key = GetHighKey();
+  KeyType low_key = recipient->GetLowKey();
+  SetFences(&separator, has_high_key_ ? &high_key : nullptr);
+  recipient->SetFences(recipient->has_low_key_ ? &low_key : nullptr, &separator);
   recipient->CopyLastFrom(first_pair);
 }
 
@@ -242,8 +607,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient)
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyLastFrom(const MappingType &item) {
   // 将item拷贝到当前array_的最后面
-  array_[GetSize()] = item;
-  IncreaseSize(1);
+  InsertAt(GetSize(), item);
 }
 
 /*
@@ -252,9 +616,14 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyLastFrom(const MappingType &item) {
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient) {
   // 将当前page的最后一个{key, value}移动到recipient的首部
+  // 新的分隔key就是移动的key
   auto last_pair = GetItem(GetSize() - 1);
+  RemoveAt(GetSize() - 1);
+  KeyType low_key = GetLowKey();
+  KeyType high_key = recipient->GetHighKey();
+  SetFences(has_low_key_ ? &low_key : nullptr, &last_pair.first);
+  recipient->SetFences(&last_pair.first, recipient->has_high_key_ ? &high_key : nullptr);
   recipient->CopyFirstFrom(last_pair);
-  IncreaseSize(-1);
 }
 
 /*
@@ -263,11 +632,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient)
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyFirstFrom(const MappingType &item) {
   // 将item拷贝到当前array_的首部
-  for (int i = GetSize(); i > 0; i--) {
-    array_[i] = array_[i - 1];
-  }
-  array_[0] = item;
-  IncreaseSize(1);
+  InsertAt(0, item);
 }
 
 template class BPlusTreeLeafPage<GenericKey<4>, RID, GenericComparator<4>>;
@@ -275,4 +640,6 @@ template class BPlusTreeLeafPage<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTreeLeafPage<GenericKey<16>, RID, GenericComparator<16>>;
 template class BPlusTreeLeafPage<GenericKey<32>, RID, GenericComparator<32>>;
 template class BPlusTreeLeafPage<GenericKey<64>, RID, GenericComparator<64>>;
+template class BPlusTreeLeafPage<GenericKey<128>, RID, GenericComparator<128>>;
+template class BPlusTreeLeafPage<GenericKey<256>, RID, GenericComparator<256>>;
 }  // namespace bustub
@@ -0,0 +1,321 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// posting_list_array.cpp
+//
+// Identification: src/storage/page/posting_list_array.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/page/posting_list_array.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "common/config.h"
+
+namespace bustub {
+
+namespace {
+
+// group内各字段的偏移
+constexpr int COUNT_OFFSET = 0;
+constexpr int TUPLE_SIZE_OFFSET = sizeof(uint16_t);
+constexpr int TUPLE_OFFSET = 2 * sizeof(uint16_t);
+
+/** Writes value as a LEB128 varint. @return bytes written */
+int PutVarint(char *dst, uint64_t value) {
+  int size = 0;
+  while (value >= 0x80) {
+    dst[size++] = static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  dst[size++] = static_cast<char>(value);
+  return size;
+}
+
+int VarintSize(uint64_t value) {
+  int size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+/** Reads a varint written by PutVarint. @return bytes read */
+int GetVarint(const char *src, uint64_t *value) {
+  *value = 0;
+  int size = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = static_cast<uint8_t>(src[size++]);
+    *value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    shift += 7;
+  } while ((byte & 0x80) != 0);
+  return size;
+}
+
+}  // namespace
+
+void PostingListArray::Reset() {
+  Header()->group_count_ = 0;
+  Header()->data_end_ = sizeof(PostingListHeader);
+}
+
+int PostingListArray::GetSize() const {
+  int group_count = GetGroupCount();
+  return group_count == 0 ? 0 : GetFirstIndex(group_count - 1) + GetCount(group_count - 1);
+}
+
+bool PostingListArray::Append(const char *tuple, int tuple_size, int64_t rid) {
+  int group_count = GetGroupCount();
+  int data_end = Header()->data_end_;
+  if (group_count > 0) {
+    int last = group_count - 1;
+    int last_size;
+    const char *last_tuple = GetTuple(last, &last_size);
+    if (last_size == tuple_size && memcmp(last_tuple, tuple, tuple_size) == 0) {
+      // 同一个key tuple，在最后一个posting list的末尾追加delta
+      int offset = GetEntry(last).offset_;
+      int64_t last_rid = GetLastRid(last);
+      assert(rid > last_rid);
+      uint64_t delta = static_cast<uint64_t>(rid) - static_cast<uint64_t>(last_rid);
+      if (GetFreeSize() < VarintSize(delta)) {
+        return false;
+      }
+      Header()->data_end_ = static_cast<uint16_t>(data_end + PutVarint(data_ + data_end, delta));
+      Write<uint16_t>(offset + COUNT_OFFSET, static_cast<uint16_t>(GetCount(last) + 1));
+      Write<int64_t>(offset + TUPLE_OFFSET + tuple_size + sizeof(int64_t), rid);
+      return true;
+    }
+  }
+  if (GetFreeSize() < DIRECTORY_ENTRY_SIZE + GROUP_HEADER_SIZE + tuple_size) {
+    return false;
+  }
+  int first_index = GetSize();
+  Write<uint16_t>(data_end + COUNT_OFFSET, 1);
+  Write<uint16_t>(data_end + TUPLE_SIZE_OFFSET, static_cast<uint16_t>(tuple_size));
+  memcpy(data_ + data_end + TUPLE_OFFSET, tuple, tuple_size);
+  Write<int64_t>(data_end + TUPLE_OFFSET + tuple_size, rid);
+  Write<int64_t>(data_end + TUPLE_OFFSET + tuple_size + sizeof(int64_t), rid);
+  SetEntry(group_count, DirectoryEntry{static_cast<uint16_t>(data_end), static_cast<uint16_t>(first_index)});
+  Header()->group_count_ = static_cast<uint16_t>(group_count + 1);
+  Header()->data_end_ = static_cast<uint16_t>(data_end + GROUP_HEADER_SIZE + tuple_size);
+  return true;
+}
+
+bool PostingListArray::Insert(int index, const char *tuple, int tuple_size, int64_t rid) {
+  if (index == GetSize()) {
+    return Append(tuple, tuple_size, rid);
+  }
+  // 和前一个或者后一个entry的key tuple相同时插入它的posting list
+  auto same_tuple = [&](int group) {
+    int group_tuple_size;
+    const char *group_tuple = GetTuple(group, &group_tuple_size);
+    return group_tuple_size == tuple_size && memcmp(group_tuple, tuple, tuple_size) == 0;
+  };
+  int next_group = FindGroup(index);
+  int group = -1;
+  if (index > 0 && same_tuple(FindGroup(index - 1))) {
+    group = FindGroup(index - 1);
+  } else if (same_tuple(next_group)) {
+    group = next_group;
+  }
+  if (group >= 0) {
+    std::vector<int64_t> rids;
+    GetRids(group, &rids);
+    rids.insert(rids.begin() + (index - GetFirstIndex(group)), rid);
+    if (!SetRids(group, rids)) {
+      return false;
+    }
+    MoveFirstIndexes(group + 1, 1);
+    return true;
+  }
+  // 新的posting list，entry index是下一个posting list的第一个entry
+  assert(GetFirstIndex(next_group) == index);
+  int group_size = GROUP_HEADER_SIZE + tuple_size;
+  int group_count = GetGroupCount();
+  if (GetFreeSize() < DIRECTORY_ENTRY_SIZE + group_size) {
+    return false;
+  }
+  int offset = GetEntry(next_group).offset_;
+  MoveData(offset, group_size);
+  Write<uint16_t>(offset + COUNT_OFFSET, 1);
+  Write<uint16_t>(offset + TUPLE_SIZE_OFFSET, static_cast<uint16_t>(tuple_size));
+  memcpy(data_ + offset + TUPLE_OFFSET, tuple, tuple_size);
+  Write<int64_t>(offset + TUPLE_OFFSET + tuple_size, rid);
+  Write<int64_t>(offset + TUPLE_OFFSET + tuple_size + sizeof(int64_t), rid);
+  // 目录从后往前增长，next_group及之后的目录项向前移一项
+  char *directory = data_ + size_ - group_count * DIRECTORY_ENTRY_SIZE;
+  memmove(directory - DIRECTORY_ENTRY_SIZE, directory, (group_count - next_group) * DIRECTORY_ENTRY_SIZE);
+  Header()->group_count_ = static_cast<uint16_t>(group_count + 1);
+  SetEntry(next_group, DirectoryEntry{static_cast<uint16_t>(offset), static_cast<uint16_t>(index)});
+  MoveFirstIndexes(next_group + 1, 1);
+  return true;
+}
+
+void PostingListArray::Remove(int index) {
+  int group = FindGroup(index);
+  if (GetCount(group) > 1) {
+    std::vector<int64_t> rids;
+    GetRids(group, &rids);
+    rids.erase(rids.begin() + (index - GetFirstIndex(group)));
+    bool fits = SetRids(group, rids);
+    assert(fits);
+    (void)fits;
+    MoveFirstIndexes(group + 1, -1);
+    return;
+  }
+  // 删除整个posting list和它的目录项
+  int group_count = GetGroupCount();
+  int offset = GetEntry(group).offset_;
+  MoveData(GroupEnd(group), offset - GroupEnd(group));
+  char *directory = data_ + size_ - group_count * DIRECTORY_ENTRY_SIZE;
+  memmove(directory + DIRECTORY_ENTRY_SIZE, directory, (group_count - group - 1) * DIRECTORY_ENTRY_SIZE);
+  Header()->group_count_ = static_cast<uint16_t>(group_count - 1);
+  MoveFirstIndexes(group, -1);
+}
+
+int PostingListArray::FindGroup(int index) const {
+  // 最后一个first index <= index的posting list
+  int left = 0;
+  int right = GetGroupCount() - 1;
+  while (left < right) {
+    int mid = left + (right - left + 1) / 2;
+    if (GetEntry(mid).first_index_ <= index) {
+      left = mid;
+    } else {
+      right = mid - 1;
+    }
+  }
+  return left;
+}
+
+int PostingListArray::GetFirstIndex(int group) const { return GetEntry(group).first_index_; }
+
+int PostingListArray::GetCount(int group) const { return Read<uint16_t>(GetEntry(group).offset_ + COUNT_OFFSET); }
+
+const char *PostingListArray::GetTuple(int group, int *tuple_size) const {
+  int offset = GetEntry(group).offset_;
+  *tuple_size = Read<uint16_t>(offset + TUPLE_SIZE_OFFSET);
+  return data_ + offset + TUPLE_OFFSET;
+}
+
+int64_t PostingListArray::GetFirstRid(int group) const {
+  return Read<int64_t>(DeltasOffset(group) - 2 * sizeof(int64_t));
+}
+
+int64_t PostingListArray::GetLastRid(int group) const { return Read<int64_t>(DeltasOffset(group) - sizeof(int64_t)); }
+
+int64_t PostingListArray::GetRid(int group, int position) const {
+  const char *delta = data_ + DeltasOffset(group);
+  auto rid = static_cast<uint64_t>(GetFirstRid(group));
+  for (int i = 0; i < position; i++) {
+    uint64_t value;
+    delta += GetVarint(delta, &value);
+    rid += value;
+  }
+  return static_cast<int64_t>(rid);
+}
+
+void PostingListArray::GetRids(int group, std::vector<int64_t> *rids) const {
+  int count = GetCount(group);
+  const char *delta = data_ + DeltasOffset(group);
+  auto rid = static_cast<uint64_t>(GetFirstRid(group));
+  rids->clear();
+  rids->reserve(count);
+  rids->push_back(static_cast<int64_t>(rid));
+  for (int i = 1; i < count; i++) {
+    uint64_t value;
+    delta += GetVarint(delta, &value);
+    rid += value;
+    rids->push_back(static_cast<int64_t>(rid));
+  }
+}
+
+int PostingListArray::GetFreeSize() const {
+  return size_ - GetGroupCount() * DIRECTORY_ENTRY_SIZE - Header()->data_end_;
+}
+
+PostingListArray::DirectoryEntry PostingListArray::GetEntry(int group) const {
+  return Read<DirectoryEntry>(size_ - (group + 1) * DIRECTORY_ENTRY_SIZE);
+}
+
+void PostingListArray::SetEntry(int group, DirectoryEntry entry) {
+  Write<DirectoryEntry>(size_ - (group + 1) * DIRECTORY_ENTRY_SIZE, entry);
+}
+
+int PostingListArray::DeltasOffset(int group) const {
+  int offset = GetEntry(group).offset_;
+  return offset + TUPLE_OFFSET + Read<uint16_t>(offset + TUPLE_SIZE_OFFSET) + 2 * sizeof(int64_t);
+}
+
+int PostingListArray::GroupEnd(int group) const {
+  return group + 1 == GetGroupCount() ? Header()->data_end_ : GetEntry(group + 1).offset_;
+}
+
+bool PostingListArray::SetRids(int group, const std::vector<int64_t> &rids) {
+  // 重新编码delta，posting list的长度变化时移动之后的数据
+  char deltas[PAGE_SIZE];
+  int deltas_size = 0;
+  for (size_t i = 1; i < rids.size(); i++) {
+    deltas_size += PutVarint(deltas + deltas_size, static_cast<uint64_t>(rids[i]) - static_cast<uint64_t>(rids[i - 1]));
+  }
+  int offset = DeltasOffset(group);
+  int end = GroupEnd(group);
+  int growth = offset + deltas_size - end;
+  if (growth > GetFreeSize()) {
+    return false;
+  }
+  MoveData(end, growth);
+  memcpy(data_ + offset, deltas, deltas_size);
+  int group_offset = GetEntry(group).offset_;
+  Write<uint16_t>(group_offset + COUNT_OFFSET, static_cast<uint16_t>(rids.size()));
+  Write<int64_t>(offset - 2 * sizeof(int64_t), rids.front());
+  Write<int64_t>(offset - sizeof(int64_t), rids.back());
+  return true;
+}
+
+void PostingListArray::MoveData(int offset, int delta) {
+  if (delta == 0) {
+    return;
+  }
+  int data_end = Header()->data_end_;
+  memmove(data_ + offset + delta, data_ + offset, data_end - offset);
+  Header()->data_end_ = static_cast<uint16_t>(data_end + delta);
+  for (int i = 0; i < GetGroupCount(); i++) {
+    DirectoryEntry entry = GetEntry(i);
+    if (entry.offset_ >= offset) {
+      entry.offset_ = static_cast<uint16_t>(entry.offset_ + delta);
+      SetEntry(i, entry);
+    }
+  }
+}
+
+void PostingListArray::MoveFirstIndexes(int group, int delta) {
+  for (int i = group; i < GetGroupCount(); i++) {
+    DirectoryEntry entry = GetEntry(i);
+    entry.first_index_ = static_cast<uint16_t>(entry.first_index_ + delta);
+    SetEntry(i, entry);
+  }
+}
+
+template <typename T>
+T PostingListArray::Read(int offset) const {
+  // 字段没有对齐
+  T value;
+  memcpy(&value, data_ + offset, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void PostingListArray::Write(int offset, T value) {
+  memcpy(data_ + offset, &value, sizeof(T));
+}
+
+}  // namespace bustub
@@ -0,0 +1,149 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// slotted_key_array.cpp
+//
+// Identification: src/storage/page/slotted_key_array.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/page/slotted_key_array.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace bustub {
+
+int SlottedKeyArray::CommonPrefix(const char *lhs, const char *rhs, int n) {
+  int i = 0;
+  while (i < n && lhs[i] == rhs[i]) {
+    i++;
+  }
+  return i;
+}
+
+int SlottedKeyArray::SignificantSize(const char *key, int key_size) {
+  while (key_size > 0 && key[key_size - 1] == 0) {
+    key_size--;
+  }
+  return key_size;
+}
+
+int SlottedKeyArray::Compare(const char *key, int significant_size, int index) const {
+  // entry的key = prefix + 存储的字节 + 0，key和prefix相同的部分不用比较
+  int prefix_size = header_->prefix_size_;
+  Slot slot = GetSlot(index);
+  int cmp = memcmp(reinterpret_cast<const unsigned char *>(key) + prefix_size,
+                   reinterpret_cast<const unsigned char *>(page_) + slot.offset_, slot.key_size_);
+  if (cmp != 0) {
+    return cmp;
+  }
+  // 之后entry的key全是0，key还有非0字节时更大
+  return significant_size > prefix_size + slot.key_size_ ? 1 : 0;
+}
+
+int SlottedKeyArray::Search(const char *key, int begin, bool upper) const {
+  int prefix_size = header_->prefix_size_;
+  int cmp = memcmp(key, prefix_, prefix_size);
+  if (cmp != 0) {
+    // key不在page的范围内，比所有key都小或者都大
+    return cmp < 0 ? begin : size_;
+  }
+  int significant_size = SignificantSize(key, key_size_);
+  int left = begin;
+  int right = size_;
+  while (left < right) {
+    int mid = left + (right - left) / 2;
+    int c = Compare(key, significant_size, mid);
+    if (c > 0 || (upper && c == 0)) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+void SlottedKeyArray::GetKey(int index, char *key) const {
+  int prefix_size = header_->prefix_size_;
+  Slot slot = GetSlot(index);
+  memcpy(key, prefix_, prefix_size);
+  memcpy(key + prefix_size, page_ + slot.offset_, slot.key_size_);
+  memset(key + prefix_size + slot.key_size_, 0, key_size_ - prefix_size - slot.key_size_);
+}
+
+const char *SlottedKeyArray::GetValue(int index) const {
+  Slot slot = GetSlot(index);
+  return page_ + slot.offset_ + slot.key_size_;
+}
+
+void SlottedKeyArray::SetValue(int index, const char *value) {
+  Slot slot = GetSlot(index);
+  memcpy(page_ + slot.offset_ + slot.key_size_, value, value_size_);
+}
+
+bool SlottedKeyArray::Insert(int index, const char *key, const char *value) {
+  int prefix_size = header_->prefix_size_;
+  assert(memcmp(key, prefix_, prefix_size) == 0);
+  int key_size = std::max(SignificantSize(key, key_size_) - prefix_size, 0);
+  int entry_size = key_size + value_size_;
+  if (GetFreeSize() < entry_size + SLOT_SIZE) {
+    return false;
+  }
+  if (header_->heap_begin_ - SlotsEnd() < entry_size + SLOT_SIZE) {
+    Compact();
+  }
+  header_->heap_begin_ -= entry_size;
+  memcpy(page_ + header_->heap_begin_, key + prefix_size, key_size);
+  memcpy(page_ + header_->heap_begin_ + key_size, value, value_size_);
+  memmove(slots_ + (index + 1) * SLOT_SIZE, slots_ + index * SLOT_SIZE, (size_ - index) * SLOT_SIZE);
+  size_++;
+  SetSlot(index, Slot{header_->heap_begin_, static_cast<uint16_t>(key_size)});
+  return true;
+}
+
+void SlottedKeyArray::Remove(int index) {
+  Slot slot = GetSlot(index);
+  if (slot.offset_ == header_->heap_begin_) {
+    // 最后分配的entry直接还给heap
+    header_->heap_begin_ += slot.key_size_ + value_size_;
+  } else {
+    header_->garbage_size_ += slot.key_size_ + value_size_;
+  }
+  memmove(slots_ + index * SLOT_SIZE, slots_ + (index + 1) * SLOT_SIZE, (size_ - index - 1) * SLOT_SIZE);
+  size_--;
+}
+
+int SlottedKeyArray::GetEntrySize(const char *key) const {
+  return SLOT_SIZE + std::max(SignificantSize(key, key_size_) - header_->prefix_size_, 0) + value_size_;
+}
+
+SlottedKeyArray::Slot SlottedKeyArray::GetSlot(int index) const {
+  Slot slot;
+  memcpy(&slot, slots_ + index * SLOT_SIZE, SLOT_SIZE);
+  return slot;
+}
+
+void SlottedKeyArray::SetSlot(int index, Slot slot) { memcpy(slots_ + index * SLOT_SIZE, &slot, SLOT_SIZE); }
+
+void SlottedKeyArray::Compact() {
+  char buffer[PAGE_SIZE];
+  int heap_begin = PAGE_SIZE;
+  for (int i = 0; i < size_; i++) {
+    Slot slot = GetSlot(i);
+    int entry_size = slot.key_size_ + value_size_;
+    heap_begin -= entry_size;
+    memcpy(buffer + heap_begin, page_ + slot.offset_, entry_size);
+    slot.offset_ = static_cast<uint16_t>(heap_begin);
+    SetSlot(i, slot);
+  }
+  memcpy(page_ + heap_begin, buffer + heap_begin, PAGE_SIZE - heap_begin);
+  header_->heap_begin_ = static_cast<uint16_t>(heap_begin);
+  header_->garbage_size_ = 0;
+}
+
+}  // namespace bustub
@@ -180,4 +180,86 @@ TEST(BufferPoolManagerTest, SampleTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, AlignedFrameTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name, true);
+  auto *bpm = new BufferPoolManager(buffer_pool_size, disk_manager, nullptr, true);
+
+  // Scenario: every frame is page aligned and zeroed, so it can be handed to O_DIRECT as is.
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    char *data = (bpm->GetPages() + i)->GetData();
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(data) % PAGE_SIZE);
+    EXPECT_EQ(0, data[0]);
+    EXPECT_EQ(0, data[PAGE_SIZE - 1]);
+  }
+
+  // Scenario: pages written back through direct I/O can be read again.
+  page_id_t page_id_temp;
+  auto *page0 = bpm->NewPage(&page_id_temp);
+  ASSERT_NE(nullptr, page0);
+  snprintf(page0->GetData(), PAGE_SIZE, "Hello");
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  for (size_t i = 1; i <= buffer_pool_size; ++i) {
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  }
+  page0 = bpm->FetchPage(0);
+  ASSERT_NE(nullptr, page0);
+  EXPECT_EQ(0, strcmp(page0->GetData(), "Hello"));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, SegmentTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(buffer_pool_size, disk_manager);
+  segment_id_t segment_id = disk_manager->CreateSegment("orders");
+
+  // Scenario: pages of a segment survive eviction like pages of the db file.
+  page_id_t segment_page_id;
+  auto *page = bpm->NewPage(&segment_page_id, segment_id);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(segment_id, DiskManager::GetSegmentId(segment_page_id));
+  snprintf(page->GetData(), PAGE_SIZE, "Hello");
+  EXPECT_EQ(true, bpm->UnpinPage(segment_page_id, true));
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  }
+  page = bpm->FetchPage(segment_page_id);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "Hello"));
+
+  // Scenario: a segment with pinned pages can't be dropped.
+  EXPECT_EQ(false, bpm->DropSegment(segment_id));
+  EXPECT_EQ(true, bpm->UnpinPage(segment_page_id, true));
+  EXPECT_EQ(true, bpm->DropSegment(segment_id));
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp, segment_id));
+
+  // Scenario: the dropped pages left their frames, every frame can be pinned again.
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.segments");
+
+  delete bpm;
+  delete disk_manager;
+}
+
 }  // namespace bustub
@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cstdio>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -48,4 +49,132 @@ TEST(CatalogTest, DISABLED_CreateTableTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(CatalogTest, CreateIndexTest) {
+  auto disk_manager = new DiskManager("catalog_test.db");
+  auto bpm = new BufferPoolManager(32, disk_manager);
+  auto catalog = new Catalog(bpm, nullptr, nullptr);
+  Transaction txn(0);
+  // B+ tree indexes record their root in the header page
+  page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  bpm->UnpinPage(header_page_id, true);
+
+  std::vector<Column> columns;
+  columns.emplace_back("A", TypeId::BIGINT);
+  columns.emplace_back("B", TypeId::INTEGER);
+  Schema schema(columns);
+  auto *table_metadata = catalog->CreateTable(&txn, "potato", schema);
+  EXPECT_EQ(catalog->GetTable("potato"), table_metadata);
+  EXPECT_EQ(catalog->GetTable(table_metadata->oid_), table_metadata);
+  EXPECT_THROW(catalog->GetTable("tomato"), std::out_of_range);
+  std::vector<RID> rids;
+  for (int64_t a = 0; a < 100; a++) {
+    Tuple tuple({ValueFactory::GetBigIntValue(a), ValueFactory::GetIntegerValue(static_cast<int32_t>(a % 10))},
+                &schema);
+    RID rid;
+    ASSERT_TRUE(table_metadata->table_->InsertTuple(tuple, &rid, &txn));
+    rids.push_back(rid);
+  }
+
+  // both kinds of index are filled from the rows of the table
+  std::vector<Column> key_columns;
+  key_columns.emplace_back("A", TypeId::BIGINT);
+  Schema key_schema(key_columns);
+  auto *tree_index = catalog->CreateIndex<GenericKey<8>, RID, GenericComparator<8>>(&txn, "tree_index", "potato",
+                                                                                    schema, key_schema, {0}, 8);
+  auto *art_index = catalog->CreateIndex<GenericKey<8>, RID, GenericComparator<8>>(
+      &txn, "art_index", "potato", schema, key_schema, {0}, 8, IndexType::ART);
+  using TreeIndex = BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>>;
+  EXPECT_NE(dynamic_cast<TreeIndex *>(tree_index->index_.get()), nullptr);
+  EXPECT_NE(dynamic_cast<ARTIndex *>(art_index->index_.get()), nullptr);
+  EXPECT_EQ(catalog->GetIndex("art_index", "potato"), art_index);
+  EXPECT_EQ(catalog->GetIndex(tree_index->index_oid_), tree_index);
+  EXPECT_EQ(catalog->GetTableIndexes("potato").size(), 2);
+  EXPECT_TRUE(catalog->GetTableIndexes("tomato").empty());
+  for (auto *index_info : {tree_index, art_index}) {
+    for (int64_t a = 0; a < 100; a++) {
+      std::vector<RID> result;
+      index_info->index_->ScanKey(Tuple({ValueFactory::GetBigIntValue(a)}, &key_schema), &result, &txn);
+      ASSERT_EQ(result, std::vector<RID>{rids[a]});
+    }
+  }
+
+  delete catalog;
+  delete bpm;
+  delete disk_manager;
+  remove("catalog_test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(CatalogTest, CoveringIndexTest) {
+  auto disk_manager = new DiskManager("catalog_test.db");
+  auto bpm = new BufferPoolManager(32, disk_manager);
+  auto catalog = new Catalog(bpm, nullptr, nullptr);
+  Transaction txn(0);
+  page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  bpm->UnpinPage(header_page_id, true);
+
+  std::vector<Column> columns;
+  columns.emplace_back("A", TypeId::BIGINT);
+  columns.emplace_back("B", TypeId::INTEGER);
+  columns.emplace_back("C", TypeId::BOOLEAN);
+  Schema schema(columns);
+  auto *table_metadata = catalog->CreateTable(&txn, "potato", schema);
+  std::vector<RID> rids;
+  for (int64_t a = 0; a < 100; a++) {
+    Tuple tuple({ValueFactory::GetBigIntValue(a), ValueFactory::GetIntegerValue(static_cast<int32_t>(a * 3)),
+                 ValueFactory::GetBooleanValue(a % 2 == 0)},
+                &schema);
+    RID rid;
+    ASSERT_TRUE(table_metadata->table_->InsertTuple(tuple, &rid, &txn));
+    rids.push_back(rid);
+  }
+
+  // the index on A includes B, the entries of A and B take 12 bytes
+  std::vector<Column> key_columns;
+  key_columns.emplace_back("A", TypeId::BIGINT);
+  Schema key_schema(key_columns);
+  auto *index_info = catalog->CreateIndex<GenericKey<16>, RID, GenericComparator<16>>(
+      &txn, "covering_index", "potato", schema, key_schema, {0}, 16, IndexType::BPLUS_TREE, {1});
+  EXPECT_THROW((catalog->CreateIndex<GenericKey<16>, RID, GenericComparator<16>>(
+                   &txn, "art_index", "potato", schema, key_schema, {0}, 16, IndexType::ART, {1})),
+               Exception);
+  Index *index = index_info->index_.get();
+  EXPECT_TRUE(index->GetMetadata()->Covers({1, 0}));
+  EXPECT_FALSE(index->GetMetadata()->Covers({0, 2}));
+  EXPECT_EQ(index->GetMetadata()->GetEntrySchema()->GetColumnCount(), 2);
+
+  // lookups take key tuples, the included values come with the entries
+  for (int64_t a = 0; a < 100; a++) {
+    Tuple key({ValueFactory::GetBigIntValue(a)}, &key_schema);
+    std::vector<std::pair<Tuple, RID>> entries;
+    index->ScanEntries(key, &entries, &txn);
+    ASSERT_EQ(entries.size(), 1);
+    EXPECT_EQ(entries[0].second, rids[a]);
+    const Schema *entry_schema = index->GetMetadata()->GetEntrySchema();
+    EXPECT_EQ(entries[0].first.GetValue(entry_schema, 0).GetAs<int64_t>(), a);
+    EXPECT_EQ(entries[0].first.GetValue(entry_schema, 1).GetAs<int32_t>(), a * 3);
+    std::vector<RID> result;
+    index->ScanKey(key, &result, &txn);
+    ASSERT_EQ(result, std::vector<RID>{rids[a]});
+  }
+
+  // DeleteEntry takes the entry tuple like InsertEntry
+  Tuple row;
+  ASSERT_TRUE(table_metadata->table_->GetTuple(rids[7], &row, &txn));
+  index->DeleteEntry(row.KeyFromTuple(schema, *index->GetMetadata()->GetEntrySchema(),
+                                      index->GetMetadata()->GetEntryAttrs()),
+                     rids[7], &txn);
+  std::vector<std::pair<Tuple, RID>> entries;
+  index->ScanEntries(Tuple({ValueFactory::GetBigIntValue(7)}, &key_schema), &entries, &txn);
+  EXPECT_TRUE(entries.empty());
+
+  delete catalog;
+  delete bpm;
+  delete disk_manager;
+  remove("catalog_test.db");
+}
+
 }  // namespace bustub
@@ -0,0 +1,312 @@
+/**
+ * art_index_test.cpp
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/art_index.h"
+#include "storage/index/b_plus_tree_index.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+std::vector<RID> Scan(Index *index, const Tuple &key) {
+  std::vector<RID> rids;
+  index->ScanKey(key, &rids, nullptr);
+  std::sort(rids.begin(), rids.end(), [](const RID &lhs, const RID &rhs) { return lhs.Get() < rhs.Get(); });
+  return rids;
+}
+
+}  // namespace
+
+TEST(ARTIndexTest, UniqueTest) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  ARTIndex index(new IndexMetadata("art_index", "foo", table_schema, {0}));
+  auto make_key = [&](int64_t a) { return Tuple({ValueFactory::GetBigIntValue(a)}, index.GetKeySchema()); };
+
+  // random keys spread over the whole range, and dense keys that fill Node48 and Node256 nodes
+  std::mt19937_64 generator(15445);
+  std::vector<int64_t> keys;
+  for (int i = 0; i < 5000; i++) {
+    keys.push_back(static_cast<int64_t>(generator()));
+  }
+  for (int64_t key = -3000; key < 3000; key++) {
+    keys.push_back(key);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  std::shuffle(keys.begin(), keys.end(), generator);
+  for (auto key : keys) {
+    index.InsertEntry(make_key(key), RID(key), nullptr);
+  }
+  // a key that is already there keeps its rid
+  index.InsertEntry(make_key(keys[0]), RID(0, 0), nullptr);
+  EXPECT_EQ(index.GetSize(), keys.size());
+  for (auto key : keys) {
+    ASSERT_EQ(Scan(&index, make_key(key)), std::vector<RID>{RID(key)}) << key;
+  }
+  EXPECT_TRUE(Scan(&index, make_key(3000)).empty());
+  EXPECT_TRUE(Scan(&index, make_key(std::numeric_limits<int64_t>::max())).empty());
+
+  // removing half of the keys shrinks and removes nodes, the rest is still there
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    index.DeleteEntry(make_key(keys[i]), RID(keys[i]), nullptr);
+  }
+  index.DeleteEntry(make_key(3000), RID(3000), nullptr);
+  EXPECT_EQ(index.GetSize(), keys.size() / 2);
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(Scan(&index, make_key(keys[i])).size(), i % 2) << keys[i];
+  }
+  // an empty tree takes new keys again
+  for (size_t i = 1; i < keys.size(); i += 2) {
+    index.DeleteEntry(make_key(keys[i]), RID(keys[i]), nullptr);
+  }
+  EXPECT_EQ(index.GetSize(), 0);
+  index.InsertEntry(make_key(42), RID(42), nullptr);
+  EXPECT_EQ(Scan(&index, make_key(42)), std::vector<RID>{RID(42)});
+  delete table_schema;
+}
+
+TEST(ARTIndexTest, VarcharTest) {
+  // long shared prefixes take chains of nodes, keys that differ within a prefix split it
+  Schema *table_schema = ParseCreateStatement("a varchar(64),b integer");
+  ARTIndex index(new IndexMetadata("art_index", "foo", table_schema, {0, 1}));
+  auto make_key = [&](const std::string &a, int32_t b) {
+    return Tuple({ValueFactory::GetVarcharValue(a), ValueFactory::GetIntegerValue(b)}, index.GetKeySchema());
+  };
+  const std::string long_prefix(40, 'x');
+  std::vector<std::pair<std::string, int32_t>> keys;
+  for (int32_t i = 0; i < 300; i++) {
+    keys.emplace_back(long_prefix + std::to_string(i), i);
+    keys.emplace_back(long_prefix.substr(0, i % 40) + "y", i);
+    keys.emplace_back("", i);
+    keys.emplace_back(std::string("a\0b", 3) + std::to_string(i % 7), i);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+  for (size_t i = 0; i < keys.size(); i++) {
+    index.InsertEntry(make_key(keys[i].first, keys[i].second), RID(i), nullptr);
+  }
+  EXPECT_EQ(index.GetSize(), keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(Scan(&index, make_key(keys[i].first, keys[i].second)), std::vector<RID>{RID(i)}) << i;
+  }
+  EXPECT_TRUE(Scan(&index, make_key(long_prefix, 0)).empty());
+  EXPECT_TRUE(Scan(&index, make_key(long_prefix + "0", 1)).empty());
+  for (size_t i = 0; i < keys.size(); i++) {
+    index.DeleteEntry(make_key(keys[i].first, keys[i].second), RID(i), nullptr);
+    if (i % 97 == 0) {
+      for (size_t j = i + 1; j < keys.size(); j++) {
+        ASSERT_EQ(Scan(&index, make_key(keys[j].first, keys[j].second)).size(), 1) << j;
+      }
+    }
+  }
+  EXPECT_EQ(index.GetSize(), 0);
+  delete table_schema;
+}
+
+TEST(ARTIndexTest, NonUniqueTest) {
+  Schema *table_schema = ParseCreateStatement("a integer,b integer");
+  ARTIndex index(new IndexMetadata("art_index", "foo", table_schema, {0}, KeyFormat::NORMALIZED, false));
+  auto make_key = [&](int32_t a) { return Tuple({ValueFactory::GetIntegerValue(a)}, index.GetKeySchema()); };
+  const int32_t keys = 20;
+  const int32_t rids_per_key = 300;
+  std::vector<RID> key_rids;
+  for (int32_t i = 0; i < rids_per_key; i++) {
+    key_rids.emplace_back(i % 7 - 1, i);
+  }
+  for (int32_t a = 0; a < keys; a++) {
+    for (const auto &rid : key_rids) {
+      index.InsertEntry(make_key(a), rid, nullptr);
+    }
+  }
+  std::sort(key_rids.begin(), key_rids.end(), [](const RID &lhs, const RID &rhs) { return lhs.Get() < rhs.Get(); });
+  EXPECT_EQ(index.GetSize(), keys * rids_per_key);
+  for (int32_t a = 0; a < keys; a++) {
+    EXPECT_EQ(Scan(&index, make_key(a)), key_rids);
+  }
+  EXPECT_TRUE(Scan(&index, make_key(keys)).empty());
+
+  // a delete only removes the entry of its rid
+  index.DeleteEntry(make_key(7), RID(-1, 0), nullptr);
+  index.DeleteEntry(make_key(7), RID(5, 6), nullptr);
+  index.DeleteEntry(make_key(7), RID(0, 0), nullptr);
+  EXPECT_EQ(Scan(&index, make_key(7)).size(), rids_per_key - 2);
+  EXPECT_EQ(Scan(&index, make_key(6)), key_rids);
+  delete table_schema;
+}
+
+TEST(ARTIndexTest, ConcurrentTest) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  ARTIndex index(new IndexMetadata("art_index", "foo", table_schema, {0}));
+  auto make_key = [&](int64_t a) { return Tuple({ValueFactory::GetBigIntValue(a)}, index.GetKeySchema()); };
+  const int num_threads = 4;
+  const int64_t keys_per_thread = 5000;
+  // the keys of the threads interleave, so that they grow, split and shrink the same nodes
+  auto thread_key = [&](int thread, int64_t i) { return i * num_threads + thread; };
+
+  // the stable keys are in the index all the time, readers must always find them
+  for (int64_t i = 0; i < keys_per_thread; i++) {
+    index.InsertEntry(make_key(-thread_key(0, i) - 1), RID(-thread_key(0, i) - 1), nullptr);
+  }
+  std::atomic<bool> done{false};
+  std::atomic<int> errors{0};
+  std::thread reader([&] {
+    std::mt19937_64 generator(1);
+    while (!done) {
+      int64_t key = -static_cast<int64_t>(generator() % keys_per_thread) * num_threads - 1;
+      std::vector<RID> rids;
+      index.ScanKey(make_key(key), &rids, nullptr);
+      if (rids.size() != 1 || !(rids[0] == RID(key))) {
+        errors++;
+      }
+    }
+  });
+  std::vector<std::thread> writers;
+  for (int thread = 0; thread < num_threads; thread++) {
+    writers.emplace_back([&, thread] {
+      for (int round = 0; round < 2; round++) {
+        for (int64_t i = 0; i < keys_per_thread; i++) {
+          index.InsertEntry(make_key(thread_key(thread, i)), RID(thread_key(thread, i)), nullptr);
+        }
+        for (int64_t i = 0; i < keys_per_thread; i++) {
+          std::vector<RID> rids;
+          index.ScanKey(make_key(thread_key(thread, i)), &rids, nullptr);
+          if (rids.size() != 1) {
+            errors++;
+          }
+        }
+        for (int64_t i = round == 0 ? 0 : 1; i < keys_per_thread; i += round == 0 ? 1 : 2) {
+          index.DeleteEntry(make_key(thread_key(thread, i)), RID(thread_key(thread, i)), nullptr);
+        }
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(errors, 0);
+  EXPECT_EQ(index.GetSize(), keys_per_thread + num_threads * keys_per_thread / 2);
+  for (int thread = 0; thread < num_threads; thread++) {
+    for (int64_t i = 0; i < keys_per_thread; i++) {
+      ASSERT_EQ(Scan(&index, make_key(thread_key(thread, i))).size(), 1 - i % 2) << thread_key(thread, i);
+    }
+  }
+  delete table_schema;
+}
+
+TEST(ARTIndexTest, ManyThreadsTest) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  ARTIndex index(new IndexMetadata("art_index", "foo", table_schema, {0}));
+  auto make_key = [&](int64_t a) { return Tuple({ValueFactory::GetBigIntValue(a)}, index.GetKeySchema()); };
+  // more threads than epoch slots, the threads that find no free slot wait for one
+  const int num_threads = 128;
+  const int64_t keys_per_thread = 200;
+  std::atomic<int> errors{0};
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < num_threads; thread++) {
+    threads.emplace_back([&, thread] {
+      for (int64_t i = 0; i < keys_per_thread; i++) {
+        index.InsertEntry(make_key(i * num_threads + thread), RID(i * num_threads + thread), nullptr);
+      }
+      for (int64_t i = 0; i < keys_per_thread; i += 2) {
+        index.DeleteEntry(make_key(i * num_threads + thread), RID(i * num_threads + thread), nullptr);
+      }
+      for (int64_t i = 0; i < keys_per_thread; i++) {
+        std::vector<RID> rids;
+        index.ScanKey(make_key(i * num_threads + thread), &rids, nullptr);
+        if (rids.size() != static_cast<size_t>(i % 2)) {
+          errors++;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(errors, 0);
+  EXPECT_EQ(index.GetSize(), num_threads * keys_per_thread / 2);
+  delete table_schema;
+}
+
+// Benchmark: inserts and point lookups of an ARTIndex against a BPlusTreeIndex whose pages all fit into the buffer
+// pool, single threaded and with four threads. It only prints timings, so it is disabled; run it with
+// --gtest_also_run_disabled_tests.
+TEST(ARTIndexTest, DISABLED_Benchmark) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  using TreeIndex = BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>>;
+  const int64_t num_keys = 100000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < num_keys; key++) {
+    keys.push_back(key * 7919 % num_keys);
+  }
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(2000, disk_manager);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  {
+    ARTIndex art(new IndexMetadata("art_index", "foo", table_schema, {0}));
+    TreeIndex tree(new IndexMetadata("tree_index", "foo", table_schema, {0}), bpm);
+    Transaction transaction(0);
+    for (Index *index : std::vector<Index *>{&tree, &art}) {
+      const char *name = index == &art ? "ARTIndex" : "BPlusTreeIndex";
+      std::vector<Tuple> tuples;
+      for (auto key : keys) {
+        tuples.emplace_back(std::vector<Value>{ValueFactory::GetBigIntValue(key)}, index->GetKeySchema());
+      }
+      auto start = std::chrono::steady_clock::now();
+      for (int64_t i = 0; i < num_keys; i++) {
+        index->InsertEntry(tuples[i], RID(keys[i]), &transaction);
+      }
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      std::cout << name << ": " << static_cast<double>(elapsed.count()) / num_keys << " ns/insert" << std::endl;
+
+      for (int num_threads : {1, 4}) {
+        std::atomic<int64_t> found{0};
+        start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < num_threads; thread++) {
+          threads.emplace_back([&, thread] {
+            Transaction lookup_transaction(thread + 1);
+            std::vector<RID> rids;
+            for (int64_t i = thread; i < num_keys; i += num_threads) {
+              rids.clear();
+              index->ScanKey(tuples[i], &rids, &lookup_transaction);
+              found += static_cast<int64_t>(rids.size());
+            }
+          });
+        }
+        for (auto &thread : threads) {
+          thread.join();
+        }
+        elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        EXPECT_EQ(found, num_keys);
+        std::cout << name << ": " << static_cast<double>(elapsed.count()) / num_keys << " ns/lookup with "
+                  << num_threads << " thread(s)" << std::endl;
+      }
+    }
+  }
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete table_schema;
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
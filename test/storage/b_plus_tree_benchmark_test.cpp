@@ -0,0 +1,212 @@
+/**
+ * b_plus_tree_benchmark_test.cpp
+ *
+ * Micro benchmarks of the B+ tree. They only print timings, so they are disabled; run them with
+ * --gtest_also_run_disabled_tests.
+ */
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+#include "storage/page/b_plus_tree_internal_page.h"
+#include "storage/page/b_plus_tree_leaf_page.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+/**
+ * Times Lookup on a full internal page and KeyIndex on a full leaf page holding the keys 0, 2, 4, ... One Lookup is
+ * the search cost of one level of a descent.
+ */
+template <size_t KeySize>
+void SearchHelper(const std::string &schema, const std::string &name) {
+  using InternalPage = BPlusTreeInternalPage<GenericKey<KeySize>, page_id_t, GenericComparator<KeySize>>;
+  using LeafPage = BPlusTreeLeafPage<GenericKey<KeySize>, RID, GenericComparator<KeySize>>;
+  Schema *key_schema = ParseCreateStatement(schema);
+  GenericComparator<KeySize> comparator(key_schema);
+  std::vector<char> internal_data(PAGE_SIZE);
+  std::vector<char> leaf_data(PAGE_SIZE);
+  auto *internal = reinterpret_cast<InternalPage *>(internal_data.data());
+  auto *leaf = reinterpret_cast<LeafPage *>(leaf_data.data());
+  internal->Init(1);
+  leaf->Init(2);
+
+  GenericKey<KeySize> index_key;
+  for (int i = 0; i < internal->GetMaxSize() - 1; i++) {
+    index_key.SetFromInteger(2 * i);
+    internal->Append(index_key, i);
+  }
+  for (int i = 0; i < leaf->GetMaxSize() - 1; i++) {
+    index_key.SetFromInteger(2 * i);
+    leaf->Insert(index_key, RID(i), comparator);
+  }
+
+  const int rounds = 200000;
+  std::mt19937_64 rng(15445);
+  std::vector<GenericKey<KeySize>> probes(1024);
+  for (auto &probe : probes) {
+    probe.SetFromInteger(static_cast<int64_t>(rng() % (2 * internal->GetSize())));
+  }
+  int64_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    sink += internal->Lookup(probes[i % probes.size()], comparator);
+  }
+  auto lookup_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    sink += leaf->KeyIndex(probes[i % probes.size()], comparator);
+  }
+  auto key_index_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  std::cout << name << ": internal Lookup over " << internal->GetSize() << " keys "
+            << static_cast<double>(lookup_ns.count()) / rounds << " ns/level, leaf KeyIndex over " << leaf->GetSize()
+            << " keys " << static_cast<double>(key_index_ns.count()) / rounds << " ns (checksum " << sink << ")"
+            << std::endl;
+  delete key_schema;
+}
+
+}  // namespace
+
+TEST(BPlusTreeBenchmark, DISABLED_SearchBenchmark) {
+  // integer keys take the branchless search, a two column key of the same size goes through the comparator
+  SearchHelper<8>("a bigint", "bigint");
+  SearchHelper<8>("a integer", "integer");
+  SearchHelper<8>("a smallint", "smallint");
+  SearchHelper<8>("a integer,b integer", "integer, integer");
+}
+
+TEST(BPlusTreeBenchmark, DISABLED_KeyFormatBenchmark) {
+  // comparison cost of both formats
+  Schema *key_schema = ParseCreateStatement("a integer,b integer");
+  auto make_key = [&](int32_t a, int32_t b) {
+    return Tuple({ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)}, key_schema);
+  };
+  GenericKey<16> lhs;
+  GenericKey<16> rhs;
+  const int rounds = 1000000;
+  for (auto format : {KeyFormat::RAW, KeyFormat::NORMALIZED}) {
+    GenericComparator<16> key_comparator(key_schema, format);
+    lhs.SetFromKey(make_key(7, -1), key_schema, format);
+    rhs.SetFromKey(make_key(7, 1), key_schema, format);
+    int64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      sink += key_comparator(i % 2 == 0 ? lhs : rhs, rhs);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << (format == KeyFormat::RAW ? "raw" : "normalized") << " (integer, integer) key: "
+              << static_cast<double>(ns.count()) / rounds << " ns/comparison (checksum " << sink << ")" << std::endl;
+  }
+  delete key_schema;
+}
+
+TEST(BPlusTreeBenchmark, DISABLED_AdaptiveHashIndexBenchmark) {
+  // hot lookups with and without the adaptive hash index
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  using Tree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  {
+    Tree plain("plain_pk", bpm, comparator, 16, 8);
+    Tree tree("foo_pk", bpm, comparator, 16, 8, DEFAULT_SEGMENT_ID, false, false, true);
+    Transaction transaction(0);
+    GenericKey<8> index_key;
+    for (int64_t key = 1; key <= 2000; key++) {
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, RID(key), &transaction);
+      plain.Insert(index_key, RID(key), &transaction);
+    }
+    auto lookup = [&](Tree *target, int64_t key) {
+      index_key.SetFromInteger(key);
+      std::vector<RID> rids;
+      return target->GetValue(index_key, &rids);
+    };
+    // the first BUILD_THRESHOLD rounds build the entries of the hot keys
+    const int rounds = 200 + AdaptiveHashIndex<GenericKey<8>>::BUILD_THRESHOLD;
+    for (Tree *target : {&plain, &tree}) {
+      int64_t found = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (int round = 0; round < rounds; round++) {
+        for (int64_t key = 1010; key < 2000; key += 20) {
+          found += lookup(target, key) ? 1 : 0;
+        }
+      }
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      std::cout << (target == &tree ? "adaptive hash index" : "descent") << ": "
+                << static_cast<double>(ns.count()) / (rounds * 50) << " ns/lookup (" << found << " found)"
+                << std::endl;
+    }
+  }
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeBenchmark, DISABLED_BloomFilterBenchmark) {
+  // lookups of absent keys with and without the Bloom filter
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  using Tree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  {
+    const int64_t num_keys = 4000;
+    Tree plain("plain_pk", bpm, comparator, 16, 8);
+    Tree tree("foo_pk", bpm, comparator, 16, 8, DEFAULT_SEGMENT_ID, false, false, false, num_keys);
+    Transaction transaction(0);
+    GenericKey<8> index_key;
+    // the even keys are inserted, the odd keys are looked up
+    for (int64_t key = 0; key < 2 * num_keys; key += 2) {
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, RID(key), &transaction);
+      plain.Insert(index_key, RID(key), &transaction);
+    }
+    const int rounds = 20;
+    for (Tree *target : {&plain, &tree}) {
+      int64_t found = 0;
+      std::vector<RID> rids;
+      auto start = std::chrono::steady_clock::now();
+      for (int round = 0; round < rounds; round++) {
+        for (int64_t key = 1; key < 2 * num_keys; key += 2) {
+          index_key.SetFromInteger(key);
+          found += target->GetValue(index_key, &rids) ? 1 : 0;
+        }
+      }
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      std::cout << (target == &tree ? "bloom filter" : "descent") << ": "
+                << static_cast<double>(ns.count()) / (rounds * num_keys) << " ns/absent lookup (" << found
+                << " found)" << std::endl;
+    }
+    BloomFilter<GenericKey<8>> *filter = tree.GetBloomFilter();
+    std::cout << "false positive rate: " << filter->GetFalsePositiveRate() << " measured, "
+              << filter->EstimateFalsePositiveRate() << " estimated" << std::endl;
+  }
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
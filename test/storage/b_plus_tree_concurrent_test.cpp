@@ -2,15 +2,22 @@
  * b_plus_tree_test.cpp
  */
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <cstdio>
 #include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
 #include <thread>                   // NOLINT
 #include "b_plus_tree_test_util.h"  // NOLINT
 
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
 #include "storage/index/b_plus_tree.h"
+#include "storage/index/b_plus_tree_index.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 // helper function to launch multiple threads
@@ -63,6 +70,29 @@ void InsertHelperSplit(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree
   delete transaction;
 }
 
+// helper function to insert in sorted batches: the thread takes every total_threads-th block of 8 keys, so threads
+// write to the same leaves
+void InsertBatchHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree, const std::vector<int64_t> &keys,
+                       int total_threads, uint64_t thread_itr) {
+  std::vector<std::pair<GenericKey<8>, RID>> batch;
+  GenericKey<8> index_key;
+  // create transaction
+  Transaction *transaction = new Transaction(0);
+  for (auto key : keys) {
+    if (static_cast<uint64_t>(key / 8) % total_threads != thread_itr) {
+      continue;
+    }
+    index_key.SetFromInteger(key);
+    batch.emplace_back(index_key, RID(static_cast<int32_t>(key >> 32), key & 0xFFFFFFFF));
+    if (batch.size() == 64) {
+      EXPECT_EQ(tree->InsertBatch(batch, transaction), batch.size());
+      batch.clear();
+    }
+  }
+  EXPECT_EQ(tree->InsertBatch(batch, transaction), batch.size());
+  delete transaction;
+}
+
 // helper function to delete
 void DeleteHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree, const std::vector<int64_t> &remove_keys,
                   __attribute__((unused)) uint64_t thread_itr = 0) {
@@ -92,7 +122,41 @@ void DeleteHelperSplit(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree
   delete transaction;
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest1) {
+// helper function for the mixed workload: insert keys interleaved with the other threads, look them up, then
+// remove every other one. Returns the number of operations through ops.
+void MixedWorkloadHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree, int64_t keys_per_thread,
+                         int64_t total_threads, std::atomic<int64_t> *ops, uint64_t thread_itr) {
+  GenericKey<8> index_key;
+  RID rid;
+  std::vector<RID> rids;
+  // create transaction
+  Transaction *transaction = new Transaction(0);
+  int64_t done = 0;
+  for (int64_t i = 0; i < keys_per_thread; i++) {
+    int64_t key = i * total_threads + static_cast<int64_t>(thread_itr);
+    rid.Set(static_cast<int32_t>(key >> 32), key & 0xFFFFFFFF);
+    index_key.SetFromInteger(key);
+    tree->Insert(index_key, rid, transaction);
+    done++;
+  }
+  for (int64_t i = 0; i < keys_per_thread; i++) {
+    int64_t key = i * total_threads + static_cast<int64_t>(thread_itr);
+    rids.clear();
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree->GetValue(index_key, &rids));
+    done++;
+  }
+  for (int64_t i = 0; i < keys_per_thread; i += 2) {
+    int64_t key = i * total_threads + static_cast<int64_t>(thread_itr);
+    index_key.SetFromInteger(key);
+    tree->Remove(index_key, transaction);
+    done++;
+  }
+  ops->fetch_add(done);
+  delete transaction;
+}
+
+TEST(BPlusTreeConcurrentTest, InsertTest1) {
   // create KeyComparator and index schema
   Schema *key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema);
@@ -145,7 +209,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest1) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest2) {
+TEST(BPlusTreeConcurrentTest, InsertTest2) {
   // create KeyComparator and index schema
   Schema *key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema);
@@ -197,7 +261,52 @@ TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest2) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest1) {
+TEST(BPlusTreeConcurrentTest, InsertBatchTest) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  // create b+ tree
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 10, 10);
+  // create and fetch header_page
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+  // keys to Insert
+  std::vector<int64_t> keys;
+  int64_t scale_factor = 2000;
+  for (int64_t key = 1; key < scale_factor; key++) {
+    keys.push_back(key);
+  }
+  LaunchParallelTest(4, InsertBatchHelper, &tree, keys, 4);
+
+  std::vector<RID> rids;
+  GenericKey<8> index_key;
+  for (auto key : keys) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, &rids);
+    ASSERT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+
+  int64_t current_key = 1;
+  for (auto iterator = tree.begin(); iterator != tree.end(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key = current_key + 1;
+  }
+  EXPECT_EQ(current_key, scale_factor);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeConcurrentTest, DeleteTest1) {
   // create KeyComparator and index schema
   Schema *key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema);
@@ -240,7 +349,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest1) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest2) {
+TEST(BPlusTreeConcurrentTest, DeleteTest2) {
   // create KeyComparator and index schema
   Schema *key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema);
@@ -284,7 +393,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest2) {
   remove("test.log");
 }
 
-TEST(BPlusTreeConcurrentTest, DISABLED_MixTest) {
+TEST(BPlusTreeConcurrentTest, MixTest) {
   // create KeyComparator and index schema
   Schema *key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema);
@@ -330,4 +439,372 @@ TEST(BPlusTreeConcurrentTest, DISABLED_MixTest) {
   remove("test.log");
 }
 
+// helper function for the B-link test: looks up keys that are known to be in the tree while other threads split
+void LookupHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree, const std::vector<int64_t> &keys,
+                  __attribute__((unused)) uint64_t thread_itr = 0) {
+  GenericKey<8> index_key;
+  std::vector<RID> rids;
+  for (int round = 0; round < 20; round++) {
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      ASSERT_TRUE(tree->GetValue(index_key, &rids)) << key;
+      EXPECT_EQ(rids[0].GetSlotNum(), key);
+    }
+  }
+}
+
+TEST(BPlusTreeConcurrentTest, BLinkTest) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  for (int iteration = 0; iteration < 5; iteration++) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManager(256, disk_manager);
+    // create b+ tree in B-link mode
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 8, 8, DEFAULT_SEGMENT_ID,
+                                                             true);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(&page_id);
+    (void)header_page;
+
+    // the multiples of 4 go in first, readers look them up while writers fill in the rest and split every level
+    std::vector<int64_t> present;
+    std::vector<int64_t> keys;
+    for (int64_t key = 1; key <= 4000; key++) {
+      (key % 4 == 0 ? present : keys).push_back(key);
+    }
+    InsertHelper(&tree, present);
+    std::vector<std::thread> threads;
+    for (uint64_t thread_itr = 0; thread_itr < 4; thread_itr++) {
+      threads.emplace_back([&, thread_itr] { InsertHelperSplit(&tree, keys, 4, thread_itr); });
+      threads.emplace_back([&, thread_itr] { LookupHelper(&tree, present, thread_itr); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    int64_t current_key = 1;
+    for (auto iterator = tree.begin(); iterator != tree.end(); ++iterator) {
+      EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+      current_key++;
+    }
+    EXPECT_EQ(current_key, 4001);
+
+    // concurrent removes leave exactly the keys of the other threads
+    LaunchParallelTest(2, DeleteHelperSplit, &tree, keys, 2);
+    current_key = 4;
+    for (auto iterator = tree.begin(); iterator != tree.end(); ++iterator) {
+      EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+      current_key += 4;
+    }
+    EXPECT_EQ(current_key, 4004);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+  delete key_schema;
+}
+
+// helper function for the reverse scan test: scans the tree backwards until done is set, at least once, and checks
+// that every scan is in descending order and sees all keys that are known to be in the tree
+void ReverseScanHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree, const std::vector<int64_t> &keys,
+                       const std::atomic<bool> *done) {
+  do {
+    int64_t last_key = std::numeric_limits<int64_t>::max();
+    size_t next = keys.size();
+    for (auto iterator = tree->RBegin(); iterator != tree->end(); ++iterator) {
+      int64_t key = (*iterator).second.GetSlotNum();
+      ASSERT_LT(key, last_key);
+      last_key = key;
+      // keys is ascending, none of its keys may be skipped
+      if (next > 0 && keys[next - 1] >= key) {
+        ASSERT_EQ(keys[next - 1], key);
+        next--;
+      }
+    }
+    EXPECT_EQ(next, 0);
+  } while (!done->load());
+}
+
+TEST(BPlusTreeConcurrentTest, ReverseScanTest) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  for (int iteration = 0; iteration < 5; iteration++) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManager(256, disk_manager);
+    // small nodes, so that the removes merge and redistribute the leaves the scans move through
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 4);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(&page_id);
+    (void)header_page;
+
+    // the multiples of 4 stay, two threads remove the rest in random order while two threads scan backwards
+    std::vector<int64_t> present;
+    std::vector<int64_t> keys;
+    for (int64_t key = 1; key <= 4000; key++) {
+      (key % 4 == 0 ? present : keys).push_back(key);
+    }
+    InsertHelper(&tree, present);
+    InsertHelper(&tree, keys);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(iteration));
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 2; reader++) {
+      readers.emplace_back([&] { ReverseScanHelper(&tree, present, &done); });
+    }
+    LaunchParallelTest(2, DeleteHelperSplit, &tree, keys, 2);
+    done = true;
+    for (auto &reader : readers) {
+      reader.join();
+    }
+    ReverseScanHelper(&tree, present, &done);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+  delete key_schema;
+}
+
+// helper function for the forward scan test: scans the tree until done is set, at least once, and checks that every
+// scan is in ascending order and sees all keys that are known to be in the tree
+void ForwardScanHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> *tree, const std::vector<int64_t> &keys,
+                       const std::atomic<bool> *done) {
+  do {
+    int64_t last_key = std::numeric_limits<int64_t>::min();
+    size_t next = 0;
+    for (auto iterator = tree->begin(); iterator != tree->end(); ++iterator) {
+      int64_t key = (*iterator).second.GetSlotNum();
+      ASSERT_GT(key, last_key);
+      last_key = key;
+      // keys is ascending, none of its keys may be skipped
+      if (next < keys.size() && keys[next] <= key) {
+        ASSERT_EQ(keys[next], key);
+        next++;
+      }
+    }
+    EXPECT_EQ(next, keys.size());
+  } while (!done->load());
+}
+
+TEST(BPlusTreeConcurrentTest, ForwardScanTest) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  for (int iteration = 0; iteration < 5; iteration++) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManager(256, disk_manager);
+    // small nodes, so that the removes merge away and redistribute the leaves ahead of the scans
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 4);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(&page_id);
+    (void)header_page;
+
+    // the multiples of 4 stay, two threads remove the rest in random order while two threads scan forwards
+    std::vector<int64_t> present;
+    std::vector<int64_t> keys;
+    for (int64_t key = 1; key <= 4000; key++) {
+      (key % 4 == 0 ? present : keys).push_back(key);
+    }
+    InsertHelper(&tree, present);
+    InsertHelper(&tree, keys);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(iteration));
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 2; reader++) {
+      readers.emplace_back([&] { ForwardScanHelper(&tree, present, &done); });
+    }
+    LaunchParallelTest(2, DeleteHelperSplit, &tree, keys, 2);
+    done = true;
+    for (auto &reader : readers) {
+      reader.join();
+    }
+    ForwardScanHelper(&tree, present, &done);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+  delete key_schema;
+}
+
+TEST(BPlusTreeConcurrentTest, ChangeBufferTest) {
+  // a non-unique index with a change buffer and a buffer pool smaller than its leaves, entry i has the key i % num_keys
+  Schema *table_schema = ParseCreateStatement("a integer");
+  using Index = BPlusTreeIndex<GenericKey<16>, RID, GenericComparator<16>>;
+  const int64_t num_entries = 40000;
+  const int32_t num_keys = 499;
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(64, disk_manager);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  {
+    Index index(new IndexMetadata("index_0", "foo", table_schema, {0}, KeyFormat::RAW, false), bpm, DEFAULT_SEGMENT_ID,
+                false, false, 0, 256);
+    auto make_key = [&](int64_t i) {
+      return Tuple({ValueFactory::GetIntegerValue(static_cast<int32_t>(i % num_keys))}, index.GetKeySchema());
+    };
+    // the entries i % 4 == 0 stay, writer t inserts the entries i % 4 == t + 1 and deletes half of them again
+    auto stays = [](int64_t i) { return i % 4 == 0 || (i % 4 <= 2 && i % 8 > 4); };
+    Transaction transaction(0);
+    std::vector<int64_t> stable_counts(num_keys);
+    for (int64_t i = 0; i < num_entries; i += 4) {
+      index.InsertEntry(make_key(i), RID(i), &transaction);
+      stable_counts[i % num_keys]++;
+    }
+
+    // readers scan keys while the changes are buffered and merged, every scan sees the stable entries of its key
+    // once and no entry of another key
+    std::atomic<bool> done{false};
+    std::atomic<int> errors{0};
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 2; reader++) {
+      readers.emplace_back([&, reader] {
+        Transaction reader_transaction(1 + reader);
+        std::mt19937 generator(reader);
+        std::vector<RID> rids;
+        while (!done) {
+          int64_t key = generator() % num_keys;
+          rids.clear();
+          index.ScanKey(make_key(key), &rids, &reader_transaction);
+          int64_t stable = 0;
+          for (const auto &rid : rids) {
+            if (rid.Get() % num_keys != key || std::count(rids.begin(), rids.end(), rid) != 1) {
+              errors++;
+            }
+            stable += rid.Get() % 4 == 0 ? 1 : 0;
+          }
+          if (stable != stable_counts[key]) {
+            errors++;
+          }
+        }
+      });
+    }
+    std::vector<std::thread> writers;
+    for (int writer = 0; writer < 2; writer++) {
+      writers.emplace_back([&, writer] {
+        Transaction writer_transaction(3 + writer);
+        for (int64_t i = writer + 1; i < num_entries; i += 4) {
+          index.InsertEntry(make_key(i), RID(i), &writer_transaction);
+        }
+        for (int64_t i = writer + 1; i < num_entries; i += 8) {
+          index.DeleteEntry(make_key(i), RID(i), &writer_transaction);
+        }
+      });
+    }
+    for (auto &writer : writers) {
+      writer.join();
+    }
+    done = true;
+    for (auto &reader : readers) {
+      reader.join();
+    }
+    EXPECT_EQ(errors, 0);
+    EXPECT_GT(index.GetChangeBuffer()->GetBufferedCount(), 0);
+
+    std::vector<RID> rids;
+    for (int64_t key = 0; key < num_keys; key++) {
+      std::vector<RID> expected;
+      for (int64_t i = key; i < num_entries; i += num_keys) {
+        if (stays(i)) {
+          expected.emplace_back(i);
+        }
+      }
+      rids.clear();
+      index.ScanKey(make_key(key), &rids, &transaction);
+      std::sort(rids.begin(), rids.end(), [](const RID &lhs, const RID &rhs) { return lhs.Get() < rhs.Get(); });
+      ASSERT_EQ(rids, expected) << key;
+    }
+  }
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete table_schema;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+// Runs a mixed insert / lookup / remove workload on one tree with small nodes, so that splits and merges happen often,
+// checks the keys left in the tree and returns the number of operations. Writers descend optimistically with read
+// latches, so threads working on different leaves do not serialize on the root. The B-link run never merges, so its
+// removes only touch leaves.
+int64_t MixedWorkload(bool b_link, int64_t num_threads, int64_t keys_per_thread) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(256, disk_manager);
+  std::atomic<int64_t> ops{0};
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 16, 16, DEFAULT_SEGMENT_ID,
+                                                             b_link);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(&page_id);
+    (void)header_page;
+
+    LaunchParallelTest(num_threads, MixedWorkloadHelper, &tree, keys_per_thread, num_threads, &ops);
+
+    // every thread removed the keys of its even iterations, the keys of odd iterations remain in order
+    int64_t expected_key = num_threads;
+    int64_t size = 0;
+    for (auto iterator = tree.begin(); iterator != tree.end(); ++iterator) {
+      EXPECT_EQ((*iterator).second.GetSlotNum(), expected_key);
+      expected_key++;
+      if (expected_key % (2 * num_threads) == 0) {
+        expected_key += num_threads;
+      }
+      size++;
+    }
+    EXPECT_EQ(size, num_threads * keys_per_thread / 2);
+  }
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+  return ops.load();
+}
+
+TEST(BPlusTreeConcurrentTest, MixedWorkloadTest) {
+  const int64_t keys_per_thread = 2000;
+  for (bool b_link : {false, true}) {
+    for (int64_t num_threads : {1, 2, 4, 8}) {
+      EXPECT_EQ(MixedWorkload(b_link, num_threads, keys_per_thread), num_threads * keys_per_thread * 5 / 2);
+    }
+  }
+}
+
+// Stress benchmark: ops/sec of the mixed workload per thread count. It only prints timings, so it is disabled; run it
+// with --gtest_also_run_disabled_tests.
+TEST(BPlusTreeConcurrentTest, DISABLED_StressBenchmark) {
+  const int64_t keys_per_thread = 2000;
+  for (bool b_link : {false, true}) {
+    for (int64_t num_threads : {1, 2, 4, 8}) {
+      auto start = std::chrono::steady_clock::now();
+      int64_t ops = MixedWorkload(b_link, num_threads, keys_per_thread);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::cout << "b_link=" << b_link << " threads=" << num_threads << " ops=" << ops << " seconds=" << elapsed.count()
+                << " ops/sec=" << static_cast<int64_t>(static_cast<double>(ops) / elapsed.count()) << std::endl;
+    }
+  }
+}
+
 }  // namespace bustub
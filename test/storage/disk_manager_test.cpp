@@ -10,11 +10,26 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstring>
+#include <memory>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
+#include "buffer/buffer_pool_manager.h"
 #include "common/exception.h"
 #include "gtest/gtest.h"
+#include "storage/disk/compressed_disk_manager.h"
 #include "storage/disk/disk_manager.h"
+#include "storage/disk/memory_disk_manager.h"
 
 namespace bustub {
 
@@ -24,12 +39,20 @@ class DiskManagerTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.orders.db");
+    remove("test.segments");
+    remove("test.pagemap");
+    remove("test.trace");
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
     remove("test.log");
+    remove("test.orders.db");
+    remove("test.segments");
+    remove("test.pagemap");
+    remove("test.trace");
   };
 };
 
@@ -55,6 +78,37 @@ TEST_F(DiskManagerTest, ReadWritePageTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, DirectIOReadWritePageTest) {
+  alignas(PAGE_SIZE) char buf[PAGE_SIZE] = {0};
+  alignas(PAGE_SIZE) char data[PAGE_SIZE] = {0};
+  char unaligned[PAGE_SIZE + 1] = {0};
+  std::string db_file("test.db");
+  // falls back to buffered I/O on file systems without O_DIRECT support
+  auto dm = DiskManager(db_file, true);
+  std::strncpy(data, "A test string.", sizeof(data));
+
+  dm.WritePage(0, data);
+  dm.ReadPage(0, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+
+  // buffers that are not page aligned go through a bounce buffer
+  std::memcpy(unaligned + 1, data, PAGE_SIZE);
+  dm.WritePage(3, unaligned + 1);
+  std::memset(unaligned, 0, sizeof(unaligned));
+  dm.ReadPage(3, unaligned + 1);
+  EXPECT_EQ(std::memcmp(unaligned + 1, data, PAGE_SIZE), 0);
+
+  // segment files are opened like the db file, with the same fallback
+  page_id_t page_id = dm.AllocatePage(dm.CreateSegment("orders"));
+  dm.WritePage(page_id, data);
+  std::memset(buf, 0, sizeof(buf));
+  dm.ReadPage(page_id, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+
+  dm.ShutDown();
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ReadWriteLogTest) {
   char buf[16] = {0};
@@ -72,6 +126,444 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, MemoryReadWriteTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  char zeroes[PAGE_SIZE] = {0};
+  MemoryDiskManager dm;
+  std::strncpy(data, "A test string.", sizeof(data));
+
+  dm.ReadPage(0, buf);  // tolerate empty read
+  EXPECT_EQ(std::memcmp(buf, zeroes, sizeof(buf)), 0);
+
+  dm.WritePage(0, data);
+  dm.ReadPage(0, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+
+  // the arena grows on demand
+  dm.WritePage(1000, data);
+  dm.ReadPage(1000, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  dm.ReadPage(999, buf);
+  EXPECT_EQ(std::memcmp(buf, zeroes, sizeof(buf)), 0);
+  EXPECT_GE(dm.GetArenaSize(), 1001 * static_cast<size_t>(PAGE_SIZE));
+  EXPECT_EQ(2, dm.GetNumWrites());
+
+  char log_buf[16] = {0};
+  char log_data[16] = {0};
+  std::strncpy(log_data, "A test string.", sizeof(log_data));
+  EXPECT_FALSE(dm.ReadLog(log_buf, sizeof(log_buf), 0));
+  dm.WriteLog(log_data, sizeof(log_data));
+  EXPECT_TRUE(dm.ReadLog(log_buf, sizeof(log_buf), 0));
+  EXPECT_EQ(std::memcmp(log_buf, log_data, sizeof(log_buf)), 0);
+  EXPECT_EQ(1, dm.GetNumFlushes());
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, MemoryLatencyTest) {
+  char buf[PAGE_SIZE] = {0};
+  const auto read_latency = std::chrono::microseconds(300);
+  const auto write_latency = std::chrono::microseconds(50);
+  MemoryDiskManager dm(std::make_unique<DiskLatencyModel>(read_latency, write_latency));
+  BufferPoolManager bpm(1, &dm);
+
+  // Scenario: a cache miss pays the write-back of the dirty victim plus the read of the requested page.
+  page_id_t page_id_temp;
+  ASSERT_NE(nullptr, bpm.NewPage(&page_id_temp));
+  EXPECT_EQ(true, bpm.UnpinPage(page_id_temp, true));
+  ASSERT_NE(nullptr, bpm.NewPage(&page_id_temp));
+  EXPECT_EQ(true, bpm.UnpinPage(page_id_temp, false));
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_NE(nullptr, bpm.FetchPage(0));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, read_latency);
+  EXPECT_EQ(true, bpm.UnpinPage(0, false));
+
+  // Scenario: the same seed always produces the same latencies.
+  auto nvme_a = DiskLatencyModel::ForDevice(DiskLatencyModel::Device::NVME, 42);
+  auto nvme_b = DiskLatencyModel::ForDevice(DiskLatencyModel::Device::NVME, 42);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(nvme_a.NextRead(), nvme_b.NextRead());
+  }
+  dm.ReadPage(0, buf);
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, SegmentTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  char other[PAGE_SIZE] = {0};
+  std::strncpy(data, "A test string.", sizeof(data));
+  std::strncpy(other, "Another test string.", sizeof(other));
+  struct stat stat_buf;
+
+  auto *dm = new DiskManager("test.db");
+  segment_id_t segment_id = dm->CreateSegment("orders");
+  EXPECT_NE(DEFAULT_SEGMENT_ID, segment_id);
+  EXPECT_EQ(segment_id, dm->CreateSegment("orders"));
+  EXPECT_THROW(dm->CreateSegment("a/b"), Exception);
+
+  // the segment id lives in the upper bits, the main db file keeps its plain page ids
+  page_id_t page0 = dm->AllocatePage(segment_id);
+  page_id_t page1 = dm->AllocatePage(segment_id);
+  EXPECT_EQ(segment_id, DiskManager::GetSegmentId(page0));
+  EXPECT_EQ(0, DiskManager::GetPageNumber(page0));
+  EXPECT_EQ(1, DiskManager::GetPageNumber(page1));
+  EXPECT_EQ(0, dm->AllocatePage());
+  EXPECT_EQ(DEFAULT_SEGMENT_ID, DiskManager::GetSegmentId(0));
+
+  dm->WritePage(page1, data);
+  dm->WritePage(1, other);
+  dm->ReadPage(page1, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  dm->ReadPage(1, buf);
+  EXPECT_EQ(std::memcmp(buf, other, sizeof(buf)), 0);
+  ASSERT_EQ(0, stat("test.orders.db", &stat_buf));
+  EXPECT_EQ(2 * PAGE_SIZE, stat_buf.st_size);
+  dm->ShutDown();
+  delete dm;
+
+  // reopening maps the name to the same segment and continues after the pages written so far
+  dm = new DiskManager("test.db");
+  EXPECT_EQ(segment_id, dm->CreateSegment("orders"));
+  dm->ReadPage(page1, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  EXPECT_EQ(2, DiskManager::GetPageNumber(dm->AllocatePage(segment_id)));
+
+  dm->TruncateSegment(segment_id);
+  ASSERT_EQ(0, stat("test.orders.db", &stat_buf));
+  EXPECT_EQ(0, stat_buf.st_size);
+  EXPECT_EQ(page0, dm->AllocatePage(segment_id));
+
+  dm->DropSegment(segment_id);
+  EXPECT_NE(0, stat("test.orders.db", &stat_buf));
+  EXPECT_EQ(INVALID_PAGE_ID, dm->AllocatePage(segment_id));
+  dm->ShutDown();
+  delete dm;
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, ConcurrentDropSegmentTest) {
+  char data[PAGE_SIZE] = {0};
+  std::strncpy(data, "A test string.", sizeof(data));
+  struct stat stat_buf;
+
+  // a writer keeps writing a page of the segment while it is dropped; a file opened right after the drop usually
+  // gets the descriptor number of the dropped segment and must not receive the page
+  DiskManager dm("test.db");
+  segment_id_t segment_id = dm.CreateSegment("orders");
+  page_id_t page_id = dm.AllocatePage(segment_id);
+  std::atomic<bool> stop{false};
+  std::thread writer([&] {
+    while (!stop) {
+      dm.WritePage(page_id, data);
+    }
+  });
+  for (int i = 0; i < 200; i++) {
+    dm.DropSegment(segment_id);
+    int fd = open("test.other", O_RDWR | O_CREAT, 0644);
+    ASSERT_GE(fd, 0);
+    std::this_thread::yield();
+    ASSERT_EQ(0, fstat(fd, &stat_buf));
+    EXPECT_EQ(0, stat_buf.st_size);
+    close(fd);
+    remove("test.other");
+    ASSERT_EQ(segment_id, dm.CreateSegment("orders"));
+    dm.AllocatePage(segment_id);
+  }
+  stop = true;
+  writer.join();
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, MemorySegmentTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  char zeroes[PAGE_SIZE] = {0};
+  std::strncpy(data, "A test string.", sizeof(data));
+  MemoryDiskManager dm;
+
+  segment_id_t segment_id = dm.CreateSegment("orders");
+  EXPECT_EQ(segment_id, dm.CreateSegment("orders"));
+  page_id_t page_id = dm.AllocatePage(segment_id);
+  EXPECT_EQ(segment_id, DiskManager::GetSegmentId(page_id));
+  dm.WritePage(page_id, data);
+  dm.ReadPage(page_id, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  // a page of a segment does not alias the page with the same number in the main arena
+  dm.ReadPage(DiskManager::GetPageNumber(page_id), buf);
+  EXPECT_EQ(std::memcmp(buf, zeroes, sizeof(buf)), 0);
+
+  dm.DropSegment(segment_id);
+  EXPECT_EQ(INVALID_PAGE_ID, dm.AllocatePage(segment_id));
+  EXPECT_EQ(0, dm.GetArenaSize());
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, PageCodecTest) {
+  char page[PAGE_SIZE] = {0};
+  char compressed[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  std::mt19937 engine(15445);
+
+  // an empty page shrinks to a few bytes
+  size_t size = PageCodec::Compress(page, PAGE_SIZE, compressed, sizeof(compressed));
+  ASSERT_GT(size, 0);
+  EXPECT_LT(size, 32);
+  ASSERT_TRUE(PageCodec::Decompress(compressed, size, buf, PAGE_SIZE));
+  EXPECT_EQ(std::memcmp(buf, page, PAGE_SIZE), 0);
+
+  // repetitive records with a few random bytes, like the tuples of a table page
+  for (int i = 0; i < PAGE_SIZE; i++) {
+    page[i] = i % 64 < 8 ? static_cast<char>(engine()) : static_cast<char>('a' + i % 64 % 26);
+  }
+  size = PageCodec::Compress(page, PAGE_SIZE, compressed, sizeof(compressed));
+  ASSERT_GT(size, 0);
+  EXPECT_LT(size, PAGE_SIZE / 2);
+  ASSERT_TRUE(PageCodec::Decompress(compressed, size, buf, PAGE_SIZE));
+  EXPECT_EQ(std::memcmp(buf, page, PAGE_SIZE), 0);
+  EXPECT_FALSE(PageCodec::Decompress(compressed, size, buf, PAGE_SIZE - 1));
+
+  // random data does not fit into half a page
+  for (char &c : page) {
+    c = static_cast<char>(engine());
+  }
+  EXPECT_EQ(0, PageCodec::Compress(page, PAGE_SIZE, compressed, PAGE_SIZE / 2));
+  size = PageCodec::Compress(page, PAGE_SIZE, compressed, sizeof(compressed));
+  if (size > 0) {
+    ASSERT_TRUE(PageCodec::Decompress(compressed, size, buf, PAGE_SIZE));
+    EXPECT_EQ(std::memcmp(buf, page, PAGE_SIZE), 0);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, CompressedReadWriteTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  char random[PAGE_SIZE];
+  char zeroes[PAGE_SIZE] = {0};
+  std::strncpy(data, "A test string.", sizeof(data));
+  std::mt19937 engine(15445);
+  for (char &c : random) {
+    c = static_cast<char>(engine());
+  }
+
+  auto *dm = new CompressedDiskManager("test.db");
+  dm->ReadPage(0, buf);  // tolerate empty read
+  EXPECT_EQ(std::memcmp(buf, zeroes, sizeof(buf)), 0);
+  for (page_id_t page_id = 0; page_id < 8; page_id++) {
+    dm->WritePage(page_id, data);
+  }
+  dm->WritePage(8, random);
+  dm->ReadPage(3, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  dm->ReadPage(8, buf);
+  EXPECT_EQ(std::memcmp(buf, random, sizeof(buf)), 0);
+
+  CompressionStats stats = dm->GetCompressionStats();
+  EXPECT_EQ(9, stats.pages_written_);
+  EXPECT_EQ(1, stats.pages_stored_raw_);
+  EXPECT_GT(stats.GetCompressionRatio(), 2);
+  EXPECT_EQ(8 * PAGE_SIZE / 8 + PAGE_SIZE, dm->GetStoredSize());
+
+  // a page that stops compressing moves to a bigger slot, the next small page reuses its old one once the page map
+  // that no longer refers to it has been saved
+  dm->WritePage(0, random);
+  dm->WritePage(9, data);
+  EXPECT_EQ(8 * PAGE_SIZE / 8 + 2 * PAGE_SIZE + PAGE_SIZE / 8, dm->GetStoredSize());
+  dm->Sync();
+  dm->WritePage(10, data);
+  EXPECT_EQ(8 * PAGE_SIZE / 8 + 2 * PAGE_SIZE + PAGE_SIZE / 8, dm->GetStoredSize());
+  dm->ShutDown();
+  delete dm;
+
+  // the page map survives a restart
+  dm = new CompressedDiskManager("test.db");
+  dm->ReadPage(0, buf);
+  EXPECT_EQ(std::memcmp(buf, random, sizeof(buf)), 0);
+  dm->ReadPage(9, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  dm->WritePage(11, data);
+  EXPECT_EQ(8 * PAGE_SIZE / 8 + 2 * PAGE_SIZE + 2 * PAGE_SIZE / 8, dm->GetStoredSize());
+  dm->ShutDown();
+  delete dm;
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, CompressedCrashTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  char other[PAGE_SIZE] = {0};
+  char random[PAGE_SIZE];
+  char zeroes[PAGE_SIZE] = {0};
+  std::strncpy(data, "A test string.", sizeof(data));
+  std::strncpy(other, "Another test string.", sizeof(other));
+  std::mt19937 engine(15445);
+  for (char &c : random) {
+    c = static_cast<char>(engine());
+  }
+  auto copy = [](const char *from, const char *to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+  };
+
+  char longer[PAGE_SIZE] = {0};
+  std::strncpy(longer, "A longer test string that compresses to more bytes in the same size class.", sizeof(longer));
+
+  auto *dm = new CompressedDiskManager("test.db");
+  dm->WritePage(0, data);
+  dm->WritePage(2, data);
+  dm->Sync();
+  // page 0 moves to a bigger slot, page 2 is rewritten in the same size class with another compressed size and page 1
+  // is written, then the process crashes before the page map is saved
+  dm->WritePage(0, random);
+  dm->WritePage(2, longer);
+  dm->WritePage(1, other);
+  copy("test.db", "crash.db");
+  copy("test.pagemap", "crash.pagemap");
+  dm->ShutDown();
+  delete dm;
+
+  // the saved page map still points at the old slots of pages 0 and 2, which the later writes must not have
+  // overwritten
+  dm = new CompressedDiskManager("crash.db");
+  dm->ReadPage(0, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  dm->ReadPage(2, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  dm->ReadPage(1, buf);
+  EXPECT_EQ(std::memcmp(buf, zeroes, sizeof(buf)), 0);
+  dm->ShutDown();
+  delete dm;
+  remove("crash.db");
+  remove("crash.log");
+  remove("crash.pagemap");
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, StatsTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  char log_data[16] = {0};
+  std::strncpy(data, "A test string.", sizeof(data));
+  DiskManager dm("test.db");
+
+  for (page_id_t page_id = 0; page_id < 3; page_id++) {
+    dm.WritePage(page_id, data);
+  }
+  dm.ReadPage(0, buf);
+  dm.ReadPage(1, buf);
+  dm.WriteLog(log_data, sizeof(log_data));
+  dm.Sync();
+
+  DiskStats stats = dm.GetStats();
+  EXPECT_EQ(3, stats.writes_);
+  EXPECT_EQ(3 * PAGE_SIZE, stats.bytes_written_);
+  EXPECT_EQ(2, stats.reads_);
+  EXPECT_EQ(2 * PAGE_SIZE, stats.bytes_read_);
+  EXPECT_EQ(1, stats.log_writes_);
+  EXPECT_EQ(sizeof(log_data), stats.log_bytes_written_);
+  EXPECT_EQ(1, stats.fsyncs_);
+  EXPECT_EQ(1, stats.max_queue_depth_);
+  EXPECT_DOUBLE_EQ(1, stats.GetMeanQueueDepth());
+
+  const LatencyHistogram &writes = dm.GetLatencyHistogram(IOKind::WRITE);
+  EXPECT_EQ(3, writes.GetCount());
+  EXPECT_GE(writes.GetPercentile(1), writes.GetMean());
+  EXPECT_EQ(2, dm.GetLatencyHistogram(IOKind::READ).GetCount());
+
+  dm.ResetStats();
+  EXPECT_EQ(0, dm.GetStats().writes_);
+  EXPECT_EQ(0, dm.GetLatencyHistogram(IOKind::WRITE).GetCount());
+  EXPECT_EQ(3, dm.GetNumWrites());
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LatencyHistogramTest) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.GetPercentile(0.5).count());
+  for (int i = 0; i < 90; i++) {
+    histogram.Record(std::chrono::nanoseconds(1000));
+  }
+  for (int i = 0; i < 10; i++) {
+    histogram.Record(std::chrono::nanoseconds(1000000));
+  }
+  EXPECT_EQ(100, histogram.GetCount());
+  EXPECT_EQ(90, histogram.GetBucketCount(9));  // 2^9 <= 1000 < 2^10
+  EXPECT_EQ(1023, histogram.GetPercentile(0.5).count());
+  EXPECT_EQ(1023, histogram.GetPercentile(0.9).count());
+  EXPECT_EQ((1 << 20) - 1, histogram.GetPercentile(0.99).count());
+  EXPECT_EQ(100900, histogram.GetMean().count());
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, TraceTest) {
+  char buf[PAGE_SIZE] = {0};
+  DiskManager dm("test.db");
+  EXPECT_FALSE(dm.DumpTrace("test.trace"));
+
+  // the ring buffer keeps the most recent requests, labeled by the tag of the issuing thread
+  dm.EnableTrace(4);
+  {
+    IOTraceTag tag("scan");
+    for (page_id_t page_id = 0; page_id < 6; page_id++) {
+      dm.ReadPage(page_id, buf);
+    }
+  }
+  dm.WritePage(6, buf);
+  std::vector<IOTraceRecord> trace = dm.GetTrace();
+  ASSERT_EQ(4, trace.size());
+  EXPECT_EQ(3, trace[0].page_id_);
+  EXPECT_EQ(IOKind::READ, trace[0].kind_);
+  EXPECT_STREQ("scan", trace[0].tag_);
+  EXPECT_EQ(6, trace[3].page_id_);
+  EXPECT_EQ(IOKind::WRITE, trace[3].kind_);
+  EXPECT_EQ(nullptr, trace[3].tag_);
+  EXPECT_LE(trace[0].timestamp_ns_, trace[3].timestamp_ns_);
+
+  ASSERT_TRUE(dm.DumpTrace("test.trace"));
+  std::ifstream dump("test.trace");
+  std::string line;
+  std::getline(dump, line);
+  EXPECT_EQ("timestamp_ns,page_id,kind,latency_ns,tag", line);
+  int lines = 0;
+  while (std::getline(dump, line)) {
+    lines++;
+  }
+  EXPECT_EQ(4, lines);
+
+  dm.DisableTrace();
+  dm.ReadPage(0, buf);
+  EXPECT_TRUE(dm.GetTrace().empty());
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, QueueDepthTest) {
+  auto latency = std::chrono::microseconds(500);
+  MemoryDiskManager dm(std::make_unique<DiskLatencyModel>(latency, latency));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&dm, t] {
+      char buf[PAGE_SIZE];
+      for (page_id_t page_id = 0; page_id < 10; page_id++) {
+        dm.ReadPage(t * 10 + page_id, buf);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  DiskStats stats = dm.GetStats();
+  EXPECT_EQ(40, stats.reads_);
+  EXPECT_GT(stats.max_queue_depth_, 1);
+  EXPECT_LE(stats.max_queue_depth_, 4);
+  EXPECT_GE(dm.GetLatencyHistogram(IOKind::READ).GetPercentile(0.5), latency);
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 
@@ -0,0 +1,313 @@
+/**
+ * lsm_index_test.cpp
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree_index.h"
+#include "storage/index/lsm_index.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+using LSMIndex16 = LSMIndex<GenericKey<16>, RID, GenericComparator<16>>;
+
+std::vector<RID> Scan(Index *index, const Tuple &key) {
+  std::vector<RID> rids;
+  index->ScanKey(key, &rids, nullptr);
+  std::sort(rids.begin(), rids.end(), [](const RID &lhs, const RID &rhs) { return lhs.Get() < rhs.Get(); });
+  return rids;
+}
+
+void RemoveFiles() {
+  remove("test.db");
+  remove("test.log");
+  remove("test.segments");
+}
+
+/** Fails the next failures_ page allocations in segments, so that writing out a run fails. */
+class FailingDiskManager : public DiskManager {
+ public:
+  explicit FailingDiskManager(const std::string &db_file) : DiskManager(db_file) {}
+
+  using DiskManager::AllocatePage;
+
+  page_id_t AllocatePage(segment_id_t segment_id) override {
+    if (failures_ > 0) {
+      failures_--;
+      return INVALID_PAGE_ID;
+    }
+    return DiskManager::AllocatePage(segment_id);
+  }
+
+  std::atomic<int> failures_{0};
+};
+
+}  // namespace
+
+TEST(LSMIndexTest, UniqueTest) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(50, disk_manager);
+  {
+    // small memtables, so that the keys end up in runs and get compacted
+    LSMIndex16 index(new IndexMetadata("lsm_index", "foo", table_schema, {0}), bpm, 100);
+    auto make_key = [&](int64_t a) { return Tuple({ValueFactory::GetBigIntValue(a)}, index.GetKeySchema()); };
+
+    std::vector<int64_t> keys;
+    for (int64_t key = 0; key < 5000; key++) {
+      keys.push_back(key * 2);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+    for (auto key : keys) {
+      index.InsertEntry(make_key(key), RID(key), nullptr);
+    }
+    // the memtable, the immutable memtables and the runs all answer lookups
+    for (auto key : keys) {
+      ASSERT_EQ(Scan(&index, make_key(key)), std::vector<RID>{RID(key)}) << key;
+    }
+    index.Flush();
+    EXPECT_GT(index.GetRunCount(), 0);
+    EXPECT_LT(index.GetRunCount(), LSMIndex16::COMPACTION_TRIGGER + 1);
+    EXPECT_GT(index.GetCompactionCount(), 0);
+    for (auto key : keys) {
+      ASSERT_EQ(Scan(&index, make_key(key)), std::vector<RID>{RID(key)}) << key;
+    }
+    // absent keys are mostly answered by the Bloom filters
+    size_t negatives = index.GetFilterNegatives();
+    for (int64_t key = 1; key < 2000; key += 2) {
+      ASSERT_TRUE(Scan(&index, make_key(key)).empty()) << key;
+    }
+    EXPECT_GT(index.GetFilterNegatives(), negatives + 900 * index.GetRunCount());
+
+    // deletes hide the keys in older runs, the last write of a key wins
+    for (size_t i = 0; i < keys.size(); i += 2) {
+      index.DeleteEntry(make_key(keys[i]), RID(keys[i]), nullptr);
+    }
+    for (size_t i = 1; i < keys.size(); i += 4) {
+      index.InsertEntry(make_key(keys[i]), RID(0, 0), nullptr);
+    }
+    auto check = [&] {
+      for (size_t i = 0; i < keys.size(); i++) {
+        std::vector<RID> expected;
+        if (i % 4 == 1) {
+          expected.emplace_back(0, 0);
+        } else if (i % 2 == 1) {
+          expected.emplace_back(keys[i]);
+        }
+        ASSERT_EQ(Scan(&index, make_key(keys[i])), expected) << keys[i];
+      }
+    };
+    check();
+    index.Flush();
+    check();
+
+    // ScanRange merges all components
+    std::vector<RID> rids;
+    index.ScanRange(make_key(0), make_key(10000), &rids, nullptr);
+    EXPECT_EQ(rids.size(), keys.size() / 2);
+  }
+  delete table_schema;
+  delete bpm;
+  delete disk_manager;
+  RemoveFiles();
+}
+
+TEST(LSMIndexTest, NonUniqueTest) {
+  Schema *table_schema = ParseCreateStatement("a integer,b integer");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(50, disk_manager);
+  {
+    LSMIndex<GenericKey<16>, RID, GenericComparator<16>> index(
+        new IndexMetadata("lsm_index", "foo", table_schema, {0}, KeyFormat::NORMALIZED, false), bpm, 64);
+    auto make_key = [&](int32_t a) { return Tuple({ValueFactory::GetIntegerValue(a)}, index.GetKeySchema()); };
+
+    // ten entries per key, written in rounds so that every key has entries in several runs
+    for (int32_t round = 0; round < 10; round++) {
+      for (int32_t key = 0; key < 200; key++) {
+        index.InsertEntry(make_key(key), RID(key, round), nullptr);
+      }
+    }
+    for (int32_t key = 0; key < 200; key += 3) {
+      index.DeleteEntry(make_key(key), RID(key, 5), nullptr);
+    }
+    for (int pass = 0; pass < 2; pass++) {
+      for (int32_t key = 0; key < 200; key++) {
+        std::vector<RID> expected;
+        for (uint32_t round = 0; round < 10; round++) {
+          if (key % 3 != 0 || round != 5) {
+            expected.emplace_back(key, round);
+          }
+        }
+        ASSERT_EQ(Scan(&index, make_key(key)), expected) << key;
+      }
+      EXPECT_TRUE(Scan(&index, make_key(200)).empty());
+
+      // [lo, hi): all entries of lo, none of hi
+      std::vector<RID> rids;
+      index.ScanRange(make_key(10), make_key(20), &rids, nullptr);
+      EXPECT_EQ(rids.size(), 10 * 10 - 3);
+      EXPECT_EQ(rids.front(), RID(10, 0));
+      EXPECT_EQ(rids.back(), RID(19, 9));
+      index.Flush();
+    }
+  }
+  delete table_schema;
+  delete bpm;
+  delete disk_manager;
+  RemoveFiles();
+}
+
+TEST(LSMIndexTest, ConcurrentTest) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(50, disk_manager);
+  {
+    LSMIndex16 index(new IndexMetadata("lsm_index", "foo", table_schema, {0}), bpm, 256);
+    auto make_key = [&](int64_t a) { return Tuple({ValueFactory::GetBigIntValue(a)}, index.GetKeySchema()); };
+    const int64_t num_keys = 20000;
+    // the even keys are there before the threads start, writers add the odd ones and readers look up the even ones
+    // while memtables are switched, written out and compacted
+    for (int64_t key = 0; key < num_keys; key += 2) {
+      index.InsertEntry(make_key(key), RID(key), nullptr);
+    }
+    std::atomic<int64_t> missing{0};
+    std::vector<std::thread> threads;
+    for (int64_t thread = 0; thread < 4; thread++) {
+      threads.emplace_back([&, thread] {
+        if (thread < 2) {
+          for (int64_t key = 1 + 2 * thread; key < num_keys; key += 4) {
+            index.InsertEntry(make_key(key), RID(key), nullptr);
+          }
+          return;
+        }
+        for (int64_t key = 2 * (thread - 2); key < num_keys; key += 4) {
+          if (Scan(&index, make_key(key)) != std::vector<RID>{RID(key)}) {
+            missing++;
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(missing, 0);
+    index.Flush();
+    for (int64_t key = 0; key < num_keys; key++) {
+      ASSERT_EQ(Scan(&index, make_key(key)), std::vector<RID>{RID(key)}) << key;
+    }
+  }
+  delete table_schema;
+  delete bpm;
+  delete disk_manager;
+  RemoveFiles();
+}
+
+TEST(LSMIndexTest, BackgroundErrorTest) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  auto *disk_manager = new FailingDiskManager("test.db");
+  auto *bpm = new BufferPoolManager(50, disk_manager);
+  {
+    LSMIndex16 index(new IndexMetadata("lsm_index", "foo", table_schema, {0}), bpm, 100);
+    auto make_key = [&](int64_t a) { return Tuple({ValueFactory::GetBigIntValue(a)}, index.GetKeySchema()); };
+    for (int64_t key = 0; key < 150; key++) {
+      index.InsertEntry(make_key(key), RID(key), nullptr);
+    }
+    index.Flush();
+    EXPECT_EQ(index.GetRunCount(), 2);
+
+    // the memtable filled by the last insert cannot be written out, Flush reports it and the entries stay readable
+    disk_manager->failures_ = 1;
+    for (int64_t key = 150; key < 250; key++) {
+      index.InsertEntry(make_key(key), RID(key), nullptr);
+    }
+    EXPECT_THROW(index.Flush(), Exception);
+    EXPECT_EQ(index.GetRunCount(), 2);
+    for (int64_t key = 0; key < 250; key++) {
+      ASSERT_EQ(Scan(&index, make_key(key)), std::vector<RID>{RID(key)}) << key;
+    }
+
+    // once the failure has been reported, the background thread tries again
+    index.Flush();
+    EXPECT_EQ(index.GetRunCount(), 3);
+    for (int64_t key = 0; key < 250; key++) {
+      ASSERT_EQ(Scan(&index, make_key(key)), std::vector<RID>{RID(key)}) << key;
+    }
+  }
+  delete table_schema;
+  delete bpm;
+  delete disk_manager;
+  RemoveFiles();
+}
+
+// Benchmark: random inserts into an LSMIndex against a BPlusTreeIndex, with a buffer pool that holds a fraction of
+// the tree, so that the tree reads and writes back leaf pages while the LSM index only appends runs. It only prints
+// timings, so it is disabled; run it with --gtest_also_run_disabled_tests.
+TEST(LSMIndexTest, DISABLED_Benchmark) {
+  Schema *table_schema = ParseCreateStatement("a bigint");
+  using TreeIndex = BPlusTreeIndex<GenericKey<16>, RID, GenericComparator<16>>;
+  const int64_t num_keys = 100000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < num_keys; key++) {
+    keys.push_back(key * 7919 % num_keys);
+  }
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(64, disk_manager);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  {
+    LSMIndex16 lsm(new IndexMetadata("lsm_index", "foo", table_schema, {0}), bpm);
+    TreeIndex tree(new IndexMetadata("tree_index", "foo", table_schema, {0}), bpm);
+    Transaction transaction(0);
+    for (Index *index : std::vector<Index *>{&tree, &lsm}) {
+      const char *name = index == &lsm ? "LSMIndex" : "BPlusTreeIndex";
+      std::vector<Tuple> tuples;
+      for (auto key : keys) {
+        tuples.emplace_back(std::vector<Value>{ValueFactory::GetBigIntValue(key)}, index->GetKeySchema());
+      }
+      auto start = std::chrono::steady_clock::now();
+      for (int64_t i = 0; i < num_keys; i++) {
+        index->InsertEntry(tuples[i], RID(keys[i]), &transaction);
+      }
+      if (index == &lsm) {
+        lsm.Flush();
+      }
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      std::cout << name << ": " << static_cast<double>(elapsed.count()) / num_keys << " ns/insert" << std::endl;
+
+      int64_t found = 0;
+      start = std::chrono::steady_clock::now();
+      std::vector<RID> rids;
+      for (int64_t i = 0; i < num_keys; i++) {
+        rids.clear();
+        index->ScanKey(tuples[i], &rids, &transaction);
+        found += static_cast<int64_t>(rids.size());
+      }
+      elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      EXPECT_EQ(found, num_keys);
+      std::cout << name << ": " << static_cast<double>(elapsed.count()) / num_keys << " ns/lookup" << std::endl;
+    }
+    std::cout << "LSMIndex: " << lsm.GetRunCount() << " run(s) after " << lsm.GetCompactionCount()
+              << " compaction(s)" << std::endl;
+  }
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete table_schema;
+  delete bpm;
+  delete disk_manager;
+  RemoveFiles();
+}
+
+}  // namespace bustub